@@ -0,0 +1,47 @@
+char buffer[1024];
+
+int crc32(char *data, int length)
+{
+    int crc = -1;
+    int i;
+    int bit;
+    for (i = 0; i < length; i++)
+    {
+        crc = crc ^ (data[i] & 255);
+        for (bit = 0; bit < 8; bit++)
+        {
+            if (crc & 1)
+            {
+                crc = ((crc >> 1) & 2147483647) ^ -306674912;
+            }
+            else
+            {
+                crc = (crc >> 1) & 2147483647;
+            }
+        }
+    }
+    return ~crc;
+}
+
+int main()
+{
+    int i;
+    for (i = 0; i < 1024; i++)
+    {
+        buffer[i] = (i * 31 + 7) & 255;
+    }
+    buffer[0] = '1';
+    buffer[1] = '2';
+    buffer[2] = '3';
+    buffer[3] = '4';
+    buffer[4] = '5';
+    buffer[5] = '6';
+    buffer[6] = '7';
+    buffer[7] = '8';
+    buffer[8] = '9';
+    if (crc32(buffer, 9) != -873187034)
+    {
+        return 1;
+    }
+    return crc32(buffer, 1024) == 0;
+}
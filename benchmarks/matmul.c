@@ -0,0 +1,55 @@
+int a[576];
+int b[576];
+int c[576];
+
+void multiply(int n)
+{
+    int i;
+    int j;
+    int k;
+    int sum;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            sum = 0;
+            for (k = 0; k < n; k++)
+            {
+                sum += a[i * n + k] * b[k * n + j];
+            }
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+int main()
+{
+    int i;
+    int j;
+    int total = 0;
+    int expected = 0;
+    int rowSum;
+    int colSum;
+    for (i = 0; i < 24; i++)
+    {
+        for (j = 0; j < 24; j++)
+        {
+            a[i * 24 + j] = (i * 7 + j * 3) % 11 - 5;
+            b[i * 24 + j] = (i * 5 + j * 13) % 17 - 8;
+        }
+    }
+    multiply(24);
+    for (i = 0; i < 24; i++)
+    {
+        colSum = 0;
+        rowSum = 0;
+        for (j = 0; j < 24; j++)
+        {
+            colSum += a[j * 24 + i];
+            rowSum += b[i * 24 + j];
+            total += c[i * 24 + j];
+        }
+        expected += colSum * rowSum;
+    }
+    return total != expected;
+}
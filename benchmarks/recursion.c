@@ -0,0 +1,35 @@
+int fib(int n)
+{
+    if (n < 2)
+    {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+int ackermann(int m, int n)
+{
+    if (m == 0)
+    {
+        return n + 1;
+    }
+    if (n == 0)
+    {
+        return ackermann(m - 1, 1);
+    }
+    return ackermann(m - 1, ackermann(m, n - 1));
+}
+
+int hanoi(int n, int from, int to, int via)
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+    return hanoi(n - 1, from, via, to) + 1 + hanoi(n - 1, via, to, from);
+}
+
+int main()
+{
+    return !(fib(18) == 2584 && ackermann(2, 3) == 9 && hanoi(10, 1, 3, 2) == 1023);
+}
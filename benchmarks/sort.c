@@ -0,0 +1,86 @@
+int keys[512];
+int copy[512];
+
+int nextKey(int seed)
+{
+    return (seed * 1103515245 + 12345) & 0x7fffffff;
+}
+
+void quickSort(int *a, int low, int high)
+{
+    int pivot;
+    int i;
+    int j;
+    int t;
+    if (low >= high)
+    {
+        return;
+    }
+    pivot = a[(low + high) / 2];
+    i = low;
+    j = high;
+    while (i <= j)
+    {
+        while (a[i] < pivot)
+        {
+            i++;
+        }
+        while (a[j] > pivot)
+        {
+            j--;
+        }
+        if (i <= j)
+        {
+            t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+            i++;
+            j--;
+        }
+    }
+    quickSort(a, low, j);
+    quickSort(a, i, high);
+}
+
+void insertionSort(int *a, int n)
+{
+    int i;
+    int j;
+    int key;
+    for (i = 1; i < n; i++)
+    {
+        key = a[i];
+        j = i - 1;
+        while (j >= 0 && a[j] > key)
+        {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = key;
+    }
+}
+
+int main()
+{
+    int seed = 42;
+    int i;
+    int sum = 0;
+    for (i = 0; i < 512; i++)
+    {
+        seed = nextKey(seed);
+        keys[i] = seed % 10000;
+        copy[i] = keys[i];
+        sum += keys[i];
+    }
+    quickSort(keys, 0, 511);
+    insertionSort(copy, 512);
+    for (i = 0; i < 512; i++)
+    {
+        if (keys[i] != copy[i] || (i > 0 && keys[i - 1] > keys[i]))
+        {
+            return 1;
+        }
+        sum -= keys[i];
+    }
+    return sum != 0;
+}
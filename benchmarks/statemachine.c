@@ -0,0 +1,96 @@
+int classify(int c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return 1;
+    }
+    if ((c >= 'a' && c <= 'z') || c == '_')
+    {
+        return 2;
+    }
+    if (c == ' ')
+    {
+        return 3;
+    }
+    return 4;
+}
+
+int identifiers;
+int operators;
+
+int lex(char *input)
+{
+    int state = 0;
+    int value = 0;
+    int sum = 0;
+    int i = 0;
+    int c;
+    int kind;
+    identifiers = 0;
+    operators = 0;
+    while (1)
+    {
+        c = input[i];
+        switch (state)
+        {
+        case 0:
+            if (c == 0)
+            {
+                return sum;
+            }
+            kind = classify(c);
+            if (kind == 1)
+            {
+                value = c - '0';
+                state = 1;
+            }
+            else if (kind == 2)
+            {
+                state = 2;
+            }
+            else if (kind == 4)
+            {
+                operators += 1;
+            }
+            i++;
+            break;
+        case 1:
+            if (classify(c) == 1)
+            {
+                value = value * 10 + c - '0';
+                i++;
+            }
+            else
+            {
+                sum += value;
+                state = 0;
+            }
+            break;
+        case 2:
+            if (classify(c) == 1 || classify(c) == 2)
+            {
+                i++;
+            }
+            else
+            {
+                identifiers += 1;
+                state = 0;
+            }
+            break;
+        default:
+            return -1;
+        }
+    }
+}
+
+int main()
+{
+    char *input = "total = price_1 * 12 + tax * 7 - discount / 3 + 100 * (rate + 25) - offset_2 % 9 + 4096";
+    int sum = 0;
+    int round;
+    for (round = 0; round < 10; round++)
+    {
+        sum = lex(input);
+    }
+    return !(sum == 4252 && identifiers == 6 && operators == 14);
+}
@@ -0,0 +1,81 @@
+int isLetter(int c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+int isVowel(int c)
+{
+    return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+}
+
+int length(char *s)
+{
+    int n = 0;
+    while (s[n] != 0)
+    {
+        n++;
+    }
+    return n;
+}
+
+int countMatches(char *text, char *pattern)
+{
+    int n = length(text);
+    int m = length(pattern);
+    int count = 0;
+    int i;
+    int j;
+    for (i = 0; i + m <= n; i++)
+    {
+        j = 0;
+        while (j < m && text[i + j] == pattern[j])
+        {
+            j++;
+        }
+        if (j == m)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+int main()
+{
+    char *text = "the quick brown fox jumps over the lazy dog and then the dog chases the fox around the farm until the farmer comes out of the house and tells them both to stop making noise because there are other animals trying to sleep in the barn on the other side of the hill";
+    int words = 0;
+    int vowels = 0;
+    int longest = 0;
+    int current = 0;
+    int round;
+    int i;
+    int matches = 0;
+    for (round = 0; round < 8; round++)
+    {
+        words = 0;
+        vowels = 0;
+        longest = 0;
+        current = 0;
+        for (i = 0; text[i] != 0; i++)
+        {
+            if (isLetter(text[i]))
+            {
+                current++;
+                vowels += isVowel(text[i]);
+            }
+            else if (current != 0)
+            {
+                words++;
+                longest = current > longest ? current : longest;
+                current = 0;
+            }
+        }
+        if (current != 0)
+        {
+            words++;
+            longest = current > longest ? current : longest;
+        }
+        matches = countMatches(text, "the");
+    }
+    return !(words == 53 && longest == 7 && matches == 15 && vowels == 78);
+}
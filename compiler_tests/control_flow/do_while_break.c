@@ -0,0 +1,18 @@
+int f(int n)
+{
+    int i = 0;
+    do
+    {
+        i++;
+        if (i == n)
+        {
+            break;
+        }
+        if (i < 3)
+        {
+            continue;
+        }
+        i = i + 10;
+    } while (i < 100);
+    return i;
+}
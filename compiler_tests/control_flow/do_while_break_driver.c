@@ -0,0 +1,6 @@
+int f(int n);
+
+int main()
+{
+    return !(f(2)==2 && f(50)==101);
+}
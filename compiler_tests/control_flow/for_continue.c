@@ -0,0 +1,14 @@
+int f(int n)
+{
+    int i;
+    int sum = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (i == 2)
+        {
+            continue;
+        }
+        sum = sum + i;
+    }
+    return sum;
+}
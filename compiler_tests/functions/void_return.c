@@ -0,0 +1,17 @@
+void step(int n, int *total)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    step(n - 1, total);
+    *total = *total * 2 + n;
+}
+
+int f(int n)
+{
+    int total;
+    total = 1;
+    step(n, &total);
+    return total;
+}
@@ -0,0 +1,17 @@
+int first;
+int second;
+int third;
+
+int f()
+{
+    int *p;
+    int *q;
+    int *r;
+    p = &first;
+    q = &second;
+    r = &third;
+    *p = 1;
+    *q = 2;
+    *r = 3;
+    return *p * 100 + *q * 10 + *r;
+}
@@ -0,0 +1,12 @@
+int f(int *p)
+{
+    int a[4];
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        a[i] = i;
+    }
+    a[2] = p[1] + a[3];
+    *(p + 3) = a[2] * a[1];
+    return p[3] + a[2] + p[0];
+}
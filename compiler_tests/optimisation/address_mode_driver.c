@@ -0,0 +1,9 @@
+int f(int *p);
+
+int main()
+{
+    int b[4];
+    b[0] = 1;
+    b[1] = 5;
+    return !(f(b) == 17);
+}
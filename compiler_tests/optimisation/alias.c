@@ -0,0 +1,24 @@
+int g = 3;
+
+int scale(int v)
+{
+    return v * g;
+}
+
+int f(int n)
+{
+    int a[4];
+    int b[4];
+    int i;
+    int s;
+    a[1] = n;
+    b[1] = 2;
+    s = a[1] + b[1];
+    b[2] = a[1] * 5;
+    s = s + a[1] * 5 + b[2];
+    for (i = 0; i < n; i++)
+    {
+        s = s + scale(i) + g;
+    }
+    return s;
+}
@@ -0,0 +1,17 @@
+int f(int x)
+{
+    int debug = 0;
+    while (0)
+    {
+        x = 100;
+    }
+    if (debug)
+    {
+        return -1;
+    }
+    if (!debug && 1)
+    {
+        x = x + 1;
+    }
+    return x;
+}
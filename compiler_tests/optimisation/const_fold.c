@@ -0,0 +1,4 @@
+int f(int x)
+{
+    return 2 * 4 + x - (10 / 3) % 2 + (1 << 4) + sizeof(int) + (3 > 2 ? 5 : 7);
+}
@@ -0,0 +1,6 @@
+int f()
+{
+    unsigned int x = 0 - 1;
+    int y = -7 / 2;
+    return (x > 5) + (-1 < 0) + (y == -3) + ((0 - 8) >> 1 == -4);
+}
@@ -0,0 +1,21 @@
+int f(int n)
+{
+    int a = 3;
+    int b;
+    b = a * 5;
+    if (n)
+    {
+        a = 4;
+    }
+    else
+    {
+        a = 4;
+    }
+    b += a;
+    while (n > 0)
+    {
+        b = b + 1;
+        n--;
+    }
+    return a + b;
+}
@@ -0,0 +1,26 @@
+int f(int x, int y)
+{
+    int a[4];
+    int i;
+    int s;
+    for (i = 0; i < 4; i++)
+    {
+        a[i] = x * i + y;
+    }
+    s = x * y + x * y;
+    i = 2;
+    s = s + a[i] + a[i];
+    if (s > 0)
+    {
+        s = s + x * y;
+    }
+    else
+    {
+        s = s - x * y;
+    }
+    y = y + 1;
+    s = s + x * y;
+    a[i] = 1;
+    s = s + a[i];
+    return s;
+}
@@ -0,0 +1,24 @@
+int f(int n)
+{
+    int a;
+    int b;
+    int c;
+    int i;
+    a = n;
+    b = a;
+    c = b * 2;
+    c = a + b;
+    for (i = 0; i < 3; i++)
+    {
+        int d;
+        d = c;
+        c = d + i;
+        if (c > 100)
+        {
+            break;
+            c = 0;
+        }
+    }
+    return c;
+    c = 1;
+}
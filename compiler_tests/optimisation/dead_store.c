@@ -0,0 +1,16 @@
+int f(int n)
+{
+    int x;
+    int y = 0;
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        x = i * 2;
+        if (i > 2)
+        {
+            y = y + x;
+        }
+    }
+    x = y * 3;
+    return x + 1;
+}
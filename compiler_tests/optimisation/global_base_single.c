@@ -0,0 +1,29 @@
+int table[64];
+int other[64];
+
+int readOnce(int i)
+{
+    return table[i];
+}
+
+int sumAll(int n)
+{
+    int i;
+    int total;
+    total = 0;
+    for (i = 0; i < n; i++)
+    {
+        total = total + other[i];
+    }
+    return total;
+}
+
+void fill(int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        table[i] = i;
+        other[i] = i * 2;
+    }
+}
@@ -0,0 +1,9 @@
+void fill(int n);
+int readOnce(int i);
+int sumAll(int n);
+
+int main()
+{
+    fill(64);
+    return !(readOnce(5) == 5 && readOnce(63) == 63 && sumAll(10) == 90);
+}
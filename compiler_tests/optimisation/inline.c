@@ -0,0 +1,30 @@
+int square(int x)
+{
+    return x * x;
+}
+
+int clamp(int x, int low, int high)
+{
+    if (x < low)
+    {
+        return low;
+    }
+    if (x > high)
+    {
+        return high;
+    }
+    return x;
+}
+
+int f(int n)
+{
+    int i;
+    int sum = 0;
+    for (i = 0; i < n; i++)
+    {
+        int c;
+        c = clamp(i * 3, 2, 20);
+        sum = sum + square(c) + clamp(i, 1, 3);
+    }
+    return sum;
+}
@@ -0,0 +1,17 @@
+int mix(int a, int b)
+{
+    int r = 0;
+    int i;
+    for (i = 0; i < b; i++)
+    {
+        r = r * 31 + a;
+        r = r ^ (r >> 3);
+        r = r & 65535;
+    }
+    return r;
+}
+
+int f(int n)
+{
+    return n * 3 + mix(n, 4) + (n + 1) * mix(n + 1, 2);
+}
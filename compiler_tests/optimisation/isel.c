@@ -0,0 +1,16 @@
+int f(int n)
+{
+    int i;
+    int s = 0;
+    unsigned int u = 40;
+    for (i = 0; i < n; i++)
+    {
+        if (i != 3)
+        {
+            s = s + i * 4 - 1;
+        }
+        s = s ^ 5;
+    }
+    u = u / 8;
+    return (s > 100 ? s & 255 : s) + (s >> 2) + u + (i <= n) + !s;
+}
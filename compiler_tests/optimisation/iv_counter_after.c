@@ -0,0 +1,32 @@
+int squares[20];
+int values[10];
+
+int f(int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < 20; i++)
+    {
+        squares[i] = i * i;
+    }
+    for (i = 1; i < n; i += 2)
+    {
+        s += squares[i];
+    }
+    return s * 1000 + i;
+}
+
+int g(int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < 10; i++)
+    {
+        values[i] = i;
+    }
+    for (i = n; i >= 0; i--)
+    {
+        s += values[i];
+    }
+    return s * 100 + i;
+}
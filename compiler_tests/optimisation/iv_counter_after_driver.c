@@ -0,0 +1,7 @@
+int f(int n);
+int g(int n);
+
+int main()
+{
+    return !(f(2) == 1003 && g(7) == 2799);
+}
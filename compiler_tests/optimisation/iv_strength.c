@@ -0,0 +1,22 @@
+int f(int n)
+{
+    int a[8];
+    int b[8];
+    int i;
+    int total;
+    for (i = 0; i < 8; i++)
+    {
+        a[i] = i;
+        b[i] = i * 2;
+    }
+    total = 0;
+    for (i = 0; i < n; i++)
+    {
+        total += a[i] + b[i];
+    }
+    for (i = 7; i >= 0; i -= 2)
+    {
+        total += a[i];
+    }
+    return total;
+}
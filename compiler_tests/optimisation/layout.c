@@ -0,0 +1,17 @@
+int f(int *a, int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (a[i] == 5)
+        {
+            s = s - 100;
+        }
+        else
+        {
+            s = s + a[i];
+        }
+    }
+    return s;
+}
@@ -0,0 +1,12 @@
+int f(int *a, int n);
+
+int main()
+{
+    int a[32];
+    int i;
+    for (i = 0; i < 32; i++)
+    {
+        a[i] = i;
+    }
+    return !(f(a, 32) == 391);
+}
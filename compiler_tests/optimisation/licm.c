@@ -0,0 +1,19 @@
+int scale = 3;
+
+int f(int n)
+{
+    int i;
+    int total;
+    total = 0;
+    for (i = 0; i < n; i++)
+    {
+        total += scale * 2 + i;
+    }
+    i = 0;
+    while (i < n * 2 - n)
+    {
+        total += i;
+        i++;
+    }
+    return total;
+}
@@ -0,0 +1,6 @@
+int f(int n);
+
+int main()
+{
+    return !(f(4) == 36);
+}
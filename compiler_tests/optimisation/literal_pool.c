@@ -0,0 +1,7 @@
+int f()
+{
+    char *s = "hello";
+    char *t = "hello";
+    char *u = "llo";
+    return (s == t) + (u == s + 2) + u[0];
+}
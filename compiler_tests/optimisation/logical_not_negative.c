@@ -0,0 +1,4 @@
+int f(int x)
+{
+    return !x + (x && 1) * 2 + (x || 0) * 4;
+}
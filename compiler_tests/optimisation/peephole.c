@@ -0,0 +1,15 @@
+int f(int x)
+{
+    int y;
+    int z;
+    y = x;
+    z = y;
+    if (x)
+    {
+    }
+    while (z > 100)
+    {
+        z = z - 1;
+    }
+    return y + z;
+}
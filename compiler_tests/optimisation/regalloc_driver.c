@@ -0,0 +1,11 @@
+int f(int n);
+
+int g(int x)
+{
+    return x + 1;
+}
+
+int main()
+{
+    return !(f(0) == -788791296);
+}
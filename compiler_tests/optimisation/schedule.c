@@ -0,0 +1,10 @@
+int f(int *a, int n)
+{
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i++)
+    {
+        s = s + a[i] * a[i] + i / 3;
+    }
+    return s;
+}
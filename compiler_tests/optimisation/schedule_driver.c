@@ -0,0 +1,12 @@
+int f(int *a, int n);
+
+int main()
+{
+    int a[8];
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        a[i] = i;
+    }
+    return !(f(a, 8) == 147);
+}
@@ -0,0 +1,12 @@
+int f(int *p)
+{
+    int a[4];
+    int i;
+    a[0] = 1;
+    a[1] = 2;
+    a[2] = 3;
+    a[3] = p[1] + a[2];
+    i = a[3] * a[1];
+    p[3] = i;
+    return i + a[3] + p[0];
+}
@@ -0,0 +1,11 @@
+int f(int *p);
+
+int main()
+{
+    int b[4];
+    b[0] = 5;
+    b[1] = 7;
+    b[2] = 0;
+    b[3] = 0;
+    return !(f(b) == 35 && b[3] == 20);
+}
@@ -0,0 +1,14 @@
+int counter;
+int table[16];
+
+int f(int n)
+{
+    int i;
+    for (i = 0; i < 16; i++)
+    {
+        table[i] = i * n;
+    }
+    counter = table[3] + table[15];
+    counter++;
+    return counter + table[2];
+}
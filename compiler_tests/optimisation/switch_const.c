@@ -0,0 +1,18 @@
+int f()
+{
+    int mode = 2;
+    int x = 0;
+    switch (mode)
+    {
+    case 1:
+        x = 10;
+        break;
+    case 2:
+    case 3:
+        x = 20;
+        break;
+    default:
+        x = 30;
+    }
+    return x;
+}
@@ -0,0 +1,25 @@
+int f()
+{
+    int x = 0;
+    switch (2)
+    {
+    case 1:
+    {
+        x = 10;
+        break;
+    }
+    case 2:
+    {
+        x = 20;
+        break;
+    }
+    case 3:
+    {
+        x = 40;
+        break;
+    }
+    default:
+        x = 30;
+    }
+    return x;
+}
@@ -0,0 +1,35 @@
+int g(int m)
+{
+    int x = 0;
+    switch (m)
+    {
+    case -1:
+        x = 10;
+        break;
+    case -2:
+        x = 20;
+        break;
+    default:
+        x = 30;
+    }
+    return x;
+}
+
+int f()
+{
+    int x = 0;
+    switch (-2)
+    {
+    case -1:
+        x = 10;
+        break;
+    case -2:
+        x = 20;
+        break;
+    case 5:
+        return 7;
+    default:
+        x = 30;
+    }
+    return x + g(-1) + g(-2) + g(4);
+}
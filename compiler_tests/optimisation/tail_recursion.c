@@ -0,0 +1,28 @@
+int sum(int n)
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+    return n + sum(n - 1);
+}
+
+int gcd(int a, int b)
+{
+    if (b == 0)
+    {
+        return a;
+    }
+    return gcd(b, a % b);
+}
+
+int finish(int x)
+{
+    return x - 1;
+}
+
+int f(int n)
+{
+    int total = sum(n) + gcd(n * 6, 84);
+    return finish(total);
+}
@@ -0,0 +1,15 @@
+int pick(int j, int p0)
+{
+    return (j ? (j % 2) : (p0 < 0)) ? -1 : 5;
+}
+
+int accumulate(int n)
+{
+    int j;
+    int p0 = 0;
+    for (j = 0; j < n; j++)
+    {
+        p0 += (j ? (j % 2) : (p0 < 0)) ? 3 : 10;
+    }
+    return p0;
+}
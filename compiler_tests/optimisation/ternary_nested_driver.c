@@ -0,0 +1,7 @@
+int pick(int j, int p0);
+int accumulate(int n);
+
+int main()
+{
+    return !(pick(0, -4) == -1 && pick(2, 1) == 5 && pick(3, 1) == -1 && accumulate(6) == 39);
+}
@@ -0,0 +1,20 @@
+int f(int n)
+{
+    int a[4];
+    int i;
+    int total;
+    for (i = 0; i < 4; i++)
+    {
+        a[i] = i + 1;
+    }
+    total = 0;
+    for (i = 0; i < 32; i++)
+    {
+        total += i;
+    }
+    for (i = 0; i < n; i++)
+    {
+        total += a[i & 3] * i;
+    }
+    return total + i;
+}
@@ -0,0 +1,11 @@
+int f(int n)
+{
+    int i;
+    for (i = 0; i < n; i += 3)
+    {
+    }
+    for (i = 1; i < 16; i += 2)
+    {
+    }
+    return i;
+}
@@ -0,0 +1,35 @@
+int upTo(int start, int limit)
+{
+    int i;
+    int total;
+    total = 0;
+    for (i = start; i < limit; i++)
+    {
+        total = total + (i & 7);
+    }
+    return total;
+}
+
+int upToMax(int start)
+{
+    int i;
+    int total;
+    total = 0;
+    for (i = start; i < 2147483647; i++)
+    {
+        total = total + (i & 7);
+    }
+    return total;
+}
+
+int downTo(int start, int limit)
+{
+    int i;
+    int total;
+    total = 0;
+    for (i = start; i > limit; i--)
+    {
+        total = total + (i & 7);
+    }
+    return total;
+}
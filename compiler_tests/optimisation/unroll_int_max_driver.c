@@ -0,0 +1,10 @@
+int upTo(int start, int limit);
+int upToMax(int start);
+int downTo(int start, int limit);
+
+int main()
+{
+    return !(upTo(2147483641, 2147483647) == 21 && upTo(2147483640, 2147483647) == 21 && upToMax(2147483641) == 21 &&
+             upToMax(2147483640) == 21 && upTo(0, 10) == 29 && downTo(-2147483641, -2147483647 - 1) == 28 &&
+             downTo(10, 0) == 31);
+}
@@ -0,0 +1,365 @@
+#!/usr/bin/env python3
+
+"""
+Measures the code the compiler generates for the kernels in benchmarks/. Each
+kernel is compiled by bin/c_compiler and run on bin/rvsim, which reports the
+static code size, the dynamic instruction count and the cycles estimated for a
+pipeline model. Every kernel returns 0 from main when it computed the right
+answer, so a miscompiled kernel shows up as a failure rather than a speedup.
+
+The numbers are compared with benchmarks/baseline.txt, or with the compiler of
+another revision built in a git worktree, so the deltas of a commit are visible.
+
+Usage: bench.py [-h] [--update] [--against REV] [--gcc] [--model MODEL]
+                [--cflags CFLAGS] [--no_build] [benchmark ...]
+
+Example usage: scripts/bench.py --against HEAD~1 sort crc
+
+This will compare sort and crc as compiled by the working tree against the
+compiler of the previous commit. Assembly and logs are kept in bin/bench.
+"""
+
+
+import sys
+import shlex
+import shutil
+import argparse
+import subprocess
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, List, Optional
+
+
+RED = "\033[31m"
+GREEN = "\033[32m"
+RESET = "\033[0m"
+
+if not sys.stdout.isatty():
+    # Don't output colours when we're not in a TTY
+    RED, GREEN, RESET = "", "", ""
+
+SCRIPT_LOCATION = Path(__file__).resolve().parent
+PROJECT_LOCATION = SCRIPT_LOCATION.joinpath("..").resolve()
+OUTPUT_FOLDER = PROJECT_LOCATION.joinpath("bin/bench").resolve()
+BENCHMARK_FOLDER = PROJECT_LOCATION.joinpath("benchmarks").resolve()
+BASELINE_FILE = BENCHMARK_FOLDER.joinpath("baseline.txt").resolve()
+COMPILER_FILE = PROJECT_LOCATION.joinpath("bin/c_compiler").resolve()
+SIMULATOR_FILE = PROJECT_LOCATION.joinpath("bin/rvsim").resolve()
+WORKTREE_FOLDER = OUTPUT_FOLDER.joinpath("worktree").resolve()
+
+GCC = "riscv64-unknown-elf-gcc"
+# gcc would otherwise turn copy loops into calls of memcpy, which bin/rvsim does not provide
+GCC_FLAGS = ["-march=rv32imfd", "-mabi=ilp32d", "-fno-tree-loop-distribute-patterns"]
+
+METRICS = ["static-size", "instructions", "cycles"]
+DEFAULT_MODEL = "rocket"
+
+BUILD_TIMEOUT_SECONDS = 120
+RUN_TIMEOUT_SECONDS = 60
+
+@dataclass
+class Measurement:
+    """The numbers of one benchmark under one compiler"""
+    benchmark: str
+    passed: bool
+    stats: Dict[str, int] = field(default_factory=dict)
+    error_log: str = ""
+
+def run_subprocess(cmd: List[str], timeout: int, log_path: Optional[Path] = None) -> tuple[int, str]:
+    """
+    Wrapper for subprocess.run(...) that keeps stdout in log_path and hands back stderr.
+
+    Returns tuple of (return_code: int, stderr: str)
+    """
+    stdout = open(log_path, "w") if log_path else subprocess.DEVNULL
+    try:
+        process = subprocess.run(cmd, stdout=stdout, stderr=subprocess.PIPE, text=True, timeout=timeout)
+    except subprocess.TimeoutExpired as e:
+        return 124, f"{e.cmd} took more than {e.timeout} seconds"
+    except OSError as e:
+        return 127, str(e)
+    finally:
+        if log_path:
+            stdout.close()
+    return process.returncode, process.stderr
+
+def make(project: Path, targets: List[str]) -> bool:
+    """
+    Wrapper for make of the given targets in project.
+
+    Return True if successful, False otherwise
+    """
+    print(GREEN + f"Running make in {project}..." + RESET)
+    return_code, error_msg = run_subprocess(["make", "-C", str(project), *targets], BUILD_TIMEOUT_SECONDS)
+    if return_code != 0:
+        print(RED + "Error when making:\n" + error_msg + RESET)
+        return False
+    return True
+
+def measure(benchmark: Path, compile_cmd: List[str], label: str, model: str) -> Measurement:
+    """
+    Compiles one benchmark with compile_cmd, to which "-S <source> -o <asm>" is
+    appended, and runs it on the simulator.
+    """
+    log_path = OUTPUT_FOLDER.joinpath(label, benchmark.stem)
+    log_path.parent.mkdir(parents=True, exist_ok=True)
+
+    return_code, error_msg = run_subprocess(
+        [*compile_cmd, "-S", str(benchmark), "-o", f"{log_path}.s"],
+        RUN_TIMEOUT_SECONDS,
+        Path(f"{log_path}.compiler.log"),
+    )
+    if return_code != 0:
+        return Measurement(benchmark.stem, False, error_log=f"failed to compile ({return_code})\n{error_msg}")
+
+    return_code, stats_log = run_subprocess(
+        [str(SIMULATOR_FILE), "--stats", "--model", model, f"{log_path}.s"],
+        RUN_TIMEOUT_SECONDS,
+        Path(f"{log_path}.simulation.log"),
+    )
+    Path(f"{log_path}.stats.log").write_text(stats_log)
+    if return_code != 0:
+        return Measurement(benchmark.stem, False, error_log=f"exited with {return_code}, see {log_path}.stats.log")
+
+    stats = {}
+    for line in stats_log.splitlines():
+        words = line.split()
+        if len(words) == 2 and words[0] in METRICS:
+            stats[words[0]] = int(words[1])
+    return Measurement(benchmark.stem, True, stats)
+
+def measure_all(benchmarks: List[Path], compile_cmd: List[str], label: str, model: str) -> Dict[str, Measurement]:
+    return {benchmark.stem: measure(benchmark, compile_cmd, label, model) for benchmark in benchmarks}
+
+def read_baseline(model: str) -> Optional[Dict[str, Measurement]]:
+    """
+    Reads benchmarks/baseline.txt, which holds a line "model <name>" followed by
+    one line "<benchmark> <static-size> <instructions> <cycles>" per benchmark.
+    """
+    if not BASELINE_FILE.exists():
+        print(RED + f"No baseline in {BASELINE_FILE}, create it with --update" + RESET)
+        return None
+
+    baseline = {}
+    for line in BASELINE_FILE.read_text().splitlines():
+        words = line.split()
+        if not words or words[0].startswith("#"):
+            continue
+        if words[0] == "model":
+            if words[1] != model:
+                print(RED + f"The baseline was recorded for the {words[1]} model, not {model}" + RESET)
+                return None
+            continue
+        stats = dict(zip(METRICS, map(int, words[1:])))
+        baseline[words[0]] = Measurement(words[0], True, stats)
+    return baseline
+
+def write_baseline(results: Dict[str, Measurement], model: str):
+    lines = [
+        "# recorded by scripts/bench.py --update, compare with scripts/bench.py",
+        "# benchmark " + " ".join(METRICS),
+        f"model {model}",
+    ]
+    for name, result in sorted(results.items()):
+        lines.append(name + " " + " ".join(str(result.stats[metric]) for metric in METRICS))
+    BASELINE_FILE.write_text("\n".join(lines) + "\n")
+    print(GREEN + f"Baseline written to {BASELINE_FILE}" + RESET)
+
+def format_delta(value: int, reference: Optional[int]) -> str:
+    if reference is None:
+        return ""
+    if reference == value:
+        return "="
+    percent = (value - reference) / reference * 100 if reference != 0 else float("inf")
+    colour = GREEN if value < reference else RED
+    return colour + f"{percent:+.1f}%" + RESET
+
+def pad(text: str, width: int) -> str:
+    # colour codes take no room on the terminal but count towards the padding
+    visible = text.replace(GREEN, "").replace(RED, "").replace(RESET, "")
+    return " " * max(width - len(visible), 0) + text
+
+def report(results: Dict[str, Measurement], reference: Optional[Dict[str, Measurement]], reference_name: str):
+    """
+    Prints each metric of every benchmark with its change against the reference,
+    lower is better for all of them.
+    """
+    if reference is not None:
+        print(f"\n>> Against {reference_name}")
+    print((f"{'benchmark':<14}" + "".join(f"{metric:>16}" + " " * 10 for metric in METRICS)).rstrip())
+
+    totals = {metric: [0, 0] for metric in METRICS}
+    for name, result in sorted(results.items()):
+        if not result.passed:
+            print(f"{name:<14}" + RED + f"FAILED: {result.error_log.strip()}" + RESET)
+            continue
+        old = reference.get(name) if reference is not None else None
+        note = ""
+        if old is not None and not old.passed:
+            note = GREEN + "  failed before" + RESET
+            old = None
+        row = f"{name:<14}"
+        for metric in METRICS:
+            value = result.stats[metric]
+            old_value = old.stats.get(metric) if old is not None else None
+            if old_value is not None:
+                totals[metric][0] += value
+                totals[metric][1] += old_value
+            delta = format_delta(value, old_value)
+            row += f"{value:>16} " + pad(delta, 9)
+        print(row.rstrip() + note)
+
+    if reference is not None:
+        print(f"{'total':<14}" + "".join(
+            " " * 17 + pad(format_delta(value, old_value) if old_value else "", 9) for value, old_value in totals.values()
+        ))
+
+def report_gcc(results: Dict[str, Measurement], gcc_results: Dict[str, Dict[str, Measurement]]):
+    """
+    Prints the dynamic instructions and cycles of every benchmark next to those of gcc,
+    with the cycles of ours over theirs.
+    """
+    print("\n>> Against " + GCC + ", instructions/cycles")
+    print(f"{'benchmark':<14}{'ours':>24}" + "".join(f"{level:>24}{'ratio':>8}" for level in gcc_results))
+    for name, result in sorted(results.items()):
+        if not result.passed:
+            continue
+        row = f"{name:<14}" + f"{result.stats['instructions']}/{result.stats['cycles']}".rjust(24)
+        for measurements in gcc_results.values():
+            theirs = measurements[name]
+            if not theirs.passed:
+                row += f"{'failed':>24}{'':>8}"
+                continue
+            ratio = result.stats["cycles"] / theirs.stats["cycles"]
+            row += f"{theirs.stats['instructions']}/{theirs.stats['cycles']}".rjust(24) + f"{ratio:>8.2f}"
+        print(row)
+
+def measure_revision(revision: str, benchmarks: List[Path], model: str, cflags: List[str]) -> Optional[Dict[str, Measurement]]:
+    """
+    Builds the compiler of another revision in a git worktree and measures it with
+    the simulator of this tree, so both see the same cost model.
+    """
+    if WORKTREE_FOLDER.exists():
+        run_subprocess(["git", "-C", str(PROJECT_LOCATION), "worktree", "remove", "--force", str(WORKTREE_FOLDER)],
+                       BUILD_TIMEOUT_SECONDS)
+        shutil.rmtree(WORKTREE_FOLDER, ignore_errors=True)
+
+    return_code, error_msg = run_subprocess(
+        ["git", "-C", str(PROJECT_LOCATION), "worktree", "add", "--detach", str(WORKTREE_FOLDER), revision],
+        BUILD_TIMEOUT_SECONDS,
+    )
+    if return_code != 0:
+        print(RED + f"Unable to check out {revision}:\n" + error_msg + RESET)
+        return None
+
+    try:
+        if not make(WORKTREE_FOLDER, ["bin/c_compiler"]):
+            return None
+        compiler = WORKTREE_FOLDER.joinpath("bin/c_compiler")
+        return measure_all(benchmarks, [str(compiler), *cflags], "against", model)
+    finally:
+        run_subprocess(["git", "-C", str(PROJECT_LOCATION), "worktree", "remove", "--force", str(WORKTREE_FOLDER)],
+                       BUILD_TIMEOUT_SECONDS)
+
+def parse_args():
+    """
+    Wrapper for argument parsing.
+    """
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        "benchmarks",
+        nargs="*",
+        help="(Optional) names of the benchmarks to run, e.g. sort. Leave blank "
+        "to run all of benchmarks/."
+    )
+    parser.add_argument(
+        "--update",
+        action="store_true",
+        default=False,
+        help="Record the numbers of this tree as the new baseline."
+    )
+    parser.add_argument(
+        "--against",
+        metavar="REV",
+        help="Compare against the compiler of a git revision instead of the baseline."
+    )
+    parser.add_argument(
+        "--gcc",
+        action="store_true",
+        default=False,
+        help=f"Also compare against {GCC} at -O0 and -O2, skipped when it is not installed."
+    )
+    parser.add_argument(
+        "--model",
+        default=DEFAULT_MODEL,
+        help="The pipeline bin/rvsim estimates cycles for, see bin/rvsim --help."
+    )
+    parser.add_argument(
+        "--cflags",
+        default="",
+        help="Extra options for bin/c_compiler, e.g. \"-fno-inline\"."
+    )
+    parser.add_argument(
+        "--no_build",
+        action="store_true",
+        default=False,
+        help="Don't run make, use bin/c_compiler and bin/rvsim as they are."
+    )
+    return parser.parse_args()
+
+def main():
+    args = parse_args()
+
+    benchmarks = sorted(BENCHMARK_FOLDER.glob("*.c"))
+    if args.benchmarks:
+        benchmarks = [benchmark for benchmark in benchmarks if benchmark.stem in args.benchmarks]
+        missing = set(args.benchmarks) - {benchmark.stem for benchmark in benchmarks}
+        if missing:
+            print(RED + "Unknown benchmarks: " + ", ".join(sorted(missing)) + RESET)
+            exit(2)
+
+    if not args.no_build and not make(PROJECT_LOCATION, ["bin/c_compiler", "bin/rvsim"]):
+        exit(3)
+
+    cflags = shlex.split(args.cflags)
+    results = measure_all(benchmarks, [str(COMPILER_FILE), *cflags], "current", args.model)
+
+    if args.update:
+        if not all(result.passed for result in results.values()):
+            report(results, None, "")
+            print(RED + "Not updating the baseline while benchmarks fail" + RESET)
+            exit(1)
+        if args.benchmarks:
+            # keep the lines of the benchmarks that were not run
+            baseline = read_baseline(args.model) or {}
+            baseline.update(results)
+            results = baseline
+        write_baseline(results, args.model)
+        return
+
+    if args.against:
+        reference = measure_revision(args.against, benchmarks, args.model, cflags)
+        if reference is None:
+            exit(4)
+        report(results, reference, args.against)
+    else:
+        report(results, read_baseline(args.model), "baseline")
+
+    if args.gcc:
+        if shutil.which(GCC) is None:
+            print(f"\n>> {GCC} not found, skipping the comparison with gcc")
+        else:
+            gcc_results = {
+                level: measure_all(benchmarks, [GCC, level, *GCC_FLAGS], "gcc" + level, args.model)
+                for level in ["-O0", "-O2"]
+            }
+            report_gcc(results, gcc_results)
+
+    if not all(result.passed for result in results.values()):
+        exit(1)
+
+if __name__ == "__main__":
+    try:
+        main()
+    finally:
+        print(RESET, end="")
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# Checks the code generated for compiler tests that come with an X.expect file next to X.c. Each line
+# of it is a function, + or -, and an extended regular expression that some line of that function's
+# assembly must (+) or must not (-) match, for codegen decisions a driver cannot observe.
+
+set -uo pipefail
+shopt -s globstar
+
+set -e
+make bin/c_compiler
+set +e
+
+mkdir -p bin/output
+
+TOTAL=0
+PASSING=0
+SPECIFIC_FOLDER="${1:-**}"
+COMPILER="$(pwd)/bin/c_compiler"
+
+for EXPECT in compiler_tests/${SPECIFIC_FOLDER}/*.expect; do
+    [ -e "${EXPECT}" ] || continue
+    (( TOTAL++ ))
+
+    TO_ASSEMBLE="${EXPECT%.expect}.c"
+    LOG_PATH="${TO_ASSEMBLE#compiler_tests/}"
+    LOG_PATH="$(pwd)/bin/output/${LOG_PATH%.c}"
+    BASE_NAME="$(basename "${LOG_PATH}")"
+    LOG_FILE_BASE="${LOG_PATH}/${BASE_NAME}"
+    rm -rf "${LOG_PATH}"
+    mkdir -p "${LOG_PATH}"
+
+    echo "${TO_ASSEMBLE}"
+    timeout --foreground 15s "${COMPILER}" -S "${TO_ASSEMBLE}" -o "${LOG_FILE_BASE}.s" 2> "${LOG_FILE_BASE}.compiler.stderr.log" > "${LOG_FILE_BASE}.compiler.stdout.log"
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to compile: ${LOG_FILE_BASE}.compiler.stderr.log\n"
+        continue
+    fi
+
+    FAILED=0
+    : > "${LOG_FILE_BASE}.expect.log"
+    while read -r FUNCTION SIGN PATTERN; do
+        [ -n "${FUNCTION}" ] || continue
+        # a function runs from its label to the next .globl
+        awk -v name="${FUNCTION}:" '$0 == name { inside = 1; next } /^\.globl/ { inside = 0 } inside' "${LOG_FILE_BASE}.s" | grep -Eq -- "${PATTERN}"
+        FOUND=$?
+        if { [ "${SIGN}" = "+" ] && [ ${FOUND} -ne 0 ]; } || { [ "${SIGN}" = "-" ] && [ ${FOUND} -eq 0 ]; }; then
+            echo "${FUNCTION} ${SIGN} ${PATTERN}" >> "${LOG_FILE_BASE}.expect.log"
+            FAILED=1
+        fi
+    done < "${EXPECT}"
+
+    if [ ${FAILED} -eq 0 ]; then
+        echo -e "\t> Pass\n"
+        (( PASSING++ ))
+    else
+        echo -e "\t> Unexpected code: ${LOG_FILE_BASE}.expect.log\n"
+    fi
+done
+
+printf "\nPassing %d/%d tests\n" "${PASSING}" "${TOTAL}"
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# Checks that the scheduler keeps every function's frame inside sp. Each compiler test is compiled
+# and no fp-relative access may come before the prologue's sp adjustment, or after the epilogue's
+# mv sp, fp other than the reloads of ra and fp. The ABI has no red zone, so anything stored below
+# sp may be overwritten at any time.
+
+set -uo pipefail
+shopt -s globstar
+
+set -e
+make bin/c_compiler
+set +e
+
+mkdir -p bin/output
+
+TOTAL=0
+PASSING=0
+SPECIFIC_FOLDER="${1:-**}"
+COMPILER="$(pwd)/bin/c_compiler"
+
+for TO_ASSEMBLE in compiler_tests/${SPECIFIC_FOLDER}/*.c; do
+    [[ "${TO_ASSEMBLE}" == *_driver.c ]] && continue
+    (( TOTAL++ ))
+
+    LOG_PATH="${TO_ASSEMBLE#compiler_tests/}"
+    LOG_PATH="$(pwd)/bin/output/${LOG_PATH%.c}"
+    BASE_NAME="$(basename "${LOG_PATH}")"
+    LOG_FILE_BASE="${LOG_PATH}/${BASE_NAME}"
+    rm -rf "${LOG_PATH}"
+    mkdir -p "${LOG_PATH}"
+
+    echo "${TO_ASSEMBLE}"
+    timeout --foreground 15s "${COMPILER}" -S "${TO_ASSEMBLE}" -o "${LOG_FILE_BASE}.s" 2> "${LOG_FILE_BASE}.compiler.stderr.log" > "${LOG_FILE_BASE}.compiler.stdout.log"
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to compile: ${LOG_FILE_BASE}.compiler.stderr.log\n"
+        continue
+    fi
+
+    awk '
+        /^[A-Za-z_][A-Za-z0-9_]*:$/ { name = $0; prologue = 1; epilogue = 0; next }
+        prologue && /addi sp, sp, -/ { prologue = 0; next }
+        prologue && /\(fp\)/ { print name " before the sp adjustment:" $0; bad = 1; prologue = 0 }
+        /mv sp, fp/ { epilogue = 1; next }
+        epilogue && /\(fp\)/ && !/lw ra, -8\(fp\)/ && !/lw fp, -4\(fp\)/ { print name " after mv sp, fp:" $0; bad = 1 }
+        epilogue && /^\t(ret|tail)/ { epilogue = 0 }
+        END { exit bad }
+    ' "${LOG_FILE_BASE}.s" > "${LOG_FILE_BASE}.frame.log"
+    if [ $? -eq 0 ]; then
+        echo -e "\t> Pass\n"
+        (( PASSING++ ))
+    else
+        echo -e "\t> Frame accessed outside sp: ${LOG_FILE_BASE}.frame.log\n"
+    fi
+done
+
+printf "\nPassing %d/%d tests\n" "${PASSING}" "${TOTAL}"
@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# Round-trips every compiler test through profile-guided optimisation on the in-tree simulator.
+# Each test and its driver are built with -fprofile-generate and run, which must leave a non-empty
+# profile.data behind. They are then rebuilt with -fprofile-use on that profile, which must match
+# the code without a warning, and run again.
+
+set -uo pipefail
+shopt -s globstar
+
+set -e
+make bin/c_compiler bin/rvsim
+set +e
+
+mkdir -p bin/output
+
+TOTAL=0
+PASSING=0
+SPECIFIC_FOLDER="${1:-**}"
+COMPILER="$(pwd)/bin/c_compiler"
+SIMULATOR="$(pwd)/bin/rvsim"
+
+for DRIVER in compiler_tests/${SPECIFIC_FOLDER}/*_driver.c; do
+    (( TOTAL++ ))
+
+    TO_ASSEMBLE="${DRIVER%_driver.c}.c"
+    LOG_PATH="${TO_ASSEMBLE#compiler_tests/}"
+    LOG_PATH="$(pwd)/bin/output/${LOG_PATH%.c}"
+    BASE_NAME="$(basename "${LOG_PATH}")"
+    LOG_FILE_BASE="${LOG_PATH}/${BASE_NAME}"
+    rm -rf "${LOG_PATH}"
+    mkdir -p "${LOG_PATH}"
+
+    echo "${TO_ASSEMBLE}"
+    OUT="${LOG_FILE_BASE}"
+    timeout --foreground 15s "${COMPILER}" -fprofile-generate -S "${TO_ASSEMBLE}" -o "${OUT}.gen.s" 2> "${LOG_FILE_BASE}.generate.stderr.log" > "${LOG_FILE_BASE}.generate.stdout.log" &&
+        timeout --foreground 15s "${COMPILER}" -fprofile-generate -S "${DRIVER}" -o "${OUT}_driver.gen.s" 2>> "${LOG_FILE_BASE}.generate.stderr.log" >> "${LOG_FILE_BASE}.generate.stdout.log"
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to compile with -fprofile-generate: ${LOG_FILE_BASE}.generate.stderr.log\n"
+        continue
+    fi
+
+    # the counters are dumped to profile.data in the working directory when main returns
+    (cd "${LOG_PATH}" && timeout --foreground 15s "${SIMULATOR}" "${OUT}.gen.s" "${OUT}_driver.gen.s" > "${LOG_FILE_BASE}.generate.simulation.log" 2>&1)
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to simulate the instrumented build: ${LOG_FILE_BASE}.generate.simulation.log\n"
+        continue
+    fi
+    if [ ! -s "${LOG_PATH}/profile.data" ]; then
+        echo -e "\t> The instrumented build wrote no profile: ${LOG_PATH}/profile.data\n"
+        continue
+    fi
+
+    timeout --foreground 15s "${COMPILER}" -fprofile-use="${LOG_PATH}/profile.data" -S "${TO_ASSEMBLE}" -o "${OUT}.s" 2> "${LOG_FILE_BASE}.use.stderr.log" > "${LOG_FILE_BASE}.use.stdout.log" &&
+        timeout --foreground 15s "${COMPILER}" -fprofile-use="${LOG_PATH}/profile.data" -S "${DRIVER}" -o "${OUT}_driver.s" 2>> "${LOG_FILE_BASE}.use.stderr.log" >> "${LOG_FILE_BASE}.use.stdout.log"
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to compile with -fprofile-use: ${LOG_FILE_BASE}.use.stderr.log\n"
+        continue
+    fi
+    if grep -q "does not match" "${LOG_FILE_BASE}.use.stderr.log"; then
+        echo -e "\t> The profile did not match the code it was collected from: ${LOG_FILE_BASE}.use.stderr.log\n"
+        continue
+    fi
+
+    timeout --foreground 15s "${SIMULATOR}" "${OUT}.s" "${OUT}_driver.s" > "${LOG_FILE_BASE}.use.simulation.log" 2>&1
+    if [ $? -eq 0 ]; then
+        echo -e "\t> Pass\n"
+        (( PASSING++ ))
+    else
+        echo -e "\t> Failed to simulate the optimised build: ${LOG_FILE_BASE}.use.simulation.log\n"
+    fi
+done
+
+printf "\nPassing %d/%d tests\n" "${PASSING}" "${TOTAL}"
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Runs the compiler tests on the in-tree simulator instead of gcc, spike and pk.
+# The driver is compiled by bin/c_compiler as well, since bin/rvsim only runs assembly.
+# With STATS=1 the dynamic counts and estimated cycles of each test are kept next to its log,
+# MODEL picks the pipeline the cycles are estimated for and CFLAGS is passed to the compiler.
+
+set -uo pipefail
+shopt -s globstar
+
+set -e
+make bin/c_compiler bin/rvsim
+set +e
+
+mkdir -p bin/output
+
+TOTAL=0
+PASSING=0
+SPECIFIC_FOLDER="${1:-**}"
+SIM_FLAGS="--model ${MODEL:-rocket}"
+if [ "${STATS:-}" == "1" ]; then
+    SIM_FLAGS="${SIM_FLAGS} --stats"
+fi
+
+for DRIVER in compiler_tests/${SPECIFIC_FOLDER}/*_driver.c; do
+    (( TOTAL++ ))
+
+    TO_ASSEMBLE="${DRIVER%_driver.c}.c"
+    LOG_PATH="${TO_ASSEMBLE#compiler_tests/}"
+    LOG_PATH="./bin/output/${LOG_PATH%.c}"
+    BASE_NAME="$(basename "${LOG_PATH}")"
+    LOG_FILE_BASE="${LOG_PATH}/${BASE_NAME}"
+    rm -rf "${LOG_PATH}"
+    mkdir -p "${LOG_PATH}"
+
+    echo "${TO_ASSEMBLE}"
+    OUT="${LOG_FILE_BASE}"
+    timeout --foreground 15s ./bin/c_compiler ${CFLAGS:-} -S "${TO_ASSEMBLE}" -o "${OUT}.s" 2> "${LOG_FILE_BASE}.compiler.stderr.log" > "${LOG_FILE_BASE}.compiler.stdout.log"
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to compile testcase: ${LOG_FILE_BASE}.compiler.stderr.log\n"
+        continue
+    fi
+    timeout --foreground 15s ./bin/c_compiler ${CFLAGS:-} -S "${DRIVER}" -o "${OUT}_driver.s" 2>> "${LOG_FILE_BASE}.compiler.stderr.log" >> "${LOG_FILE_BASE}.compiler.stdout.log"
+    if [ $? -ne 0 ]; then
+        echo -e "\t> Failed to compile driver: ${LOG_FILE_BASE}.compiler.stderr.log\n"
+        continue
+    fi
+
+    timeout --foreground 15s ./bin/rvsim ${SIM_FLAGS} "${OUT}.s" "${OUT}_driver.s" > "${LOG_FILE_BASE}.simulation.log" 2> "${LOG_FILE_BASE}.stats.log"
+    if [ $? -eq 0 ]; then
+        echo -e "\t> Pass\n"
+        (( PASSING++ ))
+    else
+        echo -e "\t> Failed to simulate: ${LOG_FILE_BASE}.simulation.log ${LOG_FILE_BASE}.stats.log\n"
+    fi
+done
+
+printf "\nPassing %d/%d tests\n" "${PASSING}" "${TOTAL}"
@@ -0,0 +1,1032 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alias.h"
+#include "ast.h"
+#include "optimise.h"
+#include "symbol.h"
+
+// alias analysis and promotion of globals, set from the command line
+bool aliasEnabled = true;
+
+// The summary of a defined function, callees are indices of other summaries
+typedef struct Summary
+{
+    const char *ident;
+    ModRef modRef;
+    size_t *callees;
+    size_t calleesSize;
+    size_t calleesCapacity;
+} Summary;
+
+static Summary *summaries = NULL;
+static size_t summariesSize = 0;
+
+// locals of the current function whose address may be held by a pointer
+static SymbolSet escapedLocals;
+
+typedef void (*ExprVisitor)(Expr *expr, void *data);
+
+static void visitInitList(InitList *initList, ExprVisitor visit, void *data)
+{
+    for (size_t i = 0; i < initList->size; i++)
+    {
+        if (initList->inits[i]->expr != NULL)
+        {
+            visit(initList->inits[i]->expr, data);
+        }
+        if (initList->inits[i]->initList != NULL)
+        {
+            visitInitList(initList->inits[i]->initList, visit, data);
+        }
+    }
+}
+
+// calls visit on every full expression of a statement
+static void visitStmt(Stmt *stmt, ExprVisitor visit, void *data)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        if (stmt->whileStmt->preheader != NULL)
+        {
+            visitStmt(stmt->whileStmt->preheader, visit, data);
+        }
+        visit(stmt->whileStmt->condition, data);
+        visitStmt(stmt->whileStmt->body, visit, data);
+        break;
+    case FOR_STMT:
+        if (stmt->forStmt->preheader != NULL)
+        {
+            visitStmt(stmt->forStmt->preheader, visit, data);
+        }
+        visitStmt(stmt->forStmt->init, visit, data);
+        visitStmt(stmt->forStmt->condition, visit, data);
+        visitStmt(stmt->forStmt->body, visit, data);
+        if (stmt->forStmt->modifier != NULL)
+        {
+            visit(stmt->forStmt->modifier, data);
+        }
+        break;
+    case IF_STMT:
+        visit(stmt->ifStmt->condition, data);
+        visitStmt(stmt->ifStmt->trueBody, visit, data);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            visitStmt(stmt->ifStmt->falseBody, visit, data);
+        }
+        break;
+    case SWITCH_STMT:
+        visit(stmt->switchStmt->selector, data);
+        visitStmt(stmt->switchStmt->body, visit, data);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            visit(stmt->exprStmt->expr, data);
+        }
+        break;
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            DeclInit *declInit = compoundStmt->declList.decls[i]->declInit;
+            if (declInit != NULL && declInit->initExpr != NULL)
+            {
+                visit(declInit->initExpr, data);
+            }
+            if (declInit != NULL && declInit->initList != NULL)
+            {
+                visitInitList(declInit->initList, visit, data);
+            }
+        }
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            visitStmt(compoundStmt->stmtList.stmts[i], visit, data);
+        }
+        break;
+    }
+    case LABEL_STMT:
+        visitStmt(stmt->labelStmt->body, visit, data);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            visit(stmt->jumpStmt->expr, data);
+        }
+        break;
+    }
+}
+
+// an address is dereferenced when it only reaches a load or store, anywhere else it may be kept in a pointer
+static void escapesExpr(Expr *expr, SymbolSet *escaped, bool dereferenced)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        // an array named outside an access decays to a pointer to it
+        SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        if (!dereferenced && symbolEntry != NULL && symbolEntry->entryType == ARRAY_ENTRY)
+        {
+            symbolSetPush(escaped, symbolEntry);
+        }
+        break;
+    }
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        switch (operation->operator)
+        {
+        case DEREF:
+            escapesExpr(operation->op1, escaped, true);
+            break;
+        case ADDRESS:
+            if (operation->op1->type == VARIABLE_EXPR)
+            {
+                if (!dereferenced)
+                {
+                    symbolSetPush(escaped, operation->op1->variable->symbolEntry);
+                }
+            }
+            else if (operation->op1->type == OPERATION_EXPR && operation->op1->operation->operator== DEREF)
+            {
+                escapesExpr(operation->op1->operation->op1, escaped, dereferenced);
+            }
+            else
+            {
+                escapesExpr(operation->op1, escaped, false);
+            }
+            break;
+        case ADD:
+        case SUB:
+            // pointer arithmetic stays inside the object it started from
+            escapesExpr(operation->op1, escaped, dereferenced && isPtr(returnType(operation->op1)));
+            if (operation->op2 != NULL)
+            {
+                escapesExpr(operation->op2, escaped,
+                            dereferenced && operation->operator== ADD && isPtr(returnType(operation->op2)));
+            }
+            break;
+        case SIZEOF_OP:
+            break;
+        default:
+            if (operation->op1 != NULL)
+            {
+                escapesExpr(operation->op1, escaped, false);
+            }
+            if (operation->op2 != NULL)
+            {
+                escapesExpr(operation->op2, escaped, false);
+            }
+            if (operation->op3 != NULL)
+            {
+                escapesExpr(operation->op3, escaped, false);
+            }
+            break;
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+        escapesExpr(expr->assignment->op, escaped, false);
+        if (expr->assignment->lvalue != NULL)
+        {
+            escapesExpr(expr->assignment->lvalue, escaped, true);
+        }
+        break;
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            escapesExpr(expr->function->args[i], escaped, false);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void collectEscapes(Expr *expr, void *data)
+{
+    escapesExpr(expr, data, false);
+}
+
+void analyseEscapes(FuncDef *func)
+{
+    symbolSetClear(&escapedLocals);
+    visitStmt(func->body, collectEscapes, &escapedLocals);
+}
+
+void escapesClear(void)
+{
+    symbolSetClear(&escapedLocals);
+}
+
+// globals have external linkage, other translation units may hold their address
+bool isEscaped(const SymbolEntry *symbolEntry)
+{
+    return symbolEntry->isGlobal || symbolSetContains(&escapedLocals, symbolEntry);
+}
+
+// the object an address points into, if it can be seen from the expression
+static SymbolEntry *addressBase(const Expr *address)
+{
+    switch (address->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        SymbolEntry *symbolEntry = address->variable->symbolEntry;
+        return symbolEntry != NULL && symbolEntry->entryType == ARRAY_ENTRY ? symbolEntry : NULL;
+    }
+    case OPERATION_EXPR:
+    {
+        const OperationExpr *operation = address->operation;
+        switch (operation->operator)
+        {
+        case ADDRESS:
+            if (operation->op1->type == VARIABLE_EXPR)
+            {
+                return operation->op1->variable->symbolEntry;
+            }
+            if (operation->op1->type == OPERATION_EXPR && operation->op1->operation->operator== DEREF)
+            {
+                return addressBase(operation->op1->operation->op1);
+            }
+            return NULL;
+        case ADD:
+            if (isPtr(returnType(operation->op1)))
+            {
+                return addressBase(operation->op1);
+            }
+            return operation->op2 != NULL && isPtr(returnType(operation->op2)) ? addressBase(operation->op2) : NULL;
+        case SUB:
+            return isPtr(returnType(operation->op1)) ? addressBase(operation->op1) : NULL;
+        default:
+            return NULL;
+        }
+    }
+    default:
+        return NULL;
+    }
+}
+
+MemoryRef memoryRef(const Expr *address, DataType type)
+{
+    MemoryRef ref = {addressBase(address), type};
+    return ref;
+}
+
+// the width of a store follows the value, it is only typed as the pointee when the two agree
+DataType storedType(const AssignExpr *assign)
+{
+    DataType pointee = removerPtrFromType(returnType(assign->lvalue));
+    return assign->type == pointee ? pointee : VOID_TYPE;
+}
+
+static DataType entryType(const SymbolEntry *symbolEntry)
+{
+    return symbolEntry->type.isStruct ? VOID_TYPE : symbolEntry->type.dataType;
+}
+
+// accesses of different types only overlap if one of them is through a character type
+static bool typesMayAlias(DataType a, DataType b)
+{
+    if (a == VOID_TYPE || b == VOID_TYPE || a == CHAR_TYPE || b == CHAR_TYPE || a == SIGNED_CHAR_TYPE ||
+        b == SIGNED_CHAR_TYPE)
+    {
+        return true;
+    }
+    if (isPtr(a) || isPtr(b))
+    {
+        return isPtr(a) && isPtr(b);
+    }
+    if ((a == INT_TYPE || a == UNSIGNED_INT_TYPE) && (b == INT_TYPE || b == UNSIGNED_INT_TYPE))
+    {
+        return true;
+    }
+    if ((a == SHORT_TYPE || a == UNSIGNED_SHORT_TYPE) && (b == SHORT_TYPE || b == UNSIGNED_SHORT_TYPE))
+    {
+        return true;
+    }
+    if ((a == LONG_TYPE || a == UNSIGNED_LONG_TYPE) && (b == LONG_TYPE || b == UNSIGNED_LONG_TYPE))
+    {
+        return true;
+    }
+    return a == b;
+}
+
+// distinct objects never overlap, an unknown pointer only reaches objects whose address escaped
+bool mayAlias(MemoryRef a, MemoryRef b)
+{
+    if (!aliasEnabled)
+    {
+        return true;
+    }
+    if (!typesMayAlias(a.type, b.type))
+    {
+        return false;
+    }
+    if (a.base != NULL && b.base != NULL)
+    {
+        return a.base == b.base;
+    }
+    if (a.base != NULL)
+    {
+        return isEscaped(a.base);
+    }
+    if (b.base != NULL)
+    {
+        return isEscaped(b.base);
+    }
+    return true;
+}
+
+// true if a store may change the value of an expression without side effects
+bool storeMayChange(const Expr *expr, MemoryRef store)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        if (symbolEntry == NULL || symbolEntry->entryType != VARIABLE_ENTRY)
+        {
+            return false;
+        }
+        if (store.base == symbolEntry)
+        {
+            return true;
+        }
+        MemoryRef read = {symbolEntry, entryType(symbolEntry)};
+        return isEscaped(symbolEntry) && mayAlias(read, store);
+    }
+    case OPERATION_EXPR:
+    {
+        const OperationExpr *operation = expr->operation;
+        if (operation->operator== DEREF && mayAlias(memoryRef(operation->op1, operation->type), store))
+        {
+            return true;
+        }
+        return (operation->op1 != NULL && storeMayChange(operation->op1, store)) ||
+               (operation->op2 != NULL && storeMayChange(operation->op2, store)) ||
+               (operation->op3 != NULL && storeMayChange(operation->op3, store));
+    }
+    case CONSTANT_EXPR:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// index of the summary of a function, summariesSize if it has no body
+static size_t findSummary(const char *ident)
+{
+    for (size_t i = 0; i < summariesSize; i++)
+    {
+        if (strcmp(summaries[i].ident, ident) == 0)
+        {
+            return i;
+        }
+    }
+    return summariesSize;
+}
+
+static const ModRef *calleeSummary(const FuncExpr *call)
+{
+    size_t index = findSummary(call->ident);
+    return index == summariesSize ? NULL : &summaries[index].modRef;
+}
+
+// true if a call with the summary may write an object, NULL for a callee that is not known
+static bool callWrites(const ModRef *summary, const SymbolEntry *base)
+{
+    if (summary == NULL || summary->unknown)
+    {
+        return isEscaped(base);
+    }
+    if (base->isGlobal && symbolSetContains(&summary->mod, base))
+    {
+        return true;
+    }
+    return summary->storesMemory && isEscaped(base);
+}
+
+static bool callChanges(const Expr *expr, const ModRef *summary)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        const SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        return symbolEntry != NULL && symbolEntry->entryType == VARIABLE_ENTRY && callWrites(summary, symbolEntry);
+    }
+    case OPERATION_EXPR:
+    {
+        const OperationExpr *operation = expr->operation;
+        if (operation->operator== DEREF)
+        {
+            const SymbolEntry *base = addressBase(operation->op1);
+            if (base != NULL ? callWrites(summary, base)
+                             : summary == NULL || summary->unknown || summary->storesMemory || summary->mod.size != 0)
+            {
+                return true;
+            }
+        }
+        return (operation->op1 != NULL && callChanges(operation->op1, summary)) ||
+               (operation->op2 != NULL && callChanges(operation->op2, summary)) ||
+               (operation->op3 != NULL && callChanges(operation->op3, summary));
+    }
+    case CONSTANT_EXPR:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// true if a call may change the value of an expression without side effects
+bool callMayChange(const Expr *expr, const FuncExpr *call)
+{
+    return callChanges(expr, aliasEnabled ? calleeSummary(call) : NULL);
+}
+
+static void summaryAddCallee(Summary *summary, size_t callee)
+{
+    if (summary->calleesSize == summary->calleesCapacity)
+    {
+        summary->calleesCapacity = summary->calleesCapacity == 0 ? 8 : summary->calleesCapacity * 2;
+        summary->callees = realloc(summary->callees, sizeof(size_t) * summary->calleesCapacity);
+        if (summary->callees == NULL)
+        {
+            abort();
+        }
+    }
+    summary->callees[summary->calleesSize++] = callee;
+}
+
+static void summariseAccess(Summary *summary, const SymbolEntry *base, bool isStore)
+{
+    if (base == NULL)
+    {
+        if (isStore)
+        {
+            summary->modRef.storesMemory = true;
+        }
+        else
+        {
+            summary->modRef.loadsMemory = true;
+        }
+    }
+    else if (base->isGlobal)
+    {
+        // a write by name may also be a compound assignment, it reads the global too
+        symbolSetPush(&summary->modRef.ref, (SymbolEntry *)base);
+        if (isStore)
+        {
+            symbolSetPush(&summary->modRef.mod, (SymbolEntry *)base);
+        }
+    }
+}
+
+static void summariseExpr(Expr *expr, void *data)
+{
+    Summary *summary = data;
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        const SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        if (symbolEntry != NULL && symbolEntry->entryType != FUNCTION_ENTRY)
+        {
+            summariseAccess(summary, symbolEntry, false);
+        }
+        break;
+    }
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        Operator operator = operation->operator;
+        if (operator== INC || operator== DEC || operator== INC_POST || operator== DEC_POST)
+        {
+            Expr *location = operation->op1;
+            if (location->type == VARIABLE_EXPR)
+            {
+                summariseAccess(summary, location->variable->symbolEntry, true);
+            }
+            else if (location->type == OPERATION_EXPR && location->operation->operator== DEREF)
+            {
+                summariseAccess(summary, addressBase(location->operation->op1), true);
+            }
+        }
+        else if (operator== DEREF)
+        {
+            summariseAccess(summary, addressBase(operation->op1), false);
+        }
+        if (operation->op1 != NULL)
+        {
+            summariseExpr(operation->op1, summary);
+        }
+        if (operation->op2 != NULL)
+        {
+            summariseExpr(operation->op2, summary);
+        }
+        if (operation->op3 != NULL)
+        {
+            summariseExpr(operation->op3, summary);
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+    {
+        AssignExpr *assign = expr->assignment;
+        if (assign->lvalue != NULL)
+        {
+            summariseAccess(summary, addressBase(assign->lvalue), true);
+            if (assign->operator!= NOT)
+            {
+                summariseAccess(summary, addressBase(assign->lvalue), false);
+            }
+            summariseExpr(assign->lvalue, summary);
+        }
+        else if (assign->symbolEntry != NULL)
+        {
+            summariseAccess(summary, assign->symbolEntry, true);
+        }
+        summariseExpr(assign->op, summary);
+        break;
+    }
+    case FUNC_EXPR:
+    {
+        size_t callee = findSummary(expr->function->ident);
+        if (callee == summariesSize)
+        {
+            summary->modRef.unknown = true;
+        }
+        else
+        {
+            summaryAddCallee(summary, callee);
+        }
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            summariseExpr(expr->function->args[i], summary);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static bool symbolSetMerge(SymbolSet *set, const SymbolSet *other)
+{
+    size_t size = set->size;
+    for (size_t i = 0; i < other->size; i++)
+    {
+        symbolSetPush(set, other->entries[i]);
+    }
+    return set->size != size;
+}
+
+// mod/ref summaries of every function with a body, closed over the call graph
+void analyseAliases(TranslationUnit *transUnit)
+{
+    aliasesDestroy();
+    for (size_t i = 0; i < transUnit->size; i++)
+    {
+        ExternDecl *externDecl = transUnit->externDecls[i];
+        if (externDecl->isFunc && !externDecl->funcDef->isPrototype)
+        {
+            summaries = realloc(summaries, sizeof(Summary) * (summariesSize + 1));
+            if (summaries == NULL)
+            {
+                abort();
+            }
+            Summary summary = {externDecl->funcDef->ident, {{NULL, 0, 0}, {NULL, 0, 0}, false, false, false}, NULL,
+                               0, 0};
+            summaries[summariesSize++] = summary;
+        }
+    }
+
+    size_t index = 0;
+    for (size_t i = 0; i < transUnit->size; i++)
+    {
+        ExternDecl *externDecl = transUnit->externDecls[i];
+        if (externDecl->isFunc && !externDecl->funcDef->isPrototype)
+        {
+            visitStmt(externDecl->funcDef->body, summariseExpr, &summaries[index++]);
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < summariesSize; i++)
+        {
+            ModRef *modRef = &summaries[i].modRef;
+            for (size_t j = 0; j < summaries[i].calleesSize; j++)
+            {
+                const ModRef *callee = &summaries[summaries[i].callees[j]].modRef;
+                changed |= symbolSetMerge(&modRef->mod, &callee->mod);
+                changed |= symbolSetMerge(&modRef->ref, &callee->ref);
+                if ((callee->storesMemory && !modRef->storesMemory) || (callee->loadsMemory && !modRef->loadsMemory) ||
+                    (callee->unknown && !modRef->unknown))
+                {
+                    modRef->storesMemory |= callee->storesMemory;
+                    modRef->loadsMemory |= callee->loadsMemory;
+                    modRef->unknown |= callee->unknown;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+void aliasesDestroy(void)
+{
+    for (size_t i = 0; i < summariesSize; i++)
+    {
+        symbolSetClear(&summaries[i].modRef.mod);
+        symbolSetClear(&summaries[i].modRef.ref);
+        free(summaries[i].callees);
+    }
+    free(summaries);
+    summaries = NULL;
+    summariesSize = 0;
+    escapesClear();
+}
+
+// What a loop does to memory, the globals it names and the types it accesses through unknown pointers
+typedef struct LoopAccesses
+{
+    SymbolSet named;     // globals read or written by name
+    SymbolSet written;   // globals written by name
+    SymbolSet addressed; // variables whose address is taken
+    uint32_t loadTypes;  // bit per DataType loaded through an unknown pointer
+    uint32_t storeTypes; // bit per DataType stored through an unknown pointer
+    ModRef calls;        // union of the summaries of the callees
+} LoopAccesses;
+
+static uint32_t typeBit(DataType type)
+{
+    return type == VOID_TYPE || type == CHAR_TYPE || type == SIGNED_CHAR_TYPE ? UINT32_MAX : (uint32_t)1 << type;
+}
+
+static bool typeMaskMayAlias(uint32_t mask, DataType type)
+{
+    for (uint32_t bit = 0; bit < 32; bit++)
+    {
+        if ((mask & ((uint32_t)1 << bit)) != 0 && typesMayAlias((DataType)bit, type))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void noteAccess(LoopAccesses *accesses, const Expr *address, DataType type, bool isStore)
+{
+    if (addressBase(address) == NULL)
+    {
+        if (isStore)
+        {
+            accesses->storeTypes |= typeBit(type);
+        }
+        else
+        {
+            accesses->loadTypes |= typeBit(type);
+        }
+    }
+}
+
+static void noteNamed(LoopAccesses *accesses, SymbolEntry *symbolEntry, bool isStore)
+{
+    if (symbolEntry != NULL && symbolEntry->isGlobal && symbolEntry->entryType == VARIABLE_ENTRY)
+    {
+        symbolSetPush(&accesses->named, symbolEntry);
+        if (isStore)
+        {
+            symbolSetPush(&accesses->written, symbolEntry);
+        }
+    }
+}
+
+static void scanLoopExpr(Expr *expr, void *data)
+{
+    LoopAccesses *accesses = data;
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        noteNamed(accesses, expr->variable->symbolEntry, false);
+        break;
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        Operator operator = operation->operator;
+        if (operator== INC || operator== DEC || operator== INC_POST || operator== DEC_POST)
+        {
+            if (operation->op1->type == VARIABLE_EXPR)
+            {
+                noteNamed(accesses, operation->op1->variable->symbolEntry, true);
+            }
+            else if (operation->op1->type == OPERATION_EXPR && operation->op1->operation->operator== DEREF)
+            {
+                noteAccess(accesses, operation->op1->operation->op1, operation->op1->operation->type, true);
+            }
+        }
+        else if (operator== DEREF)
+        {
+            noteAccess(accesses, operation->op1, operation->type, false);
+        }
+        else if (operator== ADDRESS && operation->op1->type == VARIABLE_EXPR)
+        {
+            symbolSetPush(&accesses->addressed, operation->op1->variable->symbolEntry);
+        }
+        if (operation->op1 != NULL)
+        {
+            scanLoopExpr(operation->op1, accesses);
+        }
+        if (operation->op2 != NULL)
+        {
+            scanLoopExpr(operation->op2, accesses);
+        }
+        if (operation->op3 != NULL)
+        {
+            scanLoopExpr(operation->op3, accesses);
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+    {
+        AssignExpr *assign = expr->assignment;
+        if (assign->lvalue != NULL)
+        {
+            noteAccess(accesses, assign->lvalue, storedType(assign), true);
+            if (assign->operator!= NOT)
+            {
+                noteAccess(accesses, assign->lvalue, storedType(assign), false);
+            }
+            scanLoopExpr(assign->lvalue, accesses);
+        }
+        else
+        {
+            noteNamed(accesses, assign->symbolEntry, true);
+        }
+        scanLoopExpr(assign->op, accesses);
+        break;
+    }
+    case FUNC_EXPR:
+    {
+        const ModRef *callee = calleeSummary(expr->function);
+        if (callee == NULL)
+        {
+            accesses->calls.unknown = true;
+        }
+        else
+        {
+            symbolSetMerge(&accesses->calls.mod, &callee->mod);
+            symbolSetMerge(&accesses->calls.ref, &callee->ref);
+            accesses->calls.storesMemory |= callee->storesMemory;
+            accesses->calls.loadsMemory |= callee->loadsMemory;
+            accesses->calls.unknown |= callee->unknown;
+        }
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            scanLoopExpr(expr->function->args[i], accesses);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// true if control can leave the statement other than by falling out of it, targets are its loops and switches
+static bool leavesStmt(const Stmt *stmt, SymbolSet *targets)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        symbolSetPush(targets, stmt->whileStmt->symbolEntry);
+        return leavesStmt(stmt->whileStmt->body, targets);
+    case FOR_STMT:
+        symbolSetPush(targets, stmt->forStmt->symbolEntry);
+        return leavesStmt(stmt->forStmt->body, targets);
+    case IF_STMT:
+        return leavesStmt(stmt->ifStmt->trueBody, targets) ||
+               (stmt->ifStmt->falseBody != NULL && leavesStmt(stmt->ifStmt->falseBody, targets));
+    case SWITCH_STMT:
+        symbolSetPush(targets, stmt->switchStmt->symbolEntry);
+        return leavesStmt(stmt->switchStmt->body, targets);
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            if (leavesStmt(stmt->compoundStmt->stmtList.stmts[i], targets))
+            {
+                return true;
+            }
+        }
+        return false;
+    case LABEL_STMT:
+        return leavesStmt(stmt->labelStmt->body, targets);
+    case JUMP_STMT:
+        // the targets of a break or continue enclose it, so they are already known
+        return stmt->jumpStmt->type == RETURN_JUMP || stmt->jumpStmt->type == GOTO_JUMP ||
+               !symbolSetContains(targets, stmt->jumpStmt->symbolEntry);
+    default:
+        return false;
+    }
+}
+
+// a global can live in a register for the loop if nothing in it reaches the global other than by name
+static bool isPromotable(const SymbolEntry *global, const LoopAccesses *accesses)
+{
+    DataType type = global->type.dataType;
+    if (global->type.isStruct || !(isPtr(type) || type == INT_TYPE || type == UNSIGNED_INT_TYPE || type == FLOAT_TYPE))
+    {
+        return false;
+    }
+    if (symbolSetContains(&accesses->addressed, global) || accesses->calls.unknown ||
+        accesses->calls.storesMemory || symbolSetContains(&accesses->calls.mod, global) ||
+        typeMaskMayAlias(accesses->storeTypes, type))
+    {
+        return false;
+    }
+    // a written global is only stored back at the exits, nothing may read memory for it before then
+    return !symbolSetContains(&accesses->written, global) ||
+           (!accesses->calls.loadsMemory && !symbolSetContains(&accesses->calls.ref, global) &&
+            !typeMaskMayAlias(accesses->loadTypes, type));
+}
+
+// Accesses of a global by name redirected to the local that holds it
+typedef struct Promotion
+{
+    SymbolEntry *global;
+    SymbolEntry *temp;
+} Promotion;
+
+static void promoteExpr(Expr *expr, void *data)
+{
+    const Promotion *promotion = data;
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        if (expr->variable->symbolEntry == promotion->global)
+        {
+            clearExpr(expr);
+            makeEntryRead(expr, promotion->temp);
+        }
+        break;
+    case OPERATION_EXPR:
+        if (expr->operation->op1 != NULL)
+        {
+            promoteExpr(expr->operation->op1, data);
+        }
+        if (expr->operation->op2 != NULL)
+        {
+            promoteExpr(expr->operation->op2, data);
+        }
+        if (expr->operation->op3 != NULL)
+        {
+            promoteExpr(expr->operation->op3, data);
+        }
+        break;
+    case ASSIGN_EXPR:
+    {
+        AssignExpr *assign = expr->assignment;
+        if (assign->lvalue == NULL && assign->symbolEntry == promotion->global)
+        {
+            free(assign->ident);
+            assign->ident = copyIdent(promotion->temp->ident);
+            assign->symbolEntry = promotion->temp;
+        }
+        if (assign->lvalue != NULL)
+        {
+            promoteExpr(assign->lvalue, data);
+        }
+        promoteExpr(assign->op, data);
+        break;
+    }
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            promoteExpr(expr->function->args[i], data);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static SymbolEntry *currentFunc = NULL;
+
+// loads the promotable globals of a loop in front of it and stores the written ones after it, returns the loop
+static Stmt *promoteLoop(Stmt *stmt)
+{
+    SymbolSet targets = {NULL, 0, 0};
+    bool leaves = containsLabel(stmt, false) || leavesStmt(stmt, &targets);
+    symbolSetClear(&targets);
+    if (leaves)
+    {
+        return stmt;
+    }
+
+    LoopAccesses accesses = {{NULL, 0, 0}, {NULL, 0, 0}, {NULL, 0, 0}, 0, 0,
+                             {{NULL, 0, 0}, {NULL, 0, 0}, false, false, false}};
+    visitStmt(stmt, scanLoopExpr, &accesses);
+
+    StatementList before;
+    StatementList after;
+    statementListInit(&before, 0);
+    statementListInit(&after, 0);
+    for (size_t i = 0; i < accesses.named.size; i++)
+    {
+        SymbolEntry *global = accesses.named.entries[i];
+        if (!isPromotable(global, &accesses))
+        {
+            continue;
+        }
+        Promotion promotion = {global, createTemp(currentFunc, global->type.dataType)};
+        visitStmt(stmt, promoteExpr, &promotion);
+        statementListPush(&before, assignEntryStmt(promotion.temp, entryRead(global)));
+        if (symbolSetContains(&accesses.written, global))
+        {
+            statementListPush(&after, assignEntryStmt(global, entryRead(promotion.temp)));
+        }
+    }
+
+    Stmt *loop = stmt;
+    if (before.size != 0)
+    {
+        loop = stmtCreate(stmt->type);
+        *loop = *stmt;
+        stmt->type = COMPOUND_STMT;
+        stmt->compoundStmt = compoundStmtCreate();
+        for (size_t i = 0; i < before.size; i++)
+        {
+            statementListPush(&stmt->compoundStmt->stmtList, before.stmts[i]);
+        }
+        statementListPush(&stmt->compoundStmt->stmtList, loop);
+        for (size_t i = 0; i < after.size; i++)
+        {
+            statementListPush(&stmt->compoundStmt->stmtList, after.stmts[i]);
+        }
+    }
+    free(before.stmts);
+    free(after.stmts);
+    symbolSetClear(&accesses.named);
+    symbolSetClear(&accesses.written);
+    symbolSetClear(&accesses.addressed);
+    symbolSetClear(&accesses.calls.mod);
+    symbolSetClear(&accesses.calls.ref);
+    return loop;
+}
+
+// outer loops are done first, inner loops may still promote what their outer loop could not
+static void promoteStmt(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        promoteStmt(promoteLoop(stmt)->whileStmt->body);
+        break;
+    case FOR_STMT:
+        promoteStmt(promoteLoop(stmt)->forStmt->body);
+        break;
+    case IF_STMT:
+        promoteStmt(stmt->ifStmt->trueBody);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            promoteStmt(stmt->ifStmt->falseBody);
+        }
+        break;
+    case SWITCH_STMT:
+        promoteStmt(stmt->switchStmt->body);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            promoteStmt(stmt->compoundStmt->stmtList.stmts[i]);
+        }
+        break;
+    case LABEL_STMT:
+        promoteStmt(stmt->labelStmt->body);
+        break;
+    default:
+        break;
+    }
+}
+
+// scalar globals used in a loop are kept in a local, loaded once before it and stored back once after it
+void promoteGlobals(FuncDef *func)
+{
+    if (!aliasEnabled || func->body == NULL || containsGoto(func->body))
+    {
+        return;
+    }
+    currentFunc = func->symbolEntry;
+    promoteStmt(func->body);
+    currentFunc = NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "optimise.h"
+#include "symbol.h"
+
+// A location read or written through a pointer
+typedef struct MemoryRef
+{
+    SymbolEntry *base; // the variable or array the address points into, NULL if unknown
+    DataType type;     // type of the access, VOID_TYPE if it may be read as anything
+} MemoryRef;
+
+// What a call to a function may change and read, callees included
+typedef struct ModRef
+{
+    SymbolSet mod;     // globals written by name or through an address of them
+    SymbolSet ref;     // globals read by name or through an address of them
+    bool storesMemory; // writes through a pointer of unknown target
+    bool loadsMemory;  // reads through a pointer of unknown target
+    bool unknown;      // calls a function without a body, anything may happen
+} ModRef;
+
+extern bool aliasEnabled;
+
+void analyseAliases(TranslationUnit *transUnit);
+void aliasesDestroy(void);
+void analyseEscapes(FuncDef *func);
+void escapesClear(void);
+
+bool isEscaped(const SymbolEntry *symbolEntry);
+MemoryRef memoryRef(const Expr *address, DataType type);
+DataType storedType(const AssignExpr *assign);
+bool mayAlias(MemoryRef a, MemoryRef b);
+bool storeMayChange(const Expr *expr, MemoryRef store);
+bool callMayChange(const Expr *expr, const FuncExpr *call);
+
+void promoteGlobals(FuncDef *func);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ast.h"
 #include "symbol.h"
@@ -300,6 +301,7 @@ WhileStmt *whileStmtCreate(Expr *condition, Stmt *body, const bool doWhile)
     stmt->condition = condition;
     stmt->body = body;
     stmt->doWhile = doWhile;
+    stmt->preheader = NULL;
     return stmt;
 }
 
@@ -308,6 +310,10 @@ void whileStmtDestroy(WhileStmt *stmt)
 {
     exprDestroy(stmt->condition);
     stmtDestroy(stmt->body);
+    if (stmt->preheader != NULL)
+    {
+        stmtDestroy(stmt->preheader);
+    }
     free(stmt);
 }
 
@@ -323,6 +329,7 @@ ForStmt *forStmtCreate(Stmt *init, Stmt *condition, Stmt *body)
     stmt->condition = condition;
     stmt->body = body;
     stmt->modifier = NULL;
+    stmt->preheader = NULL;
     return stmt;
 }
 
@@ -336,6 +343,10 @@ void forStmtDestroy(ForStmt *stmt)
     {
         exprDestroy(stmt->modifier);
     }
+    if (stmt->preheader != NULL)
+    {
+        stmtDestroy(stmt->preheader);
+    }
     free(stmt);
 }
 
@@ -1195,6 +1206,169 @@ DataType returnType(Expr *expr)
     }
 }
 
+// Structural equality, expressions with side effects are never equal
+bool exprEqual(const Expr *a, const Expr *b)
+{
+    if (a == NULL || b == NULL)
+    {
+        return a == b;
+    }
+    if (a->type != b->type)
+    {
+        return false;
+    }
+    switch (a->type)
+    {
+    case VARIABLE_EXPR:
+        return a->variable->symbolEntry == b->variable->symbolEntry && a->variable->type == b->variable->type &&
+               strcmp(a->variable->ident, b->variable->ident) == 0;
+    case CONSTANT_EXPR:
+    {
+        const ConstantExpr *x = a->constant;
+        const ConstantExpr *y = b->constant;
+        if (x->type != y->type || x->isString != y->isString)
+        {
+            return false;
+        }
+        if (x->isString)
+        {
+            return strcmp(x->string_const, y->string_const) == 0;
+        }
+        if (x->type == FLOAT_TYPE)
+        {
+            return memcmp(&x->float_const, &y->float_const, sizeof(float)) == 0;
+        }
+        if (x->type == CHAR_TYPE)
+        {
+            return x->char_const == y->char_const;
+        }
+        return x->int_const == y->int_const;
+    }
+    case OPERATION_EXPR:
+    {
+        const OperationExpr *x = a->operation;
+        const OperationExpr *y = b->operation;
+        Operator operator = x->operator;
+        if (operator== INC || operator== DEC || operator== INC_POST || operator== DEC_POST)
+        {
+            return false;
+        }
+        return operator== y->operator && x->type == y->type && exprEqual(x->op1, y->op1) &&
+               exprEqual(x->op2, y->op2) && exprEqual(x->op3, y->op3);
+    }
+    default:
+        return false;
+    }
+}
+
+static char *copyString(const char *string)
+{
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    char *copy = malloc(strlen(string) + 1);
+    if (copy == NULL)
+    {
+        abort();
+    }
+    strcpy(copy, string);
+    return copy;
+}
+
+// Deep copy, symbol entries are shared with the original
+Expr *exprCopy(const Expr *expr)
+{
+    if (expr == NULL)
+    {
+        return NULL;
+    }
+    Expr *copy = exprCreate(expr->type);
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        copy->variable = variableExprCreate(copyString(expr->variable->ident));
+        copy->variable->type = expr->variable->type;
+        copy->variable->symbolEntry = expr->variable->symbolEntry;
+        break;
+    case CONSTANT_EXPR:
+        copy->constant = constantExprCreate(expr->constant->type, expr->constant->isString);
+        *copy->constant = *expr->constant;
+        if (expr->constant->isString)
+        {
+            copy->constant->string_const = copyString(expr->constant->string_const);
+        }
+        break;
+    case OPERATION_EXPR:
+        copy->operation = operationExprCreate(expr->operation->operator);
+        copy->operation->type = expr->operation->type;
+        copy->operation->op1 = exprCopy(expr->operation->op1);
+        copy->operation->op2 = exprCopy(expr->operation->op2);
+        copy->operation->op3 = exprCopy(expr->operation->op3);
+        break;
+    case ASSIGN_EXPR:
+        copy->assignment = assignExprCreate(exprCopy(expr->assignment->op), expr->assignment->operator);
+        copy->assignment->ident = copyString(expr->assignment->ident);
+        copy->assignment->symbolEntry = expr->assignment->symbolEntry;
+        copy->assignment->lvalue = exprCopy(expr->assignment->lvalue);
+        copy->assignment->type = expr->assignment->type;
+        break;
+    case FUNC_EXPR:
+        copy->function = funcExprCreate(expr->function->argsSize);
+        copy->function->ident = copyString(expr->function->ident);
+        copy->function->type = expr->function->type;
+        copy->function->symbolEntry = expr->function->symbolEntry;
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            copy->function->args[i] = exprCopy(expr->function->args[i]);
+        }
+        break;
+    }
+    return copy;
+}
+
+// Deep copy of statements without declarations, loops, switches or labels, which own symbol entries
+Stmt *stmtCopy(const Stmt *stmt)
+{
+    Stmt *copy = stmtCreate(stmt->type);
+    switch (stmt->type)
+    {
+    case IF_STMT:
+        copy->ifStmt = ifStmtCreate(exprCopy(stmt->ifStmt->condition), stmtCopy(stmt->ifStmt->trueBody));
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            copy->ifStmt->falseBody = stmtCopy(stmt->ifStmt->falseBody);
+        }
+        break;
+    case EXPR_STMT:
+        copy->exprStmt = exprStmtCreate();
+        copy->exprStmt->expr = exprCopy(stmt->exprStmt->expr);
+        break;
+    case COMPOUND_STMT:
+        if (stmt->compoundStmt->declList.size != 0)
+        {
+            fprintf(stderr, "Declarations cannot be copied, exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+        copy->compoundStmt = compoundStmtCreate();
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            statementListPush(&copy->compoundStmt->stmtList, stmtCopy(stmt->compoundStmt->stmtList.stmts[i]));
+        }
+        break;
+    case JUMP_STMT:
+        copy->jumpStmt = jumpStmtCreate(stmt->jumpStmt->type);
+        copy->jumpStmt->ident = copyString(stmt->jumpStmt->ident);
+        copy->jumpStmt->expr = exprCopy(stmt->jumpStmt->expr);
+        copy->jumpStmt->symbolEntry = stmt->jumpStmt->symbolEntry;
+        break;
+    default:
+        fprintf(stderr, "Statement cannot be copied, exiting...\n");
+        exit(EXIT_FAILURE);
+    }
+    return copy;
+}
+
 // Crawls the tree and resolves the types of expressions
 void resolveType(Expr *expr)
 {
@@ -175,6 +175,7 @@ typedef struct WhileStmt
     Stmt *body;
     bool doWhile;
     SymbolEntry *symbolEntry;
+    Stmt *preheader; // NULL unless code was hoisted, runs once after the entry test
 } WhileStmt;
 
 typedef struct ForStmt
@@ -184,6 +185,7 @@ typedef struct ForStmt
     Expr *modifier;
     Stmt *body;
     SymbolEntry *symbolEntry;
+    Stmt *preheader; // NULL unless code was hoisted, runs once after the entry test
 } ForStmt;
 
 typedef struct IfStmt
@@ -469,6 +471,9 @@ Initializer *initCreate(void);
 void initDestroy(Initializer *init);
 
 DataType returnType(Expr *expr);
+bool exprEqual(const Expr *a, const Expr *b);
+Expr *exprCopy(const Expr *expr);
+Stmt *stmtCopy(const Stmt *stmt);
 void resolveType(Expr *expr);
 
 ExternDecl *externDeclCreate(bool isFunc);
@@ -1,57 +1,255 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "alias.h"
 #include "ast.h"
+#include "cfg.h"
+#include "clobber.h"
 #include "codegen.h"
+#include "dataflow.h"
+#include "cse.h"
+#include "dce.h"
+#include "inline.h"
+#include "layout.h"
+#include "loop.h"
+#include "optimise.h"
 #include "parser.tab.h"
+#include "peephole.h"
+#include "profile.h"
+#include "schedule.h"
 #include "symbol.h"
 
-int main(int argc, char **argv)
+static bool peepholeStats = false;
+static const char *cfgDumpPath = NULL;
+
+// numeric option values, capped to keep the growth they allow sane
+static bool parseCount(const char *value, size_t *count)
 {
-    if (argc != 5 && argc != 3)
+    char *end;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed > 1024)
     {
-        fprintf(stderr, "Incorrect usage, exitting...\n");
-        return EXIT_FAILURE;
+        return false;
+    }
+    *count = parsed;
+    return true;
+}
+
+// handles -f options, returns false for anything unknown
+static bool parseOption(const char *option)
+{
+    if (strcmp(option, "-fno-peephole") == 0)
+    {
+        peepholeEnabled = false;
+        return true;
+    }
+    if (strncmp(option, "-fno-peephole=", strlen("-fno-peephole=")) == 0)
+    {
+        return setPeepholeRule(option + strlen("-fno-peephole="), false);
+    }
+    if (strcmp(option, "-fpeephole-stats") == 0)
+    {
+        peepholeStats = true;
+        return true;
+    }
+    if (strcmp(option, "-fno-ipra") == 0)
+    {
+        ipraEnabled = false;
+        return true;
+    }
+    if (strncmp(option, "-fdump-cfg=", strlen("-fdump-cfg=")) == 0 && option[strlen("-fdump-cfg=")] != '\0')
+    {
+        cfgDumpPath = option + strlen("-fdump-cfg=");
+        return true;
+    }
+    if (strncmp(option, "-mtune=", strlen("-mtune=")) == 0)
+    {
+        return setTuning(option + strlen("-mtune="));
+    }
+    if (strcmp(option, "-fno-schedule-insns") == 0)
+    {
+        scheduleEnabled = false;
+        return true;
+    }
+    if (strcmp(option, "-fno-schedule-insns2") == 0)
+    {
+        postScheduleEnabled = false;
+        return true;
+    }
+    if (strcmp(option, "-fno-reorder-blocks") == 0)
+    {
+        layoutEnabled = false;
+        return true;
+    }
+    if (strcmp(option, "-fno-align-loops") == 0)
+    {
+        loopAlignment = 1;
+        return true;
+    }
+    if (strncmp(option, "-falign-loops=", strlen("-falign-loops=")) == 0)
+    {
+        // a power of two number of bytes
+        return parseCount(option + strlen("-falign-loops="), &loopAlignment) && loopAlignment != 0 &&
+               (loopAlignment & (loopAlignment - 1)) == 0;
+    }
+    if (strcmp(option, "-fprofile-generate") == 0)
+    {
+        profileGenerate = true;
+        return true;
+    }
+    if (strcmp(option, "-fprofile-use") == 0)
+    {
+        profileUsePath = DEFAULT_PROFILE_PATH;
+        return true;
+    }
+    if (strncmp(option, "-fprofile-use=", strlen("-fprofile-use=")) == 0 && option[strlen("-fprofile-use=")] != '\0')
+    {
+        profileUsePath = option + strlen("-fprofile-use=");
+        return true;
+    }
+    if (strcmp(option, "-fprofile-functions") == 0)
+    {
+        profileFunctions = true;
+        return true;
+    }
+    if (strcmp(option, "-fno-alias") == 0)
+    {
+        aliasEnabled = false;
+        return true;
+    }
+    if (strcmp(option, "-fno-cse") == 0)
+    {
+        cseEnabled = false;
+        return true;
+    }
+    if (strcmp(option, "-fno-dce") == 0)
+    {
+        dceEnabled = false;
+        return true;
+    }
+    if (strcmp(option, "-fno-dse") == 0)
+    {
+        dseEnabled = false;
+        return true;
     }
-    if (argc == 5)
+    if (strcmp(option, "-fno-inline") == 0)
     {
-        yyin = fopen(argv[2], "r");
-        if (yyin == NULL)
+        inlineEnabled = false;
+        return true;
+    }
+    if (strncmp(option, "-finline-limit=", strlen("-finline-limit=")) == 0)
+    {
+        return parseCount(option + strlen("-finline-limit="), &inlineLimit);
+    }
+    if (strncmp(option, "-finline-budget=", strlen("-finline-budget=")) == 0)
+    {
+        return parseCount(option + strlen("-finline-budget="), &inlineBudget);
+    }
+    if (strcmp(option, "-fno-unroll-loops") == 0)
+    {
+        unrollEnabled = false;
+        return true;
+    }
+    if (strncmp(option, "-funroll-factor=", strlen("-funroll-factor=")) == 0)
+    {
+        return parseCount(option + strlen("-funroll-factor="), &unrollFactor);
+    }
+    if (strncmp(option, "-funroll-budget=", strlen("-funroll-budget=")) == 0)
+    {
+        return parseCount(option + strlen("-funroll-budget="), &unrollBudget);
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    const char *sourcePath = NULL;
+    const char *outputPath = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
         {
-            fprintf(stderr, "Unable to open source file, exitting...\n");
+            sourcePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (!parseOption(argv[i]))
+        {
+            fprintf(stderr, "Incorrect usage, exitting...\n");
             return EXIT_FAILURE;
         }
-        outFile = fopen(argv[4], "w");
+    }
+    if (sourcePath == NULL || (profileGenerate && profileUsePath != NULL))
+    {
+        fprintf(stderr, "Incorrect usage, exitting...\n");
+        return EXIT_FAILURE;
+    }
+    if (profileUsePath != NULL)
+    {
+        loadProfile(profileUsePath);
+    }
+    yyin = fopen(sourcePath, "r");
+    if (yyin == NULL)
+    {
+        fprintf(stderr, "Unable to open source file, exitting...\n");
+        return EXIT_FAILURE;
+    }
+    if (outputPath != NULL)
+    {
+        outFile = fopen(outputPath, "w");
         if (outFile == NULL)
         {
             fprintf(stderr, "Unable to open output file for writting, exitting...\n");
             fclose(yyin);
+            return EXIT_FAILURE;
         }
     }
     else
     {
-        yyin = fopen(argv[2], "r");
-        if (yyin == NULL)
+        fprintf(stderr, "No output file specified, outputing to STDOUT...\n");
+        outFile = stdout;
+    }
+    if (cfgDumpPath != NULL)
+    {
+        cfgDumpFile = fopen(cfgDumpPath, "w");
+        if (cfgDumpFile == NULL)
         {
-            fprintf(stderr, "Unable to open source file, exitting...\n");
+            fprintf(stderr, "Unable to open graph file for writting, exitting...\n");
+            fclose(yyin);
             return EXIT_FAILURE;
         }
-        fprintf(stderr, "No output file specified, outputing to STDOUT...\n");
-        outFile = stdout;
     }
     yyparse();
     SymbolTable *globalTable = populateSymbolTable(root);
     displaySymbolTable(globalTable);
+    optimiseTranslationUnit(root);
 
     compileTranslationUnit(root);
     transUnitDestroy(root);
     symbolTableDestroy(globalTable);
+    optimiserEntriesDestroy();
+    aliasesDestroy();
+    clobbersDestroy();
+    profileDestroy();
+
+    if (peepholeStats)
+    {
+        printPeepholeStats(stderr);
+    }
 
     fclose(yyin);
-    if (argc == 5)
+    if (outputPath != NULL)
     {
         fclose(outFile);
     }
+    if (cfgDumpFile != NULL)
+    {
+        fclose(cfgDumpFile);
+    }
     // TODO: Maybe remove
     yylex_destroy();
     return EXIT_SUCCESS;
@@ -0,0 +1,621 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "peephole.h"
+
+// where -fdump-cfg writes a graph of every compiled function, NULL if it was not given
+FILE *cfgDumpFile = NULL;
+
+// Scratch arrays of the Lengauer-Tarjan algorithm, over any graph given as successor and predecessor lists
+typedef struct DomState
+{
+    const BlockList *succs;
+    const BlockList *preds;
+    size_t *dfnum;
+    size_t *vertex;
+    size_t *parent;
+    size_t *semi;
+    size_t *ancestor;
+    size_t *label;
+    BlockList *bucket;
+    size_t count;
+} DomState;
+
+void blockListPush(BlockList *list, size_t block)
+{
+    if (list->size == list->capacity)
+    {
+        list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+        list->blocks = realloc(list->blocks, sizeof(size_t) * list->capacity);
+        if (list->blocks == NULL)
+        {
+            abort();
+        }
+    }
+    list->blocks[list->size++] = block;
+}
+
+bool blockListContains(const BlockList *list, size_t block)
+{
+    for (size_t i = 0; i < list->size; i++)
+    {
+        if (list->blocks[i] == block)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void blockListDestroy(BlockList *list)
+{
+    free(list->blocks);
+    list->blocks = NULL;
+    list->size = 0;
+    list->capacity = 0;
+}
+
+static size_t *indexArray(size_t size)
+{
+    size_t *array = malloc(sizeof(size_t) * (size + 1));
+    if (array == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i <= size; i++)
+    {
+        array[i] = NO_BLOCK;
+    }
+    return array;
+}
+
+static bool isOp(const Instr *instr, const char *opcode)
+{
+    return instr->kind == INSTR_OP && strcmp(instr->opcode, opcode) == 0;
+}
+
+// returns, tail calls and indirect jumps, control does not come back to the function
+static bool leavesFunction(const Instr *instr)
+{
+    return isOp(instr, "ret") || isOp(instr, "tail") || isOp(instr, "jr");
+}
+
+static bool endsBlock(const Instr *instr)
+{
+    return isOp(instr, "j") || leavesFunction(instr) || isBranch(instr);
+}
+
+// the last instruction of a block that is not deleted, NULL if there is none
+static const Instr *lastInstr(const Cfg *cfg, size_t block)
+{
+    for (size_t i = cfg->blocks[block].end; i > cfg->blocks[block].first; i--)
+    {
+        const Instr *instr = &cfg->list->instrs[i - 1];
+        if (!instr->deleted && instr->kind == INSTR_OP)
+        {
+            return instr;
+        }
+    }
+    return NULL;
+}
+
+void cfgAddBlock(Cfg *cfg, size_t first, size_t *capacity)
+{
+    if (cfg->size == *capacity)
+    {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        cfg->blocks = realloc(cfg->blocks, sizeof(BasicBlock) * *capacity);
+        if (cfg->blocks == NULL)
+        {
+            abort();
+        }
+    }
+    BasicBlock *block = &cfg->blocks[cfg->size++];
+    memset(block, 0, sizeof(BasicBlock));
+    block->first = first;
+    block->end = first;
+    block->idom = NO_BLOCK;
+    block->ipdom = NO_BLOCK;
+    block->rpoIndex = NO_BLOCK;
+    block->loop = NO_BLOCK;
+}
+
+void cfgAddEdge(Cfg *cfg, size_t from, size_t to)
+{
+    if (to != NO_BLOCK && !blockListContains(&cfg->blocks[from].succs, to))
+    {
+        blockListPush(&cfg->blocks[from].succs, to);
+        blockListPush(&cfg->blocks[to].preds, from);
+    }
+}
+
+size_t cfgBlockOf(const Cfg *cfg, const char *label)
+{
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        for (size_t i = cfg->blocks[block].first; i < cfg->blocks[block].end; i++)
+        {
+            const Instr *instr = &cfg->list->instrs[i];
+            if (!instr->deleted && instr->kind == INSTR_LABEL && strcmp(instr->operands[0], label) == 0)
+            {
+                return block;
+            }
+        }
+    }
+    return NO_BLOCK;
+}
+
+// a label starts a block once the current one holds an instruction, jumps and branches end one
+static void splitBlocks(Cfg *cfg)
+{
+    size_t capacity = 0;
+    bool hasOps = false;
+    bool ended = false;
+    cfgAddBlock(cfg, 0, &capacity);
+    for (size_t i = 0; i < cfg->list->size; i++)
+    {
+        const Instr *instr = &cfg->list->instrs[i];
+        if (!instr->deleted && (ended || (instr->kind == INSTR_LABEL && hasOps)))
+        {
+            cfg->blocks[cfg->size - 1].end = i;
+            cfgAddBlock(cfg, i, &capacity);
+            hasOps = false;
+            ended = false;
+        }
+        if (!instr->deleted && instr->kind == INSTR_OP)
+        {
+            hasOps = true;
+            ended = endsBlock(instr);
+        }
+    }
+    cfg->blocks[cfg->size - 1].end = cfg->list->size;
+
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        const Instr *last = lastInstr(cfg, block);
+        size_t next = block + 1 < cfg->size ? block + 1 : NO_BLOCK;
+        if (last == NULL || (!endsBlock(last)))
+        {
+            cfgAddEdge(cfg, block, next);
+        }
+        else if (isOp(last, "j"))
+        {
+            cfgAddEdge(cfg, block, cfgBlockOf(cfg, last->operands[0]));
+        }
+        else if (isBranch(last))
+        {
+            cfgAddEdge(cfg, block, cfgBlockOf(cfg, last->operands[last->operandCount - 1]));
+            cfgAddEdge(cfg, block, next);
+        }
+    }
+}
+
+static void postOrder(const Cfg *cfg, size_t block, bool *visited, BlockList *order)
+{
+    visited[block] = true;
+    const BlockList *succs = &cfg->blocks[block].succs;
+    for (size_t i = 0; i < succs->size; i++)
+    {
+        if (!visited[succs->blocks[i]])
+        {
+            postOrder(cfg, succs->blocks[i], visited, order);
+        }
+    }
+    blockListPush(order, block);
+}
+
+static void reversePostOrder(Cfg *cfg)
+{
+    bool *visited = calloc(cfg->size, sizeof(bool));
+    if (visited == NULL)
+    {
+        abort();
+    }
+    BlockList order = {NULL, 0, 0};
+    postOrder(cfg, 0, visited, &order);
+    for (size_t i = order.size; i > 0; i--)
+    {
+        cfg->blocks[order.blocks[i - 1]].rpoIndex = cfg->rpo.size;
+        blockListPush(&cfg->rpo, order.blocks[i - 1]);
+    }
+    blockListDestroy(&order);
+    free(visited);
+}
+
+static void domDfs(DomState *state, size_t v, size_t parent)
+{
+    state->dfnum[v] = state->count;
+    state->vertex[state->count++] = v;
+    state->parent[v] = parent;
+    for (size_t i = 0; i < state->succs[v].size; i++)
+    {
+        size_t w = state->succs[v].blocks[i];
+        if (state->dfnum[w] == NO_BLOCK)
+        {
+            domDfs(state, w, v);
+        }
+    }
+}
+
+static void compress(DomState *state, size_t v)
+{
+    size_t ancestor = state->ancestor[v];
+    if (state->ancestor[ancestor] != NO_BLOCK)
+    {
+        compress(state, ancestor);
+        if (state->semi[state->label[ancestor]] < state->semi[state->label[v]])
+        {
+            state->label[v] = state->label[ancestor];
+        }
+        state->ancestor[v] = state->ancestor[ancestor];
+    }
+}
+
+// the vertex of least semidominator on the compressed path to the root of the forest
+static size_t eval(DomState *state, size_t v)
+{
+    if (state->ancestor[v] == NO_BLOCK)
+    {
+        return v;
+    }
+    compress(state, v);
+    return state->label[v];
+}
+
+// Lengauer-Tarjan with path compression, idom[root] and idom of unreachable nodes are NO_BLOCK
+static void lengauerTarjan(const BlockList *succs, const BlockList *preds, size_t size, size_t root, size_t *idom)
+{
+    DomState state = {succs, preds, indexArray(size), indexArray(size), indexArray(size), indexArray(size),
+                      indexArray(size), indexArray(size), calloc(size, sizeof(BlockList)), 0};
+    if (state.bucket == NULL)
+    {
+        abort();
+    }
+    domDfs(&state, root, NO_BLOCK);
+    for (size_t v = 0; v < size; v++)
+    {
+        idom[v] = NO_BLOCK;
+        state.semi[v] = state.dfnum[v];
+        state.label[v] = v;
+    }
+
+    for (size_t i = state.count; i-- > 1;)
+    {
+        size_t w = state.vertex[i];
+        size_t parent = state.parent[w];
+        for (size_t j = 0; j < preds[w].size; j++)
+        {
+            size_t v = preds[w].blocks[j];
+            if (state.dfnum[v] == NO_BLOCK)
+            {
+                continue;
+            }
+            size_t u = eval(&state, v);
+            if (state.semi[u] < state.semi[w])
+            {
+                state.semi[w] = state.semi[u];
+            }
+        }
+        blockListPush(&state.bucket[state.vertex[state.semi[w]]], w);
+        state.ancestor[w] = parent;
+
+        BlockList *bucket = &state.bucket[parent];
+        for (size_t j = 0; j < bucket->size; j++)
+        {
+            size_t v = bucket->blocks[j];
+            size_t u = eval(&state, v);
+            idom[v] = state.semi[u] < state.semi[v] ? u : parent;
+        }
+        bucket->size = 0;
+    }
+    for (size_t i = 1; i < state.count; i++)
+    {
+        size_t w = state.vertex[i];
+        if (idom[w] != state.vertex[state.semi[w]])
+        {
+            idom[w] = idom[idom[w]];
+        }
+    }
+
+    for (size_t v = 0; v < size; v++)
+    {
+        blockListDestroy(&state.bucket[v]);
+    }
+    free(state.bucket);
+    free(state.dfnum);
+    free(state.vertex);
+    free(state.parent);
+    free(state.semi);
+    free(state.ancestor);
+    free(state.label);
+}
+
+static void dominators(Cfg *cfg)
+{
+    BlockList *succs = malloc(sizeof(BlockList) * cfg->size);
+    BlockList *preds = malloc(sizeof(BlockList) * cfg->size);
+    size_t *idom = indexArray(cfg->size);
+    if (succs == NULL || preds == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        succs[i] = cfg->blocks[i].succs;
+        preds[i] = cfg->blocks[i].preds;
+    }
+    lengauerTarjan(succs, preds, cfg->size, 0, idom);
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        cfg->blocks[i].idom = idom[i];
+    }
+    free(succs);
+    free(preds);
+    free(idom);
+}
+
+// dominators of the reversed graph, rooted at a virtual exit every block leaving the function reaches
+static void postDominators(Cfg *cfg)
+{
+    size_t exit = cfg->size;
+    BlockList *succs = calloc(cfg->size + 1, sizeof(BlockList));
+    BlockList *preds = calloc(cfg->size + 1, sizeof(BlockList));
+    size_t *ipdom = indexArray(cfg->size + 1);
+    if (succs == NULL || preds == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        const BasicBlock *block = &cfg->blocks[i];
+        for (size_t j = 0; j < block->preds.size; j++)
+        {
+            blockListPush(&succs[i], block->preds.blocks[j]);
+        }
+        for (size_t j = 0; j < block->succs.size; j++)
+        {
+            blockListPush(&preds[i], block->succs.blocks[j]);
+        }
+        if (block->succs.size == 0)
+        {
+            blockListPush(&succs[exit], i);
+            blockListPush(&preds[i], exit);
+        }
+    }
+    lengauerTarjan(succs, preds, cfg->size + 1, exit, ipdom);
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        cfg->blocks[i].ipdom = ipdom[i] == exit ? NO_BLOCK : ipdom[i];
+    }
+    for (size_t i = 0; i <= cfg->size; i++)
+    {
+        blockListDestroy(&succs[i]);
+        blockListDestroy(&preds[i]);
+    }
+    free(succs);
+    free(preds);
+    free(ipdom);
+}
+
+bool cfgDominates(const Cfg *cfg, size_t a, size_t b)
+{
+    for (size_t block = b; block != NO_BLOCK; block = cfg->blocks[block].idom)
+    {
+        if (block == a)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool cfgPostDominates(const Cfg *cfg, size_t a, size_t b)
+{
+    for (size_t block = b; block != NO_BLOCK; block = cfg->blocks[block].ipdom)
+    {
+        if (block == a)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static Loop *loopOf(Cfg *cfg, size_t header)
+{
+    for (size_t i = 0; i < cfg->loopCount; i++)
+    {
+        if (cfg->loops[i].header == header)
+        {
+            return &cfg->loops[i];
+        }
+    }
+    cfg->loops = realloc(cfg->loops, sizeof(Loop) * (cfg->loopCount + 1));
+    if (cfg->loops == NULL)
+    {
+        abort();
+    }
+    Loop *loop = &cfg->loops[cfg->loopCount++];
+    loop->header = header;
+    loop->body = (BlockList){NULL, 0, 0};
+    loop->parent = NO_BLOCK;
+    loop->depth = 1;
+    blockListPush(&loop->body, header);
+    return loop;
+}
+
+// one loop per header, the union of the bodies of its back edges
+static void naturalLoops(Cfg *cfg)
+{
+    for (size_t i = 0; i < cfg->rpo.size; i++)
+    {
+        size_t tail = cfg->rpo.blocks[i];
+        const BlockList *succs = &cfg->blocks[tail].succs;
+        for (size_t j = 0; j < succs->size; j++)
+        {
+            size_t header = succs->blocks[j];
+            if (!cfgDominates(cfg, header, tail))
+            {
+                continue;
+            }
+            Loop *loop = loopOf(cfg, header);
+            BlockList stack = {NULL, 0, 0};
+            if (!blockListContains(&loop->body, tail))
+            {
+                blockListPush(&loop->body, tail);
+                blockListPush(&stack, tail);
+            }
+            while (stack.size != 0)
+            {
+                const BlockList *preds = &cfg->blocks[stack.blocks[--stack.size]].preds;
+                for (size_t k = 0; k < preds->size; k++)
+                {
+                    size_t pred = preds->blocks[k];
+                    if (cfg->blocks[pred].rpoIndex != NO_BLOCK && !blockListContains(&loop->body, pred))
+                    {
+                        blockListPush(&loop->body, pred);
+                        blockListPush(&stack, pred);
+                    }
+                }
+            }
+            blockListDestroy(&stack);
+        }
+    }
+
+    // the parent of a loop is the smallest other loop holding its header
+    for (size_t i = 0; i < cfg->loopCount; i++)
+    {
+        Loop *loop = &cfg->loops[i];
+        for (size_t j = 0; j < cfg->loopCount; j++)
+        {
+            const Loop *other = &cfg->loops[j];
+            if (j != i && blockListContains(&other->body, loop->header) &&
+                (loop->parent == NO_BLOCK || other->body.size < cfg->loops[loop->parent].body.size))
+            {
+                loop->parent = j;
+            }
+        }
+    }
+    for (size_t i = 0; i < cfg->loopCount; i++)
+    {
+        Loop *loop = &cfg->loops[i];
+        for (size_t parent = loop->parent; parent != NO_BLOCK; parent = cfg->loops[parent].parent)
+        {
+            loop->depth++;
+        }
+        for (size_t j = 0; j < loop->body.size; j++)
+        {
+            BasicBlock *block = &cfg->blocks[loop->body.blocks[j]];
+            if (loop->depth > block->loopDepth)
+            {
+                block->loop = i;
+                block->loopDepth = loop->depth;
+            }
+        }
+    }
+}
+
+// splits the instructions of one function into blocks, then computes orders, dominators and loops
+void cfgBuild(Cfg *cfg, InstrList *list)
+{
+    cfg->list = list;
+    cfg->blocks = NULL;
+    cfg->size = 0;
+    cfg->rpo = (BlockList){NULL, 0, 0};
+    cfg->loops = NULL;
+    cfg->loopCount = 0;
+
+    splitBlocks(cfg);
+    cfgAnalyse(cfg);
+}
+
+// orders, dominators and loops of a graph whose blocks and edges are already in place
+void cfgAnalyse(Cfg *cfg)
+{
+    reversePostOrder(cfg);
+    dominators(cfg);
+    postDominators(cfg);
+    naturalLoops(cfg);
+}
+
+void cfgDestroy(Cfg *cfg)
+{
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        blockListDestroy(&cfg->blocks[i].succs);
+        blockListDestroy(&cfg->blocks[i].preds);
+    }
+    for (size_t i = 0; i < cfg->loopCount; i++)
+    {
+        blockListDestroy(&cfg->loops[i].body);
+    }
+    free(cfg->blocks);
+    free(cfg->loops);
+    blockListDestroy(&cfg->rpo);
+    cfg->blocks = NULL;
+    cfg->loops = NULL;
+    cfg->size = 0;
+    cfg->loopCount = 0;
+}
+
+// instruction text inside a quoted Graphviz label, one left aligned line each
+static void writeDotText(const char *text, FILE *file)
+{
+    for (; *text != '\0' && *text != '\n'; text++)
+    {
+        if (*text == '"' || *text == '\\')
+        {
+            fputc('\\', file);
+        }
+        fputc(*text == '\t' ? ' ' : *text, file);
+    }
+    fputs("\\l", file);
+}
+
+// blocks with their instructions, control flow edges solid, the dominator tree dashed
+void cfgWriteDot(const Cfg *cfg, const char *name, FILE *file)
+{
+    fprintf(file, "digraph \"%s\"\n{\n", name);
+    fprintf(file, "    node [shape=box, fontname=\"monospace\"];\n");
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        const BasicBlock *block = &cfg->blocks[i];
+        fprintf(file, "    b%lu [label=\"B%lu", i, i);
+        if (block->rpoIndex == NO_BLOCK)
+        {
+            fprintf(file, " unreachable");
+        }
+        if (block->loopDepth != 0)
+        {
+            fprintf(file, " loop depth %lu", block->loopDepth);
+        }
+        fprintf(file, "\\l");
+        for (size_t j = block->first; j < block->end; j++)
+        {
+            const Instr *instr = &cfg->list->instrs[j];
+            if (!instr->deleted)
+            {
+                writeDotText(instr->text, file);
+            }
+        }
+        fprintf(file, "\"];\n");
+    }
+    for (size_t i = 0; i < cfg->size; i++)
+    {
+        const BasicBlock *block = &cfg->blocks[i];
+        for (size_t j = 0; j < block->succs.size; j++)
+        {
+            size_t succ = block->succs.blocks[j];
+            bool backEdge = cfgDominates(cfg, succ, i);
+            fprintf(file, "    b%lu -> b%lu%s;\n", i, succ, backEdge ? " [style=bold]" : "");
+        }
+        if (block->idom != NO_BLOCK)
+        {
+            fprintf(file, "    b%lu -> b%lu [style=dashed, color=blue, constraint=false];\n", block->idom, i);
+        }
+    }
+    fprintf(file, "}\n");
+}
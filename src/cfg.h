@@ -0,0 +1,68 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "peephole.h"
+
+#define NO_BLOCK ((size_t)-1)
+
+typedef struct BlockList
+{
+    size_t *blocks;
+    size_t size;
+    size_t capacity;
+} BlockList;
+
+// A straight run of instructions, entered only at the top and left only at the bottom
+typedef struct BasicBlock
+{
+    size_t first; // index of the first instruction in the list
+    size_t end;   // one past the last instruction
+    BlockList succs;
+    BlockList preds;
+    size_t idom;      // immediate dominator, NO_BLOCK for the entry and unreachable blocks
+    size_t ipdom;     // immediate post-dominator, NO_BLOCK if the block leaves the function or never does
+    size_t rpoIndex;  // position in reverse post-order, NO_BLOCK if unreachable
+    size_t loop;      // innermost natural loop containing the block, NO_BLOCK outside loops
+    size_t loopDepth; // number of loops containing the block
+} BasicBlock;
+
+// The blocks of a back edge target that can reach one of its back edges without passing it
+typedef struct Loop
+{
+    size_t header;
+    BlockList body; // header included
+    size_t parent;  // innermost enclosing loop, NO_BLOCK at the outermost level
+    size_t depth;   // 1 for outermost loops
+} Loop;
+
+typedef struct Cfg
+{
+    InstrList *list; // NULL for a graph over machine instructions
+    BasicBlock *blocks; // blocks[0] is the entry
+    size_t size;
+    BlockList rpo; // reachable blocks in reverse post-order
+    Loop *loops;
+    size_t loopCount;
+} Cfg;
+
+extern FILE *cfgDumpFile;
+
+void blockListPush(BlockList *list, size_t block);
+bool blockListContains(const BlockList *list, size_t block);
+void blockListDestroy(BlockList *list);
+
+void cfgBuild(Cfg *cfg, InstrList *list);
+void cfgAddBlock(Cfg *cfg, size_t first, size_t *capacity);
+void cfgAddEdge(Cfg *cfg, size_t from, size_t to);
+void cfgAnalyse(Cfg *cfg);
+void cfgDestroy(Cfg *cfg);
+size_t cfgBlockOf(const Cfg *cfg, const char *label);
+bool cfgDominates(const Cfg *cfg, size_t a, size_t b);
+bool cfgPostDominates(const Cfg *cfg, size_t a, size_t b);
+void cfgWriteDot(const Cfg *cfg, const char *name, FILE *file);
+
+#endif
@@ -0,0 +1,376 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "clobber.h"
+#include "codegen.h"
+#include "peephole.h"
+
+// interprocedural register allocation, set from the command line
+bool ipraEnabled = true;
+
+// The caller-saved registers a compiled function may overwrite, those of its callees included
+typedef struct FuncClobbers
+{
+    char *ident;
+    uint64_t mask;
+} FuncClobbers;
+
+static FuncClobbers *clobbers = NULL;
+static size_t clobbersSize = 0;
+static size_t clobbersCapacity = 0;
+
+// Functions of a translation unit in the order they are compiled, callees before their callers
+typedef struct CallOrder
+{
+    TranslationUnit *transUnit;
+    bool *visited;
+    size_t *order;
+    size_t size;
+} CallOrder;
+
+static void visitFunc(size_t index, CallOrder *callOrder);
+
+uint64_t regMask(Reg reg)
+{
+    return (uint64_t)1 << reg;
+}
+
+// what a call may change under the calling convention, anything else is restored by the callee
+static uint64_t callerSaved(void)
+{
+    static const Reg saved[] = {RA, T0, T1, T2, T3, T4, T5, T6, A0, A1, A2, A3, A4, A5, A6, A7,
+                                FT0, FT1, FT2, FT3, FT4, FT5, FT6, FT7, FT8, FT9, FT10, FT11,
+                                FA0, FA1, FA2, FA3, FA4, FA5, FA6, FA7};
+    uint64_t mask = 0;
+    for (size_t i = 0; i < sizeof(saved) / sizeof(saved[0]); i++)
+    {
+        mask |= regMask(saved[i]);
+    }
+    return mask;
+}
+
+static bool regFromName(const char *name, Reg *reg)
+{
+    for (size_t i = 0; i < 64; i++)
+    {
+        if (strcmp(regStr(i), name) == 0)
+        {
+            *reg = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// stores, branches and jumps, their first operand is read rather than written
+static bool writesNothing(const Instr *instr)
+{
+    static const char *opcodes[] = {"sb", "sh", "sw", "fsw", "fsd", "j", "jr", "ret",
+                                    "beq", "bne", "blt", "bge", "bltu", "bgeu", "bgt", "ble",
+                                    "bgtu", "bleu", "beqz", "bnez", "bltz", "bgez", "blez", "bgtz"};
+    for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++)
+    {
+        if (strcmp(instr->opcode, opcodes[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a line the peephole reader could not split, nothing is known about what it writes
+static bool isOpaque(const Instr *instr)
+{
+    const char *text = instr->text;
+    while (*text == ' ' || *text == '\t')
+    {
+        text++;
+    }
+    return instr->kind == INSTR_DIRECTIVE && *text != '.' && *text != '#' && *text != '\n' && *text != '\0';
+}
+
+uint64_t funcClobbers(const char *ident)
+{
+    if (ipraEnabled)
+    {
+        for (size_t i = 0; i < clobbersSize; i++)
+        {
+            if (strcmp(clobbers[i].ident, ident) == 0)
+            {
+                return clobbers[i].mask;
+            }
+        }
+    }
+    // not compiled yet, external or part of a cycle of calls
+    return callerSaved();
+}
+
+// s1-s11 are saved by every prologue and restored before every return, the pair is dropped for
+// registers the body never writes
+void trimCalleeSaves(InstrList *list)
+{
+    if (!ipraEnabled)
+    {
+        return;
+    }
+    for (size_t n = 1; n <= 11; n++)
+    {
+        char name[8];
+        char saveSlot[OPERAND_LENGTH];
+        char restoreSlot[OPERAND_LENGTH];
+        sprintf(name, "s%lu", n);
+        sprintf(saveSlot, "-%lu(sp)", 8 + (n * 4));
+        sprintf(restoreSlot, "-%lu(fp)", 8 + (n * 4));
+
+        bool written = false;
+        for (size_t i = 0; i < list->size && !written; i++)
+        {
+            const Instr *instr = &list->instrs[i];
+            if (instr->deleted)
+            {
+                continue;
+            }
+            bool restore = strcmp(instr->opcode, "lw") == 0 && instr->operandCount == 2 &&
+                           strcmp(instr->operands[1], restoreSlot) == 0;
+            written = isOpaque(instr) ||
+                      (instr->kind == INSTR_OP && !writesNothing(instr) && !restore && instr->operandCount != 0 &&
+                       strcmp(instr->operands[0], name) == 0);
+        }
+        if (written)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < list->size; i++)
+        {
+            Instr *instr = &list->instrs[i];
+            if (instr->kind == INSTR_OP && instr->operandCount == 2 && strcmp(instr->operands[0], name) == 0 &&
+                ((strcmp(instr->opcode, "sw") == 0 && strcmp(instr->operands[1], saveSlot) == 0) ||
+                 (strcmp(instr->opcode, "lw") == 0 && strcmp(instr->operands[1], restoreSlot) == 0)))
+            {
+                instr->deleted = true;
+            }
+        }
+    }
+}
+
+// the registers written by a finished function, calls add what their callee clobbers
+void recordClobbers(const char *ident, const InstrList *list)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < list->size; i++)
+    {
+        const Instr *instr = &list->instrs[i];
+        if (instr->deleted)
+        {
+            continue;
+        }
+        if (isOpaque(instr) || (instr->kind == INSTR_OP && (strcmp(instr->opcode, "jal") == 0 || strcmp(instr->opcode, "jalr") == 0)))
+        {
+            mask |= callerSaved();
+            continue;
+        }
+        if (instr->kind != INSTR_OP || writesNothing(instr) || instr->operandCount == 0)
+        {
+            continue;
+        }
+        if (strcmp(instr->opcode, "call") == 0 || strcmp(instr->opcode, "tail") == 0)
+        {
+            mask |= funcClobbers(instr->operands[0]) | regMask(RA);
+            continue;
+        }
+        Reg reg;
+        if (regFromName(instr->operands[0], &reg))
+        {
+            mask |= regMask(reg);
+        }
+    }
+
+    if (clobbersSize == clobbersCapacity)
+    {
+        clobbersCapacity = clobbersCapacity == 0 ? 16 : clobbersCapacity * 2;
+        clobbers = realloc(clobbers, sizeof(FuncClobbers) * clobbersCapacity);
+        if (clobbers == NULL)
+        {
+            abort();
+        }
+    }
+    clobbers[clobbersSize].ident = malloc(strlen(ident) + 1);
+    if (clobbers[clobbersSize].ident == NULL)
+    {
+        abort();
+    }
+    strcpy(clobbers[clobbersSize].ident, ident);
+    clobbers[clobbersSize].mask = mask & callerSaved();
+    clobbersSize++;
+}
+
+static void visitCallsExpr(const Expr *expr, CallOrder *callOrder)
+{
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+        if (expr->operation->op1 != NULL)
+        {
+            visitCallsExpr(expr->operation->op1, callOrder);
+        }
+        if (expr->operation->op2 != NULL)
+        {
+            visitCallsExpr(expr->operation->op2, callOrder);
+        }
+        if (expr->operation->op3 != NULL)
+        {
+            visitCallsExpr(expr->operation->op3, callOrder);
+        }
+        break;
+    case ASSIGN_EXPR:
+        visitCallsExpr(expr->assignment->op, callOrder);
+        if (expr->assignment->lvalue != NULL)
+        {
+            visitCallsExpr(expr->assignment->lvalue, callOrder);
+        }
+        break;
+    case FUNC_EXPR:
+    {
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            visitCallsExpr(expr->function->args[i], callOrder);
+        }
+        TranslationUnit *transUnit = callOrder->transUnit;
+        for (size_t i = 0; i < transUnit->size; i++)
+        {
+            ExternDecl *externDecl = transUnit->externDecls[i];
+            if (externDecl->isFunc && !externDecl->funcDef->isPrototype &&
+                strcmp(externDecl->funcDef->ident, expr->function->ident) == 0)
+            {
+                if (!callOrder->visited[i])
+                {
+                    visitFunc(i, callOrder);
+                }
+                break;
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void visitCallsStmt(const Stmt *stmt, CallOrder *callOrder)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        if (stmt->whileStmt->preheader != NULL)
+        {
+            visitCallsStmt(stmt->whileStmt->preheader, callOrder);
+        }
+        visitCallsExpr(stmt->whileStmt->condition, callOrder);
+        visitCallsStmt(stmt->whileStmt->body, callOrder);
+        break;
+    case FOR_STMT:
+        if (stmt->forStmt->preheader != NULL)
+        {
+            visitCallsStmt(stmt->forStmt->preheader, callOrder);
+        }
+        visitCallsStmt(stmt->forStmt->init, callOrder);
+        visitCallsStmt(stmt->forStmt->condition, callOrder);
+        visitCallsStmt(stmt->forStmt->body, callOrder);
+        if (stmt->forStmt->modifier != NULL)
+        {
+            visitCallsExpr(stmt->forStmt->modifier, callOrder);
+        }
+        break;
+    case IF_STMT:
+        visitCallsExpr(stmt->ifStmt->condition, callOrder);
+        visitCallsStmt(stmt->ifStmt->trueBody, callOrder);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            visitCallsStmt(stmt->ifStmt->falseBody, callOrder);
+        }
+        break;
+    case SWITCH_STMT:
+        visitCallsExpr(stmt->switchStmt->selector, callOrder);
+        visitCallsStmt(stmt->switchStmt->body, callOrder);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            visitCallsExpr(stmt->exprStmt->expr, callOrder);
+        }
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->declList.size; i++)
+        {
+            Decl *decl = stmt->compoundStmt->declList.decls[i];
+            if (decl->declInit != NULL && decl->declInit->initExpr != NULL)
+            {
+                visitCallsExpr(decl->declInit->initExpr, callOrder);
+            }
+        }
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            visitCallsStmt(stmt->compoundStmt->stmtList.stmts[i], callOrder);
+        }
+        break;
+    case LABEL_STMT:
+        visitCallsStmt(stmt->labelStmt->body, callOrder);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            visitCallsExpr(stmt->jumpStmt->expr, callOrder);
+        }
+        break;
+    }
+}
+
+static void visitFunc(size_t index, CallOrder *callOrder)
+{
+    callOrder->visited[index] = true;
+    FuncDef *funcDef = callOrder->transUnit->externDecls[index]->funcDef;
+    if (funcDef->body != NULL)
+    {
+        visitCallsStmt(funcDef->body, callOrder);
+    }
+    callOrder->order[callOrder->size++] = index;
+}
+
+// indices of the function definitions in a depth first post-order of the call graph, a function
+// in a cycle is reached before some of its callees and assumes they clobber everything
+size_t *bottomUpOrder(TranslationUnit *transUnit, size_t *size)
+{
+    CallOrder callOrder = {transUnit, calloc(transUnit->size + 1, sizeof(bool)),
+                           malloc(sizeof(size_t) * (transUnit->size + 1)), 0};
+    if (callOrder.visited == NULL || callOrder.order == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < transUnit->size; i++)
+    {
+        ExternDecl *externDecl = transUnit->externDecls[i];
+        if (externDecl->isFunc && !externDecl->funcDef->isPrototype && !callOrder.visited[i])
+        {
+            visitFunc(i, &callOrder);
+        }
+    }
+    free(callOrder.visited);
+    *size = callOrder.size;
+    return callOrder.order;
+}
+
+void clobbersDestroy(void)
+{
+    for (size_t i = 0; i < clobbersSize; i++)
+    {
+        free(clobbers[i].ident);
+    }
+    free(clobbers);
+    clobbers = NULL;
+    clobbersSize = 0;
+    clobbersCapacity = 0;
+}
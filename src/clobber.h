@@ -0,0 +1,21 @@
+#ifndef CLOBBER_H
+#define CLOBBER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "codegen.h"
+#include "peephole.h"
+
+extern bool ipraEnabled;
+
+uint64_t regMask(Reg reg);
+uint64_t funcClobbers(const char *ident);
+void trimCalleeSaves(InstrList *list);
+void recordClobbers(const char *ident, const InstrList *list);
+size_t *bottomUpOrder(TranslationUnit *transUnit, size_t *size);
+void clobbersDestroy(void);
+
+#endif
@@ -1,21 +1,62 @@
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ast.h"
+#include "cfg.h"
+#include "clobber.h"
 #include "codegen.h"
+#include "dataflow.h"
+#include "isel.h"
+#include "layout.h"
+#include "literals.h"
+#include "mir.h"
+#include "optimise.h"
+#include "peephole.h"
+#include "profile.h"
+#include "recursion.h"
+#include "regalloc.h"
+#include "schedule.h"
 #include "symbol.h"
 
 FILE *outFile;
 
-size_t LCLabelId = 0;
 size_t ifLabelId = 0;
-bool regs[64] = {0};
 int ternID = 0;
 
+// the function being compiled, a call it returns the result of can reuse its frame
+static DataType funcReturnType = VOID_TYPE;
+static bool funcFrameEscapes = false;
+static const char *funcIdent = NULL;
+static bool funcIsMain = false;
+static size_t vregCount = 0;
+static bool unitHasMain = false;
+
+// what the entry hook of -fprofile-functions read, for the exit hooks to measure against
+typedef struct FuncHook
+{
+    Reg cycles;
+    Reg instrs;
+    Reg childCycles; // of the caller, restored with this call added on the way out
+    Reg childInstrs;
+} FuncHook;
+
+static FuncHook funcHook;
+
 const char *regStr(Reg reg)
 {
+    if (reg >= VREG_BASE)
+    {
+        // a few buffers so that one instruction can name all of its operands
+        static char names[4][24];
+        static size_t next = 0;
+        char *name = names[next++ % 4];
+        snprintf(name, sizeof(names[0]), "%s%d", (reg - VREG_BASE) % 2 == 1 ? "fv" : "v", (int)(reg - VREG_BASE));
+        return name;
+    }
     switch (reg)
     {
     case ZERO:
@@ -149,47 +190,22 @@ const char *regStr(Reg reg)
     }
 }
 
-// Returns a temporary register
+// Returns a fresh virtual register, allocateRegisters maps it to a real one
 Reg getTmpReg(void)
 {
-    for (size_t i = 0; i < 32; i++)
-    {
-        if (i == T0 || i == T1 || i == T2 || i == T3 || i == T4 || i == T5 || i == T6 ||
-            i == S1 || i == S2 || i == S3 || i == S4 || i == S5 || i == S6 || i == S7 || i == S8 || i == S9)
-        {
-            if (!regs[i])
-            {
-                regs[i] = true;
-                return i;
-            }
-        }
-    }
-    fprintf(stderr, "All registers filled, exiting...\n");
-    exit(-1);
+    return VREG_BASE + 2 * vregCount++;
 }
 
-// Returns a temporary register
+// Returns a fresh floating-point virtual register
 Reg getTmpFltReg(void)
 {
-    for (size_t i = 32; i < 64; i++)
-    {
-        if (i == FT0 || i == FT1 || i == FT2 || i == FT3 || i == FT4 || i == FT5 || i == FT6 || i == FT7 || i == FT8 || i == FT9 || i == FT10 || i == FT11)
-        {
-            if (!regs[i])
-            {
-                regs[i] = true;
-                return i;
-            }
-        }
-    }
-    fprintf(stderr, "All floating-point registers filled, exiting...\n");
-    exit(-1);
+    return VREG_BASE + 2 * vregCount++ + 1;
 }
 
-// Free a register
+// Virtual registers are never reused, a value's live range ends at its last use
 void freeReg(Reg reg)
 {
-    regs[reg] = false;
+    (void)reg;
 }
 
 // Gets a "unique" number, aborts if we run out of numbers
@@ -234,624 +250,359 @@ void compileExpr(Expr *expr, Reg dest)
     }
 }
 
-void compileConstantExpr(ConstantExpr *expr, const Reg dest)
+// globals of at most this many bytes go in small data, within reach of gp
+#define SMALL_DATA_LIMIT 8
+#define GLOBAL_BASE_COUNT 2
+
+// large globals of the function being compiled whose address is kept in a register the allocator never hands out
+static const SymbolEntry *globalBases[GLOBAL_BASE_COUNT];
+static const Reg globalBaseRegs[GLOBAL_BASE_COUNT] = {S10, S11};
+
+static bool isSmallData(const SymbolEntry *symbolEntry)
 {
-    if (expr->isString)
-    {
-        uint64_t labelId = getId(&LCLabelId);
-        fprintf(outFile, ".section .sdata\n");
-        fprintf(outFile, ".align 2\n");
-        fprintf(outFile, ".LC%lu:\n", labelId);
-        fprintf(outFile, "\t.string \"%s\"\n", expr->string_const);
-        fprintf(outFile, ".text\n");
-        fprintf(outFile, "\tla %s, .LC%lu\n", regStr(dest), labelId);
-    }
-    else
+    return symbolEntry->storageSize <= SMALL_DATA_LIMIT;
+}
+
+static bool globalBase(const SymbolEntry *symbolEntry, Reg *base)
+{
+    for (size_t i = 0; i < GLOBAL_BASE_COUNT; i++)
     {
-        switch (expr->type)
+        if (globalBases[i] == symbolEntry)
         {
-        case INT_TYPE:
-        {
-            fprintf(outFile, "\tli %s, %i\n", regStr(dest), expr->int_const);
-            break;
-        }
-        case CHAR_TYPE:
-        {
-            fprintf(outFile, "\tli %s, %u\n", regStr(dest), expr->char_const); // TODO: Switch to hex format, check if there is unsigned version, switch to non-pseudoinstruction for char
-            break;
-        }
-        case FLOAT_TYPE:
-        {
-            Reg address = getTmpReg();
-            uint64_t labelId = getId(&LCLabelId);
-            fprintf(outFile, ".section .rodata\n");
-            fprintf(outFile, ".LC%lu:\n", labelId);
-            fprintf(outFile, "\t.float %f\n", expr->float_const);
-            fprintf(outFile, ".text\n");
-            fprintf(outFile, "\tlui %s, %%hi(.LC%lu)\n", regStr(address), labelId);
-            fprintf(outFile, "\tflw %s, %%lo(.LC%lu)(%s)\n", regStr(dest), labelId, regStr(address));
-            break;
-        }
-        default:
-        {
-            fprintf(stderr, "Non-long types not supported, exiting...\n");
-            exit(EXIT_FAILURE);
-        }
+            *base = globalBaseRegs[i];
+            return true;
         }
     }
+    return false;
 }
 
-void compileOperationExpr(OperationExpr *expr, const Reg dest)
+static size_t baseUsesExpr(const Expr *expr, const SymbolEntry *symbolEntry)
 {
-    switch (expr->operator)
+    switch (expr->type)
     {
-    case ADD:
+    case VARIABLE_EXPR:
+        return expr->variable->symbolEntry == symbolEntry;
+    case OPERATION_EXPR:
     {
-        switch (expr->type)
-        {
-        case FLOAT_TYPE:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfadd.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        case DOUBLE_TYPE:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfadd.d %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        default:
-        {
-            if (isPtr(expr->type))
-            {
-                bool op1Ptr = isPtr(returnType(expr->op1));
-                bool op2Ptr = isPtr(returnType(expr->op2));
-                if (op1Ptr && op2Ptr)
-                {
-                    Reg op1 = getTmpReg();
-                    Reg op2 = getTmpReg();
-                    compileExpr(expr->op1, op1);
-                    compileExpr(expr->op2, op2);
-                    fprintf(outFile, "\tadd %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-                    freeReg(op1);
-                    freeReg(op2);
-                }
-                else
-                {
-                    // TODO: Deal with non-long types
-                    Reg op1 = getTmpReg();
-                    Reg op2 = getTmpReg();
-                    compileExpr(expr->op1, op1);
-                    compileExpr(expr->op2, op2);
-                    fprintf(outFile, "\tli %s, %lu\n", regStr(dest), typeSize(removerPtrFromType(expr->type)));
-                    if (op1Ptr)
-                    {
-                        fprintf(outFile, "\tmul %s, %s, %s\n", regStr(op2), regStr(op2), regStr(dest));
-                    }
-                    else
-                    {
-                        fprintf(outFile, "\tmul %s, %s, %s\n", regStr(op1), regStr(op1), regStr(dest));
-                    }
-                    fprintf(outFile, "\tadd %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-                    freeReg(op1);
-                    freeReg(op2);
-                }
-            }
-            else
-            {
-                // TODO: Deal with non-long types
-                Reg op1 = getTmpReg();
-                Reg op2 = getTmpReg();
-                compileExpr(expr->op1, op1);
-                compileExpr(expr->op2, op2);
-                fprintf(outFile, "\tadd %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-                freeReg(op1);
-                freeReg(op2);
-            }
-            break;
-        }
-        }
-        break;
+        OperationExpr *operation = expr->operation;
+        return (operation->op1 == NULL ? 0 : baseUsesExpr(operation->op1, symbolEntry)) +
+               (operation->op2 == NULL ? 0 : baseUsesExpr(operation->op2, symbolEntry)) +
+               (operation->op3 == NULL ? 0 : baseUsesExpr(operation->op3, symbolEntry));
     }
-    case SUB:
+    case ASSIGN_EXPR:
+        return baseUsesExpr(expr->assignment->op, symbolEntry) +
+               (expr->assignment->lvalue == NULL ? 0 : baseUsesExpr(expr->assignment->lvalue, symbolEntry));
+    case FUNC_EXPR:
     {
-        switch (expr->type)
-        {
-        case FLOAT_TYPE:
+        size_t uses = 0;
+        for (size_t i = 0; i < expr->function->argsSize; i++)
         {
-            if (expr->op2 == NULL)
-            {
-                compileExpr(expr->op1, dest);
-                fprintf(outFile, "\tfneg.s %s, %s\n", regStr(dest), regStr(dest));
-            }
-            else
-            {
-                Reg op1 = getTmpFltReg();
-                Reg op2 = getTmpFltReg();
-                compileExpr(expr->op1, op1);
-                compileExpr(expr->op2, op2);
-                fprintf(outFile, "\tfsub.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-                freeReg(op1);
-                freeReg(op2);
-            }
-            break;
+            uses += baseUsesExpr(expr->function->args[i], symbolEntry);
         }
-        case DOUBLE_TYPE:
+        return uses;
+    }
+    default:
+        return 0;
+    }
+}
+
+// how many times a statement names a global, a use inside a loop counts twice as it runs again
+static size_t baseUsesStmt(const Stmt *stmt, const SymbolEntry *symbolEntry)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return (stmt->whileStmt->preheader == NULL ? 0 : baseUsesStmt(stmt->whileStmt->preheader, symbolEntry)) +
+               2 * (baseUsesExpr(stmt->whileStmt->condition, symbolEntry) + baseUsesStmt(stmt->whileStmt->body, symbolEntry));
+    case FOR_STMT:
+        return (stmt->forStmt->preheader == NULL ? 0 : baseUsesStmt(stmt->forStmt->preheader, symbolEntry)) +
+               baseUsesStmt(stmt->forStmt->init, symbolEntry) +
+               2 * (baseUsesStmt(stmt->forStmt->condition, symbolEntry) + baseUsesStmt(stmt->forStmt->body, symbolEntry) +
+                    (stmt->forStmt->modifier == NULL ? 0 : baseUsesExpr(stmt->forStmt->modifier, symbolEntry)));
+    case IF_STMT:
+        return baseUsesExpr(stmt->ifStmt->condition, symbolEntry) + baseUsesStmt(stmt->ifStmt->trueBody, symbolEntry) +
+               (stmt->ifStmt->falseBody == NULL ? 0 : baseUsesStmt(stmt->ifStmt->falseBody, symbolEntry));
+    case SWITCH_STMT:
+        return baseUsesExpr(stmt->switchStmt->selector, symbolEntry) + baseUsesStmt(stmt->switchStmt->body, symbolEntry);
+    case EXPR_STMT:
+        return stmt->exprStmt->expr == NULL ? 0 : baseUsesExpr(stmt->exprStmt->expr, symbolEntry);
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        size_t uses = 0;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
         {
-            if (expr->op2 == NULL)
-            {
-                compileExpr(expr->op1, dest);
-                fprintf(outFile, "\tfneg.s %s, %s\n", regStr(dest), regStr(dest));
-            }
-            else
+            Decl *decl = compoundStmt->declList.decls[i];
+            if (decl->declInit != NULL && decl->declInit->initExpr != NULL)
             {
-                Reg op1 = getTmpFltReg();
-                Reg op2 = getTmpFltReg();
-                compileExpr(expr->op1, op1);
-                compileExpr(expr->op2, op2);
-                fprintf(outFile, "\tfsub.d %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-                freeReg(op1);
-                freeReg(op2);
+                uses += baseUsesExpr(decl->declInit->initExpr, symbolEntry);
             }
-            break;
         }
-        default:
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
         {
-            if (expr->op2 == NULL)
-            {
-                compileExpr(expr->op1, dest);
-                fprintf(outFile, "\tneg %s, %s\n", regStr(dest), regStr(dest));
-            }
-            else
-            {
-                // TODO: Deal with non-long types
-                Reg op1 = getTmpReg();
-                Reg op2 = getTmpReg();
-                compileExpr(expr->op1, op1);
-                compileExpr(expr->op2, op2);
-                fprintf(outFile, "\tsub %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-                freeReg(op1);
-                freeReg(op2);
-            }
-            break;
-        }
+            uses += baseUsesStmt(compoundStmt->stmtList.stmts[i], symbolEntry);
         }
-        break;
+        return uses;
     }
-    case MUL:
-    {
-        switch (expr->type)
-        {
-        case FLOAT_TYPE:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfmul.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        case DOUBLE_TYPE:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfmul.d %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        default:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tmul %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        }
-        break;
+    case LABEL_STMT:
+        return baseUsesStmt(stmt->labelStmt->body, symbolEntry);
+    case JUMP_STMT:
+        return stmt->jumpStmt->expr == NULL ? 0 : baseUsesExpr(stmt->jumpStmt->expr, symbolEntry);
     }
-    case DIV:
+    return 0;
+}
+
+// the address of a large global the body uses more than once is computed once, after the prologue, a single use is
+// cheaper addressed directly than through a callee-saved register that has to be spilled and reloaded, and with a goto
+// any use may be in a loop
+static void loadGlobalBases(Stmt *body)
+{
+    for (size_t i = 0; i < GLOBAL_BASE_COUNT; i++)
     {
-        switch (expr->type)
-        {
-        case FLOAT_TYPE:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfdiv.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        case DOUBLE_TYPE:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfdiv.d %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        default:
-        {
-            // TODO: Deal with non-long types
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tdiv %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
-        }
-        break;
+        globalBases[i] = NULL;
     }
-    case MOD:
+    if (body == NULL)
     {
-        // TODO: Deal with non-long types
-        // TODO: Deal with unsigned division
-        Reg op1 = getTmpReg();
-        Reg op2 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        compileExpr(expr->op2, op2);
-        fprintf(outFile, "\trem %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-        freeReg(op1); // TODO: Test register eviction
-        freeReg(op2);
-        break;
+        return;
     }
-    case NOT:
+    SymbolSet named = {NULL, 0, 0};
+    collectSymbolsStmt(body, &named, COLLECT_NAMED);
+    bool jumps = containsGoto(body);
+    size_t count = 0;
+    for (size_t i = 0; i < named.size && count < GLOBAL_BASE_COUNT; i++)
     {
-        // TODO: Deal with unsigned
-        Reg op1 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        fprintf(outFile, "\tsgtz %s, %s\n", regStr(op1), regStr(op1));
-        fprintf(outFile, "\tnot %s, %s\n", regStr(dest), regStr(op1));
-        freeReg(op1); // TODO: Test register eviction
-        break;
+        const SymbolEntry *symbolEntry = named.entries[i];
+        if (symbolEntry->isGlobal && symbolEntry->entryType == ARRAY_ENTRY && !isSmallData(symbolEntry) &&
+            (jumps || baseUsesStmt(body, symbolEntry) > 1))
+        {
+            const char *reg = regStr(globalBaseRegs[count]);
+            fprintf(outFile, "\tlui %s, %%hi(%s)\n", reg, symbolEntry->ident);
+            fprintf(outFile, "\taddi %s, %s, %%lo(%s)\n", reg, reg, symbolEntry->ident);
+            globalBases[count++] = symbolEntry;
+        }
     }
-    case NOT_BIT:
+    symbolSetClear(&named);
+}
+
+// a load or store of a global scalar, the linker relaxes the lui away for small data
+static void compileGlobalAccess(const char *opcode, Reg value, const SymbolEntry *symbolEntry)
+{
+    Reg base = getTmpReg();
+    fprintf(outFile, "\tlui %s, %%hi(%s)\n", regStr(base), symbolEntry->ident);
+    fprintf(outFile, "\t%s %s, %%lo(%s)(%s)\n", opcode, regStr(value), symbolEntry->ident, regStr(base));
+    freeReg(base);
+}
+
+static void compileGlobalAddress(const SymbolEntry *symbolEntry, Reg dest)
+{
+    Reg base;
+    if (globalBase(symbolEntry, &base))
     {
-        // TODO: Deal with unsigned
-        Reg op1 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        fprintf(outFile, "\tnot %s, %s\n", regStr(dest), regStr(op1));
-        freeReg(op1); // TODO: Test register eviction
-        break;
+        fprintf(outFile, "\tmv %s, %s\n", regStr(dest), regStr(base));
     }
-    case EQ:
+    else
     {
-        // if one of the ops is a float (cant use expr->type)
-        if (returnType(expr->op1) == FLOAT_TYPE)
-        {
-            // TODO: Deal with signs
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfeq.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
-        }
-        else
-        {
-            // TODO: Deal with signs
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tsub %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            fprintf(outFile, "\tseqz %s, %s\n", regStr(dest), regStr(dest));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
-        }
+        fprintf(outFile, "\tlui %s, %%hi(%s)\n", regStr(dest), symbolEntry->ident);
+        fprintf(outFile, "\taddi %s, %s, %%lo(%s)\n", regStr(dest), regStr(dest), symbolEntry->ident);
     }
-    case NE:
+}
+
+// An address as a base register and a displacement that fits the 12 bit immediate of a load or store
+typedef struct MemOperand
+{
+    Reg base;
+    long offset;
+} MemOperand;
+
+static bool isIntConstant(const Expr *expr, long *value)
+{
+    if (expr->type != CONSTANT_EXPR || expr->constant->isString ||
+        (expr->constant->type != INT_TYPE && expr->constant->type != UNSIGNED_INT_TYPE))
     {
-        if (returnType(expr->op1) == FLOAT_TYPE)
-        {
-            // TODO: Deal with signs
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tfeq.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            fprintf(outFile, "\txor %s, %s, %i\n", regStr(dest), regStr(dest), 1);
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
-        }
-        else
-        {
-            // TODO: Deal with signs
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tsub %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            fprintf(outFile, "\tsnez %s, %s\n", regStr(dest), regStr(dest));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
-        }
+        return false;
     }
-    case LT:
+    *value = expr->constant->int_const;
+    return true;
+}
+
+// peels constant displacements, scaled by the element size, off an address, NULL if what is left is already in base
+static Expr *splitAddress(Expr *address, long *offset, Reg *base)
+{
+    if (address->type == VARIABLE_EXPR)
     {
-        if (returnType(expr->op1) == FLOAT_TYPE)
+        SymbolEntry *symbolEntry = address->variable->symbolEntry;
+        if (symbolEntry != NULL && symbolEntry->entryType == ARRAY_ENTRY && !symbolEntry->isGlobal)
         {
-            // TODO: Deal with signs
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tflt.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
+            *offset -= (long)symbolEntry->stackOffset;
+            *base = FP;
+            return NULL;
         }
-        else
+        if (symbolEntry != NULL && symbolEntry->entryType == ARRAY_ENTRY && globalBase(symbolEntry, base))
         {
-            // TODO: Deal with signs
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tslt %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
+            return NULL;
         }
+        return address;
     }
-    case GT:
+    if (address->type != OPERATION_EXPR)
     {
-        if (returnType(expr->op1) == FLOAT_TYPE)
-        {
-            // TODO: Deal with signs
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tflt.s %s, %s, %s\n", regStr(dest), regStr(op2), regStr(op1));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
-        }
-        else
-        {
-            // TODO: Deal with signs
-            // TODO: Test the damn code
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tslt %s, %s, %s\n", regStr(dest), regStr(op2), regStr(op1));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
-        }
+        return address;
     }
-    case LE:
+    OperationExpr *operation = address->operation;
+    long value;
+    switch (operation->operator)
     {
-        if (returnType(expr->op1) == FLOAT_TYPE)
+    case ADDRESS:
+        if (operation->op1->type == VARIABLE_EXPR && operation->op1->variable->symbolEntry != NULL &&
+            !operation->op1->variable->symbolEntry->isGlobal)
         {
-            // TODO: Deal with signs
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tflt.s %s, %s, %s\n", regStr(dest), regStr(op2), regStr(op1));
-            fprintf(outFile, "\txori %s, %s, 1\n", regStr(dest), regStr(dest));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
+            *offset -= (long)operation->op1->variable->symbolEntry->stackOffset;
+            *base = FP;
+            return NULL;
         }
-        else
+        return address;
+    case ADD:
+        if (!isPtr(operation->type))
         {
-            // TODO: Deal with signs
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tslt %s, %s, %s\n", regStr(dest), regStr(op2), regStr(op1));
-            fprintf(outFile, "\txori %s, %s, 1\n", regStr(dest), regStr(dest));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
+            return address;
         }
-    }
-    case GE:
-    {
-        if (returnType(expr->op1) == FLOAT_TYPE)
+        if (isIntConstant(operation->op2, &value) && isPtr(returnType(operation->op1)))
         {
-            // TODO: Deal with signs
-            Reg op1 = getTmpFltReg();
-            Reg op2 = getTmpFltReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tflt.s %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            fprintf(outFile, "\txori %s, %s, 1\n", regStr(dest), regStr(dest));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
+            *offset += value * (long)typeSize(removerPtrFromType(operation->type));
+            return splitAddress(operation->op1, offset, base);
         }
-        else
+        if (isIntConstant(operation->op1, &value) && isPtr(returnType(operation->op2)))
         {
-            // TODO: Deal with signs
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tslt %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            fprintf(outFile, "\txori %s, %s, 1\n", regStr(dest), regStr(dest));
-            freeReg(op1); // TODO: Test register eviction
-            freeReg(op2);
-            break;
+            *offset += value * (long)typeSize(removerPtrFromType(operation->type));
+            return splitAddress(operation->op2, offset, base);
         }
+        return address;
+    default:
+        return address;
     }
-    case OR:
+}
+
+// computes what an address does not fold into the displacement, the frame pointer and global bases need no register
+static MemOperand compileMemOperand(Expr *address)
+{
+    long offset = 0;
+    Reg base = FP;
+    Expr *root = splitAddress(address, &offset, &base);
+    if (offset < -2048 || offset > 2047)
     {
-        // TODO: Deal with signs
-        Reg op1 = getTmpReg();
-        Reg op2 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        compileExpr(expr->op2, op2);
-        fprintf(outFile, "\tor %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-        fprintf(outFile, "\tsgtz %s, %s\n", regStr(dest), regStr(dest));
-        freeReg(op1); // TODO: Test register eviction
-        freeReg(op2);
-        break;
+        root = address;
+        offset = 0;
     }
-    case AND:
+    MemOperand operand = {base, offset};
+    if (root != NULL)
     {
-        // TODO: Deal with signs
-        Reg op1 = getTmpReg();
-        Reg op2 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        compileExpr(expr->op2, op2);
-        fprintf(outFile, "\tsgtz %s, %s\n", regStr(op1), regStr(op1));
-        fprintf(outFile, "\tsgtz %s, %s\n", regStr(op2), regStr(op2));
-        fprintf(outFile, "\tand %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-        freeReg(op1); // TODO: Test register eviction
-        freeReg(op2);
-        break;
-    }
-    case OR_BIT:
-    {
-        // TODO: Deal with signs
-        Reg op1 = getTmpReg();
-        Reg op2 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        compileExpr(expr->op2, op2);
-        fprintf(outFile, "\tor %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-        freeReg(op1); // TODO: Test register eviction
-        freeReg(op2);
-        break;
+        operand.base = getTmpReg();
+        compileExpr(root, operand.base);
     }
-    case AND_BIT:
+    return operand;
+}
+
+static void freeMemOperand(MemOperand operand)
+{
+    if (operand.base != FP && operand.base != S10 && operand.base != S11)
     {
-        // TODO: Deal with signs
-        Reg op1 = getTmpReg();
-        Reg op2 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        compileExpr(expr->op2, op2);
-        fprintf(outFile, "\tand %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-        freeReg(op1); // TODO: Test register eviction
-        freeReg(op2);
-        break;
+        freeReg(operand.base);
     }
-    case XOR:
+}
+
+void compileConstantExpr(ConstantExpr *expr, const Reg dest)
+{
+    if (expr->isString)
     {
-        // TODO: Deal with signs
-        Reg op1 = getTmpReg();
-        Reg op2 = getTmpReg();
-        compileExpr(expr->op1, op1);
-        compileExpr(expr->op2, op2);
-        fprintf(outFile, "\txor %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-        freeReg(op1); // TODO: Test register eviction
-        freeReg(op2);
-        break;
+        fprintf(outFile, "\tla %s, .LC%lu\n", regStr(dest), stringLiteralLabel(expr->string_const));
     }
-    case LEFT_SHIFT:
+    else
     {
         switch (expr->type)
         {
-        case FLOAT_TYPE:
-        {
-            fprintf(stderr, "Shift-operations cannot be done on floating-point types, exiting...\n");
-            exit(EXIT_FAILURE);
-            break;
-        }
-        case DOUBLE_TYPE:
+        case INT_TYPE:
+        case UNSIGNED_INT_TYPE:
         {
-            fprintf(stderr, "Shift-operations cannot be done on floating-point types, exiting...\n");
-            exit(EXIT_FAILURE);
+            fprintf(outFile, "\tli %s, %i\n", regStr(dest), expr->int_const);
             break;
         }
-        default:
+        case CHAR_TYPE:
         {
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tsll %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
+            fprintf(outFile, "\tli %s, %u\n", regStr(dest), expr->char_const); // TODO: Switch to hex format, check if there is unsigned version, switch to non-pseudoinstruction for char
             break;
         }
-        }
-        break;
-    }
-    case RIGHT_SHIFT:
-    {
-        switch (expr->type)
-        {
         case FLOAT_TYPE:
         {
-            fprintf(stderr, "Shift-operations cannot be done on floating-point types, exiting...\n");
-            exit(EXIT_FAILURE);
+            float value = expr->float_const;
+            if (value == 0.0f && !signbit(value))
+            {
+                fprintf(outFile, "\tfmv.w.x %s, zero\n", regStr(dest));
+            }
+            else if (value == (int)value && value >= -2048.0f && value < 2048.0f)
+            {
+                // small whole numbers are converted exactly from an immediate
+                Reg tmp = getTmpReg();
+                fprintf(outFile, "\tli %s, %i\n", regStr(tmp), (int)value);
+                fprintf(outFile, "\tfcvt.s.w %s, %s\n", regStr(dest), regStr(tmp));
+                freeReg(tmp);
+            }
+            else
+            {
+                Reg address = getTmpReg();
+                size_t labelId = floatLiteralLabel(value);
+                fprintf(outFile, "\tlui %s, %%hi(.LC%lu)\n", regStr(address), labelId);
+                fprintf(outFile, "\tflw %s, %%lo(.LC%lu)(%s)\n", regStr(dest), labelId, regStr(address));
+                freeReg(address);
+            }
             break;
         }
-        case DOUBLE_TYPE:
+        default:
         {
-            fprintf(stderr, "Shift-operations cannot be done on floating-point types, exiting...\n");
+            fprintf(stderr, "Non-long types not supported, exiting...\n");
             exit(EXIT_FAILURE);
-            break;
         }
-        case INT_TYPE: // Signed shift
-        {
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tsra %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
         }
-        default:
+    }
+}
+
+void compileOperationExpr(OperationExpr *expr, const Reg dest)
+{
+    if (selectExpr(expr, dest))
+    {
+        return;
+    }
+    switch (expr->operator)
+    {
+    case ADD: // pointer arithmetic, the selector covers the rest
+    {
+        bool op1Ptr = isPtr(returnType(expr->op1));
+        bool op2Ptr = isPtr(returnType(expr->op2));
+        Reg op1 = getTmpReg();
+        Reg op2 = getTmpReg();
+        compileExpr(expr->op1, op1);
+        compileExpr(expr->op2, op2);
+        if (op1Ptr != op2Ptr)
         {
-            Reg op1 = getTmpReg();
-            Reg op2 = getTmpReg();
-            compileExpr(expr->op1, op1);
-            compileExpr(expr->op2, op2);
-            fprintf(outFile, "\tsrl %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
-            freeReg(op1);
-            freeReg(op2);
-            break;
-        }
+            // TODO: Deal with non-long types
+            fprintf(outFile, "\tli %s, %lu\n", regStr(dest), typeSize(removerPtrFromType(expr->type)));
+            if (op1Ptr)
+            {
+                fprintf(outFile, "\tmul %s, %s, %s\n", regStr(op2), regStr(op2), regStr(dest));
+            }
+            else
+            {
+                fprintf(outFile, "\tmul %s, %s, %s\n", regStr(op1), regStr(op1), regStr(dest));
+            }
         }
+        fprintf(outFile, "\tadd %s, %s, %s\n", regStr(dest), regStr(op1), regStr(op2));
+        freeReg(op1);
+        freeReg(op2);
+        break;
+    }
+    case LEFT_SHIFT:
+    case RIGHT_SHIFT:
+    {
+        fprintf(stderr, "Shift-operations cannot be done on floating-point types, exiting...\n");
+        exit(EXIT_FAILURE);
         break;
     }
     case INC:
@@ -994,7 +745,7 @@ void compileOperationExpr(OperationExpr *expr, const Reg dest)
             }
             if (expr->op1->variable->symbolEntry->isGlobal)
             {
-                fprintf(outFile, "\tla %s, %s\n", regStr(dest), expr->op1->variable->ident);
+                compileGlobalAddress(expr->op1->variable->symbolEntry, dest);
             }
             else
             {
@@ -1014,42 +765,37 @@ void compileOperationExpr(OperationExpr *expr, const Reg dest)
         {
         case CHAR_TYPE:
         {
-            Reg lvalue = getTmpReg();
-            compileExpr(expr->op1, lvalue);
-            fprintf(outFile, "\tlb %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-            freeReg(lvalue);
+            MemOperand address = compileMemOperand(expr->op1);
+            fprintf(outFile, "\tlb %s, %ld(%s)\n", regStr(dest), address.offset, regStr(address.base));
+            freeMemOperand(address);
             break;
         }
         case INT_TYPE:
         {
-            Reg lvalue = getTmpReg();
-            compileExpr(expr->op1, lvalue);
-            fprintf(outFile, "\tlw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-            freeReg(lvalue);
+            MemOperand address = compileMemOperand(expr->op1);
+            fprintf(outFile, "\tlw %s, %ld(%s)\n", regStr(dest), address.offset, regStr(address.base));
+            freeMemOperand(address);
             break;
         }
         case FLOAT_TYPE:
         {
-            Reg lvalue = getTmpReg();
-            compileExpr(expr->op1, lvalue);
-            fprintf(outFile, "\tflw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-            freeReg(lvalue);
+            MemOperand address = compileMemOperand(expr->op1);
+            fprintf(outFile, "\tflw %s, %ld(%s)\n", regStr(dest), address.offset, regStr(address.base));
+            freeMemOperand(address);
             break;
         }
         case DOUBLE_TYPE:
         {
-            Reg lvalue = getTmpReg();
-            compileExpr(expr->op1, lvalue);
-            fprintf(outFile, "\tfld %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-            freeReg(lvalue);
+            MemOperand address = compileMemOperand(expr->op1);
+            fprintf(outFile, "\tfld %s, %ld(%s)\n", regStr(dest), address.offset, regStr(address.base));
+            freeMemOperand(address);
             break;
         }
         default:
         {
-            Reg lvalue = getTmpReg();
-            compileExpr(expr->op1, lvalue);
-            fprintf(outFile, "\tlw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-            freeReg(lvalue);
+            MemOperand address = compileMemOperand(expr->op1);
+            fprintf(outFile, "\tlw %s, %ld(%s)\n", regStr(dest), address.offset, regStr(address.base));
+            freeMemOperand(address);
             break;
         }
         }
@@ -1059,20 +805,22 @@ void compileOperationExpr(OperationExpr *expr, const Reg dest)
     {
         Reg tmp = getTmpReg();
         compileExpr(expr->op1, tmp);
+        freeReg(tmp);
         compileExpr(expr->op2, dest);
         break;
     }
     case TERN:
     {
-        Reg condition = getTmpReg(); // always an int (bool)
-        compileExpr(expr->op1, condition);
-        fprintf(outFile, "\tbeqz %s, .TERNa%i\n", regStr(condition), ternID);
+        // taken before the condition is compiled, a ternary nested in it takes the next ids
+        int id = ternID++;
+        char target[32];
+        sprintf(target, ".TERNa%i", id);
+        selectBranch(expr->op1, false, target);
         compileExpr(expr->op2, dest);
-        fprintf(outFile, "\tj .TERNb%i\n", ternID); // unconditional jump
-        fprintf(outFile, ".TERNa%lu:\n", ternID);
+        fprintf(outFile, "\tj .TERNb%i\n", id); // unconditional jump
+        fprintf(outFile, ".TERNa%i:\n", id);
         compileExpr(expr->op3, dest);
-        fprintf(outFile, ".TERNb%lu:\n", ternID);
-        ternID++;
+        fprintf(outFile, ".TERNb%i:\n", id);
         break;
     }
     default:
@@ -1095,7 +843,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
         }
         else
         {
-            fprintf(outFile, "\tlw %s, %s\n", regStr(dest), expr->ident);
+            compileGlobalAccess("lw", dest, expr->symbolEntry);
         }
         break;
     }
@@ -1107,7 +855,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
         }
         else
         {
-            fprintf(outFile, "\tlw %s, %s\n", regStr(dest), expr->ident);
+            compileGlobalAccess("lw", dest, expr->symbolEntry);
         }
         break;
     }
@@ -1119,7 +867,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
         }
         else
         {
-            fprintf(outFile, "\tflw %s, %s, zero\n", regStr(dest), expr->ident);
+            compileGlobalAccess("flw", dest, expr->symbolEntry);
         }
         break;
     }
@@ -1131,7 +879,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
         }
         else
         {
-            fprintf(outFile, "\tfld %s, %s, zero\n", regStr(dest), expr->ident);
+            compileGlobalAccess("fld", dest, expr->symbolEntry);
         }
         break;
     }
@@ -1143,7 +891,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
         }
         else
         {
-            fprintf(outFile, "\tlb %s, %s\n", regStr(dest), expr->ident);
+            compileGlobalAccess("lb", dest, expr->symbolEntry);
         }
         break;
     }
@@ -1158,7 +906,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
             }
             else
             {
-                fprintf(outFile, "\tla %s, %s\n", regStr(dest), expr->ident);
+                compileGlobalAddress(expr->symbolEntry, dest);
             }
         }
         else
@@ -1169,7 +917,7 @@ void compileVariableExpr(VariableExpr *expr, const Reg dest)
             }
             else
             {
-                fprintf(outFile, "\tlw %s, %s\n", regStr(dest), expr->ident);
+                compileGlobalAccess("lw", dest, expr->symbolEntry);
             }
         }
         break;
@@ -1204,7 +952,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tsb %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("sb", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1213,10 +961,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tsb %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tsb %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
             free(rvalue->op1->assignment);
             free(rvalue->op1);
@@ -1229,7 +976,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tsb %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("sb", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1238,10 +985,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tsb %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tsb %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
         }
         break;
@@ -1264,7 +1010,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tsw %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("sw", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1273,10 +1019,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tsw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tsw %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
             free(rvalue->op1->assignment);
             free(rvalue->op1);
@@ -1289,7 +1034,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tsw %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("sw", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1298,10 +1043,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tsw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tsw %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
         }
         break;
@@ -1323,7 +1067,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tfsw %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("fsw", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1332,10 +1076,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tfsw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tfsw %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
             free(rvalue->op2->assignment);
             free(rvalue->op2);
@@ -1347,7 +1090,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tfsw %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("fsw", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1356,10 +1099,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tfsw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tfsw %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
         }
         break;
@@ -1380,7 +1122,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tfsd %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("fsd", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1389,10 +1131,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tfsd %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tfsd %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
             free(rvalue->op2->assignment);
             free(rvalue->op2);
@@ -1404,7 +1145,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tfsd %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("fsd", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1413,10 +1154,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tfsd %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tfsd %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
         }
         break;
@@ -1437,7 +1177,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tsw %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("sw", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1446,10 +1186,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tsw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tsw %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
             free(rvalue->op2->assignment);
             free(rvalue->op2);
@@ -1462,7 +1201,7 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             {
                 if (expr->symbolEntry->isGlobal)
                 {
-                    fprintf(outFile, "\tsw %s, %s, zero\n", regStr(dest), expr->ident);
+                    compileGlobalAccess("sw", dest, expr->symbolEntry);
                 }
                 else
                 {
@@ -1471,10 +1210,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
             }
             else
             {
-                Reg lvalue = getTmpReg();
-                compileExpr(expr->lvalue, lvalue);
-                fprintf(outFile, "\tsw %s, 0(%s)\n", regStr(dest), regStr(lvalue));
-                freeReg(lvalue);
+                MemOperand lvalue = compileMemOperand(expr->lvalue);
+                fprintf(outFile, "\tsw %s, %ld(%s)\n", regStr(dest), lvalue.offset, regStr(lvalue.base));
+                freeMemOperand(lvalue);
             }
         }
         fprintf(stderr, "Type not supported\n");
@@ -1486,25 +1224,9 @@ void compileAssignExpr(AssignExpr *expr, Reg dest)
 
 void compileFuncExpr(FuncExpr *expr, Reg dest)
 {
+    // temporaries live across the call are kept clear of what it clobbers by allocateRegisters
     compileCallArgs(expr);
-    for (size_t i = 0; i <= 6; i++) // Store T0-T7
-    {
-        fprintf(outFile, "\tsw t%lu, -%lu(fp)\n", i, 52 + 4 + (i * 4));
-    }
-    for (size_t i = 0; i <= 11; i++) // Store FT0-FT11
-    {
-        fprintf(outFile, "\tfsd ft%lu, -%lu(fp)\n", i, 80 + 8 + (i * 8));
-    }
     fprintf(outFile, "\tcall %s\n", expr->ident);
-    for (size_t i = 0; i <= 6; i++) // Restore T0-T7
-    {
-        fprintf(outFile, "\tlw t%lu, -%lu(fp)\n", i, 52 + 4 + (i * 4));
-    }
-    // TODO: Check if treating all floating point registers as holding doubles is okay
-    for (size_t i = 0; i <= 11; i++) // Restore FT0-FT11
-    {
-        fprintf(outFile, "\tfld ft%lu, -%lu(fp)\n", i, 80 + 8 + (i * 8));
-    }
     if (expr->type == FLOAT_TYPE || expr->type == DOUBLE_TYPE)
     {
         fprintf(outFile, "\tmv %s, fa0\n", regStr(dest));
@@ -1523,6 +1245,10 @@ void compileStmt(Stmt *stmt)
     {
     case EXPR_STMT:
     {
+        if (stmt->exprStmt->expr == NULL)
+        {
+            break;
+        }
         if (returnType(stmt->exprStmt->expr) == FLOAT_TYPE || returnType(stmt->exprStmt->expr) == DOUBLE_TYPE)
         {
             compileExpr(stmt->exprStmt->expr, FA0);
@@ -1576,20 +1302,130 @@ void compileStmt(Stmt *stmt)
     }
 }
 
+// the result of the call is handed back unchanged in the same register and no argument can point into the frame
+static bool isTailCall(Expr *expr)
+{
+    // main has to dump the profile counters after the call returns and a timed function stop its clock
+    if (expr->type != FUNC_EXPR || funcFrameEscapes || expr->function->argsSize > 8 || (profileGenerate && funcIsMain) ||
+        profileFunctions)
+    {
+        return false;
+    }
+    DataType type = returnType(expr);
+    if (type == FLOAT_TYPE || type == DOUBLE_TYPE || funcReturnType == FLOAT_TYPE || funcReturnType == DOUBLE_TYPE)
+    {
+        return type == funcReturnType;
+    }
+    return true;
+}
+
+// Counts the call and starts the clocks of a timed function, its callees count their cycles and instructions from
+// zero into __profile_children while it runs
+static void compileEntryHook(void)
+{
+    if (!profileFunctions)
+    {
+        return;
+    }
+    noteProfiledFunc(funcIdent);
+    Reg table = getTmpReg();
+    Reg calls = getTmpReg();
+    Reg children = getTmpReg();
+    funcHook = (FuncHook){getTmpReg(), getTmpReg(), getTmpReg(), getTmpReg()};
+    fprintf(outFile, "\tla %s, .FPROF_%s\n", regStr(table), funcIdent);
+    fprintf(outFile, "\tlw %s, %d(%s)\n", regStr(calls), FUNC_PROFILE_CALLS, regStr(table));
+    fprintf(outFile, "\taddi %s, %s, 1\n", regStr(calls), regStr(calls));
+    fprintf(outFile, "\tsw %s, %d(%s)\n", regStr(calls), FUNC_PROFILE_CALLS, regStr(table));
+    fprintf(outFile, "\tla %s, __profile_children\n", regStr(children));
+    fprintf(outFile, "\tlw %s, 0(%s)\n", regStr(funcHook.childCycles), regStr(children));
+    fprintf(outFile, "\tlw %s, 4(%s)\n", regStr(funcHook.childInstrs), regStr(children));
+    fprintf(outFile, "\tsw zero, 0(%s)\n", regStr(children));
+    fprintf(outFile, "\tsw zero, 4(%s)\n", regStr(children));
+    fprintf(outFile, "\trdinstret %s\n", regStr(funcHook.instrs));
+    fprintf(outFile, "\trdcycle %s\n", regStr(funcHook.cycles));
+}
+
+// adds what one clock measured since entry to the inclusive total, less what the callees took to the exclusive one
+static void compileClockExit(Reg now, Reg start, Reg saved, int total, int self, int child)
+{
+    Reg table = getTmpReg();
+    Reg children = getTmpReg();
+    Reg elapsed = getTmpReg();
+    Reg sum = getTmpReg();
+    Reg spent = getTmpReg();
+    fprintf(outFile, "\tsub %s, %s, %s\n", regStr(elapsed), regStr(now), regStr(start));
+    fprintf(outFile, "\tla %s, .FPROF_%s\n", regStr(table), funcIdent);
+    fprintf(outFile, "\tla %s, __profile_children\n", regStr(children));
+    fprintf(outFile, "\tlw %s, %d(%s)\n", regStr(sum), total, regStr(table));
+    fprintf(outFile, "\tadd %s, %s, %s\n", regStr(sum), regStr(sum), regStr(elapsed));
+    fprintf(outFile, "\tsw %s, %d(%s)\n", regStr(sum), total, regStr(table));
+    fprintf(outFile, "\tlw %s, %d(%s)\n", regStr(spent), child, regStr(children));
+    fprintf(outFile, "\tsub %s, %s, %s\n", regStr(spent), regStr(elapsed), regStr(spent));
+    fprintf(outFile, "\tlw %s, %d(%s)\n", regStr(sum), self, regStr(table));
+    fprintf(outFile, "\tadd %s, %s, %s\n", regStr(sum), regStr(sum), regStr(spent));
+    fprintf(outFile, "\tsw %s, %d(%s)\n", regStr(sum), self, regStr(table));
+    fprintf(outFile, "\tadd %s, %s, %s\n", regStr(sum), regStr(saved), regStr(elapsed));
+    fprintf(outFile, "\tsw %s, %d(%s)\n", regStr(sum), child, regStr(children));
+}
+
+// Stops the clocks of a timed function, then an instrumented main writes out the profiles before its epilogue,
+// keeping the result it returns
+static void compileExitHooks(void)
+{
+    if (profileFunctions)
+    {
+        Reg cycles = getTmpReg();
+        Reg instrs = getTmpReg();
+        fprintf(outFile, "\trdcycle %s\n", regStr(cycles));
+        fprintf(outFile, "\trdinstret %s\n", regStr(instrs));
+        compileClockExit(cycles, funcHook.cycles, funcHook.childCycles, FUNC_PROFILE_CYCLES, FUNC_PROFILE_SELF_CYCLES, 0);
+        compileClockExit(instrs, funcHook.instrs, funcHook.childInstrs, FUNC_PROFILE_INSTRS, FUNC_PROFILE_SELF_INSTRS, 4);
+    }
+    if (!funcIsMain || (!profileGenerate && !profileFunctions))
+    {
+        return;
+    }
+    Reg result = getTmpReg();
+    fprintf(outFile, "\tmv %s, a0\n", regStr(result));
+    if (profileGenerate)
+    {
+        fprintf(outFile, "\tcall __profile_dump\n");
+    }
+    if (profileFunctions)
+    {
+        fprintf(outFile, "\tcall __profile_report\n");
+    }
+    fprintf(outFile, "\tmv a0, %s\n", regStr(result));
+}
+
+// arguments go straight into the argument registers, then the frame is torn down and the callee returns for us
+static void compileTailCall(FuncExpr *expr)
+{
+    compileCallArgs(expr);
+    for (size_t i = 1; i <= 11; i++) // Restore S1-S11
+    {
+        fprintf(outFile, "\tlw s%lu, -%lu(fp)\n", i, 8 + (i * 4));
+    }
+    fprintf(outFile, "\tmv sp, fp\n");
+    fprintf(outFile, "\tlw ra, -8(fp)\n");
+    fprintf(outFile, "\tlw fp, -4(fp)\n");
+    fprintf(outFile, "\ttail %s\n", expr->ident);
+}
+
 void compileJumpStmt(JumpStmt *stmt)
 {
     switch (stmt->type)
     {
     case RETURN_JUMP:
     {
-        if (stmt->expr == NULL)
+        if (stmt->expr != NULL && isTailCall(stmt->expr))
         {
-            fprintf(outFile, "\tret\n");
+            compileTailCall(stmt->expr->function);
         }
         else
         {
             // TODO: Deal with other types
-            switch (returnType(stmt->expr))
+            switch (stmt->expr == NULL ? VOID_TYPE : returnType(stmt->expr))
             {
             case FLOAT_TYPE:
             {
@@ -1601,12 +1437,17 @@ void compileJumpStmt(JumpStmt *stmt)
                 compileExpr(stmt->expr, FA0);
                 break;
             }
+            case VOID_TYPE:
+            {
+                break;
+            }
             default:
             {
                 compileExpr(stmt->expr, A0);
                 break;
             }
             }
+            compileExitHooks();
             for (size_t i = 1; i <= 11; i++) // Restore S1-S11
             {
                 fprintf(outFile, "\tlw s%lu, -%lu(fp)\n", i, 8 + (i * 4)); // Save RA
@@ -1647,12 +1488,12 @@ void compileJumpStmt(JumpStmt *stmt)
         {
         case WHILE_ENTRY:
         {
-            fprintf(outFile, "\tj .WHILE%s\n", stmt->symbolEntry->ident);
+            fprintf(outFile, "\tj .WHILE_CONT%s\n", stmt->symbolEntry->ident);
             break;
         }
         case FOR_ENTRY:
         {
-            fprintf(outFile, "\tj .FOR_MOD%s\n", stmt->symbolEntry->ident);
+            fprintf(outFile, "\tj .FOR_CONT%s\n", stmt->symbolEntry->ident);
             break;
         }
         }
@@ -1693,14 +1534,13 @@ void compileCompoundStmt(CompoundStmt *stmt)
 
 void compileIfStmt(IfStmt *stmt)
 {
-    Reg condition = getTmpReg();
-    compileExpr(stmt->condition, condition);
     size_t endId = getId(&ifLabelId);
     size_t elseId = getId(&ifLabelId);
+    char target[32];
+    sprintf(target, ".IF%lu", stmt->falseBody != NULL ? elseId : endId);
+    selectBranch(stmt->condition, false, target);
     if (stmt->falseBody != NULL)
     {
-        fprintf(outFile, "\tbeqz %s, .IF%lu\n", regStr(condition), elseId);
-        freeReg(condition);
         compileStmt(stmt->trueBody);
         fprintf(outFile, "\tj .IF%lu\n", endId);
         fprintf(outFile, ".IF%lu:\n", elseId);
@@ -1709,82 +1549,123 @@ void compileIfStmt(IfStmt *stmt)
     }
     else
     {
-        fprintf(outFile, "\tbeqz %s, .IF%lu\n", regStr(condition), endId);
-        freeReg(condition);
         compileStmt(stmt->trueBody);
         fprintf(outFile, ".IF%lu:\n", endId);
     }
 }
 
-void compileWhileStmt(WhileStmt *stmt)
+// branches to label when the condition is non-zero (taken) or zero (not taken)
+static void compileCondBranch(Expr *condition, bool taken, const char *prefix, const char *ident)
+{
+    char target[64];
+    sprintf(target, ".%s%s", prefix, ident);
+    selectBranch(condition, taken, target);
+}
+
+// Loops are rotated into a guarded do-while: a guard test in front of the body, then the preheader
+// holding any hoisted code, a single continue block holding the modifier and one bottom test that
+// branches back, so every iteration runs one conditional branch. A NULL condition is always true.
+static void compileLoop(const char *prefix, const char *ident, Expr *condition, Expr *modifier, Stmt *body, Stmt *preheader, bool guarded)
 {
-    Reg condition = getTmpReg();
-    // TODO: Add do while support
-    if (stmt->doWhile)
+    bool constValue = true;
+    bool isConst = condition == NULL || constantCondition(condition, &constValue);
+    char endPrefix[32];
+    char contPrefix[32];
+    sprintf(endPrefix, "%s_END", prefix);
+    sprintf(contPrefix, "%s_CONT", prefix);
+
+    if (guarded && !isConst)
     {
-        fprintf(outFile, ".DO_WHILE%s:\n", stmt->symbolEntry->ident);
-        compileStmt(stmt->body);
-        compileExpr(stmt->condition, condition);
-        fprintf(outFile, "\tbnez %s, .DO_WHILE%s\n", regStr(condition), stmt->symbolEntry->ident);
-        freeReg(condition);
+        compileCondBranch(condition, false, endPrefix, ident);
     }
-    else
+    else if (guarded && !constValue)
     {
-        fprintf(outFile, ".WHILE%s:\n", stmt->symbolEntry->ident);
-        compileExpr(stmt->condition, condition);
-        freeReg(condition);
-        fprintf(outFile, "\tbeqz %s, .WHILE_END%s\n", regStr(condition), stmt->symbolEntry->ident);
-        compileStmt(stmt->body);
-        fprintf(outFile, "\tj .WHILE%s\n", stmt->symbolEntry->ident);
-        fprintf(outFile, ".WHILE_END%s:\n", stmt->symbolEntry->ident);
+        fprintf(outFile, "\tj .%s%s\n", endPrefix, ident);
+    }
+    if (preheader != NULL)
+    {
+        compileStmt(preheader);
+    }
+    fprintf(outFile, ".%s%s:\n", prefix, ident);
+    compileStmt(body);
+    fprintf(outFile, ".%s%s:\n", contPrefix, ident);
+    if (modifier != NULL)
+    {
+        DataType type = returnType(modifier);
+        Reg tmp = type == FLOAT_TYPE || type == DOUBLE_TYPE ? getTmpFltReg() : getTmpReg();
+        compileExpr(modifier, tmp);
+        freeReg(tmp);
+    }
+    if (!isConst)
+    {
+        compileCondBranch(condition, true, prefix, ident);
     }
+    else if (constValue)
+    {
+        fprintf(outFile, "\tj .%s%s\n", prefix, ident);
+    }
+    fprintf(outFile, ".%s%s:\n", endPrefix, ident);
+}
+
+void compileWhileStmt(WhileStmt *stmt)
+{
+    compileLoop("WHILE", stmt->symbolEntry->ident, stmt->condition, NULL, stmt->body, stmt->preheader, !stmt->doWhile);
 }
 
 void compileForStmt(ForStmt *stmt)
 {
-    Reg condition = getTmpReg();
     compileStmt(stmt->init);
-    fprintf(outFile, ".FOR%s:\n", stmt->symbolEntry->ident);
-    compileExpr(stmt->condition->exprStmt->expr, condition);
-    fprintf(outFile, "\tbeqz %s, .FOR_END%s\n", regStr(condition), stmt->symbolEntry->ident);
-    freeReg(condition);
-    compileStmt(stmt->body);
-    if (stmt->modifier != NULL)
-    {
-        // TODO: Add code to deal with floats
-        Reg tmp = getTmpReg();
-        compileExpr(stmt->modifier, tmp);
-        freeReg(tmp);
-        fprintf(outFile, "\tj .FOR%s\n", stmt->symbolEntry->ident);
-
-        fprintf(outFile, ".FOR_MOD%s:\n", stmt->symbolEntry->ident);
-        Reg tmp1 = getTmpReg();
-        compileExpr(stmt->modifier, tmp1);
-        freeReg(tmp1);
+    compileLoop("FOR", stmt->symbolEntry->ident, stmt->condition->exprStmt->expr, stmt->modifier, stmt->body, stmt->preheader, true);
+}
 
-        fprintf(outFile, "\tj .FOR_END%s\n", stmt->symbolEntry->ident);
-    }
-    fprintf(outFile, "\tj .FOR%s\n", stmt->symbolEntry->ident);
-    fprintf(outFile, ".FOR_END%s:\n", stmt->symbolEntry->ident);
+// the label of a case, a negative value is spelt with an m as '-' cannot appear in a label
+static const char *caseLabel(const char *switchIdent, int32_t value)
+{
+    static char label[64];
+    snprintf(label, sizeof(label), ".SWITCH%s_CASE%s%lld", switchIdent, value < 0 ? "m" : "",
+             value < 0 ? -(long long)value : (long long)value);
+    return label;
 }
 
 void compileSwitchStmt(SwitchStmt *stmt)
 {
+    bool constValue;
+    if (constantCondition(stmt->selector, &constValue) && stmt->body->type == COMPOUND_STMT)
+    {
+        // the case taken is known, jump straight to it
+        LabelStmt *target;
+        switchTarget(stmt, &target);
+        if (target == NULL)
+        {
+            fprintf(outFile, "\tj .SWITCH_END%s\n", stmt->symbolEntry->ident);
+        }
+        else if (target->caseLabel == NULL)
+        {
+            fprintf(outFile, "\tj .SWITCH_DEFAULT%s\n", stmt->symbolEntry->ident);
+        }
+        else
+        {
+            fprintf(outFile, "\tj %s\n", caseLabel(stmt->symbolEntry->ident, target->caseLabel->constant->int_const));
+        }
+        compileStmt(stmt->body);
+        fprintf(outFile, ".SWITCH_END%s:\n", stmt->symbolEntry->ident);
+        return;
+    }
+
     Reg selector = getTmpReg();
     Reg tmp = getTmpReg();
     compileExpr(stmt->selector, selector);
-    // TODO: Add code to deal with const expr
     bool hasDefault = false;
     for (size_t i = 0; i < stmt->body->compoundStmt->stmtList.size; i++)
     {
-        if (stmt->body->compoundStmt->stmtList.stmts[i]->type == LABEL_STMT)
+        // labels can be stacked, case 1: case 2: ...
+        for (Stmt *label = stmt->body->compoundStmt->stmtList.stmts[i]; label->type == LABEL_STMT; label = label->labelStmt->body)
         {
-            if (stmt->body->compoundStmt->stmtList.stmts[i]->labelStmt->caseLabel != NULL)
+            if (label->labelStmt->caseLabel != NULL)
             {
-                fprintf(outFile, "\tli %s, %i\n", regStr(tmp), stmt->body->compoundStmt->stmtList.stmts[i]->labelStmt->caseLabel->constant->int_const);
-                fprintf(outFile, "\tbeq %s, %s, .SWITCH%s_CASE%i\n", regStr(selector), regStr(tmp),
-                        stmt->symbolEntry->ident,
-                        stmt->body->compoundStmt->stmtList.stmts[i]->labelStmt->caseLabel->constant->int_const);
+                fprintf(outFile, "\tli %s, %i\n", regStr(tmp), label->labelStmt->caseLabel->constant->int_const);
+                fprintf(outFile, "\tbeq %s, %s, %s\n", regStr(selector), regStr(tmp),
+                        caseLabel(stmt->symbolEntry->ident, label->labelStmt->caseLabel->constant->int_const));
             }
             else
             {
@@ -1816,7 +1697,7 @@ void compileLabelStmt(LabelStmt *stmt)
     }
     else if (stmt->caseLabel != NULL)
     {
-        fprintf(outFile, ".SWITCH%s_CASE%i:\n", stmt->symbolEntry->ident, evaluateIntConstExpr(stmt->caseLabel));
+        fprintf(outFile, "%s:\n", caseLabel(stmt->symbolEntry->ident, evaluateIntConstExpr(stmt->caseLabel)));
         compileStmt(stmt->body);
         // TOOD: Add support for const expr
     }
@@ -1828,9 +1709,40 @@ void compileLabelStmt(LabelStmt *stmt)
 //     fprintf(outFile, "\tsw %s, -%lu(fp)\n", regStr(dest), decl->symbolEntry->stackOffset);
 // }
 
+// writes the machine code out and reads it back as text for the passes that work on lines
+static void lowerToText(MachineFunc *machineFunc, InstrList *list)
+{
+    FILE *file = tmpfile();
+    if (file == NULL)
+    {
+        fprintf(stderr, "Unable to create temporary file, exiting...\n");
+        exit(EXIT_FAILURE);
+    }
+    mirWrite(machineFunc, file);
+    mirDestroy(machineFunc);
+    instrListRead(list, file);
+    fclose(file);
+}
+
 void compileFunc(FuncDef *func)
 {
+    // the function is buffered so that the peephole pass can see all of it
+    FILE *funcFile = outFile;
+    outFile = tmpfile();
+    if (outFile == NULL)
+    {
+        fprintf(stderr, "Unable to create temporary file, exiting...\n");
+        exit(EXIT_FAILURE);
+    }
     // displayParameterLocations(func->args);
+    funcIdent = func->ident;
+    funcIsMain = strcmp(func->ident, "main") == 0 && func->body != NULL;
+    unitHasMain |= funcIsMain;
+    if (profileUsePath != NULL)
+    {
+        // functions the profiled runs never called are grouped away from the hot ones
+        fprintf(outFile, isColdFunc(func->ident) ? "\t.section .text.unlikely\n" : ".text\n");
+    }
     fprintf(outFile, ".globl %s\n", func->ident);
     fprintf(outFile, ".type %s, @function\n", func->ident);
     fprintf(outFile, "%s:\n", func->ident);
@@ -1842,7 +1754,12 @@ void compileFunc(FuncDef *func)
     }
     fprintf(outFile, "\tmv fp, sp\n");
     fprintf(outFile, "\taddi sp, sp, -%lu\n", func->symbolEntry->storageSize);
+    loadGlobalBases(func->body);
     // TODO: Figure out if FP needs to be restored
+    vregCount = 0;
+    compileEntryHook();
+    funcReturnType = func->ptrCount != 0 ? VOID_PTR_TYPE : func->symbolEntry->type.dataType;
+    funcFrameEscapes = func->body == NULL || frameEscapes(func->body);
 
     if (func->isParam)
     {
@@ -1880,6 +1797,7 @@ void compileFunc(FuncDef *func)
     }
 
     // fprintf(outFile, "\tmv sp, fp\n");
+    compileExitHooks();
     for (size_t i = 1; i <= 11; i++) // Restore S1-S11
     {
         fprintf(outFile, "\tlw s%lu, -%lu(fp)\n", i, 8 + (i * 4)); // Save RA
@@ -1888,6 +1806,55 @@ void compileFunc(FuncDef *func)
     fprintf(outFile, "\tlw fp, -4(fp)\n");
     fprintf(outFile, "\taddi sp, sp, %lu\n", func->symbolEntry->storageSize);
     fprintf(outFile, "\tret\n");
+
+    InstrList instrList;
+    instrListRead(&instrList, outFile);
+    fclose(outFile);
+
+    // the virtual registers are allocated and the frame laid out before the text passes run
+    MachineFunc machineFunc;
+    mirCreate(&machineFunc, func->symbolEntry->storageSize);
+    mirBuild(&machineFunc, &instrList);
+    instrListDestroy(&instrList);
+    if (profileGenerate)
+    {
+        instrumentProfile(&machineFunc, func->ident);
+    }
+    // laid out before allocation so that an instrumented build and one using its profile see the same blocks
+    if (layoutEnabled || loopAlignment > 1)
+    {
+        layoutBlocks(&machineFunc);
+    }
+    if (scheduleEnabled)
+    {
+        scheduleInstructions(&machineFunc, false);
+    }
+    allocateRegisters(&machineFunc);
+    mirFinalizeFrame(&machineFunc);
+    lowerToText(&machineFunc, &instrList);
+    outFile = funcFile;
+    runPeephole(&instrList);
+    eliminateDeadStores(&instrList);
+    trimCalleeSaves(&instrList);
+    if (postScheduleEnabled)
+    {
+        // scheduled again once the spill code and what the text passes left are final
+        mirCreate(&machineFunc, func->symbolEntry->storageSize);
+        mirBuild(&machineFunc, &instrList);
+        instrListDestroy(&instrList);
+        scheduleInstructions(&machineFunc, true);
+        lowerToText(&machineFunc, &instrList);
+    }
+    recordClobbers(func->ident, &instrList);
+    if (cfgDumpFile != NULL)
+    {
+        Cfg cfg;
+        cfgBuild(&cfg, &instrList);
+        cfgWriteDot(&cfg, func->ident, cfgDumpFile);
+        cfgDestroy(&cfg);
+    }
+    instrListWrite(&instrList, outFile);
+    instrListDestroy(&instrList);
 }
 
 void compileCallArgs(FuncExpr *expr)
@@ -2070,13 +2037,42 @@ void compileFuncArgs(DeclarationList declList)
 
 void compileTranslationUnit(TranslationUnit *transUnit)
 {
+    // functions are compiled callees first so that calls know what they clobber, then written out in source order
+    FILE **funcFiles = calloc(transUnit->size + 1, sizeof(FILE *));
+    if (funcFiles == NULL)
+    {
+        abort();
+    }
+    size_t orderSize;
+    size_t *order = bottomUpOrder(transUnit, &orderSize);
+    FILE *unitFile = outFile;
+    for (size_t i = 0; i < orderSize; i++)
+    {
+        outFile = tmpfile();
+        if (outFile == NULL)
+        {
+            fprintf(stderr, "Unable to create temporary file, exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+        compileFunc(transUnit->externDecls[order[i]]->funcDef);
+        funcFiles[order[i]] = outFile;
+    }
+    outFile = unitFile;
+    free(order);
+
     for (size_t i = 0; i < transUnit->size; i++)
     {
         if (transUnit->externDecls[i]->isFunc)
         {
-            if (!transUnit->externDecls[i]->funcDef->isPrototype)
+            if (funcFiles[i] != NULL)
             {
-                compileFunc(transUnit->externDecls[i]->funcDef);
+                rewind(funcFiles[i]);
+                int c;
+                while ((c = fgetc(funcFiles[i])) != EOF)
+                {
+                    fputc(c, outFile);
+                }
+                fclose(funcFiles[i]);
             }
         }
         else
@@ -2084,18 +2080,22 @@ void compileTranslationUnit(TranslationUnit *transUnit)
             compileGlobal(transUnit->externDecls[i]->decl);
         }
     }
+    free(funcFiles);
+    emitLiteralPools(outFile);
+    emitProfileData(outFile, unitHasMain);
 }
 
 void compileGlobal(Decl *decl)
 {
     // TODO: Add const expr eval
+    const char *prefix = isSmallData(decl->symbolEntry) ? "s" : "";
     if (decl->declInit->initExpr == NULL)
     {
-        fprintf(outFile, "\t.section .sbss\n");
+        fprintf(outFile, "\t.section .%sbss\n", prefix);
     }
     else
     {
-        fprintf(outFile, "\t.section .sdata\n");
+        fprintf(outFile, "\t.section .%sdata\n", prefix);
     }
     fprintf(outFile, "\t.align 2\n\t.globl %s\n\t.type %s, @object\n\t.size %s, %lu\n", decl->symbolEntry->ident, decl->symbolEntry->ident, decl->symbolEntry->ident, decl->symbolEntry->storageSize);
     fprintf(outFile, "%s:\n", decl->symbolEntry->ident);
@@ -2113,12 +2113,7 @@ void compileGlobal(Decl *decl)
             }
             else if (decl->declInit->initExpr->type == CONSTANT_EXPR && decl->declInit->initExpr->constant->isString)
             {
-                uint64_t labelId = getId(&LCLabelId);
-                fprintf(outFile, "\t.word .LC%lu\n", labelId);
-                fprintf(outFile, "\t.align 2\n");
-                fprintf(outFile, ".LC%lu:\n", labelId);
-                fprintf(outFile, "\t.string \"%s\"\n", decl->declInit->initExpr->constant->string_const);
-                fprintf(outFile, ".text\n");
+                fprintf(outFile, "\t.word .LC%lu\n", stringLiteralLabel(decl->declInit->initExpr->constant->string_const));
             }
             else
             {
@@ -2130,7 +2125,7 @@ void compileGlobal(Decl *decl)
     {
         if (decl->declInit->initExpr == NULL)
         {
-            fprintf(outFile, "\t.float\n");
+            fprintf(outFile, "\t.zero %lu\n", decl->symbolEntry->storageSize);
         }
         else
         {
@@ -2141,7 +2136,7 @@ void compileGlobal(Decl *decl)
     {
         if (decl->declInit->initExpr == NULL)
         {
-            fprintf(outFile, "\t.double\n");
+            fprintf(outFile, "\t.zero %lu\n", decl->symbolEntry->storageSize);
         }
         else
         {
@@ -2159,7 +2154,7 @@ void compileGlobal(Decl *decl)
     {
         if (decl->declInit->initExpr == NULL)
         {
-            fprintf(outFile, "\t.word\n");
+            fprintf(outFile, "\t.zero %lu\n", decl->symbolEntry->storageSize);
         }
         else
         {
@@ -1,6 +1,7 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
+#include <stdbool.h>
 #include <stdio.h>
 
 #include "ast.h"
@@ -75,6 +76,8 @@ typedef enum
     FT11,
 } Reg;
 
+#define VREG_BASE 64 // Reg values from here up name virtual registers, odd ones floating-point
+
 typedef struct ParamRegCounts
 {
     size_t intRegs;
@@ -84,6 +87,7 @@ typedef struct ParamRegCounts
 const char *regStr(Reg reg);
 Reg getTmpReg(void);
 Reg getTmpFltReg(void);
+void freeReg(Reg reg);
 
 void compileExpr(Expr *expr, Reg dest);
 void compileOperationExpr(OperationExpr *expr, Reg dest);
@@ -0,0 +1,557 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alias.h"
+#include "ast.h"
+#include "cse.h"
+#include "loop.h"
+#include "optimise.h"
+#include "symbol.h"
+
+// common subexpression elimination, set from the command line
+bool cseEnabled = true;
+
+// A value computed at some point of the function, reused by later occurrences it dominates
+typedef struct ValueNumber
+{
+    Expr *key;         // copy of the computation, occurrences are compared against it
+    Expr *site;        // the first occurrence, becomes an assignment to the temporary once reused
+    SymbolEntry *temp; // NULL until the value is first reused
+} ValueNumber;
+
+// The values available at a point, indices into the numbered values of the function
+typedef struct ValueTable
+{
+    size_t *indices;
+    size_t size;
+    size_t capacity;
+} ValueTable;
+
+static ValueNumber *values = NULL;
+static size_t valuesSize = 0;
+static size_t valuesCapacity = 0;
+
+static SymbolEntry *currentFunc = NULL;
+
+static void cseStmt(Stmt *stmt, ValueTable *table);
+
+static ValueTable tableCopy(const ValueTable *table)
+{
+    ValueTable copy = {NULL, table->size, table->size};
+    if (table->size != 0)
+    {
+        copy.indices = malloc(sizeof(size_t) * table->size);
+        if (copy.indices == NULL)
+        {
+            abort();
+        }
+        memcpy(copy.indices, table->indices, sizeof(size_t) * table->size);
+    }
+    return copy;
+}
+
+static void tableDestroy(ValueTable *table)
+{
+    free(table->indices);
+    table->indices = NULL;
+    table->size = 0;
+    table->capacity = 0;
+}
+
+static void tablePush(ValueTable *table, size_t index)
+{
+    if (table->size == table->capacity)
+    {
+        table->capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+        table->indices = realloc(table->indices, sizeof(size_t) * table->capacity);
+        if (table->indices == NULL)
+        {
+            abort();
+        }
+    }
+    table->indices[table->size++] = index;
+}
+
+// key is owned by the numbered value from here on
+static void numberValue(Expr *key, Expr *site, ValueTable *table)
+{
+    if (valuesSize == valuesCapacity)
+    {
+        valuesCapacity = valuesCapacity == 0 ? 32 : valuesCapacity * 2;
+        values = realloc(values, sizeof(ValueNumber) * valuesCapacity);
+        if (values == NULL)
+        {
+            abort();
+        }
+    }
+    values[valuesSize].key = key;
+    values[valuesSize].site = site;
+    values[valuesSize].temp = NULL;
+    tablePush(table, valuesSize++);
+}
+
+// true if an expression reads the variable
+static bool readsEntry(const Expr *expr, const SymbolEntry *symbolEntry)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        return expr->variable->symbolEntry == symbolEntry;
+    case OPERATION_EXPR:
+        return (expr->operation->op1 != NULL && readsEntry(expr->operation->op1, symbolEntry)) ||
+               (expr->operation->op2 != NULL && readsEntry(expr->operation->op2, symbolEntry)) ||
+               (expr->operation->op3 != NULL && readsEntry(expr->operation->op3, symbolEntry));
+    default:
+        return false;
+    }
+}
+
+// true if a store through a pointer or a call may change the value of an expression
+static bool readsMemory(const Expr *expr)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        const SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        return symbolEntry != NULL && symbolEntry->entryType == VARIABLE_ENTRY && isEscaped(symbolEntry);
+    }
+    case OPERATION_EXPR:
+        return expr->operation->operator== DEREF ||
+               (expr->operation->op1 != NULL && readsMemory(expr->operation->op1)) ||
+               (expr->operation->op2 != NULL && readsMemory(expr->operation->op2)) ||
+               (expr->operation->op3 != NULL && readsMemory(expr->operation->op3));
+    default:
+        return false;
+    }
+}
+
+static void killEntry(ValueTable *table, const SymbolEntry *symbolEntry)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (!readsEntry(values[table->indices[i]].key, symbolEntry))
+        {
+            table->indices[kept++] = table->indices[i];
+        }
+    }
+    table->size = kept;
+}
+
+static void killMemory(ValueTable *table)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (!readsMemory(values[table->indices[i]].key))
+        {
+            table->indices[kept++] = table->indices[i];
+        }
+    }
+    table->size = kept;
+}
+
+static void killStore(ValueTable *table, MemoryRef store)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (!storeMayChange(values[table->indices[i]].key, store))
+        {
+            table->indices[kept++] = table->indices[i];
+        }
+    }
+    table->size = kept;
+}
+
+static void killCall(ValueTable *table, const FuncExpr *call)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (!callMayChange(values[table->indices[i]].key, call))
+        {
+            table->indices[kept++] = table->indices[i];
+        }
+    }
+    table->size = kept;
+}
+
+// a variable written by name, globals and escaped locals may also be read through pointers
+static void killWrite(ValueTable *table, SymbolEntry *symbolEntry)
+{
+    killEntry(table, symbolEntry);
+    if (isEscaped(symbolEntry))
+    {
+        MemoryRef store = {symbolEntry, symbolEntry->type.isStruct ? VOID_TYPE : symbolEntry->type.dataType};
+        killStore(table, store);
+    }
+}
+
+// removes every value a statement may change wherever control is inside it
+static void killEffects(ValueTable *table, Stmt *stmt)
+{
+    LoopEffects effects = {{NULL, 0, 0}, false, false};
+    collectSymbolsStmt(stmt, &effects.assigned, COLLECT_ASSIGNED);
+    collectEffectsStmt(stmt, &effects);
+    for (size_t i = 0; i < effects.assigned.size; i++)
+    {
+        killWrite(table, effects.assigned.entries[i]);
+    }
+    if (effects.storesMemory || effects.calls)
+    {
+        killMemory(table);
+    }
+    symbolSetClear(&effects.assigned);
+}
+
+// computations worth keeping in a temporary, loads and anything larger than a single operation on leaves
+static bool isCandidate(const Expr *expr)
+{
+    if (expr->type != OPERATION_EXPR)
+    {
+        return false;
+    }
+    switch (expr->operation->operator)
+    {
+    case INC:
+    case DEC:
+    case INC_POST:
+    case DEC_POST:
+    case TERN:
+    case COMMA_OP:
+    case SIZEOF_OP:
+    case ADDRESS:
+        return false;
+    default:
+        break;
+    }
+    if (hasSideEffects(expr) || tempType((Expr *)expr) == VOID_TYPE)
+    {
+        return false;
+    }
+    // a variable plus a constant costs nothing once folded into the displacement of a load or store
+    const OperationExpr *operation = expr->operation;
+    if (operation->operator== ADD && isPtr(operation->type) &&
+        ((operation->op1->type == VARIABLE_EXPR && operation->op2->type == CONSTANT_EXPR) ||
+         (operation->op1->type == CONSTANT_EXPR && operation->op2->type == VARIABLE_EXPR)))
+    {
+        return false;
+    }
+    return expr->operation->operator== DEREF || exprSize(expr) >= 3;
+}
+
+static bool lookupValue(const ValueTable *table, const Expr *expr, size_t *index)
+{
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (exprEqual(values[table->indices[i]].key, expr))
+        {
+            *index = table->indices[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// replaces an occurrence with a read of the temporary, the first occurrence now assigns it
+static void reuseValue(Expr *expr, ValueNumber *value)
+{
+    if (value->temp == NULL)
+    {
+        value->temp = createTemp(currentFunc, tempType(value->key));
+        Expr *first = exprCreate(OPERATION_EXPR);
+        *first = *value->site;
+        Expr *assign = assignEntryExpr(value->temp, first);
+        *value->site = *assign;
+        free(assign);
+    }
+    clearExpr(expr);
+    makeEntryRead(expr, value->temp);
+}
+
+static void cseExpr(Expr *expr, ValueTable *table, bool dominates);
+
+// a later load of the address a value was stored to reads the stored value, until something may overwrite it
+static void forwardStore(AssignExpr *assign, Expr *address, MemoryRef store, ValueTable *table, bool dominates)
+{
+    DataType type = store.type;
+    Expr *load = operationCreate(DEREF, type, address, NULL);
+    if (dominates && aliasEnabled && assign->operator== NOT &&
+        (isPtr(type) || type == INT_TYPE || type == UNSIGNED_INT_TYPE || type == FLOAT_TYPE) &&
+        !hasSideEffects(address) && !storeMayChange(address, store))
+    {
+        numberValue(load, assign->op, table);
+    }
+    else
+    {
+        exprDestroy(load);
+    }
+}
+
+// the operand of ++, -- or & is a location, only the address inside it is a value
+static void cseLocation(Expr *expr, ValueTable *table, bool dominates)
+{
+    if (expr->type == OPERATION_EXPR && expr->operation->operator== DEREF)
+    {
+        cseExpr(expr->operation->op1, table, dominates);
+    }
+}
+
+// values are only numbered where they dominate the rest of the region, not in operands that may be skipped
+static void cseExpr(Expr *expr, ValueTable *table, bool dominates)
+{
+    size_t index;
+    if (isCandidate(expr) && lookupValue(table, expr, &index))
+    {
+        reuseValue(expr, &values[index]);
+        return;
+    }
+
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        switch (operation->operator)
+        {
+        case INC:
+        case DEC:
+        case INC_POST:
+        case DEC_POST:
+            cseLocation(operation->op1, table, dominates);
+            if (operation->op1->type == VARIABLE_EXPR)
+            {
+                killWrite(table, operation->op1->variable->symbolEntry);
+            }
+            else if (operation->op1->type == OPERATION_EXPR && operation->op1->operation->operator== DEREF)
+            {
+                OperationExpr *location = operation->op1->operation;
+                killStore(table, memoryRef(location->op1, location->type));
+            }
+            else
+            {
+                killMemory(table);
+            }
+            break;
+        case ADDRESS:
+            cseLocation(operation->op1, table, dominates);
+            break;
+        case SIZEOF_OP:
+            break;
+        case AND:
+        case OR:
+            cseExpr(operation->op1, table, dominates);
+            cseExpr(operation->op2, table, false);
+            break;
+        case TERN:
+            cseExpr(operation->op1, table, dominates);
+            cseExpr(operation->op2, table, false);
+            cseExpr(operation->op3, table, false);
+            break;
+        default:
+            if (operation->op1 != NULL)
+            {
+                cseExpr(operation->op1, table, dominates);
+            }
+            if (operation->op2 != NULL)
+            {
+                cseExpr(operation->op2, table, dominates);
+            }
+            if (operation->op3 != NULL)
+            {
+                cseExpr(operation->op3, table, dominates);
+            }
+            break;
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+    {
+        // the value is computed before the address it is stored to
+        AssignExpr *assign = expr->assignment;
+        cseExpr(assign->op, table, dominates);
+        if (assign->lvalue != NULL)
+        {
+            Expr *address = exprCopy(assign->lvalue);
+            cseExpr(assign->lvalue, table, dominates);
+            MemoryRef store = memoryRef(address, storedType(assign));
+            killStore(table, store);
+            forwardStore(assign, address, store, table, dominates);
+        }
+        else if (assign->symbolEntry != NULL)
+        {
+            killWrite(table, assign->symbolEntry);
+        }
+        break;
+    }
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            cseExpr(expr->function->args[i], table, dominates);
+        }
+        killCall(table, expr->function);
+        break;
+    default:
+        break;
+    }
+
+    if (dominates && isCandidate(expr))
+    {
+        numberValue(exprCopy(expr), expr, table);
+    }
+}
+
+// a region entered once from the current point, what it numbers is dropped and what it changes is killed
+static void cseRegion(Stmt *stmt, ValueTable *table)
+{
+    ValueTable region = tableCopy(table);
+    cseStmt(stmt, &region);
+    tableDestroy(&region);
+    killEffects(table, stmt);
+}
+
+static void cseLoop(Stmt *stmt, ValueTable *table)
+{
+    // values changed anywhere in the loop are not available on its second iteration
+    killEffects(table, stmt);
+    ValueTable loop = tableCopy(table);
+    if (stmt->type == WHILE_STMT)
+    {
+        WhileStmt *whileStmt = stmt->whileStmt;
+        if (whileStmt->doWhile)
+        {
+            // continue skips the rest of the body, the condition only sees values from before it
+            ValueTable condition = tableCopy(&loop);
+            if (whileStmt->preheader != NULL)
+            {
+                cseStmt(whileStmt->preheader, &loop);
+            }
+            cseStmt(whileStmt->body, &loop);
+            cseExpr(whileStmt->condition, &condition, false);
+            tableDestroy(&condition);
+        }
+        else
+        {
+            cseExpr(whileStmt->condition, &loop, true);
+            if (whileStmt->preheader != NULL)
+            {
+                cseStmt(whileStmt->preheader, &loop);
+            }
+            cseStmt(whileStmt->body, &loop);
+        }
+    }
+    else
+    {
+        ForStmt *forStmt = stmt->forStmt;
+        cseStmt(forStmt->condition, &loop);
+        ValueTable modifier = tableCopy(&loop);
+        if (forStmt->preheader != NULL)
+        {
+            cseStmt(forStmt->preheader, &loop);
+        }
+        cseStmt(forStmt->body, &loop);
+        if (forStmt->modifier != NULL)
+        {
+            cseExpr(forStmt->modifier, &modifier, false);
+        }
+        tableDestroy(&modifier);
+    }
+    tableDestroy(&loop);
+}
+
+static void cseStmt(Stmt *stmt, ValueTable *table)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        cseLoop(stmt, table);
+        break;
+    case FOR_STMT:
+        // the initialiser runs once, before the loop
+        cseStmt(stmt->forStmt->init, table);
+        cseLoop(stmt, table);
+        break;
+    case IF_STMT:
+        cseExpr(stmt->ifStmt->condition, table, true);
+        cseRegion(stmt->ifStmt->trueBody, table);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            cseRegion(stmt->ifStmt->falseBody, table);
+        }
+        break;
+    case SWITCH_STMT:
+        cseExpr(stmt->switchStmt->selector, table, true);
+        cseRegion(stmt->switchStmt->body, table);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            cseExpr(stmt->exprStmt->expr, table, true);
+        }
+        break;
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            Decl *decl = compoundStmt->declList.decls[i];
+            if (decl->declInit != NULL && decl->declInit->initExpr != NULL)
+            {
+                cseExpr(decl->declInit->initExpr, table, true);
+            }
+            if (decl->symbolEntry != NULL)
+            {
+                killWrite(table, decl->symbolEntry);
+            }
+        }
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            cseStmt(compoundStmt->stmtList.stmts[i], table);
+        }
+        break;
+    }
+    case LABEL_STMT:
+        // a case label is a join, nothing computed before it dominates it
+        table->size = 0;
+        cseStmt(stmt->labelStmt->body, table);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            cseExpr(stmt->jumpStmt->expr, table, true);
+        }
+        break;
+    }
+}
+
+// there is no separate IR, values are numbered over the AST: statements of a block in order, and down the
+// dominator tree that if, switch and loop nesting gives a function without goto
+void eliminateCommonSubexprs(FuncDef *func)
+{
+    if (!cseEnabled || func->body == NULL || containsGoto(func->body))
+    {
+        return;
+    }
+    currentFunc = func->symbolEntry;
+    analyseEscapes(func);
+
+    ValueTable table = {NULL, 0, 0};
+    cseStmt(func->body, &table);
+    tableDestroy(&table);
+
+    for (size_t i = 0; i < valuesSize; i++)
+    {
+        exprDestroy(values[i].key);
+    }
+    free(values);
+    values = NULL;
+    valuesSize = 0;
+    valuesCapacity = 0;
+    escapesClear();
+    currentFunc = NULL;
+}
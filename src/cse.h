@@ -0,0 +1,12 @@
+#ifndef CSE_H
+#define CSE_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+extern bool cseEnabled;
+
+void eliminateCommonSubexprs(FuncDef *func);
+
+#endif
@@ -0,0 +1,438 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "dataflow.h"
+#include "peephole.h"
+
+// dead store elimination, set from the command line
+bool dseEnabled = true;
+
+static const struct
+{
+    const char *opcode;
+    size_t width;
+    bool isStore;
+} memoryOps[] = {{"lb", 1, false}, {"lbu", 1, false}, {"lh", 2, false}, {"lhu", 2, false}, {"lw", 4, false},
+                 {"flw", 4, false}, {"fld", 8, false}, {"sb", 1, true}, {"sh", 2, true}, {"sw", 4, true},
+                 {"fsw", 4, true}, {"fsd", 8, true}};
+
+#define MEMORY_OP_COUNT (sizeof(memoryOps) / sizeof(memoryOps[0]))
+
+BitSet bitSetCreate(size_t size)
+{
+    BitSet set = {calloc(size / 64 + 1, sizeof(uint64_t)), size};
+    if (set.words == NULL)
+    {
+        abort();
+    }
+    return set;
+}
+
+void bitSetDestroy(BitSet *set)
+{
+    free(set->words);
+    set->words = NULL;
+    set->size = 0;
+}
+
+void bitSetAdd(BitSet *set, size_t bit)
+{
+    set->words[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+void bitSetRemove(BitSet *set, size_t bit)
+{
+    set->words[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+bool bitSetContains(const BitSet *set, size_t bit)
+{
+    return (set->words[bit / 64] >> (bit % 64)) & 1;
+}
+
+// returns true if the set grew
+bool bitSetUnion(BitSet *set, const BitSet *other)
+{
+    bool changed = false;
+    for (size_t i = 0; i <= set->size / 64; i++)
+    {
+        uint64_t words = set->words[i] | other->words[i];
+        changed |= words != set->words[i];
+        set->words[i] = words;
+    }
+    return changed;
+}
+
+void bitSetCopy(BitSet *set, const BitSet *other)
+{
+    memcpy(set->words, other->words, sizeof(uint64_t) * (set->size / 64 + 1));
+}
+
+static BitSet *bitSetArray(size_t count, size_t bits)
+{
+    BitSet *sets = malloc(sizeof(BitSet) * (count + 1));
+    if (sets == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        sets[i] = bitSetCreate(bits);
+    }
+    return sets;
+}
+
+static void bitSetArrayDestroy(BitSet *sets, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        bitSetDestroy(&sets[i]);
+    }
+    free(sets);
+}
+
+// every set starts empty, the caller fills in gen and kill before solving
+void dataflowCreate(Dataflow *dataflow, const Cfg *cfg, DataflowDirection direction, size_t bits)
+{
+    dataflow->direction = direction;
+    dataflow->blockCount = cfg->size;
+    dataflow->gen = bitSetArray(cfg->size, bits);
+    dataflow->kill = bitSetArray(cfg->size, bits);
+    dataflow->in = bitSetArray(cfg->size, bits);
+    dataflow->out = bitSetArray(cfg->size, bits);
+}
+
+void dataflowDestroy(Dataflow *dataflow)
+{
+    bitSetArrayDestroy(dataflow->gen, dataflow->blockCount);
+    bitSetArrayDestroy(dataflow->kill, dataflow->blockCount);
+    bitSetArrayDestroy(dataflow->in, dataflow->blockCount);
+    bitSetArrayDestroy(dataflow->out, dataflow->blockCount);
+    dataflow->blockCount = 0;
+}
+
+// worklist iteration to the least fixed point, blocks start in reverse post-order (forwards) or its reverse
+void dataflowSolve(Dataflow *dataflow, const Cfg *cfg)
+{
+    bool forward = dataflow->direction == DATAFLOW_FORWARD;
+    // the meet flows into one side of a block and the transfer out of the other
+    BitSet *meet = forward ? dataflow->in : dataflow->out;
+    BitSet *result = forward ? dataflow->out : dataflow->in;
+
+    size_t capacity = cfg->size + 1;
+    size_t *queue = malloc(sizeof(size_t) * capacity);
+    bool *queued = calloc(cfg->size + 1, sizeof(bool));
+    if (queue == NULL || queued == NULL)
+    {
+        abort();
+    }
+    size_t head = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < cfg->rpo.size; i++)
+    {
+        size_t block = cfg->rpo.blocks[forward ? i : cfg->rpo.size - 1 - i];
+        queue[count++] = block;
+        queued[block] = true;
+    }
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        if (!queued[block])
+        {
+            queue[count++] = block;
+            queued[block] = true;
+        }
+    }
+
+    BitSet scratch = bitSetCreate(dataflow->gen[0].size);
+    while (count != 0)
+    {
+        size_t block = queue[head];
+        head = (head + 1) % capacity;
+        count--;
+        queued[block] = false;
+
+        const BlockList *sources = forward ? &cfg->blocks[block].preds : &cfg->blocks[block].succs;
+        for (size_t i = 0; i < sources->size; i++)
+        {
+            bitSetUnion(&meet[block], &result[sources->blocks[i]]);
+        }
+        bitSetCopy(&scratch, &meet[block]);
+        for (size_t i = 0; i <= scratch.size / 64; i++)
+        {
+            scratch.words[i] = dataflow->gen[block].words[i] | (scratch.words[i] & ~dataflow->kill[block].words[i]);
+        }
+        if (!bitSetUnion(&result[block], &scratch))
+        {
+            continue;
+        }
+
+        const BlockList *targets = forward ? &cfg->blocks[block].succs : &cfg->blocks[block].preds;
+        for (size_t i = 0; i < targets->size; i++)
+        {
+            size_t target = targets->blocks[i];
+            if (!queued[target])
+            {
+                queue[(head + count) % capacity] = target;
+                count++;
+                queued[target] = true;
+            }
+        }
+    }
+    bitSetDestroy(&scratch);
+    free(queue);
+    free(queued);
+}
+
+// off(fp) loads and stores, the only way the code generator reaches a local slot directly
+bool frameAccess(const Instr *instr, FrameAccess *access)
+{
+    if (instr->kind != INSTR_OP || instr->operandCount != 2)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < MEMORY_OP_COUNT; i++)
+    {
+        if (strcmp(instr->opcode, memoryOps[i].opcode) == 0)
+        {
+            char *end;
+            long offset = strtol(instr->operands[1], &end, 10);
+            if (end == instr->operands[1] || strcmp(end, "(fp)") != 0)
+            {
+                return false;
+            }
+            access->offset = offset;
+            access->width = memoryOps[i].width;
+            access->isStore = memoryOps[i].isStore;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isMemoryOp(const Instr *instr, bool *isStore)
+{
+    for (size_t i = 0; i < MEMORY_OP_COUNT; i++)
+    {
+        if (strcmp(instr->opcode, memoryOps[i].opcode) == 0)
+        {
+            *isStore = memoryOps[i].isStore;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the prologue and epilogue move between sp and fp, and loads and stores save and restore fp itself
+static bool isFrameSetup(const Instr *instr)
+{
+    if (strcmp(instr->opcode, "mv") == 0 && instr->operandCount == 2)
+    {
+        return (strcmp(instr->operands[0], "fp") == 0 && strcmp(instr->operands[1], "sp") == 0) ||
+               (strcmp(instr->operands[0], "sp") == 0 && strcmp(instr->operands[1], "fp") == 0);
+    }
+    if (strcmp(instr->opcode, "addi") == 0 && instr->operandCount == 3)
+    {
+        return strcmp(instr->operands[0], "sp") == 0 && strcmp(instr->operands[1], "sp") == 0;
+    }
+    return false;
+}
+
+// a slot escapes once fp or sp is used other than as the base of a load or store, or sp is loaded from
+FrameLayout frameLayout(const InstrList *list)
+{
+    FrameLayout layout = {0, 0, false};
+    long low = 0;
+    long high = 0;
+    for (size_t i = 0; i < list->size; i++)
+    {
+        const Instr *instr = &list->instrs[i];
+        if (instr->deleted)
+        {
+            continue;
+        }
+        const char *text = instr->text;
+        while (*text == ' ' || *text == '\t')
+        {
+            text++;
+        }
+        if (instr->kind == INSTR_DIRECTIVE && *text != '.' && *text != '#' && *text != '\n' && *text != '\0')
+        {
+            // not understood, it may do anything with the frame
+            layout.escapes = true;
+            continue;
+        }
+        if (instr->kind != INSTR_OP)
+        {
+            continue;
+        }
+        FrameAccess access;
+        if (frameAccess(instr, &access))
+        {
+            low = access.offset < low ? access.offset : low;
+            high = access.offset + (long)access.width > high ? access.offset + (long)access.width : high;
+            continue;
+        }
+        if (isFrameSetup(instr))
+        {
+            continue;
+        }
+        bool isStore = false;
+        bool memoryOp = isMemoryOp(instr, &isStore);
+        for (size_t j = 0; j < instr->operandCount; j++)
+        {
+            const char *operand = instr->operands[j];
+            bool bare = strcmp(operand, "fp") == 0 || strcmp(operand, "sp") == 0;
+            bool based = strstr(operand, "(fp)") != NULL || strstr(operand, "(sp)") != NULL;
+            if ((bare && !(memoryOp && j == 0)) || (based && !memoryOp) ||
+                (memoryOp && !isStore && strstr(operand, "(sp)") != NULL))
+            {
+                layout.escapes = true;
+            }
+        }
+    }
+    layout.base = low;
+    layout.size = (size_t)(high - low);
+    return layout;
+}
+
+// backward liveness of frame bytes, a store kills only the bytes it covers
+void frameLiveness(Dataflow *dataflow, const Cfg *cfg, const FrameLayout *layout)
+{
+    dataflowCreate(dataflow, cfg, DATAFLOW_BACKWARD, layout->size);
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        BitSet *gen = &dataflow->gen[block];
+        BitSet *kill = &dataflow->kill[block];
+        for (size_t i = cfg->blocks[block].end; i > cfg->blocks[block].first; i--)
+        {
+            const Instr *instr = &cfg->list->instrs[i - 1];
+            FrameAccess access;
+            if (instr->deleted || !frameAccess(instr, &access))
+            {
+                continue;
+            }
+            for (size_t byte = 0; byte < access.width; byte++)
+            {
+                size_t bit = (size_t)(access.offset - layout->base) + byte;
+                if (access.isStore)
+                {
+                    bitSetRemove(gen, bit);
+                    bitSetAdd(kill, bit);
+                }
+                else
+                {
+                    bitSetAdd(gen, bit);
+                }
+            }
+        }
+    }
+    dataflowSolve(dataflow, cfg);
+}
+
+// forward reaching definitions of frame slots, returns the instruction index of each definition bit
+size_t *reachingDefinitions(Dataflow *dataflow, const Cfg *cfg, size_t *defCount)
+{
+    size_t *defs = malloc(sizeof(size_t) * (cfg->list->size + 1));
+    FrameAccess *slots = malloc(sizeof(FrameAccess) * (cfg->list->size + 1));
+    if (defs == NULL || slots == NULL)
+    {
+        abort();
+    }
+    *defCount = 0;
+    for (size_t i = 0; i < cfg->list->size; i++)
+    {
+        FrameAccess access;
+        if (!cfg->list->instrs[i].deleted && frameAccess(&cfg->list->instrs[i], &access) && access.isStore)
+        {
+            slots[*defCount] = access;
+            defs[(*defCount)++] = i;
+        }
+    }
+
+    dataflowCreate(dataflow, cfg, DATAFLOW_FORWARD, *defCount);
+    size_t def = 0;
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        BitSet *gen = &dataflow->gen[block];
+        BitSet *kill = &dataflow->kill[block];
+        // definitions are numbered in instruction order, so a block owns a contiguous run of them
+        for (; def < *defCount && defs[def] < cfg->blocks[block].end; def++)
+        {
+            for (size_t other = 0; other < *defCount; other++)
+            {
+                if (other != def && slots[other].offset == slots[def].offset && slots[other].width == slots[def].width)
+                {
+                    bitSetRemove(gen, other);
+                    bitSetAdd(kill, other);
+                }
+            }
+            bitSetAdd(gen, def);
+        }
+    }
+    dataflowSolve(dataflow, cfg);
+    free(slots);
+    return defs;
+}
+
+// deletes stores to locals whose bytes are all overwritten or dead before they are next read
+void eliminateDeadStores(InstrList *list)
+{
+    if (!dseEnabled)
+    {
+        return;
+    }
+    FrameLayout layout = frameLayout(list);
+    if (layout.escapes || layout.size == 0)
+    {
+        return;
+    }
+    Cfg cfg;
+    cfgBuild(&cfg, list);
+    Dataflow liveness;
+    frameLiveness(&liveness, &cfg, &layout);
+
+    BitSet live = bitSetCreate(layout.size);
+    for (size_t block = 0; block < cfg.size; block++)
+    {
+        bitSetCopy(&live, &liveness.out[block]);
+        for (size_t i = cfg.blocks[block].end; i > cfg.blocks[block].first; i--)
+        {
+            Instr *instr = &list->instrs[i - 1];
+            FrameAccess access;
+            if (instr->deleted || !frameAccess(instr, &access))
+            {
+                continue;
+            }
+            size_t first = (size_t)(access.offset - layout.base);
+            bool read = false;
+            for (size_t byte = 0; byte < access.width; byte++)
+            {
+                read |= bitSetContains(&live, first + byte);
+            }
+            if (access.isStore && !read && access.offset + (long)access.width <= 0)
+            {
+                // slots at non-negative offsets belong to the caller
+                instr->deleted = true;
+                continue;
+            }
+            for (size_t byte = 0; byte < access.width; byte++)
+            {
+                if (access.isStore)
+                {
+                    bitSetRemove(&live, first + byte);
+                }
+                else
+                {
+                    bitSetAdd(&live, first + byte);
+                }
+            }
+        }
+    }
+    bitSetDestroy(&live);
+    dataflowDestroy(&liveness);
+    cfgDestroy(&cfg);
+}
@@ -0,0 +1,71 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cfg.h"
+#include "peephole.h"
+
+typedef struct BitSet
+{
+    uint64_t *words;
+    size_t size; // in bits
+} BitSet;
+
+typedef enum
+{
+    DATAFLOW_FORWARD,
+    DATAFLOW_BACKWARD
+} DataflowDirection;
+
+// A union problem over the blocks of a graph, in = gen | (out & ~kill) backwards and the mirror forwards
+typedef struct Dataflow
+{
+    DataflowDirection direction;
+    size_t blockCount;
+    BitSet *gen;
+    BitSet *kill;
+    BitSet *in;
+    BitSet *out;
+} Dataflow;
+
+// A load or store addressed off the frame pointer
+typedef struct FrameAccess
+{
+    long offset;
+    size_t width;
+    bool isStore;
+} FrameAccess;
+
+// The bytes of the frame that frame pointer accesses touch, bit i is the byte at base + i
+typedef struct FrameLayout
+{
+    long base;
+    size_t size;
+    bool escapes; // the address of a slot is computed, so pointers may reach any of them
+} FrameLayout;
+
+extern bool dseEnabled;
+
+BitSet bitSetCreate(size_t size);
+void bitSetDestroy(BitSet *set);
+void bitSetAdd(BitSet *set, size_t bit);
+void bitSetRemove(BitSet *set, size_t bit);
+bool bitSetContains(const BitSet *set, size_t bit);
+bool bitSetUnion(BitSet *set, const BitSet *other);
+void bitSetCopy(BitSet *set, const BitSet *other);
+
+void dataflowCreate(Dataflow *dataflow, const Cfg *cfg, DataflowDirection direction, size_t bits);
+void dataflowSolve(Dataflow *dataflow, const Cfg *cfg);
+void dataflowDestroy(Dataflow *dataflow);
+
+bool frameAccess(const Instr *instr, FrameAccess *access);
+FrameLayout frameLayout(const InstrList *list);
+void frameLiveness(Dataflow *dataflow, const Cfg *cfg, const FrameLayout *layout);
+size_t *reachingDefinitions(Dataflow *dataflow, const Cfg *cfg, size_t *defCount);
+
+void eliminateDeadStores(InstrList *list);
+
+#endif
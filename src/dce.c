@@ -0,0 +1,817 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "dce.h"
+#include "optimise.h"
+#include "symbol.h"
+
+// copy propagation and dead code elimination, set from the command line
+bool dceEnabled = true;
+
+// A variable known to hold the same value as another, uses of dest read src instead
+typedef struct Copy
+{
+    SymbolEntry *dest;
+    SymbolEntry *src;
+} Copy;
+
+typedef struct CopyTable
+{
+    Copy *copies;
+    size_t size;
+    size_t capacity;
+} CopyTable;
+
+// What is live where a break, continue or case label of a loop or switch leads
+typedef struct JumpTarget
+{
+    SymbolEntry *symbolEntry;
+    SymbolSet breakLive;
+    SymbolSet continueLive;
+    SymbolSet caseLive; // switches only, the union over their case labels
+} JumpTarget;
+
+static JumpTarget *targets = NULL;
+static size_t targetsSize = 0;
+static size_t targetsCapacity = 0;
+
+// locals of the current function whose address escapes
+static SymbolSet addressTaken;
+
+static void copyStmt(Stmt *stmt, CopyTable *table);
+static void liveStmt(Stmt *stmt, SymbolSet *live, bool rewrite);
+
+// scalar locals whose every read and write is visible in the function
+static bool isTracked(const SymbolEntry *symbolEntry)
+{
+    return symbolEntry != NULL && !symbolEntry->isGlobal && symbolEntry->entryType == VARIABLE_ENTRY &&
+           !symbolEntry->type.isStruct && !symbolSetContains(&addressTaken, symbolEntry);
+}
+
+static CopyTable copyTableCopy(const CopyTable *table)
+{
+    CopyTable copy = {NULL, table->size, table->size};
+    if (table->size != 0)
+    {
+        copy.copies = malloc(sizeof(Copy) * table->size);
+        if (copy.copies == NULL)
+        {
+            abort();
+        }
+        memcpy(copy.copies, table->copies, sizeof(Copy) * table->size);
+    }
+    return copy;
+}
+
+static void copyTableDestroy(CopyTable *table)
+{
+    free(table->copies);
+    table->copies = NULL;
+    table->size = 0;
+    table->capacity = 0;
+}
+
+static void copyTablePush(CopyTable *table, SymbolEntry *dest, SymbolEntry *src)
+{
+    if (table->size == table->capacity)
+    {
+        table->capacity = table->capacity == 0 ? 8 : table->capacity * 2;
+        table->copies = realloc(table->copies, sizeof(Copy) * table->capacity);
+        if (table->copies == NULL)
+        {
+            abort();
+        }
+    }
+    table->copies[table->size].dest = dest;
+    table->copies[table->size].src = src;
+    table->size++;
+}
+
+// a write to a variable ends every copy it takes part in
+static void copyTableKill(CopyTable *table, const SymbolEntry *symbolEntry)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (table->copies[i].dest != symbolEntry && table->copies[i].src != symbolEntry)
+        {
+            table->copies[kept++] = table->copies[i];
+        }
+    }
+    table->size = kept;
+}
+
+static void copyTableKillSet(CopyTable *table, Stmt *stmt)
+{
+    SymbolSet assigned = {NULL, 0, 0};
+    collectSymbolsStmt(stmt, &assigned, COLLECT_ASSIGNED);
+    for (size_t i = 0; i < assigned.size; i++)
+    {
+        copyTableKill(table, assigned.entries[i]);
+    }
+    symbolSetClear(&assigned);
+}
+
+// the variable a store copies, NULL unless it is a plain copy between tracked locals of one type
+static SymbolEntry *copiedEntry(const SymbolEntry *dest, const Expr *value)
+{
+    if (value->type != VARIABLE_EXPR || !isTracked(dest))
+    {
+        return NULL;
+    }
+    SymbolEntry *src = value->variable->symbolEntry;
+    if (!isTracked(src) || src == dest || src->type.dataType != dest->type.dataType ||
+        value->variable->type != src->type.dataType)
+    {
+        return NULL;
+    }
+    return src;
+}
+
+// copies are only recorded where they hold for the rest of the region, not in operands that may be skipped
+static void copyExpr(Expr *expr, CopyTable *table, bool dominates)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        for (size_t i = 0; i < table->size; i++)
+        {
+            if (table->copies[i].dest == expr->variable->symbolEntry)
+            {
+                SymbolEntry *src = table->copies[i].src;
+                clearExpr(expr);
+                makeEntryRead(expr, src);
+                break;
+            }
+        }
+        break;
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        switch (operation->operator)
+        {
+        case INC:
+        case DEC:
+        case INC_POST:
+        case DEC_POST:
+            if (operation->op1->type == VARIABLE_EXPR)
+            {
+                copyTableKill(table, operation->op1->variable->symbolEntry);
+            }
+            else
+            {
+                copyExpr(operation->op1, table, dominates);
+            }
+            break;
+        case ADDRESS:
+        case SIZEOF_OP:
+            break;
+        case AND:
+        case OR:
+            copyExpr(operation->op1, table, dominates);
+            copyExpr(operation->op2, table, false);
+            break;
+        case TERN:
+            copyExpr(operation->op1, table, dominates);
+            copyExpr(operation->op2, table, false);
+            copyExpr(operation->op3, table, false);
+            break;
+        default:
+            if (operation->op1 != NULL)
+            {
+                copyExpr(operation->op1, table, dominates);
+            }
+            if (operation->op2 != NULL)
+            {
+                copyExpr(operation->op2, table, dominates);
+            }
+            if (operation->op3 != NULL)
+            {
+                copyExpr(operation->op3, table, dominates);
+            }
+            break;
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+    {
+        AssignExpr *assign = expr->assignment;
+        copyExpr(assign->op, table, dominates);
+        if (assign->lvalue != NULL)
+        {
+            copyExpr(assign->lvalue, table, dominates);
+            break;
+        }
+        copyTableKill(table, assign->symbolEntry);
+        SymbolEntry *src = assign->operator== NOT ? copiedEntry(assign->symbolEntry, assign->op) : NULL;
+        if (dominates && src != NULL)
+        {
+            copyTablePush(table, assign->symbolEntry, src);
+        }
+        break;
+    }
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            copyExpr(expr->function->args[i], table, dominates);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// a region entered once from the current point, what it records is dropped and what it writes is killed
+static void copyRegion(Stmt *stmt, CopyTable *table)
+{
+    CopyTable region = copyTableCopy(table);
+    copyStmt(stmt, &region);
+    copyTableDestroy(&region);
+    copyTableKillSet(table, stmt);
+}
+
+static void copyLoop(Stmt *stmt, CopyTable *table)
+{
+    // copies broken anywhere in the loop do not hold on its second iteration
+    copyTableKillSet(table, stmt);
+    CopyTable loop = copyTableCopy(table);
+    if (stmt->type == WHILE_STMT)
+    {
+        WhileStmt *whileStmt = stmt->whileStmt;
+        if (whileStmt->doWhile)
+        {
+            // continue skips the rest of the body, the condition only sees copies from before it
+            CopyTable condition = copyTableCopy(&loop);
+            if (whileStmt->preheader != NULL)
+            {
+                copyStmt(whileStmt->preheader, &loop);
+            }
+            copyStmt(whileStmt->body, &loop);
+            copyExpr(whileStmt->condition, &condition, false);
+            copyTableDestroy(&condition);
+        }
+        else
+        {
+            copyExpr(whileStmt->condition, &loop, true);
+            if (whileStmt->preheader != NULL)
+            {
+                copyStmt(whileStmt->preheader, &loop);
+            }
+            copyStmt(whileStmt->body, &loop);
+        }
+    }
+    else
+    {
+        ForStmt *forStmt = stmt->forStmt;
+        copyStmt(forStmt->condition, &loop);
+        CopyTable modifier = copyTableCopy(&loop);
+        if (forStmt->preheader != NULL)
+        {
+            copyStmt(forStmt->preheader, &loop);
+        }
+        copyStmt(forStmt->body, &loop);
+        if (forStmt->modifier != NULL)
+        {
+            copyExpr(forStmt->modifier, &modifier, false);
+        }
+        copyTableDestroy(&modifier);
+    }
+    copyTableDestroy(&loop);
+}
+
+static void copyStmt(Stmt *stmt, CopyTable *table)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        copyLoop(stmt, table);
+        break;
+    case FOR_STMT:
+        copyStmt(stmt->forStmt->init, table);
+        copyLoop(stmt, table);
+        break;
+    case IF_STMT:
+        copyExpr(stmt->ifStmt->condition, table, true);
+        copyRegion(stmt->ifStmt->trueBody, table);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            copyRegion(stmt->ifStmt->falseBody, table);
+        }
+        break;
+    case SWITCH_STMT:
+        copyExpr(stmt->switchStmt->selector, table, true);
+        copyRegion(stmt->switchStmt->body, table);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            copyExpr(stmt->exprStmt->expr, table, true);
+        }
+        break;
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            Decl *decl = compoundStmt->declList.decls[i];
+            Expr *initExpr = decl->declInit != NULL ? decl->declInit->initExpr : NULL;
+            if (initExpr != NULL)
+            {
+                copyExpr(initExpr, table, true);
+            }
+            copyTableKill(table, decl->symbolEntry);
+            SymbolEntry *src = initExpr != NULL ? copiedEntry(decl->symbolEntry, initExpr) : NULL;
+            if (src != NULL)
+            {
+                copyTablePush(table, decl->symbolEntry, src);
+            }
+        }
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            copyStmt(compoundStmt->stmtList.stmts[i], table);
+        }
+        break;
+    }
+    case LABEL_STMT:
+        // a case label is a join, nothing recorded before it holds after it
+        table->size = 0;
+        copyStmt(stmt->labelStmt->body, table);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            copyExpr(stmt->jumpStmt->expr, table, true);
+        }
+        break;
+    }
+}
+
+// replaces reads of a local copied from another with reads of the original, the copy is then usually dead
+void propagateCopies(FuncDef *func)
+{
+    if (!dceEnabled || func->body == NULL || containsGoto(func->body))
+    {
+        return;
+    }
+    collectSymbolsStmt(func->body, &addressTaken, COLLECT_ADDRESS_TAKEN);
+    CopyTable table = {NULL, 0, 0};
+    copyStmt(func->body, &table);
+    copyTableDestroy(&table);
+    symbolSetClear(&addressTaken);
+}
+
+// true if control can reach the end of a statement, loops and switches are assumed to
+static bool fallsThrough(const Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case JUMP_STMT:
+        return false;
+    case IF_STMT:
+        return stmt->ifStmt->falseBody == NULL || fallsThrough(stmt->ifStmt->trueBody) ||
+               fallsThrough(stmt->ifStmt->falseBody);
+    case COMPOUND_STMT:
+    {
+        const StatementList *stmtList = &stmt->compoundStmt->stmtList;
+        return stmtList->size == 0 || fallsThrough(stmtList->stmts[stmtList->size - 1]);
+    }
+    case LABEL_STMT:
+        return fallsThrough(stmt->labelStmt->body);
+    default:
+        return true;
+    }
+}
+
+// drops the statements after a return, break or continue up to the next label
+static void removeUnreachable(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        removeUnreachable(stmt->whileStmt->body);
+        break;
+    case FOR_STMT:
+        removeUnreachable(stmt->forStmt->body);
+        break;
+    case IF_STMT:
+        removeUnreachable(stmt->ifStmt->trueBody);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            removeUnreachable(stmt->ifStmt->falseBody);
+        }
+        break;
+    case SWITCH_STMT:
+        removeUnreachable(stmt->switchStmt->body);
+        break;
+    case LABEL_STMT:
+        removeUnreachable(stmt->labelStmt->body);
+        break;
+    case COMPOUND_STMT:
+    {
+        StatementList *stmtList = &stmt->compoundStmt->stmtList;
+        size_t kept = 0;
+        bool reachable = true;
+        for (size_t i = 0; i < stmtList->size; i++)
+        {
+            Stmt *current = stmtList->stmts[i];
+            if (!reachable && !containsLabel(current, false))
+            {
+                stmtDestroy(current);
+                continue;
+            }
+            removeUnreachable(current);
+            reachable = fallsThrough(current);
+            stmtList->stmts[kept++] = current;
+        }
+        stmtList->size = kept;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void symbolSetUnion(SymbolSet *set, const SymbolSet *other)
+{
+    for (size_t i = 0; i < other->size; i++)
+    {
+        symbolSetPush(set, other->entries[i]);
+    }
+}
+
+static SymbolSet symbolSetCopy(const SymbolSet *set)
+{
+    SymbolSet copy = {NULL, 0, 0};
+    symbolSetUnion(&copy, set);
+    return copy;
+}
+
+static void symbolSetRemove(SymbolSet *set, const SymbolEntry *symbolEntry)
+{
+    for (size_t i = 0; i < set->size; i++)
+    {
+        if (set->entries[i] == symbolEntry)
+        {
+            set->entries[i] = set->entries[--set->size];
+            return;
+        }
+    }
+}
+
+// replaces the contents of a set, the other set is consumed
+static void symbolSetMove(SymbolSet *set, SymbolSet *other)
+{
+    symbolSetClear(set);
+    *set = *other;
+    other->entries = NULL;
+    other->size = 0;
+    other->capacity = 0;
+}
+
+static JumpTarget *pushTarget(SymbolEntry *symbolEntry, const SymbolSet *out)
+{
+    if (targetsSize == targetsCapacity)
+    {
+        targetsCapacity = targetsCapacity == 0 ? 8 : targetsCapacity * 2;
+        targets = realloc(targets, sizeof(JumpTarget) * targetsCapacity);
+        if (targets == NULL)
+        {
+            abort();
+        }
+    }
+    JumpTarget *target = &targets[targetsSize++];
+    target->symbolEntry = symbolEntry;
+    target->breakLive = symbolSetCopy(out);
+    target->continueLive = (SymbolSet){NULL, 0, 0};
+    target->caseLive = (SymbolSet){NULL, 0, 0};
+    return target;
+}
+
+static void popTarget(void)
+{
+    JumpTarget *target = &targets[--targetsSize];
+    symbolSetClear(&target->breakLive);
+    symbolSetClear(&target->continueLive);
+    symbolSetClear(&target->caseLive);
+}
+
+// the target stack may grow while a target is in use, so it is found again by its entry
+static JumpTarget *findTarget(const SymbolEntry *symbolEntry)
+{
+    for (size_t i = targetsSize; i > 0; i--)
+    {
+        if (targets[i - 1].symbolEntry == symbolEntry)
+        {
+            return &targets[i - 1];
+        }
+    }
+    return NULL;
+}
+
+static void addReads(const Expr *expr, SymbolSet *live)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        if (isTracked(expr->variable->symbolEntry))
+        {
+            symbolSetPush(live, expr->variable->symbolEntry);
+        }
+        break;
+    case OPERATION_EXPR:
+        if (expr->operation->op1 != NULL)
+        {
+            addReads(expr->operation->op1, live);
+        }
+        if (expr->operation->op2 != NULL)
+        {
+            addReads(expr->operation->op2, live);
+        }
+        if (expr->operation->op3 != NULL)
+        {
+            addReads(expr->operation->op3, live);
+        }
+        break;
+    case ASSIGN_EXPR:
+        if (expr->assignment->lvalue == NULL && expr->assignment->operator!= NOT &&
+            isTracked(expr->assignment->symbolEntry))
+        {
+            symbolSetPush(live, expr->assignment->symbolEntry);
+        }
+        addReads(expr->assignment->op, live);
+        if (expr->assignment->lvalue != NULL)
+        {
+            addReads(expr->assignment->lvalue, live);
+        }
+        break;
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            addReads(expr->function->args[i], live);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// the local a statement level expression writes and nothing else needs, NULL if there is none
+static SymbolEntry *deadTarget(const Expr *expr, const SymbolSet *live)
+{
+    SymbolEntry *symbolEntry = NULL;
+    if (expr->type == ASSIGN_EXPR && expr->assignment->lvalue == NULL)
+    {
+        symbolEntry = expr->assignment->symbolEntry;
+    }
+    else if (expr->type == OPERATION_EXPR && expr->operation->op1 != NULL &&
+             expr->operation->op1->type == VARIABLE_EXPR &&
+             (expr->operation->operator== INC || expr->operation->operator== DEC ||
+              expr->operation->operator== INC_POST || expr->operation->operator== DEC_POST))
+    {
+        symbolEntry = expr->operation->op1->variable->symbolEntry;
+    }
+    return isTracked(symbolEntry) && !symbolSetContains(live, symbolEntry) ? symbolEntry : NULL;
+}
+
+// live holds what is live after the expression on entry and what is live before it on return
+static void liveExpr(const Expr *expr, SymbolSet *live)
+{
+    if (expr->type == ASSIGN_EXPR && expr->assignment->lvalue == NULL && expr->assignment->operator== NOT)
+    {
+        symbolSetRemove(live, expr->assignment->symbolEntry);
+    }
+    addReads(expr, live);
+}
+
+static void liveExprStmt(ExprStmt *exprStmt, SymbolSet *live, bool rewrite)
+{
+    if (exprStmt->expr == NULL)
+    {
+        return;
+    }
+    if (rewrite && !hasSideEffects(exprStmt->expr))
+    {
+        exprDestroy(exprStmt->expr);
+        exprStmt->expr = NULL;
+        return;
+    }
+    if (rewrite && deadTarget(exprStmt->expr, live) != NULL)
+    {
+        // only the side effects of the stored value are kept
+        Expr *expr = exprStmt->expr;
+        Expr *value = expr->type == ASSIGN_EXPR ? takeExpr(&expr->assignment->op) : NULL;
+        exprStmt->expr = value != NULL && hasSideEffects(value) ? value : NULL;
+        if (exprStmt->expr != value)
+        {
+            exprDestroy(value);
+        }
+        exprDestroy(expr);
+        if (exprStmt->expr == NULL)
+        {
+            return;
+        }
+    }
+    liveExpr(exprStmt->expr, live);
+}
+
+// what is live at the condition of a loop, given a guess that only grows until it is stable
+static void liveLoop(Stmt *stmt, const SymbolSet *out, SymbolSet *head, bool rewrite)
+{
+    SymbolSet next = symbolSetCopy(out);
+    if (stmt->type == WHILE_STMT)
+    {
+        WhileStmt *whileStmt = stmt->whileStmt;
+        JumpTarget *target = pushTarget(whileStmt->symbolEntry, out);
+        target->continueLive = symbolSetCopy(head);
+        SymbolSet body = symbolSetCopy(head);
+        liveStmt(whileStmt->body, &body, rewrite);
+        if (whileStmt->preheader != NULL)
+        {
+            SymbolSet preheader = symbolSetCopy(&body);
+            liveStmt(whileStmt->preheader, &preheader, rewrite);
+            symbolSetUnion(&next, &preheader);
+            symbolSetClear(&preheader);
+        }
+        symbolSetUnion(&next, &body);
+        addReads(whileStmt->condition, &next);
+        symbolSetClear(&body);
+        popTarget();
+    }
+    else
+    {
+        ForStmt *forStmt = stmt->forStmt;
+        SymbolSet modifier = symbolSetCopy(head);
+        if (forStmt->modifier != NULL)
+        {
+            liveExpr(forStmt->modifier, &modifier);
+        }
+        JumpTarget *target = pushTarget(forStmt->symbolEntry, out);
+        target->continueLive = symbolSetCopy(&modifier);
+        liveStmt(forStmt->body, &modifier, rewrite);
+        if (forStmt->preheader != NULL)
+        {
+            SymbolSet preheader = symbolSetCopy(&modifier);
+            liveStmt(forStmt->preheader, &preheader, rewrite);
+            symbolSetUnion(&next, &preheader);
+            symbolSetClear(&preheader);
+        }
+        symbolSetUnion(&next, &modifier);
+        liveStmt(forStmt->condition, &next, false);
+        symbolSetClear(&modifier);
+        popTarget();
+    }
+    symbolSetMove(head, &next);
+}
+
+static void liveStmt(Stmt *stmt, SymbolSet *live, bool rewrite)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+    case FOR_STMT:
+    {
+        // iterate to a fixed point before anything is removed, the sets only grow
+        SymbolSet head = symbolSetCopy(live);
+        size_t size;
+        do
+        {
+            size = head.size;
+            liveLoop(stmt, live, &head, false);
+        } while (head.size != size);
+        if (rewrite)
+        {
+            liveLoop(stmt, live, &head, true);
+        }
+
+        if (stmt->type == WHILE_STMT && stmt->whileStmt->doWhile)
+        {
+            // entered at the body rather than the condition
+            JumpTarget *target = pushTarget(stmt->whileStmt->symbolEntry, live);
+            target->continueLive = symbolSetCopy(&head);
+            SymbolSet body = symbolSetCopy(&head);
+            liveStmt(stmt->whileStmt->body, &body, false);
+            if (stmt->whileStmt->preheader != NULL)
+            {
+                liveStmt(stmt->whileStmt->preheader, &body, false);
+            }
+            popTarget();
+            symbolSetMove(&head, &body);
+        }
+        else if (stmt->type == FOR_STMT)
+        {
+            liveStmt(stmt->forStmt->init, &head, rewrite);
+        }
+        symbolSetMove(live, &head);
+        break;
+    }
+    case IF_STMT:
+    {
+        SymbolSet trueLive = symbolSetCopy(live);
+        liveStmt(stmt->ifStmt->trueBody, &trueLive, rewrite);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            liveStmt(stmt->ifStmt->falseBody, live, rewrite);
+        }
+        symbolSetUnion(live, &trueLive);
+        symbolSetClear(&trueLive);
+        addReads(stmt->ifStmt->condition, live);
+        break;
+    }
+    case SWITCH_STMT:
+    {
+        pushTarget(stmt->switchStmt->symbolEntry, live);
+        SymbolSet body = symbolSetCopy(live);
+        liveStmt(stmt->switchStmt->body, &body, rewrite);
+        symbolSetClear(&body);
+        // without a default the switch may jump straight to its end
+        symbolSetUnion(live, &findTarget(stmt->switchStmt->symbolEntry)->caseLive);
+        popTarget();
+        addReads(stmt->switchStmt->selector, live);
+        break;
+    }
+    case EXPR_STMT:
+        liveExprStmt(stmt->exprStmt, live, rewrite);
+        break;
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = compoundStmt->stmtList.size; i > 0; i--)
+        {
+            liveStmt(compoundStmt->stmtList.stmts[i - 1], live, rewrite);
+        }
+        for (size_t i = compoundStmt->declList.size; i > 0; i--)
+        {
+            Decl *decl = compoundStmt->declList.decls[i - 1];
+            Expr *initExpr = decl->declInit != NULL ? decl->declInit->initExpr : NULL;
+            if (rewrite && initExpr != NULL && isTracked(decl->symbolEntry) &&
+                !symbolSetContains(live, decl->symbolEntry) && !hasSideEffects(initExpr))
+            {
+                exprDestroy(initExpr);
+                decl->declInit->initExpr = NULL;
+                initExpr = NULL;
+            }
+            symbolSetRemove(live, decl->symbolEntry);
+            if (initExpr != NULL)
+            {
+                addReads(initExpr, live);
+            }
+        }
+        break;
+    }
+    case LABEL_STMT:
+    {
+        LabelStmt *labelStmt = stmt->labelStmt;
+        liveStmt(labelStmt->body, live, rewrite);
+        JumpTarget *target = findTarget(labelStmt->symbolEntry);
+        if (labelStmt->ident == NULL && target != NULL)
+        {
+            symbolSetUnion(&target->caseLive, live);
+        }
+        break;
+    }
+    case JUMP_STMT:
+    {
+        JumpStmt *jumpStmt = stmt->jumpStmt;
+        JumpTarget *target = findTarget(jumpStmt->symbolEntry);
+        SymbolSet next = {NULL, 0, 0};
+        if (jumpStmt->type == BREAK_JUMP && target != NULL)
+        {
+            next = symbolSetCopy(&target->breakLive);
+        }
+        else if (jumpStmt->type == CONTINUE_JUMP && target != NULL)
+        {
+            next = symbolSetCopy(&target->continueLive);
+        }
+        if (jumpStmt->expr != NULL)
+        {
+            addReads(jumpStmt->expr, &next);
+        }
+        symbolSetMove(live, &next);
+        break;
+    }
+    }
+}
+
+// removes code after jumps, then stores to locals that are never read again, by a backward liveness pass over
+// the structured statements
+void eliminateDeadCode(FuncDef *func)
+{
+    if (!dceEnabled || func->body == NULL || containsGoto(func->body))
+    {
+        return;
+    }
+    removeUnreachable(func->body);
+    collectSymbolsStmt(func->body, &addressTaken, COLLECT_ADDRESS_TAKEN);
+    SymbolSet live = {NULL, 0, 0};
+    liveStmt(func->body, &live, true);
+    symbolSetClear(&live);
+    symbolSetClear(&addressTaken);
+
+    free(targets);
+    targets = NULL;
+    targetsCapacity = 0;
+}
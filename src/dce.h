@@ -0,0 +1,13 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+extern bool dceEnabled;
+
+void propagateCopies(FuncDef *func);
+void eliminateDeadCode(FuncDef *func);
+
+#endif
@@ -0,0 +1,727 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "inline.h"
+#include "loop.h"
+#include "optimise.h"
+#include "profile.h"
+#include "symbol.h"
+
+// inlining knobs, set from the command line, a call costs the argument moves, 38 saves and restores
+// and the call itself, so a body up to inlineLimit nodes is taken to be cheaper than calling it
+bool inlineEnabled = true;
+size_t inlineLimit = 40;   // largest callee body copied into a caller, in AST nodes
+size_t inlineBudget = 400; // growth allowed per function, in AST nodes
+
+typedef enum
+{
+    DISCARD_RESULT, // f(args);
+    ASSIGN_RESULT,  // x = f(args);
+    RETURN_RESULT   // return f(args);
+} ResultUse;
+
+// What a callee looks like to the cost model
+typedef struct CalleeShape
+{
+    size_t size;     // AST nodes
+    size_t returns;  // return statements
+    bool recursive;  // calls itself
+    bool copyable;   // every local can be given a slot in the caller
+} CalleeShape;
+
+// One call being expanded, the entries of the callee are renamed to fresh ones owned by the caller
+typedef struct Expansion
+{
+    FuncDef *caller;
+    SymbolEntry **from;
+    SymbolEntry **to;
+    size_t size;
+    size_t capacity;
+    ResultUse use;
+    SymbolEntry *target; // assigned the result for ASSIGN_RESULT
+    SymbolEntry *exit;   // loop the body is wrapped in so returns can leave it early, can be NULL
+} Expansion;
+
+typedef struct InlineState
+{
+    TranslationUnit *transUnit;
+    size_t index; // the caller, definitions before it have already been optimised and can be copied
+    FuncDef *caller;
+    size_t growth; // AST nodes added to the caller so far
+} InlineState;
+
+static Stmt *copyStmt(const Stmt *stmt, Expansion *expansion);
+static void inlineExpr(Expr *expr, InlineState *state);
+
+static bool isScalarType(DataType type)
+{
+    return type == INT_TYPE || type == CHAR_TYPE || type == FLOAT_TYPE;
+}
+
+static size_t paramCount(const FuncDef *func)
+{
+    return func->isParam ? func->args.size : 0;
+}
+
+static bool callsExpr(const Expr *expr, const char *ident)
+{
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+        return (expr->operation->op1 != NULL && callsExpr(expr->operation->op1, ident)) ||
+               (expr->operation->op2 != NULL && callsExpr(expr->operation->op2, ident)) ||
+               (expr->operation->op3 != NULL && callsExpr(expr->operation->op3, ident));
+    case ASSIGN_EXPR:
+        return callsExpr(expr->assignment->op, ident) ||
+               (expr->assignment->lvalue != NULL && callsExpr(expr->assignment->lvalue, ident));
+    case FUNC_EXPR:
+        if (strcmp(expr->function->ident, ident) == 0)
+        {
+            return true;
+        }
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            if (callsExpr(expr->function->args[i], ident))
+            {
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+static void measureExpr(const Expr *expr, const char *ident, CalleeShape *shape)
+{
+    if (expr != NULL)
+    {
+        shape->size += exprSize(expr);
+        shape->recursive = shape->recursive || callsExpr(expr, ident);
+    }
+}
+
+static void measureStmt(const Stmt *stmt, const char *ident, CalleeShape *shape)
+{
+    shape->size++;
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        measureExpr(stmt->whileStmt->condition, ident, shape);
+        measureStmt(stmt->whileStmt->body, ident, shape);
+        if (stmt->whileStmt->preheader != NULL)
+        {
+            measureStmt(stmt->whileStmt->preheader, ident, shape);
+        }
+        break;
+    case FOR_STMT:
+        measureStmt(stmt->forStmt->init, ident, shape);
+        measureStmt(stmt->forStmt->condition, ident, shape);
+        measureExpr(stmt->forStmt->modifier, ident, shape);
+        measureStmt(stmt->forStmt->body, ident, shape);
+        if (stmt->forStmt->preheader != NULL)
+        {
+            measureStmt(stmt->forStmt->preheader, ident, shape);
+        }
+        break;
+    case IF_STMT:
+        measureExpr(stmt->ifStmt->condition, ident, shape);
+        measureStmt(stmt->ifStmt->trueBody, ident, shape);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            measureStmt(stmt->ifStmt->falseBody, ident, shape);
+        }
+        break;
+    case SWITCH_STMT:
+        measureExpr(stmt->switchStmt->selector, ident, shape);
+        measureStmt(stmt->switchStmt->body, ident, shape);
+        break;
+    case EXPR_STMT:
+        measureExpr(stmt->exprStmt->expr, ident, shape);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->declList.size; i++)
+        {
+            Decl *decl = stmt->compoundStmt->declList.decls[i];
+            SymbolEntry *symbolEntry = decl->symbolEntry;
+            Expr *initExpr = decl->declInit == NULL ? NULL : decl->declInit->initExpr;
+            if (symbolEntry == NULL || symbolEntry->entryType != VARIABLE_ENTRY || symbolEntry->type.isStruct ||
+                (decl->declInit != NULL && decl->declInit->initList != NULL) ||
+                (initExpr != NULL && !isScalarType(symbolEntry->type.dataType)))
+            {
+                shape->copyable = false;
+            }
+            measureExpr(initExpr, ident, shape);
+        }
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            measureStmt(stmt->compoundStmt->stmtList.stmts[i], ident, shape);
+        }
+        break;
+    case LABEL_STMT:
+        if (stmt->labelStmt->ident != NULL)
+        {
+            shape->copyable = false;
+        }
+        measureStmt(stmt->labelStmt->body, ident, shape);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->type == GOTO_JUMP)
+        {
+            shape->copyable = false;
+        }
+        if (stmt->jumpStmt->type == RETURN_JUMP)
+        {
+            shape->returns++;
+        }
+        measureExpr(stmt->jumpStmt->expr, ident, shape);
+        break;
+    }
+}
+
+static FuncDef *findCallee(const InlineState *state, const char *ident)
+{
+    for (size_t i = 0; i < state->index; i++)
+    {
+        ExternDecl *externDecl = state->transUnit->externDecls[i];
+        if (externDecl->isFunc && !externDecl->funcDef->isPrototype && externDecl->funcDef->body != NULL &&
+            strcmp(externDecl->funcDef->ident, ident) == 0)
+        {
+            return externDecl->funcDef;
+        }
+    }
+    return NULL;
+}
+
+// the callee of a call that is small, not recursive and passes only values an assignment handles
+static FuncDef *inlinableCallee(const FuncExpr *call, InlineState *state, CalleeShape *shape)
+{
+    FuncDef *callee = findCallee(state, call->ident);
+    if (callee == NULL || callee == state->caller || callee->symbolEntry == NULL || callee->ptrCount != 0 ||
+        callee->symbolEntry->type.isStruct ||
+        (callee->symbolEntry->type.dataType != VOID_TYPE && !isScalarType(callee->symbolEntry->type.dataType)) ||
+        call->argsSize != paramCount(callee) || isColdFunc(callee->ident))
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < call->argsSize; i++)
+    {
+        SymbolEntry *param = callee->args.decls[i]->symbolEntry;
+        if (param == NULL || param->entryType != VARIABLE_ENTRY || param->type.isStruct ||
+            !isScalarType(param->type.dataType) || returnType(call->args[i]) != param->type.dataType)
+        {
+            return NULL;
+        }
+    }
+
+    *shape = (CalleeShape){0, 0, false, true};
+    measureStmt(callee->body, callee->ident, shape);
+    if (shape->recursive || !shape->copyable || shape->size > inlineLimit || state->growth + shape->size > inlineBudget)
+    {
+        return NULL;
+    }
+    return callee;
+}
+
+// the entry of the caller standing in for an entry of the callee, globals and functions are shared
+static SymbolEntry *mapEntry(Expansion *expansion, SymbolEntry *symbolEntry)
+{
+    if (symbolEntry == NULL || symbolEntry->isGlobal)
+    {
+        return symbolEntry;
+    }
+    for (size_t i = 0; i < expansion->size; i++)
+    {
+        if (expansion->from[i] == symbolEntry)
+        {
+            return expansion->to[i];
+        }
+    }
+
+    SymbolEntry *fresh;
+    switch (symbolEntry->entryType)
+    {
+    case VARIABLE_ENTRY:
+        fresh = createTemp(expansion->caller->symbolEntry, symbolEntry->type.dataType);
+        break;
+    case WHILE_ENTRY:
+        fresh = whileEntryCreate();
+        registerEntry(fresh);
+        break;
+    case FOR_ENTRY:
+        fresh = forEntryCreate();
+        registerEntry(fresh);
+        break;
+    case SWITCH_ENTRY:
+        fresh = switchEntryCreate();
+        registerEntry(fresh);
+        break;
+    default:
+        return symbolEntry;
+    }
+
+    if (expansion->size == expansion->capacity)
+    {
+        expansion->capacity = expansion->capacity == 0 ? 8 : expansion->capacity * 2;
+        expansion->from = realloc(expansion->from, sizeof(SymbolEntry *) * expansion->capacity);
+        expansion->to = realloc(expansion->to, sizeof(SymbolEntry *) * expansion->capacity);
+        if (expansion->from == NULL || expansion->to == NULL)
+        {
+            abort();
+        }
+    }
+    expansion->from[expansion->size] = symbolEntry;
+    expansion->to[expansion->size] = fresh;
+    expansion->size++;
+    return fresh;
+}
+
+static void renameIdent(char **ident, const SymbolEntry *symbolEntry)
+{
+    free(*ident);
+    *ident = copyIdent(symbolEntry->ident);
+}
+
+static void remapExpr(Expr *expr, Expansion *expansion)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        SymbolEntry *symbolEntry = mapEntry(expansion, expr->variable->symbolEntry);
+        if (symbolEntry != expr->variable->symbolEntry)
+        {
+            expr->variable->symbolEntry = symbolEntry;
+            renameIdent(&expr->variable->ident, symbolEntry);
+        }
+        break;
+    }
+    case OPERATION_EXPR:
+        if (expr->operation->op1 != NULL)
+        {
+            remapExpr(expr->operation->op1, expansion);
+        }
+        if (expr->operation->op2 != NULL)
+        {
+            remapExpr(expr->operation->op2, expansion);
+        }
+        if (expr->operation->op3 != NULL)
+        {
+            remapExpr(expr->operation->op3, expansion);
+        }
+        break;
+    case ASSIGN_EXPR:
+    {
+        SymbolEntry *symbolEntry = mapEntry(expansion, expr->assignment->symbolEntry);
+        if (symbolEntry != expr->assignment->symbolEntry)
+        {
+            expr->assignment->symbolEntry = symbolEntry;
+            renameIdent(&expr->assignment->ident, symbolEntry);
+        }
+        remapExpr(expr->assignment->op, expansion);
+        if (expr->assignment->lvalue != NULL)
+        {
+            remapExpr(expr->assignment->lvalue, expansion);
+        }
+        break;
+    }
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            remapExpr(expr->function->args[i], expansion);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static Expr *copyExpr(const Expr *expr, Expansion *expansion)
+{
+    Expr *copy = exprCopy(expr);
+    if (copy != NULL)
+    {
+        remapExpr(copy, expansion);
+    }
+    return copy;
+}
+
+// return x -> { result = x; break; }, the break is left out when the return is the last statement
+static Stmt *expandReturn(const JumpStmt *jumpStmt, Expansion *expansion)
+{
+    Expr *value = copyExpr(jumpStmt->expr, expansion);
+    if (expansion->use == RETURN_RESULT)
+    {
+        Stmt *stmt = stmtCreate(JUMP_STMT);
+        stmt->jumpStmt = jumpStmtCreate(RETURN_JUMP);
+        stmt->jumpStmt->expr = value;
+        return stmt;
+    }
+
+    Stmt *result;
+    if (value != NULL && expansion->use == ASSIGN_RESULT)
+    {
+        result = assignEntryStmt(expansion->target, value);
+    }
+    else
+    {
+        result = emptyStmt(EXPR_STMT);
+        result->exprStmt->expr = value;
+    }
+    if (expansion->exit == NULL)
+    {
+        return result;
+    }
+    Stmt *stmt = emptyStmt(COMPOUND_STMT);
+    statementListPush(&stmt->compoundStmt->stmtList, result);
+    statementListPush(&stmt->compoundStmt->stmtList, loopJump(BREAK_JUMP, expansion->exit));
+    return stmt;
+}
+
+// deep copy with the locals, loops and switches of the callee renamed, declarations become assignments
+static Stmt *copyStmt(const Stmt *stmt, Expansion *expansion)
+{
+    Stmt *copy = stmtCreate(stmt->type);
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+    {
+        WhileStmt *whileStmt = stmt->whileStmt;
+        copy->whileStmt = whileStmtCreate(copyExpr(whileStmt->condition, expansion), copyStmt(whileStmt->body, expansion),
+                                          whileStmt->doWhile);
+        copy->whileStmt->symbolEntry = mapEntry(expansion, whileStmt->symbolEntry);
+        if (whileStmt->preheader != NULL)
+        {
+            copy->whileStmt->preheader = copyStmt(whileStmt->preheader, expansion);
+        }
+        break;
+    }
+    case FOR_STMT:
+    {
+        ForStmt *forStmt = stmt->forStmt;
+        copy->forStmt = forStmtCreate(copyStmt(forStmt->init, expansion), copyStmt(forStmt->condition, expansion),
+                                      copyStmt(forStmt->body, expansion));
+        copy->forStmt->modifier = copyExpr(forStmt->modifier, expansion);
+        copy->forStmt->symbolEntry = mapEntry(expansion, forStmt->symbolEntry);
+        if (forStmt->preheader != NULL)
+        {
+            copy->forStmt->preheader = copyStmt(forStmt->preheader, expansion);
+        }
+        break;
+    }
+    case IF_STMT:
+        copy->ifStmt = ifStmtCreate(copyExpr(stmt->ifStmt->condition, expansion), copyStmt(stmt->ifStmt->trueBody, expansion));
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            copy->ifStmt->falseBody = copyStmt(stmt->ifStmt->falseBody, expansion);
+        }
+        break;
+    case SWITCH_STMT:
+        copy->switchStmt = switchStmtCreate(copyExpr(stmt->switchStmt->selector, expansion),
+                                            copyStmt(stmt->switchStmt->body, expansion));
+        copy->switchStmt->symbolEntry = mapEntry(expansion, stmt->switchStmt->symbolEntry);
+        break;
+    case EXPR_STMT:
+        copy->exprStmt = exprStmtCreate();
+        copy->exprStmt->expr = copyExpr(stmt->exprStmt->expr, expansion);
+        break;
+    case COMPOUND_STMT:
+    {
+        copy->compoundStmt = compoundStmtCreate();
+        for (size_t i = 0; i < stmt->compoundStmt->declList.size; i++)
+        {
+            Decl *decl = stmt->compoundStmt->declList.decls[i];
+            SymbolEntry *local = mapEntry(expansion, decl->symbolEntry);
+            if (decl->declInit != NULL && decl->declInit->initExpr != NULL)
+            {
+                statementListPush(&copy->compoundStmt->stmtList,
+                                  assignEntryStmt(local, copyExpr(decl->declInit->initExpr, expansion)));
+            }
+        }
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            statementListPush(&copy->compoundStmt->stmtList, copyStmt(stmt->compoundStmt->stmtList.stmts[i], expansion));
+        }
+        break;
+    }
+    case LABEL_STMT:
+        copy->labelStmt = labelStmtCreate(copyStmt(stmt->labelStmt->body, expansion));
+        copy->labelStmt->caseLabel = exprCopy(stmt->labelStmt->caseLabel);
+        copy->labelStmt->symbolEntry = mapEntry(expansion, stmt->labelStmt->symbolEntry);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->type == RETURN_JUMP)
+        {
+            free(copy);
+            return expandReturn(stmt->jumpStmt, expansion);
+        }
+        copy->jumpStmt = jumpStmtCreate(stmt->jumpStmt->type);
+        copy->jumpStmt->symbolEntry = mapEntry(expansion, stmt->jumpStmt->symbolEntry);
+        break;
+    }
+    return copy;
+}
+
+static bool endsWithReturn(const Stmt *body)
+{
+    const StatementList *stmtList = &body->compoundStmt->stmtList;
+    if (stmtList->size == 0)
+    {
+        return false;
+    }
+    const Stmt *last = stmtList->stmts[stmtList->size - 1];
+    return last->type == JUMP_STMT && last->jumpStmt->type == RETURN_JUMP;
+}
+
+// { params = args; while (1) { body; break; } }, the loop is only needed if a return has to leave early
+static Stmt *expandCall(FuncDef *callee, FuncExpr *call, const CalleeShape *shape, Expansion *expansion)
+{
+    Stmt *expanded = emptyStmt(COMPOUND_STMT);
+    for (size_t i = 0; i < call->argsSize; i++)
+    {
+        SymbolEntry *param = mapEntry(expansion, callee->args.decls[i]->symbolEntry);
+        statementListPush(&expanded->compoundStmt->stmtList, assignEntryStmt(param, takeExpr(&call->args[i])));
+    }
+    bool leavesEarly = shape->returns > 1 || (shape->returns == 1 && !endsWithReturn(callee->body));
+    if (expansion->use == RETURN_RESULT || !leavesEarly)
+    {
+        statementListPush(&expanded->compoundStmt->stmtList, copyStmt(callee->body, expansion));
+        return expanded;
+    }
+
+    expansion->exit = whileEntryCreate();
+    registerEntry(expansion->exit);
+    Stmt *iteration = emptyStmt(COMPOUND_STMT);
+    statementListPush(&iteration->compoundStmt->stmtList, copyStmt(callee->body, expansion));
+    statementListPush(&iteration->compoundStmt->stmtList, loopJump(BREAK_JUMP, expansion->exit));
+    Stmt *loop = stmtCreate(WHILE_STMT);
+    loop->whileStmt = whileStmtCreate(intConstantExpr(1), iteration, false);
+    loop->whileStmt->symbolEntry = expansion->exit;
+    statementListPush(&expanded->compoundStmt->stmtList, loop);
+    return expanded;
+}
+
+// f(args);, x = f(args); and return f(args); take the whole body of the callee
+static bool inlineCallStmt(Stmt *stmt, InlineState *state)
+{
+    Expansion expansion = {state->caller, NULL, NULL, 0, 0, DISCARD_RESULT, NULL, NULL};
+    Expr *call = NULL;
+    DataType resultType = VOID_TYPE;
+    if (stmt->type == EXPR_STMT && stmt->exprStmt->expr != NULL)
+    {
+        Expr *expr = stmt->exprStmt->expr;
+        if (expr->type == FUNC_EXPR)
+        {
+            call = expr;
+        }
+        else if (expr->type == ASSIGN_EXPR && expr->assignment->lvalue == NULL && expr->assignment->operator== NOT &&
+                 expr->assignment->op->type == FUNC_EXPR && expr->assignment->symbolEntry != NULL &&
+                 expr->assignment->symbolEntry->entryType == VARIABLE_ENTRY)
+        {
+            call = expr->assignment->op;
+            expansion.use = ASSIGN_RESULT;
+            expansion.target = expr->assignment->symbolEntry;
+            resultType = expr->assignment->type;
+        }
+    }
+    else if (stmt->type == JUMP_STMT && stmt->jumpStmt->type == RETURN_JUMP && stmt->jumpStmt->expr != NULL &&
+             stmt->jumpStmt->expr->type == FUNC_EXPR && state->caller->ptrCount == 0)
+    {
+        call = stmt->jumpStmt->expr;
+        expansion.use = RETURN_RESULT;
+        resultType = state->caller->symbolEntry->type.dataType;
+    }
+    if (call == NULL)
+    {
+        return false;
+    }
+
+    CalleeShape shape;
+    FuncDef *callee = inlinableCallee(call->function, state, &shape);
+    if (callee == NULL || (expansion.use != DISCARD_RESULT && callee->symbolEntry->type.dataType != resultType))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < call->function->argsSize; i++)
+    {
+        inlineExpr(call->function->args[i], state);
+    }
+    Stmt *expanded = expandCall(callee, call->function, &shape, &expansion);
+    state->growth += shape.size;
+    noteInlined(callee->ident);
+    free(expansion.from);
+    free(expansion.to);
+
+    Stmt *old = stmtCreate(stmt->type);
+    *old = *stmt;
+    stmtDestroy(old);
+    *stmt = *expanded;
+    free(expanded);
+    return true;
+}
+
+// a callee that is just return x can go anywhere an expression can: f(a, b) -> (p = a, (q = b, x))
+static void inlineExpr(Expr *expr, InlineState *state)
+{
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+        if (expr->operation->op1 != NULL)
+        {
+            inlineExpr(expr->operation->op1, state);
+        }
+        if (expr->operation->op2 != NULL)
+        {
+            inlineExpr(expr->operation->op2, state);
+        }
+        if (expr->operation->op3 != NULL)
+        {
+            inlineExpr(expr->operation->op3, state);
+        }
+        return;
+    case ASSIGN_EXPR:
+        inlineExpr(expr->assignment->op, state);
+        if (expr->assignment->lvalue != NULL)
+        {
+            inlineExpr(expr->assignment->lvalue, state);
+        }
+        return;
+    case FUNC_EXPR:
+        break;
+    default:
+        return;
+    }
+
+    FuncExpr *call = expr->function;
+    for (size_t i = 0; i < call->argsSize; i++)
+    {
+        inlineExpr(call->args[i], state);
+    }
+    CalleeShape shape;
+    FuncDef *callee = inlinableCallee(call, state, &shape);
+    if (callee == NULL || callee->body->compoundStmt->declList.size != 0 || callee->body->compoundStmt->stmtList.size != 1 ||
+        !endsWithReturn(callee->body) || callee->body->compoundStmt->stmtList.stmts[0]->jumpStmt->expr == NULL)
+    {
+        return;
+    }
+    for (size_t i = 0; i < call->argsSize; i++)
+    {
+        // the comma operator evaluates its left side into an integer register
+        if (returnType(call->args[i]) == FLOAT_TYPE)
+        {
+            return;
+        }
+    }
+
+    Expansion expansion = {state->caller, NULL, NULL, 0, 0, DISCARD_RESULT, NULL, NULL};
+    SymbolEntry **params = malloc(sizeof(SymbolEntry *) * (call->argsSize + 1));
+    if (params == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < call->argsSize; i++)
+    {
+        params[i] = mapEntry(&expansion, callee->args.decls[i]->symbolEntry);
+    }
+    Expr *value = copyExpr(callee->body->compoundStmt->stmtList.stmts[0]->jumpStmt->expr, &expansion);
+    for (size_t i = call->argsSize; i > 0; i--)
+    {
+        Expr *assign = assignEntryExpr(params[i - 1], takeExpr(&call->args[i - 1]));
+        value = operationCreate(COMMA_OP, returnType(value), assign, value);
+    }
+    free(params);
+    free(expansion.from);
+    free(expansion.to);
+    state->growth += shape.size;
+    noteInlined(callee->ident);
+
+    clearExpr(expr);
+    *expr = *value;
+    free(value);
+}
+
+static void inlineStmt(Stmt *stmt, InlineState *state)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        if (stmt->whileStmt->preheader != NULL)
+        {
+            inlineStmt(stmt->whileStmt->preheader, state);
+        }
+        inlineExpr(stmt->whileStmt->condition, state);
+        inlineStmt(stmt->whileStmt->body, state);
+        break;
+    case FOR_STMT:
+        if (stmt->forStmt->preheader != NULL)
+        {
+            inlineStmt(stmt->forStmt->preheader, state);
+        }
+        inlineStmt(stmt->forStmt->init, state);
+        inlineStmt(stmt->forStmt->condition, state);
+        inlineStmt(stmt->forStmt->body, state);
+        if (stmt->forStmt->modifier != NULL)
+        {
+            inlineExpr(stmt->forStmt->modifier, state);
+        }
+        break;
+    case IF_STMT:
+        inlineExpr(stmt->ifStmt->condition, state);
+        inlineStmt(stmt->ifStmt->trueBody, state);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            inlineStmt(stmt->ifStmt->falseBody, state);
+        }
+        break;
+    case SWITCH_STMT:
+        inlineExpr(stmt->switchStmt->selector, state);
+        inlineStmt(stmt->switchStmt->body, state);
+        break;
+    case EXPR_STMT:
+        if (!inlineCallStmt(stmt, state) && stmt->exprStmt->expr != NULL)
+        {
+            inlineExpr(stmt->exprStmt->expr, state);
+        }
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->declList.size; i++)
+        {
+            Decl *decl = stmt->compoundStmt->declList.decls[i];
+            if (decl->declInit != NULL && decl->declInit->initExpr != NULL)
+            {
+                inlineExpr(decl->declInit->initExpr, state);
+            }
+        }
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            inlineStmt(stmt->compoundStmt->stmtList.stmts[i], state);
+        }
+        break;
+    case LABEL_STMT:
+        inlineStmt(stmt->labelStmt->body, state);
+        break;
+    case JUMP_STMT:
+        if (!inlineCallStmt(stmt, state) && stmt->jumpStmt->expr != NULL)
+        {
+            inlineExpr(stmt->jumpStmt->expr, state);
+        }
+        break;
+    }
+}
+
+// copies small non-recursive functions defined earlier in the file into the function at index,
+// their locals get slots in its frame
+void inlineCalls(TranslationUnit *transUnit, size_t index)
+{
+    FuncDef *caller = transUnit->externDecls[index]->funcDef;
+    // growing a function the profile says never runs only costs code size
+    if (!inlineEnabled || caller->body == NULL || caller->symbolEntry == NULL || isColdFunc(caller->ident))
+    {
+        return;
+    }
+    InlineState state = {transUnit, index, caller, 0};
+    inlineStmt(caller->body, &state);
+}
@@ -0,0 +1,15 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ast.h"
+
+extern bool inlineEnabled;
+extern size_t inlineLimit;
+extern size_t inlineBudget;
+
+void inlineCalls(TranslationUnit *transUnit, size_t index);
+
+#endif
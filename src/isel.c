@@ -0,0 +1,404 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ast.h"
+#include "codegen.h"
+#include "isel.h"
+#include "peephole.h"
+
+#define INTEGER_CLASSES (INT_CLASS | UINT_CLASS | PTR_CLASS)
+#define UNSIGNED_CLASSES (UINT_CLASS | PTR_CLASS)
+#define ARITH_CLASSES (INT_CLASS | UINT_CLASS)
+#define ALL_CLASSES (INTEGER_CLASSES | FLOAT_CLASS | DOUBLE_CLASS)
+
+#define NO_COST (INT_MAX / 4)
+#define TEXT_LENGTH 32
+
+// The RV32IMFD machine description. Costs are rough latencies, the selector picks the cheapest tiling, so
+// a constant operand that fits an immediate beats loading it, and a comparison feeding a branch fuses into it.
+// Adding an instruction is adding a row, operators with no row for a type fall back to compileOperationExpr.
+static const Rule rules[] = {
+    {NT_REG, ADD, false, ARITH_CLASSES, {NT_REG, NT_REG}, 1, "add %d, %1, %2"},
+    {NT_REG, ADD, false, ARITH_CLASSES, {NT_REG, NT_IMM}, 1, "addi %d, %1, %2"},
+    {NT_REG, ADD, false, ARITH_CLASSES, {NT_IMM, NT_REG}, 1, "addi %d, %2, %1"},
+    {NT_REG, ADD, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "fadd.s %d, %1, %2"},
+    {NT_REG, ADD, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "fadd.d %d, %1, %2"},
+
+    {NT_REG, SUB, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "sub %d, %1, %2"},
+    {NT_REG, SUB, false, INTEGER_CLASSES, {NT_REG, NT_NEGIMM}, 1, "addi %d, %1, %2"},
+    {NT_REG, SUB, false, INTEGER_CLASSES, {NT_ZERO, NT_REG}, 1, "neg %d, %2"},
+    {NT_REG, SUB, false, INTEGER_CLASSES, {NT_REG, NT_NONE}, 1, "neg %d, %1"},
+    {NT_REG, SUB, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "fsub.s %d, %1, %2"},
+    {NT_REG, SUB, false, FLOAT_CLASS, {NT_REG, NT_NONE}, 1, "fneg.s %d, %1"},
+    {NT_REG, SUB, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "fsub.d %d, %1, %2"},
+    {NT_REG, SUB, false, DOUBLE_CLASS, {NT_REG, NT_NONE}, 1, "fneg.d %d, %1"},
+
+    {NT_REG, MUL, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 3, "mul %d, %1, %2"},
+    {NT_REG, MUL, false, INTEGER_CLASSES, {NT_REG, NT_POW2}, 1, "slli %d, %1, %2"},
+    {NT_REG, MUL, false, INTEGER_CLASSES, {NT_POW2, NT_REG}, 1, "slli %d, %2, %1"},
+    {NT_REG, MUL, false, FLOAT_CLASS, {NT_REG, NT_REG}, 5, "fmul.s %d, %1, %2"},
+    {NT_REG, MUL, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 5, "fmul.d %d, %1, %2"},
+
+    {NT_REG, DIV, false, INT_CLASS, {NT_REG, NT_REG}, 20, "div %d, %1, %2"},
+    {NT_REG, DIV, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 20, "divu %d, %1, %2"},
+    {NT_REG, DIV, false, UNSIGNED_CLASSES, {NT_REG, NT_POW2}, 1, "srli %d, %1, %2"},
+    {NT_REG, DIV, false, FLOAT_CLASS, {NT_REG, NT_REG}, 20, "fdiv.s %d, %1, %2"},
+    {NT_REG, DIV, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 30, "fdiv.d %d, %1, %2"},
+
+    {NT_REG, MOD, false, INT_CLASS, {NT_REG, NT_REG}, 20, "rem %d, %1, %2"},
+    {NT_REG, MOD, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 20, "remu %d, %1, %2"},
+
+    {NT_REG, AND_BIT, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "and %d, %1, %2"},
+    {NT_REG, AND_BIT, false, INTEGER_CLASSES, {NT_REG, NT_IMM}, 1, "andi %d, %1, %2"},
+    {NT_REG, AND_BIT, false, INTEGER_CLASSES, {NT_IMM, NT_REG}, 1, "andi %d, %2, %1"},
+    {NT_REG, OR_BIT, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "or %d, %1, %2"},
+    {NT_REG, OR_BIT, false, INTEGER_CLASSES, {NT_REG, NT_IMM}, 1, "ori %d, %1, %2"},
+    {NT_REG, OR_BIT, false, INTEGER_CLASSES, {NT_IMM, NT_REG}, 1, "ori %d, %2, %1"},
+    {NT_REG, XOR, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "xor %d, %1, %2"},
+    {NT_REG, XOR, false, INTEGER_CLASSES, {NT_REG, NT_IMM}, 1, "xori %d, %1, %2"},
+    {NT_REG, XOR, false, INTEGER_CLASSES, {NT_IMM, NT_REG}, 1, "xori %d, %2, %1"},
+    {NT_REG, NOT_BIT, false, INTEGER_CLASSES, {NT_REG, NT_NONE}, 1, "not %d, %1"},
+
+    {NT_REG, LEFT_SHIFT, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "sll %d, %1, %2"},
+    {NT_REG, LEFT_SHIFT, false, INTEGER_CLASSES, {NT_REG, NT_SHAMT}, 1, "slli %d, %1, %2"},
+    {NT_REG, RIGHT_SHIFT, false, INT_CLASS, {NT_REG, NT_REG}, 1, "sra %d, %1, %2"},
+    {NT_REG, RIGHT_SHIFT, false, INT_CLASS, {NT_REG, NT_SHAMT}, 1, "srai %d, %1, %2"},
+    {NT_REG, RIGHT_SHIFT, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "srl %d, %1, %2"},
+    {NT_REG, RIGHT_SHIFT, false, UNSIGNED_CLASSES, {NT_REG, NT_SHAMT}, 1, "srli %d, %1, %2"},
+
+    // logical operators take any scalar, compared against zero
+    {NT_REG, NOT, false, ALL_CLASSES, {NT_REG, NT_NONE}, 1, "seqz %d, %1"},
+    {NT_REG, AND, false, ALL_CLASSES, {NT_REG, NT_REG}, 3, "snez %1, %1\nsnez %2, %2\nand %d, %1, %2"},
+    {NT_REG, OR, false, ALL_CLASSES, {NT_REG, NT_REG}, 2, "or %d, %1, %2\nsnez %d, %d"},
+
+    // comparisons are classed by their operands
+    {NT_REG, EQ, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 2, "sub %d, %1, %2\nseqz %d, %d"},
+    {NT_REG, EQ, false, INTEGER_CLASSES, {NT_REG, NT_IMM}, 2, "xori %d, %1, %2\nseqz %d, %d"},
+    {NT_REG, EQ, false, INTEGER_CLASSES, {NT_REG, NT_ZERO}, 1, "seqz %d, %1"},
+    {NT_REG, NE, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 2, "sub %d, %1, %2\nsnez %d, %d"},
+    {NT_REG, NE, false, INTEGER_CLASSES, {NT_REG, NT_IMM}, 2, "xori %d, %1, %2\nsnez %d, %d"},
+    {NT_REG, NE, false, INTEGER_CLASSES, {NT_REG, NT_ZERO}, 1, "snez %d, %1"},
+    {NT_REG, LT, false, INT_CLASS, {NT_REG, NT_REG}, 1, "slt %d, %1, %2"},
+    {NT_REG, LT, false, INT_CLASS, {NT_REG, NT_IMM}, 1, "slti %d, %1, %2"},
+    {NT_REG, LT, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "sltu %d, %1, %2"},
+    {NT_REG, LT, false, UNSIGNED_CLASSES, {NT_REG, NT_IMM}, 1, "sltiu %d, %1, %2"},
+    {NT_REG, GT, false, INT_CLASS, {NT_REG, NT_REG}, 1, "slt %d, %2, %1"},
+    {NT_REG, GT, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "sltu %d, %2, %1"},
+    {NT_REG, LE, false, INT_CLASS, {NT_REG, NT_REG}, 2, "slt %d, %2, %1\nxori %d, %d, 1"},
+    {NT_REG, LE, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 2, "sltu %d, %2, %1\nxori %d, %d, 1"},
+    {NT_REG, GE, false, INT_CLASS, {NT_REG, NT_REG}, 2, "slt %d, %1, %2\nxori %d, %d, 1"},
+    {NT_REG, GE, false, INT_CLASS, {NT_REG, NT_IMM}, 2, "slti %d, %1, %2\nxori %d, %d, 1"},
+    {NT_REG, GE, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 2, "sltu %d, %1, %2\nxori %d, %d, 1"},
+    {NT_REG, GE, false, UNSIGNED_CLASSES, {NT_REG, NT_IMM}, 2, "sltiu %d, %1, %2\nxori %d, %d, 1"},
+
+    {NT_REG, EQ, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "feq.s %d, %1, %2"},
+    {NT_REG, NE, false, FLOAT_CLASS, {NT_REG, NT_REG}, 5, "feq.s %d, %1, %2\nxori %d, %d, 1"},
+    {NT_REG, LT, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "flt.s %d, %1, %2"},
+    {NT_REG, GT, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "flt.s %d, %2, %1"},
+    {NT_REG, LE, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "fle.s %d, %1, %2"},
+    {NT_REG, GE, false, FLOAT_CLASS, {NT_REG, NT_REG}, 4, "fle.s %d, %2, %1"},
+    {NT_REG, EQ, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "feq.d %d, %1, %2"},
+    {NT_REG, NE, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 5, "feq.d %d, %1, %2\nxori %d, %d, 1"},
+    {NT_REG, LT, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "flt.d %d, %1, %2"},
+    {NT_REG, GT, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "flt.d %d, %2, %1"},
+    {NT_REG, LE, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "fle.d %d, %1, %2"},
+    {NT_REG, GE, false, DOUBLE_CLASS, {NT_REG, NT_REG}, 4, "fle.d %d, %2, %1"},
+
+    // branches taken when the condition holds, the selector inverts the opcode to branch when it does not
+    {NT_COND, EQ, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "beq %1, %2, %l"},
+    {NT_COND, EQ, false, INTEGER_CLASSES, {NT_REG, NT_ZERO}, 1, "beqz %1, %l"},
+    {NT_COND, NE, false, INTEGER_CLASSES, {NT_REG, NT_REG}, 1, "bne %1, %2, %l"},
+    {NT_COND, NE, false, INTEGER_CLASSES, {NT_REG, NT_ZERO}, 1, "bnez %1, %l"},
+    {NT_COND, LT, false, INT_CLASS, {NT_REG, NT_REG}, 1, "blt %1, %2, %l"},
+    {NT_COND, LT, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "bltu %1, %2, %l"},
+    {NT_COND, GT, false, INT_CLASS, {NT_REG, NT_REG}, 1, "blt %2, %1, %l"},
+    {NT_COND, GT, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "bltu %2, %1, %l"},
+    {NT_COND, LE, false, INT_CLASS, {NT_REG, NT_REG}, 1, "bge %2, %1, %l"},
+    {NT_COND, LE, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "bgeu %2, %1, %l"},
+    {NT_COND, GE, false, INT_CLASS, {NT_REG, NT_REG}, 1, "bge %1, %2, %l"},
+    {NT_COND, GE, false, UNSIGNED_CLASSES, {NT_REG, NT_REG}, 1, "bgeu %1, %2, %l"},
+    {NT_COND, NOT, false, ALL_CLASSES, {NT_REG, NT_NONE}, 1, "beqz %1, %l"},
+    {NT_COND, ADD, true, ALL_CLASSES, {NT_REG, NT_NONE}, 1, "bnez %1, %l"}, // any value against zero
+};
+
+#define RULE_COUNT (sizeof(rules) / sizeof(rules[0]))
+
+// the cheapest rule deriving each nonterminal at a node
+typedef struct Label
+{
+    int cost[NT_COUNT];
+    const Rule *rule[NT_COUNT];
+    long value; // of a constant leaf
+} Label;
+
+static unsigned typeClass(DataType type)
+{
+    switch (type)
+    {
+    case FLOAT_TYPE:
+        return FLOAT_CLASS;
+    case DOUBLE_TYPE:
+        return DOUBLE_CLASS;
+    case UNSIGNED_SHORT_TYPE:
+    case UNSIGNED_INT_TYPE:
+    case UNSIGNED_LONG_TYPE:
+        return UINT_CLASS;
+    default:
+        return isPtr(type) ? PTR_CLASS : INT_CLASS;
+    }
+}
+
+// comparisons and logical operators are classed by what they compare, everything else by its result
+static unsigned operationClass(OperationExpr *expr)
+{
+    switch (expr->operator)
+    {
+    case EQ:
+    case NE:
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+    case NOT:
+    case AND:
+    case OR:
+        return typeClass(returnType(expr->op1));
+    default:
+        return typeClass(expr->type);
+    }
+}
+
+static int log2Exact(long value)
+{
+    int log = 0;
+    while (value > 1 && value % 2 == 0)
+    {
+        value /= 2;
+        log++;
+    }
+    return value == 1 ? log : -1;
+}
+
+static void labelExpr(Expr *expr, Label *label);
+
+// cost of deriving kid as the nonterminal, NO_COST if it cannot be
+static int kidCost(Expr *kid, const Label *kidLabel, NonTerminal nonTerminal)
+{
+    if (nonTerminal == NT_NONE)
+    {
+        return kid == NULL ? 0 : NO_COST;
+    }
+    return kid == NULL ? NO_COST : kidLabel->cost[nonTerminal];
+}
+
+static void labelLeaf(Expr *expr, Label *label)
+{
+    label->cost[NT_REG] = 1; // compileExpr loads it
+    if (expr->type != CONSTANT_EXPR || expr->constant->isString ||
+        (expr->constant->type != INT_TYPE && expr->constant->type != UNSIGNED_INT_TYPE))
+    {
+        return;
+    }
+    long value = expr->constant->int_const;
+    label->value = value;
+    if (value >= -2048 && value <= 2047)
+    {
+        label->cost[NT_IMM] = 0;
+    }
+    if (value >= -2047 && value <= 2048)
+    {
+        label->cost[NT_NEGIMM] = 0;
+    }
+    if (value == 0)
+    {
+        label->cost[NT_ZERO] = 0;
+    }
+    if (value >= 0 && value <= 31)
+    {
+        label->cost[NT_SHAMT] = 0;
+    }
+    if (value > 0 && value <= (1L << 30) && log2Exact(value) >= 0)
+    {
+        label->cost[NT_POW2] = 0;
+    }
+}
+
+// bottom-up dynamic programming, the whole subtree is labelled on every call
+static void labelExpr(Expr *expr, Label *label)
+{
+    for (size_t i = 0; i < NT_COUNT; i++)
+    {
+        label->cost[i] = NO_COST;
+        label->rule[i] = NULL;
+    }
+    label->value = 0;
+
+    if (expr->type == OPERATION_EXPR)
+    {
+        OperationExpr *operation = expr->operation;
+        Label kidLabels[2];
+        Expr *kids[2] = {operation->op1, operation->op2};
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (kids[i] != NULL)
+            {
+                labelExpr(kids[i], &kidLabels[i]);
+            }
+        }
+        unsigned class = operationClass(operation);
+        for (size_t i = 0; i < RULE_COUNT; i++)
+        {
+            const Rule *rule = &rules[i];
+            if (rule->chain || rule->operator != operation->operator || !(rule->classes & class))
+            {
+                continue;
+            }
+            int cost = rule->cost + kidCost(kids[0], &kidLabels[0], rule->kids[0]) + kidCost(kids[1], &kidLabels[1], rule->kids[1]);
+            if (cost < label->cost[rule->result])
+            {
+                label->cost[rule->result] = cost;
+                label->rule[rule->result] = rule;
+            }
+        }
+        if (label->rule[NT_REG] == NULL)
+        {
+            label->cost[NT_REG] = 1; // left to compileOperationExpr
+        }
+    }
+    else
+    {
+        labelLeaf(expr, label);
+    }
+
+    unsigned class = typeClass(returnType(expr));
+    for (size_t i = 0; i < RULE_COUNT; i++)
+    {
+        const Rule *rule = &rules[i];
+        if (rule->chain && (rule->classes & class) && label->cost[rule->kids[0]] + rule->cost < label->cost[rule->result])
+        {
+            label->cost[rule->result] = label->cost[rule->kids[0]] + rule->cost;
+            label->rule[rule->result] = rule;
+        }
+    }
+}
+
+// expands a template, inverting the branch in front of it when it is to be taken on false
+static void emitRule(const Rule *rule, Reg dest, char operands[2][TEXT_LENGTH], const char *target, bool taken)
+{
+    const char *c = rule->emit;
+    fputc('\t', outFile);
+    if (!taken)
+    {
+        char opcode[TEXT_LENGTH] = {0};
+        size_t length = strcspn(c, " ");
+        memcpy(opcode, c, length < TEXT_LENGTH ? length : TEXT_LENGTH - 1);
+        fputs(invertBranch(opcode), outFile);
+        c += length;
+    }
+    for (; *c != '\0'; c++)
+    {
+        if (*c == '\n')
+        {
+            fputs("\n\t", outFile);
+        }
+        else if (*c == '%')
+        {
+            c++;
+            switch (*c)
+            {
+            case 'd':
+                fputs(regStr(dest), outFile);
+                break;
+            case '1':
+                fputs(operands[0], outFile);
+                break;
+            case '2':
+                fputs(operands[1], outFile);
+                break;
+            case 'l':
+                fputs(target, outFile);
+                break;
+            default:
+                fputc(*c, outFile);
+                break;
+            }
+        }
+        else
+        {
+            fputc(*c, outFile);
+        }
+    }
+    fputc('\n', outFile);
+}
+
+// emits the tile, register operands are compiled first in order and fold back into their own selection
+static void reduce(Expr *expr, const Rule *rule, Reg dest, const char *target, bool taken)
+{
+    Expr *kids[2] = {expr, NULL};
+    if (!rule->chain)
+    {
+        kids[0] = expr->operation->op1;
+        kids[1] = expr->operation->op2;
+    }
+    bool floatKids = !(rule->classes & INTEGER_CLASSES);
+    Reg kidRegs[2];
+    char operands[2][TEXT_LENGTH] = {{0}};
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (rule->kids[i] == NT_NONE)
+        {
+            continue;
+        }
+        if (rule->kids[i] == NT_REG)
+        {
+            kidRegs[i] = floatKids ? getTmpFltReg() : getTmpReg();
+            compileExpr(kids[i], kidRegs[i]);
+            snprintf(operands[i], TEXT_LENGTH, "%s", regStr(kidRegs[i]));
+            continue;
+        }
+        Label kidLabel;
+        labelExpr(kids[i], &kidLabel);
+        long value = kidLabel.value;
+        if (rule->kids[i] == NT_NEGIMM)
+        {
+            value = -value;
+        }
+        else if (rule->kids[i] == NT_POW2)
+        {
+            value = log2Exact(value);
+        }
+        snprintf(operands[i], TEXT_LENGTH, "%ld", value);
+    }
+    emitRule(rule, dest, operands, target, taken);
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (rule->kids[i] == NT_REG)
+        {
+            freeReg(kidRegs[i]);
+        }
+    }
+}
+
+// selects the cheapest tiling of the operation into dest, false if the description has no rule for it
+bool selectExpr(OperationExpr *expr, Reg dest)
+{
+    Expr node = {.type = OPERATION_EXPR, .operation = expr};
+    Label label;
+    labelExpr(&node, &label);
+    if (label.rule[NT_REG] == NULL)
+    {
+        return false;
+    }
+    reduce(&node, label.rule[NT_REG], dest, NULL, true);
+    return true;
+}
+
+// branches to target when the condition is non-zero (taken) or zero (not taken)
+void selectBranch(Expr *condition, bool taken, const char *target)
+{
+    Label label;
+    labelExpr(condition, &label);
+    reduce(condition, label.rule[NT_COND], ZERO, target, taken);
+}
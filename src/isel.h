@@ -0,0 +1,49 @@
+#ifndef ISEL_H
+#define ISEL_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "codegen.h"
+
+// what a tile leaves its result as
+typedef enum
+{
+    NT_NONE,   // no operand
+    NT_REG,    // a value in a register
+    NT_COND,   // a branch on the value, nothing left in a register
+    NT_IMM,    // a constant that fits a 12-bit immediate
+    NT_NEGIMM, // a constant whose negation fits a 12-bit immediate
+    NT_ZERO,   // the constant 0
+    NT_SHAMT,  // a constant shift amount, 0 to 31
+    NT_POW2,   // a positive power of two, used as its log
+    NT_COUNT
+} NonTerminal;
+
+// the kinds of value an operation works on, a rule applies to a mask of them
+typedef enum
+{
+    INT_CLASS = 1,
+    UINT_CLASS = 2,
+    PTR_CLASS = 4,
+    FLOAT_CLASS = 8,
+    DOUBLE_CLASS = 16
+} TypeClass;
+
+// One tile of the machine description: an operator over operand nonterminals, what it costs and what it emits.
+// In the template %d is the destination, %1 and %2 the operands and %l the branch target, lines split on '\n'.
+typedef struct Rule
+{
+    NonTerminal result;
+    Operator operator;
+    bool chain; // derives result from the node itself as kids[0], operator is unused
+    unsigned classes;
+    NonTerminal kids[2];
+    int cost;
+    const char *emit;
+} Rule;
+
+bool selectExpr(OperationExpr *expr, Reg dest);
+void selectBranch(Expr *condition, bool taken, const char *label);
+
+#endif
@@ -0,0 +1,572 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "codegen.h"
+#include "layout.h"
+#include "mir.h"
+#include "profile.h"
+
+#define MAX_CYCLE_PROBABILITY 0.95 // keeps the frequency of a loop header finite
+
+bool layoutEnabled = true;
+size_t loopAlignment = 16;
+
+// Ball and Larus, the chance a heuristic that applies to a branch predicts it right
+#define LOOP_BRANCH_PROBABILITY 0.88
+#define LOOP_EXIT_PROBABILITY 0.80
+#define OPCODE_PROBABILITY 0.84
+#define RETURN_PROBABILITY 0.72
+
+typedef enum
+{
+    TERM_FALL,   // runs into the next block
+    TERM_JUMP,   // ends in j
+    TERM_BRANCH, // ends in a conditional branch, runs into the next block otherwise
+    TERM_EXIT    // leaves the function
+} Terminator;
+
+// How control leaves a block, succs[0] is the branch or jump target and succs[1] the block run into
+typedef struct BlockExit
+{
+    Terminator terminator;
+    size_t last; // the terminating instruction
+    size_t succs[2];
+    double probs[2];
+    double frequency; // runs per entry to the function
+    size_t label;     // string of the label the block starts with, NO_BLOCK until one is needed
+    bool labelled;    // the label was there before layout
+} BlockExit;
+
+// An edge chained as a fall-through when it is among the most frequent
+typedef struct LayoutEdge
+{
+    size_t from;
+    size_t to;
+    double weight;
+} LayoutEdge;
+
+// labels appear nowhere but at the top of a block, the directives of a function only before its first
+static bool canLayout(const MachineFunc *func)
+{
+    bool labelled = false;
+    for (size_t i = 0; i < func->size; i++)
+    {
+        MachineOpcode opcode = func->opcodes[i];
+        if (opcode == MOP_JR || (opcode == MOP_DIRECTIVE && labelled))
+        {
+            return false;
+        }
+        if (opcode == MOP_OTHER)
+        {
+            const char *name = mirString(func, func->texts[i]);
+            if (name[0] == 'b' || name[0] == 'j')
+            {
+                return false;
+            }
+        }
+        labelled |= opcode == MOP_LABEL;
+    }
+    return true;
+}
+
+static size_t blockOfLabel(const MachineFunc *func, const Cfg *cfg, size_t label)
+{
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        for (size_t i = cfg->blocks[block].first;
+             i < cfg->blocks[block].end && (func->opcodes[i] == MOP_LABEL || func->opcodes[i] == MOP_DIRECTIVE); i++)
+        {
+            if (func->opcodes[i] == MOP_LABEL && func->texts[i] == label)
+            {
+                return block;
+            }
+        }
+    }
+    return NO_BLOCK;
+}
+
+static void findExits(const MachineFunc *func, const Cfg *cfg, BlockExit *exits)
+{
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        BlockExit *exit = &exits[block];
+        const BasicBlock *basicBlock = &cfg->blocks[block];
+        exit->last = NO_BLOCK;
+        exit->label = NO_BLOCK;
+        exit->frequency = 0;
+        for (size_t i = basicBlock->first; i < basicBlock->end; i++)
+        {
+            if (func->opcodes[i] == MOP_LABEL && exit->label == NO_BLOCK && exit->last == NO_BLOCK)
+            {
+                exit->label = func->texts[i];
+            }
+            if (func->opcodes[i] != MOP_LABEL && func->opcodes[i] != MOP_DIRECTIVE)
+            {
+                exit->last = i;
+            }
+        }
+        exit->labelled = exit->label != NO_BLOCK;
+        size_t next = block + 1 < cfg->size ? block + 1 : NO_BLOCK;
+        unsigned flags = exit->last == NO_BLOCK ? 0 : mirFlags(func, exit->last);
+        exit->terminator = flags & MF_JUMP ? TERM_JUMP : flags & MF_BRANCH ? TERM_BRANCH : flags & MF_EXIT ? TERM_EXIT : TERM_FALL;
+        exit->succs[0] = NO_BLOCK;
+        exit->succs[1] = NO_BLOCK;
+        exit->probs[0] = 0;
+        exit->probs[1] = 0;
+        if (exit->terminator == TERM_JUMP || exit->terminator == TERM_BRANCH)
+        {
+            const MachineOperand *target = mirOperand(func, exit->last, func->operandCounts[exit->last] - 1);
+            exit->succs[0] = target->kind == MO_SYMBOL ? blockOfLabel(func, cfg, target->symbol) : NO_BLOCK;
+            exit->probs[0] = 1;
+        }
+        if (exit->terminator == TERM_BRANCH || exit->terminator == TERM_FALL)
+        {
+            exit->succs[1] = next;
+            exit->probs[1] = 1;
+        }
+    }
+}
+
+// the value a register holds at the end of a block is a constant, zero or set by li in the block
+static bool isConstantReg(const MachineFunc *func, const BasicBlock *block, size_t before, Reg reg)
+{
+    if (reg == ZERO)
+    {
+        return true;
+    }
+    for (size_t i = before; i-- > block->first;)
+    {
+        RegRefs defs;
+        mirDefs(func, i, &defs);
+        if (defs.count != 0 && defs.regs[0] == reg)
+        {
+            return func->opcodes[i] == MOP_LI;
+        }
+    }
+    return false;
+}
+
+// x == constant, x < 0 and x <= 0 are usually false
+static bool opcodeHeuristic(const MachineFunc *func, const BasicBlock *block, size_t branch, double *taken)
+{
+    const MachineOperand *operands = mirOperand(func, branch, 0);
+    Reg first = operands[0].reg;
+    Reg second = func->operandCounts[branch] == 3 ? operands[1].reg : ZERO;
+    switch (func->opcodes[branch])
+    {
+    case MOP_BEQZ:
+    case MOP_BNEZ:
+    case MOP_BEQ:
+    case MOP_BNE:
+        if (!isConstantReg(func, block, branch, first) && !isConstantReg(func, block, branch, second))
+        {
+            return false;
+        }
+        *taken = func->opcodes[branch] == MOP_BEQZ || func->opcodes[branch] == MOP_BEQ ? 1 - OPCODE_PROBABILITY : OPCODE_PROBABILITY;
+        return true;
+    case MOP_BLT:
+    case MOP_BGE:
+        // blt x, zero is x < 0 and blt zero, x is x > 0
+        if (second == ZERO)
+        {
+            *taken = func->opcodes[branch] == MOP_BLT ? 1 - OPCODE_PROBABILITY : OPCODE_PROBABILITY;
+            return true;
+        }
+        if (first == ZERO)
+        {
+            *taken = func->opcodes[branch] == MOP_BLT ? OPCODE_PROBABILITY : 1 - OPCODE_PROBABILITY;
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+// Dempster-Shafer, as Wu and Larus combine the heuristics that apply to one branch
+static double combine(double probability, double evidence)
+{
+    double agree = probability * evidence;
+    return agree / (agree + (1 - probability) * (1 - evidence));
+}
+
+static bool inLoop(const Cfg *cfg, size_t loop, size_t block)
+{
+    return loop != NO_BLOCK && block != NO_BLOCK && blockListContains(&cfg->loops[loop].body, block);
+}
+
+static void estimateProbabilities(const MachineFunc *func, const Cfg *cfg, BlockExit *exits)
+{
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        BlockExit *exit = &exits[block];
+        if (exit->terminator != TERM_BRANCH || exit->succs[0] == NO_BLOCK || exit->succs[1] == NO_BLOCK ||
+            exit->succs[0] == exit->succs[1])
+        {
+            continue;
+        }
+        double taken = 0.5;
+        size_t loop = cfg->blocks[block].loop;
+        for (size_t i = 0; i < 2; i++)
+        {
+            size_t succ = exit->succs[i];
+            double towards = i == 0 ? LOOP_BRANCH_PROBABILITY : 1 - LOOP_BRANCH_PROBABILITY;
+            if (cfgDominates(cfg, succ, block))
+            {
+                taken = combine(taken, towards); // a back edge
+            }
+            else if (inLoop(cfg, loop, succ) != inLoop(cfg, loop, exit->succs[1 - i]) && !inLoop(cfg, loop, succ))
+            {
+                taken = combine(taken, i == 0 ? 1 - LOOP_EXIT_PROBABILITY : LOOP_EXIT_PROBABILITY);
+            }
+            if (exits[succ].terminator == TERM_EXIT && exits[exit->succs[1 - i]].terminator != TERM_EXIT)
+            {
+                taken = combine(taken, i == 0 ? 1 - RETURN_PROBABILITY : RETURN_PROBABILITY);
+            }
+        }
+        double opcode;
+        if (opcodeHeuristic(func, &cfg->blocks[block], exit->last, &opcode))
+        {
+            taken = combine(taken, opcode);
+        }
+        exit->probs[0] = taken;
+        exit->probs[1] = 1 - taken;
+    }
+}
+
+static double edgeProbability(const BlockExit *exit, size_t to)
+{
+    double probability = 0;
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (exit->succs[i] == to)
+        {
+            probability += exit->probs[i];
+        }
+    }
+    return probability;
+}
+
+// In reverse post-order, a loop header is entered 1 / (1 - p) times for each entry where p is the chance of a back edge
+static void estimateFrequencies(const Cfg *cfg, BlockExit *exits)
+{
+    for (size_t i = 0; i < cfg->rpo.size; i++)
+    {
+        size_t block = cfg->rpo.blocks[i];
+        const BasicBlock *basicBlock = &cfg->blocks[block];
+        double frequency = block == 0 ? 1 : 0;
+        double cycle = 0;
+        for (size_t j = 0; j < basicBlock->preds.size; j++)
+        {
+            size_t pred = basicBlock->preds.blocks[j];
+            if (cfg->blocks[pred].rpoIndex == NO_BLOCK)
+            {
+                continue;
+            }
+            if (cfg->blocks[pred].rpoIndex < basicBlock->rpoIndex)
+            {
+                frequency += exits[pred].frequency * edgeProbability(&exits[pred], block);
+            }
+            else
+            {
+                cycle += edgeProbability(&exits[pred], block);
+            }
+        }
+        cycle = cycle > MAX_CYCLE_PROBABILITY ? MAX_CYCLE_PROBABILITY : cycle;
+        exits[block].frequency = frequency / (1 - cycle);
+    }
+}
+
+// with a profile, the runs of each block per call and how often each branch was taken wherever it ran at all
+static void measureFrequencies(const Cfg *cfg, const ProfileCounts *counts, BlockExit *exits)
+{
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        BlockExit *exit = &exits[block];
+        uint64_t runs = 0;
+        for (size_t i = 0; i < counts->size; i++)
+        {
+            runs += counts->from[i] == block ? counts->counts[i] : 0;
+        }
+        exit->frequency = (double)runs / (double)counts->entries;
+        if (exit->terminator != TERM_BRANCH || exit->succs[0] == NO_BLOCK || exit->succs[1] == NO_BLOCK ||
+            exit->succs[0] == exit->succs[1])
+        {
+            continue;
+        }
+        uint64_t taken = profileEdgeCount(counts, block, exit->succs[0]);
+        uint64_t fall = profileEdgeCount(counts, block, exit->succs[1]);
+        if (taken + fall != 0)
+        {
+            exit->probs[0] = (double)taken / (double)(taken + fall);
+            exit->probs[1] = 1 - exit->probs[0];
+        }
+    }
+}
+
+static int compareEdges(const void *a, const void *b)
+{
+    const LayoutEdge *first = a;
+    const LayoutEdge *second = b;
+    if (first->weight != second->weight)
+    {
+        return first->weight > second->weight ? -1 : 1;
+    }
+    if (first->from != second->from)
+    {
+        return first->from < second->from ? -1 : 1;
+    }
+    return first->to < second->to ? -1 : first->to > second->to;
+}
+
+// Pettis and Hansen, the heaviest edges become fall-throughs where both ends are still free
+static void chainBlocks(const Cfg *cfg, const BlockExit *exits, size_t *next, size_t *prev)
+{
+    LayoutEdge *edges = malloc(sizeof(LayoutEdge) * (2 * cfg->size + 1));
+    if (edges == NULL)
+    {
+        abort();
+    }
+    size_t edgeCount = 0;
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        next[block] = NO_BLOCK;
+        prev[block] = NO_BLOCK;
+        for (size_t i = 0; i < 2; i++)
+        {
+            size_t to = exits[block].succs[i];
+            // a back edge run into would put the loop test at the top and a jump at the bottom of the body
+            if (to != NO_BLOCK && to != block && to != 0 && (i == 0 || to != exits[block].succs[0]) &&
+                !cfgDominates(cfg, to, block))
+            {
+                edges[edgeCount++] = (LayoutEdge){block, to, exits[block].frequency * edgeProbability(&exits[block], to)};
+            }
+        }
+    }
+    qsort(edges, edgeCount, sizeof(LayoutEdge), compareEdges);
+    for (size_t i = 0; i < edgeCount; i++)
+    {
+        size_t from = edges[i].from;
+        size_t to = edges[i].to;
+        if (next[from] != NO_BLOCK || prev[to] != NO_BLOCK || exits[from].terminator == TERM_EXIT)
+        {
+            continue;
+        }
+        size_t head = from;
+        while (prev[head] != NO_BLOCK)
+        {
+            head = prev[head];
+        }
+        if (head != to)
+        {
+            next[from] = to;
+            prev[to] = from;
+        }
+    }
+    free(edges);
+}
+
+// the entry chain first, then the others hottest first so cold code ends up out of line at the bottom
+static void orderChains(const Cfg *cfg, const BlockExit *exits, const size_t *next, const size_t *prev, size_t *order)
+{
+    size_t placed = 0;
+    bool *done = calloc(cfg->size, sizeof(bool));
+    if (done == NULL)
+    {
+        abort();
+    }
+    size_t head = 0;
+    while (head != NO_BLOCK)
+    {
+        for (size_t block = head; block != NO_BLOCK; block = next[block])
+        {
+            order[placed++] = block;
+            done[block] = true;
+        }
+        head = NO_BLOCK;
+        for (size_t block = 0; block < cfg->size; block++)
+        {
+            if (!done[block] && prev[block] == NO_BLOCK && (head == NO_BLOCK || exits[block].frequency > exits[head].frequency))
+            {
+                head = block;
+            }
+        }
+    }
+    free(done);
+}
+
+static size_t blockLabel(MachineFunc *func, BlockExit *exits, size_t block, size_t funcName)
+{
+    if (exits[block].label == NO_BLOCK)
+    {
+        char label[256];
+        snprintf(label, sizeof(label), ".BLOCK%s_%zu", mirString(func, funcName), block);
+        exits[block].label = mirAddString(func, label);
+    }
+    return exits[block].label;
+}
+
+static void appendJump(MachineFunc *func, size_t label)
+{
+    size_t jump = mirAppend(func, MOP_J);
+    mirAddOperand(func, jump, MO_SYMBOL)->symbol = label;
+}
+
+static bool needsAlignment(const Cfg *cfg, const BlockExit *exits, size_t block, size_t before)
+{
+    if (loopAlignment <= 1 || block == 0 || cfg->blocks[block].loop == NO_BLOCK || cfg->loops[cfg->blocks[block].loop].header != block ||
+        exits[block].frequency <= 1)
+    {
+        return false;
+    }
+    // padding run into from inside the loop would be executed on every iteration
+    bool fallsIn = before != NO_BLOCK && exits[before].terminator != TERM_JUMP && exits[before].terminator != TERM_EXIT;
+    return !(fallsIn && inLoop(cfg, cfg->blocks[block].loop, before));
+}
+
+// Rewrites the function in the given block order, fixing up the branches and jumps at the end of each block
+static void emitLayout(MachineFunc *func, const Cfg *cfg, BlockExit *exits, const size_t *order)
+{
+    size_t funcName = NO_BLOCK;
+    for (size_t i = 0; i < func->size && funcName == NO_BLOCK; i++)
+    {
+        if (func->opcodes[i] == MOP_LABEL)
+        {
+            funcName = func->texts[i];
+        }
+    }
+    // labels are made for every block that a jump will need to reach before anything is copied
+    for (size_t k = 0; k < cfg->size; k++)
+    {
+        const BlockExit *exit = &exits[order[k]];
+        size_t following = k + 1 < cfg->size ? order[k + 1] : NO_BLOCK;
+        if ((exit->terminator == TERM_BRANCH || exit->terminator == TERM_FALL) && exit->succs[1] != NO_BLOCK &&
+            exit->succs[1] != following)
+        {
+            blockLabel(func, exits, exit->succs[1], funcName);
+        }
+    }
+
+    size_t size = func->size;
+    for (size_t k = 0; k < cfg->size; k++)
+    {
+        size_t block = order[k];
+        size_t following = k + 1 < cfg->size ? order[k + 1] : NO_BLOCK;
+        const BasicBlock *basicBlock = &cfg->blocks[block];
+        const BlockExit *exit = &exits[block];
+        if (needsAlignment(cfg, exits, block, k == 0 ? NO_BLOCK : order[k - 1]))
+        {
+            char directive[32];
+            size_t log = 0;
+            while (((size_t)1 << log) < loopAlignment)
+            {
+                log++;
+            }
+            snprintf(directive, sizeof(directive), "\t.p2align %zu", log);
+            size_t align = mirAppend(func, MOP_DIRECTIVE);
+            func->texts[align] = mirAddString(func, directive);
+        }
+        if (!exit->labelled && exit->label != NO_BLOCK)
+        {
+            size_t label = mirAppend(func, MOP_LABEL);
+            func->texts[label] = exit->label;
+        }
+        for (size_t i = basicBlock->first; i < basicBlock->end; i++)
+        {
+            if (i != exit->last || (exit->terminator != TERM_JUMP && exit->terminator != TERM_BRANCH))
+            {
+                mirAppendCopy(func, i);
+            }
+        }
+
+        size_t target = exit->succs[0];
+        size_t fall = exit->succs[1];
+        bool fallJumps = fall != NO_BLOCK && fall != following;
+        if (exit->terminator == TERM_JUMP && target != following)
+        {
+            mirAppendCopy(func, exit->last);
+        }
+        else if (exit->terminator == TERM_BRANCH && target == following && target != fall && fallJumps)
+        {
+            // taken into the block that follows, so the inverse is taken to the other
+            size_t branch = mirAppendCopy(func, exit->last);
+            func->opcodes[branch] = mirInvertBranch(func->opcodes[branch]);
+            mirOperand(func, branch, func->operandCounts[branch] - 1)->symbol = exits[fall].label;
+        }
+        else if (exit->terminator == TERM_BRANCH)
+        {
+            if (target != fall)
+            {
+                mirAppendCopy(func, exit->last);
+            }
+            if (fallJumps)
+            {
+                appendJump(func, exits[fall].label);
+            }
+        }
+        else if (exit->terminator == TERM_FALL && fallJumps)
+        {
+            appendJump(func, exits[fall].label);
+        }
+    }
+    mirRemove(func, 0, size);
+}
+
+// Places blocks so that the likely successor of each is the one it runs into and aligns the headers of hot loops,
+// likely going by the profile where -fprofile-use has one that matches the function
+void layoutBlocks(MachineFunc *func)
+{
+    if (!canLayout(func))
+    {
+        return;
+    }
+    Cfg cfg;
+    mirCfg(func, &cfg);
+    BlockExit *exits = malloc(sizeof(BlockExit) * cfg.size);
+    size_t *next = malloc(sizeof(size_t) * cfg.size);
+    size_t *prev = malloc(sizeof(size_t) * cfg.size);
+    size_t *order = malloc(sizeof(size_t) * cfg.size);
+    if (exits == NULL || next == NULL || prev == NULL || order == NULL)
+    {
+        abort();
+    }
+    findExits(func, &cfg, exits);
+    estimateProbabilities(func, &cfg, exits);
+    ProfileCounts counts;
+    bool measured = profileCounts(func, &cfg, &counts);
+    if (measured && counts.entries != 0)
+    {
+        measureFrequencies(&cfg, &counts, exits);
+    }
+    else
+    {
+        estimateFrequencies(&cfg, exits);
+    }
+    if (measured)
+    {
+        profileCountsDestroy(&counts);
+    }
+    if (layoutEnabled)
+    {
+        chainBlocks(&cfg, exits, next, prev);
+    }
+    else
+    {
+        for (size_t block = 0; block < cfg.size; block++)
+        {
+            next[block] = block + 1 < cfg.size ? block + 1 : NO_BLOCK;
+            prev[block] = block > 0 ? block - 1 : NO_BLOCK;
+        }
+    }
+    orderChains(&cfg, exits, next, prev, order);
+    emitLayout(func, &cfg, exits, order);
+    free(exits);
+    free(next);
+    free(prev);
+    free(order);
+    cfgDestroy(&cfg);
+}
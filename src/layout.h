@@ -0,0 +1,14 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mir.h"
+
+extern bool layoutEnabled;
+extern size_t loopAlignment; // bytes, hot loop headers start on a multiple of it
+
+void layoutBlocks(MachineFunc *func);
+
+#endif
@@ -0,0 +1,305 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "literals.h"
+
+typedef struct StringLiteral
+{
+    char *bytes; // escapes decoded, without the terminator
+    size_t length;
+    size_t labelId;
+} StringLiteral;
+
+typedef struct FloatLiteral
+{
+    uint32_t bits;
+    size_t labelId;
+} FloatLiteral;
+
+// Literals of the translation unit, emitted once at the end of the file
+static StringLiteral *strings = NULL;
+static size_t stringsSize = 0;
+static size_t stringsCapacity = 0;
+
+static FloatLiteral *floats = NULL;
+static size_t floatsSize = 0;
+static size_t floatsCapacity = 0;
+
+static size_t literalLabelId = 0;
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// decodes the escape sequences of a literal as written in the source, returns the number of bytes
+static size_t decodeString(const char *escaped, char *bytes)
+{
+    size_t length = 0;
+    while (*escaped != '\0')
+    {
+        if (*escaped != '\\')
+        {
+            bytes[length++] = *escaped++;
+            continue;
+        }
+        escaped++;
+        switch (*escaped)
+        {
+        case 'n':
+            bytes[length++] = '\n';
+            escaped++;
+            break;
+        case 't':
+            bytes[length++] = '\t';
+            escaped++;
+            break;
+        case 'r':
+            bytes[length++] = '\r';
+            escaped++;
+            break;
+        case 'a':
+            bytes[length++] = '\a';
+            escaped++;
+            break;
+        case 'b':
+            bytes[length++] = '\b';
+            escaped++;
+            break;
+        case 'f':
+            bytes[length++] = '\f';
+            escaped++;
+            break;
+        case 'v':
+            bytes[length++] = '\v';
+            escaped++;
+            break;
+        case 'x':
+        {
+            int value = 0;
+            escaped++;
+            while (hexValue(*escaped) >= 0)
+            {
+                value = value * 16 + hexValue(*escaped++);
+            }
+            bytes[length++] = (char)value;
+            break;
+        }
+        case '\0':
+            break;
+        default:
+        {
+            if (*escaped >= '0' && *escaped <= '7')
+            {
+                int value = 0;
+                for (int i = 0; i < 3 && *escaped >= '0' && *escaped <= '7'; i++)
+                {
+                    value = value * 8 + (*escaped++ - '0');
+                }
+                bytes[length++] = (char)value;
+            }
+            else
+            {
+                // \\, \', \" and \?
+                bytes[length++] = *escaped++;
+            }
+            break;
+        }
+        }
+    }
+    return length;
+}
+
+// label of the pool entry holding a string, equal strings share one entry
+size_t stringLiteralLabel(const char *escaped)
+{
+    char *bytes = malloc(strlen(escaped) + 1);
+    if (bytes == NULL)
+    {
+        abort();
+    }
+    size_t length = decodeString(escaped, bytes);
+    for (size_t i = 0; i < stringsSize; i++)
+    {
+        if (strings[i].length == length && memcmp(strings[i].bytes, bytes, length) == 0)
+        {
+            free(bytes);
+            return strings[i].labelId;
+        }
+    }
+    if (stringsSize == stringsCapacity)
+    {
+        stringsCapacity = stringsCapacity == 0 ? 16 : stringsCapacity * 2;
+        strings = realloc(strings, sizeof(StringLiteral) * stringsCapacity);
+        if (strings == NULL)
+        {
+            abort();
+        }
+    }
+    strings[stringsSize].bytes = bytes;
+    strings[stringsSize].length = length;
+    strings[stringsSize].labelId = literalLabelId++;
+    return strings[stringsSize++].labelId;
+}
+
+// label of the pool entry holding a float, keyed by its bit pattern so -0.0 and 0.0 stay apart
+size_t floatLiteralLabel(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (size_t i = 0; i < floatsSize; i++)
+    {
+        if (floats[i].bits == bits)
+        {
+            return floats[i].labelId;
+        }
+    }
+    if (floatsSize == floatsCapacity)
+    {
+        floatsCapacity = floatsCapacity == 0 ? 16 : floatsCapacity * 2;
+        floats = realloc(floats, sizeof(FloatLiteral) * floatsCapacity);
+        if (floats == NULL)
+        {
+            abort();
+        }
+    }
+    floats[floatsSize].bits = bits;
+    floats[floatsSize].labelId = literalLabelId++;
+    return floats[floatsSize++].labelId;
+}
+
+static void emitBytes(FILE *file, const char *directive, const char *bytes, size_t length)
+{
+    fprintf(file, "\t%s \"", directive);
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)bytes[i];
+        if (c == '"' || c == '\\')
+        {
+            fprintf(file, "\\%c", c);
+        }
+        else if (c >= ' ' && c <= '~')
+        {
+            fputc(c, file);
+        }
+        else
+        {
+            fprintf(file, "\\%03o", c);
+        }
+    }
+    fprintf(file, "\"\n");
+}
+
+// the longest other literal that ends with the same bytes, or the literal itself
+static size_t suffixRoot(size_t index)
+{
+    size_t root = index;
+    for (size_t i = 0; i < stringsSize; i++)
+    {
+        if (strings[i].length > strings[root].length &&
+            memcmp(strings[i].bytes + strings[i].length - strings[index].length, strings[index].bytes, strings[index].length) == 0)
+        {
+            root = i;
+        }
+    }
+    return root;
+}
+
+static int compareOffsets(const void *a, const void *b)
+{
+    size_t x = ((const size_t *)a)[1];
+    size_t y = ((const size_t *)b)[1];
+    return (x > y) - (x < y);
+}
+
+// writes the pools, literals that are a suffix of another one get a label inside it
+void emitLiteralPools(FILE *file)
+{
+    if (floatsSize != 0)
+    {
+        fprintf(file, ".section .rodata\n");
+        fprintf(file, ".align 2\n");
+        for (size_t i = 0; i < floatsSize; i++)
+        {
+            fprintf(file, ".LC%lu:\n", floats[i].labelId);
+            fprintf(file, "\t.word 0x%08x\n", floats[i].bits);
+        }
+    }
+
+    if (stringsSize != 0)
+    {
+        fprintf(file, ".section .rodata\n");
+        // pairs of string index and offset in the root
+        size_t (*members)[2] = malloc(sizeof(size_t[2]) * stringsSize);
+        if (members == NULL)
+        {
+            abort();
+        }
+        size_t *roots = malloc(sizeof(size_t) * stringsSize);
+        if (roots == NULL)
+        {
+            abort();
+        }
+        for (size_t i = 0; i < stringsSize; i++)
+        {
+            roots[i] = suffixRoot(i);
+        }
+        for (size_t i = 0; i < stringsSize; i++)
+        {
+            if (roots[i] != i)
+            {
+                continue;
+            }
+            size_t memberCount = 0;
+            for (size_t j = 0; j < stringsSize; j++)
+            {
+                if (roots[j] == i)
+                {
+                    members[memberCount][0] = j;
+                    members[memberCount][1] = strings[i].length - strings[j].length;
+                    memberCount++;
+                }
+            }
+            qsort(members, memberCount, sizeof(members[0]), compareOffsets);
+            size_t position = 0;
+            for (size_t j = 0; j < memberCount; j++)
+            {
+                if (members[j][1] > position)
+                {
+                    emitBytes(file, ".ascii", strings[i].bytes + position, members[j][1] - position);
+                    position = members[j][1];
+                }
+                fprintf(file, ".LC%lu:\n", strings[members[j][0]].labelId);
+            }
+            emitBytes(file, ".string", strings[i].bytes + position, strings[i].length - position);
+        }
+        free(members);
+        free(roots);
+    }
+
+    for (size_t i = 0; i < stringsSize; i++)
+    {
+        free(strings[i].bytes);
+    }
+    free(strings);
+    free(floats);
+    strings = NULL;
+    floats = NULL;
+    stringsSize = stringsCapacity = 0;
+    floatsSize = floatsCapacity = 0;
+}
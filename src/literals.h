@@ -0,0 +1,11 @@
+#ifndef LITERALS_H
+#define LITERALS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+size_t stringLiteralLabel(const char *escaped);
+size_t floatLiteralLabel(float value);
+void emitLiteralPools(FILE *file);
+
+#endif
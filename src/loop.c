@@ -0,0 +1,1645 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "loop.h"
+#include "optimise.h"
+#include "profile.h"
+#include "symbol.h"
+
+// An invariant value already moved out of the current loop
+typedef struct HoistedValue
+{
+    Expr *value;
+    SymbolEntry *temp;
+} HoistedValue;
+
+typedef struct LoopState
+{
+    LoopEffects effects;
+    HoistedValue *hoisted;
+    size_t hoistedSize;
+    size_t hoistedCapacity;
+} LoopState;
+
+// unrolling knobs, set from the command line
+bool unrollEnabled = true;
+size_t unrollFactor = 4;   // copies of the body in a partially unrolled loop
+size_t unrollBudget = 256; // growth allowed per function, in AST nodes
+
+// locals of the current function whose address escapes
+static SymbolSet addressTaken;
+static SymbolEntry *currentFunc = NULL;
+
+void collectEffectsExpr(const Expr *expr, LoopEffects *effects)
+{
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+    {
+        const OperationExpr *operation = expr->operation;
+        Operator operator = operation->operator;
+        if ((operator== INC || operator== DEC || operator== INC_POST || operator== DEC_POST) &&
+            operation->op1->type != VARIABLE_EXPR)
+        {
+            effects->storesMemory = true;
+        }
+        if (operation->op1 != NULL)
+        {
+            collectEffectsExpr(operation->op1, effects);
+        }
+        if (operation->op2 != NULL)
+        {
+            collectEffectsExpr(operation->op2, effects);
+        }
+        if (operation->op3 != NULL)
+        {
+            collectEffectsExpr(operation->op3, effects);
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+        if (expr->assignment->lvalue != NULL)
+        {
+            effects->storesMemory = true;
+            collectEffectsExpr(expr->assignment->lvalue, effects);
+        }
+        collectEffectsExpr(expr->assignment->op, effects);
+        break;
+    case FUNC_EXPR:
+        effects->calls = true;
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            collectEffectsExpr(expr->function->args[i], effects);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void collectEffectsStmt(const Stmt *stmt, LoopEffects *effects)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        if (stmt->whileStmt->preheader != NULL)
+        {
+            collectEffectsStmt(stmt->whileStmt->preheader, effects);
+        }
+        collectEffectsExpr(stmt->whileStmt->condition, effects);
+        collectEffectsStmt(stmt->whileStmt->body, effects);
+        break;
+    case FOR_STMT:
+        if (stmt->forStmt->preheader != NULL)
+        {
+            collectEffectsStmt(stmt->forStmt->preheader, effects);
+        }
+        collectEffectsStmt(stmt->forStmt->init, effects);
+        collectEffectsStmt(stmt->forStmt->condition, effects);
+        collectEffectsStmt(stmt->forStmt->body, effects);
+        if (stmt->forStmt->modifier != NULL)
+        {
+            collectEffectsExpr(stmt->forStmt->modifier, effects);
+        }
+        break;
+    case IF_STMT:
+        collectEffectsExpr(stmt->ifStmt->condition, effects);
+        collectEffectsStmt(stmt->ifStmt->trueBody, effects);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            collectEffectsStmt(stmt->ifStmt->falseBody, effects);
+        }
+        break;
+    case SWITCH_STMT:
+        collectEffectsExpr(stmt->switchStmt->selector, effects);
+        collectEffectsStmt(stmt->switchStmt->body, effects);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            collectEffectsExpr(stmt->exprStmt->expr, effects);
+        }
+        break;
+    case COMPOUND_STMT:
+    {
+        const CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            DeclInit *declInit = compoundStmt->declList.decls[i]->declInit;
+            if (declInit != NULL && declInit->initExpr != NULL)
+            {
+                collectEffectsExpr(declInit->initExpr, effects);
+            }
+        }
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            collectEffectsStmt(compoundStmt->stmtList.stmts[i], effects);
+        }
+        break;
+    }
+    case LABEL_STMT:
+        collectEffectsStmt(stmt->labelStmt->body, effects);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            collectEffectsExpr(stmt->jumpStmt->expr, effects);
+        }
+        break;
+    }
+}
+
+// true if control can leave the statement other than by falling through, or enter it through a label
+static bool containsJump(const Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return containsJump(stmt->whileStmt->body);
+    case FOR_STMT:
+        return containsJump(stmt->forStmt->body);
+    case IF_STMT:
+        return containsJump(stmt->ifStmt->trueBody) ||
+               (stmt->ifStmt->falseBody != NULL && containsJump(stmt->ifStmt->falseBody));
+    case SWITCH_STMT:
+        return containsJump(stmt->switchStmt->body);
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            if (containsJump(stmt->compoundStmt->stmtList.stmts[i]))
+            {
+                return true;
+            }
+        }
+        return false;
+    case LABEL_STMT:
+    case JUMP_STMT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// the type a hoisted value is kept in, VOID_TYPE if it cannot be kept in a 4 byte slot
+DataType tempType(Expr *expr)
+{
+    DataType type = returnType(expr);
+    if (isPtr(type) || type == INT_TYPE || type == UNSIGNED_INT_TYPE || type == FLOAT_TYPE)
+    {
+        return type;
+    }
+    if (type == CHAR_TYPE || type == SIGNED_CHAR_TYPE || type == SHORT_TYPE || type == UNSIGNED_SHORT_TYPE)
+    {
+        // values are already extended to a full register
+        return INT_TYPE;
+    }
+    return VOID_TYPE;
+}
+
+// true if the value of an expression is the same on every iteration, loads must execute on every iteration
+static bool isInvariant(const Expr *expr, const LoopEffects *effects, bool everyIteration)
+{
+    switch (expr->type)
+    {
+    case CONSTANT_EXPR:
+        return true;
+    case VARIABLE_EXPR:
+    {
+        const SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        if (symbolEntry == NULL)
+        {
+            return false;
+        }
+        if (symbolEntry->entryType == ARRAY_ENTRY)
+        {
+            // the value of an array is its address
+            return true;
+        }
+        if (symbolEntry->entryType != VARIABLE_ENTRY || symbolSetContains(&effects->assigned, symbolEntry))
+        {
+            return false;
+        }
+        if (symbolEntry->isGlobal || symbolSetContains(&addressTaken, symbolEntry))
+        {
+            return !effects->calls && !effects->storesMemory;
+        }
+        return true;
+    }
+    case OPERATION_EXPR:
+    {
+        const OperationExpr *operation = expr->operation;
+        switch (operation->operator)
+        {
+        case INC:
+        case DEC:
+        case INC_POST:
+        case DEC_POST:
+        case TERN:
+        case AND:
+        case OR:
+        case COMMA_OP:
+        case SIZEOF_OP:
+            return false;
+        case ADDRESS:
+            return operation->op1->type == VARIABLE_EXPR && operation->op1->variable->symbolEntry != NULL;
+        case DEREF:
+            if (!everyIteration || effects->calls || effects->storesMemory)
+            {
+                return false;
+            }
+            break;
+        default:
+            break;
+        }
+        return isInvariant(operation->op1, effects, everyIteration) &&
+               (operation->op2 == NULL || isInvariant(operation->op2, effects, everyIteration)) &&
+               (operation->op3 == NULL || isInvariant(operation->op3, effects, everyIteration));
+    }
+    default:
+        return false;
+    }
+}
+
+// hoisting only pays when the value costs more than the reload from its stack slot
+static bool isProfitable(const Expr *expr)
+{
+    switch (expr->type)
+    {
+    case CONSTANT_EXPR:
+        return expr->constant->isString || (expr->constant->type == FLOAT_TYPE && expr->constant->float_const != 0.0f);
+    case VARIABLE_EXPR:
+        return expr->variable->symbolEntry->isGlobal;
+    case OPERATION_EXPR:
+        // the address of a local is a single addi
+        return expr->operation->operator!= ADDRESS || expr->operation->op1->variable->symbolEntry->isGlobal;
+    default:
+        return false;
+    }
+}
+
+// turns a loop statement in place into { init; before; loop }, init may be NULL
+static void wrapLoop(Stmt *stmt, Stmt *init, StatementList *before)
+{
+    Stmt *loop = stmtCreate(stmt->type);
+    *loop = *stmt;
+    stmt->type = COMPOUND_STMT;
+    stmt->compoundStmt = compoundStmtCreate();
+    if (init != NULL)
+    {
+        statementListPush(&stmt->compoundStmt->stmtList, init);
+    }
+    for (size_t i = 0; i < before->size; i++)
+    {
+        statementListPush(&stmt->compoundStmt->stmtList, before->stmts[i]);
+    }
+    statementListPush(&stmt->compoundStmt->stmtList, loop);
+}
+
+// moves an invariant expression into a temporary assigned in target, equal values share one temporary
+static void hoistValue(Expr *expr, LoopState *state, StatementList *target)
+{
+    for (size_t i = 0; i < state->hoistedSize; i++)
+    {
+        if (exprEqual(state->hoisted[i].value, expr))
+        {
+            clearExpr(expr);
+            makeEntryRead(expr, state->hoisted[i].temp);
+            return;
+        }
+    }
+    DataType type = tempType(expr);
+    if (type == VOID_TYPE)
+    {
+        return;
+    }
+    SymbolEntry *temp = createTemp(currentFunc, type);
+    Expr *value = exprCreate(expr->type);
+    *value = *expr;
+    makeEntryRead(expr, temp);
+
+    statementListPush(target, assignEntryStmt(temp, value));
+
+    if (state->hoistedSize == state->hoistedCapacity)
+    {
+        state->hoistedCapacity = state->hoistedCapacity == 0 ? 8 : state->hoistedCapacity * 2;
+        state->hoisted = realloc(state->hoisted, sizeof(HoistedValue) * state->hoistedCapacity);
+        if (state->hoisted == NULL)
+        {
+            abort();
+        }
+    }
+    state->hoisted[state->hoistedSize].value = value;
+    state->hoisted[state->hoistedSize].temp = temp;
+    state->hoistedSize++;
+}
+
+// hoists the largest invariant subexpressions
+static void hoistExpr(Expr *expr, LoopState *state, bool everyIteration, StatementList *target)
+{
+    if (isInvariant(expr, &state->effects, everyIteration))
+    {
+        if (isProfitable(expr))
+        {
+            hoistValue(expr, state, target);
+        }
+        return;
+    }
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        switch (operation->operator)
+        {
+        case INC:
+        case DEC:
+        case INC_POST:
+        case DEC_POST:
+        case ADDRESS:
+            return;
+        case AND:
+        case OR:
+            hoistExpr(operation->op1, state, everyIteration, target);
+            hoistExpr(operation->op2, state, false, target);
+            return;
+        case TERN:
+            hoistExpr(operation->op1, state, everyIteration, target);
+            hoistExpr(operation->op2, state, false, target);
+            hoistExpr(operation->op3, state, false, target);
+            return;
+        default:
+            hoistExpr(operation->op1, state, everyIteration, target);
+            if (operation->op2 != NULL)
+            {
+                hoistExpr(operation->op2, state, everyIteration, target);
+            }
+            if (operation->op3 != NULL)
+            {
+                hoistExpr(operation->op3, state, everyIteration, target);
+            }
+            return;
+        }
+    }
+    case ASSIGN_EXPR:
+        hoistExpr(expr->assignment->op, state, everyIteration, target);
+        if (expr->assignment->lvalue != NULL)
+        {
+            hoistExpr(expr->assignment->lvalue, state, everyIteration, target);
+        }
+        return;
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            hoistExpr(expr->function->args[i], state, everyIteration, target);
+        }
+        return;
+    default:
+        return;
+    }
+}
+
+static void hoistStmt(Stmt *stmt, LoopState *state, bool everyIteration, StatementList *target);
+
+// statements after the first one that may jump do not run on every iteration
+static void hoistCompoundStmt(CompoundStmt *compoundStmt, LoopState *state, bool everyIteration, StatementList *target)
+{
+    for (size_t i = 0; i < compoundStmt->declList.size; i++)
+    {
+        DeclInit *declInit = compoundStmt->declList.decls[i]->declInit;
+        if (declInit != NULL && declInit->initExpr != NULL)
+        {
+            hoistExpr(declInit->initExpr, state, everyIteration, target);
+        }
+    }
+    for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+    {
+        Stmt *stmt = compoundStmt->stmtList.stmts[i];
+        if (containsJump(stmt))
+        {
+            everyIteration = false;
+        }
+        hoistStmt(stmt, state, everyIteration, target);
+    }
+}
+
+static void hoistStmt(Stmt *stmt, LoopState *state, bool everyIteration, StatementList *target)
+{
+    switch (stmt->type)
+    {
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            hoistExpr(stmt->exprStmt->expr, state, everyIteration, target);
+        }
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            hoistExpr(stmt->jumpStmt->expr, state, false, target);
+        }
+        break;
+    case COMPOUND_STMT:
+        hoistCompoundStmt(stmt->compoundStmt, state, everyIteration, target);
+        break;
+    case IF_STMT:
+        hoistExpr(stmt->ifStmt->condition, state, everyIteration, target);
+        hoistStmt(stmt->ifStmt->trueBody, state, false, target);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            hoistStmt(stmt->ifStmt->falseBody, state, false, target);
+        }
+        break;
+    case WHILE_STMT:
+    {
+        // an inner loop runs its entry test each time, everything else may not run
+        WhileStmt *whileStmt = stmt->whileStmt;
+        hoistExpr(whileStmt->condition, state, everyIteration && !whileStmt->doWhile, target);
+        if (whileStmt->preheader != NULL)
+        {
+            hoistStmt(whileStmt->preheader, state, false, target);
+        }
+        hoistStmt(whileStmt->body, state, false, target);
+        break;
+    }
+    case FOR_STMT:
+    {
+        ForStmt *forStmt = stmt->forStmt;
+        hoistStmt(forStmt->init, state, everyIteration, target);
+        hoistStmt(forStmt->condition, state, everyIteration, target);
+        if (forStmt->preheader != NULL)
+        {
+            hoistStmt(forStmt->preheader, state, false, target);
+        }
+        hoistStmt(forStmt->body, state, false, target);
+        if (forStmt->modifier != NULL)
+        {
+            hoistExpr(forStmt->modifier, state, false, target);
+        }
+        break;
+    }
+    case SWITCH_STMT:
+        hoistExpr(stmt->switchStmt->selector, state, everyIteration, target);
+        hoistStmt(stmt->switchStmt->body, state, false, target);
+        break;
+    case LABEL_STMT:
+        hoistStmt(stmt->labelStmt->body, state, false, target);
+        break;
+    }
+}
+
+static void licmStmt(Stmt *stmt);
+
+// hoists the invariant code of one loop, the values of its entry test go in front of the loop and the
+// values of its body into the preheader, which runs only once the entry test has passed
+static void licmLoop(Stmt *stmt)
+{
+    LoopState state = {{{NULL, 0, 0}, false, false}, NULL, 0, 0};
+    collectSymbolsStmt(stmt, &state.effects.assigned, COLLECT_ASSIGNED);
+    collectEffectsStmt(stmt, &state.effects);
+
+    StatementList outer;
+    statementListInit(&outer, 0);
+    Stmt *preheader = emptyStmt(COMPOUND_STMT);
+    StatementList *preheaderList = &preheader->compoundStmt->stmtList;
+    Stmt *init = NULL;
+
+    if (stmt->type == WHILE_STMT)
+    {
+        WhileStmt *whileStmt = stmt->whileStmt;
+        if (whileStmt->doWhile)
+        {
+            // the body always runs once, there is no entry test to place the values behind
+            hoistStmt(whileStmt->body, &state, true, &outer);
+            hoistExpr(whileStmt->condition, &state, false, &outer);
+        }
+        else
+        {
+            hoistExpr(whileStmt->condition, &state, true, &outer);
+            hoistStmt(whileStmt->body, &state, true, preheaderList);
+        }
+    }
+    else
+    {
+        ForStmt *forStmt = stmt->forStmt;
+        if (forStmt->condition->exprStmt->expr != NULL)
+        {
+            hoistExpr(forStmt->condition->exprStmt->expr, &state, true, &outer);
+        }
+        hoistStmt(forStmt->body, &state, true, preheaderList);
+        if (forStmt->modifier != NULL)
+        {
+            hoistExpr(forStmt->modifier, &state, false, preheaderList);
+        }
+        if (outer.size != 0)
+        {
+            // the initialiser has to run before the hoisted values are computed
+            init = forStmt->init;
+            forStmt->init = emptyStmt(EXPR_STMT);
+        }
+    }
+
+    Stmt **preheaderSlot = stmt->type == WHILE_STMT ? &stmt->whileStmt->preheader : &stmt->forStmt->preheader;
+    if (preheaderList->size != 0)
+    {
+        if (*preheaderSlot != NULL)
+        {
+            statementListPush(preheaderList, *preheaderSlot);
+        }
+        *preheaderSlot = preheader;
+    }
+    else
+    {
+        stmtDestroy(preheader);
+    }
+
+    if (outer.size != 0)
+    {
+        wrapLoop(stmt, init, &outer);
+    }
+    free(outer.stmts);
+    symbolSetClear(&state.effects.assigned);
+    free(state.hoisted);
+}
+
+// inner loops are done first so that their hoisted code can move further out
+static void licmStmt(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        licmStmt(stmt->whileStmt->body);
+        licmLoop(stmt);
+        break;
+    case FOR_STMT:
+        licmStmt(stmt->forStmt->body);
+        licmLoop(stmt);
+        break;
+    case IF_STMT:
+        licmStmt(stmt->ifStmt->trueBody);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            licmStmt(stmt->ifStmt->falseBody);
+        }
+        break;
+    case SWITCH_STMT:
+        licmStmt(stmt->switchStmt->body);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            licmStmt(stmt->compoundStmt->stmtList.stmts[i]);
+        }
+        break;
+    case LABEL_STMT:
+        licmStmt(stmt->labelStmt->body);
+        break;
+    default:
+        break;
+    }
+}
+
+// a pointer that replaces base + counter in a counted loop
+typedef struct DerivedPointer
+{
+    Expr *base; // operand of the initial value, pointers with equal bases are shared
+    SymbolEntry *temp;
+    size_t elementSize;
+} DerivedPointer;
+
+typedef struct InductionState
+{
+    SymbolEntry *counter;
+    int32_t step;
+    LoopEffects effects;
+    DerivedPointer *pointers;
+    size_t pointersSize;
+    size_t pointersCapacity;
+    StatementList init; // initial values of the pointers, computed in front of the loop
+} InductionState;
+
+// body of the function being reduced, used to check whether a counter is read after its loop
+static Stmt *currentBody = NULL;
+
+static bool isCounter(const Expr *expr, const SymbolEntry *counter)
+{
+    return expr != NULL && expr->type == VARIABLE_EXPR && expr->variable->symbolEntry == counter;
+}
+
+// recognises i++, ++i, i--, --i, i += c, i -= c and i = i + c
+static bool counterStep(const Expr *modifier, SymbolEntry **counter, int32_t *step)
+{
+    if (modifier->type == OPERATION_EXPR)
+    {
+        const OperationExpr *operation = modifier->operation;
+        if (operation->op1 == NULL || operation->op1->type != VARIABLE_EXPR)
+        {
+            return false;
+        }
+        switch (operation->operator)
+        {
+        case INC:
+        case INC_POST:
+            *step = 1;
+            break;
+        case DEC:
+        case DEC_POST:
+            *step = -1;
+            break;
+        default:
+            return false;
+        }
+        *counter = operation->op1->variable->symbolEntry;
+        return true;
+    }
+    if (modifier->type != ASSIGN_EXPR || modifier->assignment->lvalue != NULL)
+    {
+        return false;
+    }
+    const AssignExpr *assign = modifier->assignment;
+    const Expr *amount = assign->op;
+    if (assign->operator== NOT && amount->type == OPERATION_EXPR && amount->operation->operator== ADD)
+    {
+        const OperationExpr *sum = amount->operation;
+        if (isCounter(sum->op1, assign->symbolEntry))
+        {
+            amount = sum->op2;
+        }
+        else if (isCounter(sum->op2, assign->symbolEntry))
+        {
+            amount = sum->op1;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (assign->operator!= ADD && assign->operator!= SUB)
+    {
+        return false;
+    }
+    if (amount->type != CONSTANT_EXPR || amount->constant->isString || amount->constant->type != INT_TYPE)
+    {
+        return false;
+    }
+    *step = assign->operator== SUB ? -amount->constant->int_const : amount->constant->int_const;
+    *counter = assign->symbolEntry;
+    return *step != 0;
+}
+
+// the counter of a counted for-loop, a local int changed only by a constant step in the modifier
+static SymbolEntry *loopCounter(ForStmt *forStmt, int32_t *step)
+{
+    SymbolEntry *counter = NULL;
+    if (forStmt->modifier == NULL || !counterStep(forStmt->modifier, &counter, step))
+    {
+        return NULL;
+    }
+    if (counter == NULL || counter->entryType != VARIABLE_ENTRY || counter->isGlobal || counter->type.isStruct ||
+        counter->type.dataType != INT_TYPE || symbolSetContains(&addressTaken, counter))
+    {
+        return NULL;
+    }
+    SymbolSet assigned = {NULL, 0, 0};
+    collectSymbolsStmt(forStmt->condition, &assigned, COLLECT_ASSIGNED);
+    collectSymbolsStmt(forStmt->body, &assigned, COLLECT_ASSIGNED);
+    bool counted = !symbolSetContains(&assigned, counter);
+    symbolSetClear(&assigned);
+    return counted ? counter : NULL;
+}
+
+static bool readsCounterExpr(const Expr *expr, const SymbolEntry *counter)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        return expr->variable->symbolEntry == counter;
+    case OPERATION_EXPR:
+        return readsCounterExpr(expr->operation->op1, counter) ||
+               (expr->operation->op2 != NULL && readsCounterExpr(expr->operation->op2, counter)) ||
+               (expr->operation->op3 != NULL && readsCounterExpr(expr->operation->op3, counter));
+    case ASSIGN_EXPR:
+    {
+        const AssignExpr *assign = expr->assignment;
+        if (assign->lvalue == NULL && assign->operator!= NOT && assign->symbolEntry == counter)
+        {
+            return true;
+        }
+        return readsCounterExpr(assign->op, counter) ||
+               (assign->lvalue != NULL && readsCounterExpr(assign->lvalue, counter));
+    }
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            if (readsCounterExpr(expr->function->args[i], counter))
+            {
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+static bool containsStmt(const Stmt *stmt, const Stmt *target)
+{
+    if (stmt == target)
+    {
+        return true;
+    }
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return containsStmt(stmt->whileStmt->body, target);
+    case FOR_STMT:
+        return containsStmt(stmt->forStmt->body, target);
+    case IF_STMT:
+        return containsStmt(stmt->ifStmt->trueBody, target) ||
+               (stmt->ifStmt->falseBody != NULL && containsStmt(stmt->ifStmt->falseBody, target));
+    case SWITCH_STMT:
+        return containsStmt(stmt->switchStmt->body, target);
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            if (containsStmt(stmt->compoundStmt->stmtList.stmts[i], target))
+            {
+                return true;
+            }
+        }
+        return false;
+    case LABEL_STMT:
+        return containsStmt(stmt->labelStmt->body, target);
+    default:
+        return false;
+    }
+}
+
+// true for a for-loop initialiser that sets the counter without reading it
+static bool resetsCounter(const Stmt *init, const SymbolEntry *counter)
+{
+    if (init->type != EXPR_STMT || init->exprStmt->expr == NULL || init->exprStmt->expr->type != ASSIGN_EXPR)
+    {
+        return false;
+    }
+    const AssignExpr *assign = init->exprStmt->expr->assignment;
+    return assign->lvalue == NULL && assign->operator== NOT && assign->symbolEntry == counter &&
+           !readsCounterExpr(assign->op, counter);
+}
+
+// true if the statement sets the counter before anything in it can read it
+static bool startsWithReset(const Stmt *stmt, const SymbolEntry *counter)
+{
+    switch (stmt->type)
+    {
+    case EXPR_STMT:
+        return resetsCounter(stmt, counter);
+    case FOR_STMT:
+        return resetsCounter(stmt->forStmt->init, counter);
+    case COMPOUND_STMT:
+        return stmt->compoundStmt->declList.size == 0 && stmt->compoundStmt->stmtList.size != 0 &&
+               startsWithReset(stmt->compoundStmt->stmtList.stmts[0], counter);
+    default:
+        return false;
+    }
+}
+
+// true if the counter is read anywhere in stmt other than inside skip, reads that follow a later reset of
+// the counter cannot see the value skip leaves behind
+static bool readsCounterStmt(const Stmt *stmt, const Stmt *skip, const SymbolEntry *counter)
+{
+    if (stmt == skip)
+    {
+        return false;
+    }
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return readsCounterExpr(stmt->whileStmt->condition, counter) ||
+               readsCounterStmt(stmt->whileStmt->body, skip, counter);
+    case FOR_STMT:
+    {
+        const ForStmt *forStmt = stmt->forStmt;
+        if (skip != NULL && resetsCounter(forStmt->init, counter) && !containsStmt(stmt, skip))
+        {
+            return false;
+        }
+        return readsCounterStmt(forStmt->init, skip, counter) || readsCounterStmt(forStmt->condition, skip, counter) ||
+               (forStmt->modifier != NULL && readsCounterExpr(forStmt->modifier, counter)) ||
+               readsCounterStmt(forStmt->body, skip, counter);
+    }
+    case IF_STMT:
+        return readsCounterExpr(stmt->ifStmt->condition, counter) ||
+               readsCounterStmt(stmt->ifStmt->trueBody, skip, counter) ||
+               (stmt->ifStmt->falseBody != NULL && readsCounterStmt(stmt->ifStmt->falseBody, skip, counter));
+    case SWITCH_STMT:
+        return readsCounterExpr(stmt->switchStmt->selector, counter) ||
+               readsCounterStmt(stmt->switchStmt->body, skip, counter);
+    case EXPR_STMT:
+        return stmt->exprStmt->expr != NULL && readsCounterExpr(stmt->exprStmt->expr, counter);
+    case COMPOUND_STMT:
+    {
+        const CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            DeclInit *declInit = compoundStmt->declList.decls[i]->declInit;
+            if (declInit != NULL && declInit->initExpr != NULL && readsCounterExpr(declInit->initExpr, counter))
+            {
+                return true;
+            }
+        }
+        bool reset = false;
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            Stmt *child = compoundStmt->stmtList.stmts[i];
+            bool passesSkip = skip != NULL && containsStmt(child, skip);
+            if (child->type == LABEL_STMT)
+            {
+                // a case label can be entered without passing the reset
+                reset = false;
+            }
+            if (reset && skip != NULL && !passesSkip)
+            {
+                continue;
+            }
+            if (readsCounterStmt(child, skip, counter))
+            {
+                return true;
+            }
+            // only a reset after skip hides the value it leaves behind
+            reset = !passesSkip && (reset || startsWithReset(child, counter));
+        }
+        return false;
+    }
+    case LABEL_STMT:
+        return readsCounterStmt(stmt->labelStmt->body, skip, counter);
+    case JUMP_STMT:
+        return stmt->jumpStmt->expr != NULL && readsCounterExpr(stmt->jumpStmt->expr, counter);
+    }
+    return false;
+}
+
+// replaces base + counter with a pointer that starts at the same address
+static void derivePointer(Expr *expr, Expr *base, InductionState *state)
+{
+    DataType type = expr->operation->type;
+    size_t elementSize = typeSize(removerPtrFromType(type));
+    for (size_t i = 0; i < state->pointersSize; i++)
+    {
+        DerivedPointer *pointer = &state->pointers[i];
+        if (pointer->elementSize == elementSize && exprEqual(pointer->base, base))
+        {
+            clearExpr(expr);
+            makeEntryRead(expr, pointer->temp);
+            return;
+        }
+    }
+    SymbolEntry *temp = createTemp(currentFunc, type);
+    Expr *value = exprCreate(expr->type);
+    *value = *expr;
+    makeEntryRead(expr, temp);
+    statementListPush(&state->init, assignEntryStmt(temp, value));
+
+    if (state->pointersSize == state->pointersCapacity)
+    {
+        state->pointersCapacity = state->pointersCapacity == 0 ? 4 : state->pointersCapacity * 2;
+        state->pointers = realloc(state->pointers, sizeof(DerivedPointer) * state->pointersCapacity);
+        if (state->pointers == NULL)
+        {
+            abort();
+        }
+    }
+    state->pointers[state->pointersSize].base = base;
+    state->pointers[state->pointersSize].temp = temp;
+    state->pointers[state->pointersSize].elementSize = elementSize;
+    state->pointersSize++;
+}
+
+// a[i + c] from an unrolled loop, base + (i + c) becomes p + c * size with the offset in bytes
+static bool offsetAddress(Expr *expr, InductionState *state)
+{
+    OperationExpr *operation = expr->operation;
+    Expr **indexSlot = isPtr(returnType(operation->op1)) ? &operation->op2 : &operation->op1;
+    Expr *base = isPtr(returnType(operation->op1)) ? operation->op1 : operation->op2;
+    Expr *index = *indexSlot;
+    if (index->type != OPERATION_EXPR || index->operation->operator!= ADD || !isInvariant(base, &state->effects, false))
+    {
+        return false;
+    }
+    Expr *counter = index->operation->op1;
+    Expr *offset = index->operation->op2;
+    if (!isCounter(counter, state->counter))
+    {
+        counter = index->operation->op2;
+        offset = index->operation->op1;
+    }
+    if (!isCounter(counter, state->counter) || offset->type != CONSTANT_EXPR || offset->constant->isString ||
+        offset->constant->type != INT_TYPE)
+    {
+        return false;
+    }
+    DataType type = operation->type;
+    offset->constant->int_const *= (int32_t)typeSize(removerPtrFromType(type));
+    free(index->operation);
+    free(index);
+
+    Expr *address = operationCreate(ADD, type, base, counter);
+    derivePointer(address, address->operation->op1, state);
+    operation->op1 = address;
+    operation->op2 = offset;
+    operation->type = INT_TYPE;
+    return true;
+}
+
+static void reduceExpr(Expr *expr, InductionState *state)
+{
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        if (operation->operator== ADD && isPtr(operation->type))
+        {
+            // a[i] is *(a + i)
+            Expr *base = NULL;
+            if (isCounter(operation->op2, state->counter))
+            {
+                base = operation->op1;
+            }
+            else if (isCounter(operation->op1, state->counter))
+            {
+                base = operation->op2;
+            }
+            if (base != NULL && isPtr(returnType(base)) && isInvariant(base, &state->effects, false))
+            {
+                derivePointer(expr, base, state);
+                return;
+            }
+            if (offsetAddress(expr, state))
+            {
+                return;
+            }
+        }
+        reduceExpr(operation->op1, state);
+        if (operation->op2 != NULL)
+        {
+            reduceExpr(operation->op2, state);
+        }
+        if (operation->op3 != NULL)
+        {
+            reduceExpr(operation->op3, state);
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+        reduceExpr(expr->assignment->op, state);
+        if (expr->assignment->lvalue != NULL)
+        {
+            reduceExpr(expr->assignment->lvalue, state);
+        }
+        break;
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            reduceExpr(expr->function->args[i], state);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void reduceStmt(Stmt *stmt, InductionState *state)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        reduceExpr(stmt->whileStmt->condition, state);
+        reduceStmt(stmt->whileStmt->body, state);
+        break;
+    case FOR_STMT:
+        reduceStmt(stmt->forStmt->init, state);
+        reduceStmt(stmt->forStmt->condition, state);
+        if (stmt->forStmt->modifier != NULL)
+        {
+            reduceExpr(stmt->forStmt->modifier, state);
+        }
+        reduceStmt(stmt->forStmt->body, state);
+        break;
+    case IF_STMT:
+        reduceExpr(stmt->ifStmt->condition, state);
+        reduceStmt(stmt->ifStmt->trueBody, state);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            reduceStmt(stmt->ifStmt->falseBody, state);
+        }
+        break;
+    case SWITCH_STMT:
+        reduceExpr(stmt->switchStmt->selector, state);
+        reduceStmt(stmt->switchStmt->body, state);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            reduceExpr(stmt->exprStmt->expr, state);
+        }
+        break;
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            DeclInit *declInit = compoundStmt->declList.decls[i]->declInit;
+            if (declInit != NULL && declInit->initExpr != NULL)
+            {
+                reduceExpr(declInit->initExpr, state);
+            }
+        }
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            reduceStmt(compoundStmt->stmtList.stmts[i], state);
+        }
+        break;
+    }
+    case LABEL_STMT:
+        reduceStmt(stmt->labelStmt->body, state);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            reduceExpr(stmt->jumpStmt->expr, state);
+        }
+        break;
+    }
+}
+
+// matches an exit test of the form counter op limit, with the limit invariant and op agreeing with
+// the direction of the step, n > i is returned as i < n
+static bool exitTest(Expr *condition, const SymbolEntry *counter, int32_t step, const LoopEffects *effects,
+                     Operator *operator, Expr ***counterSlot, Expr ***limitSlot)
+{
+    if (condition == NULL || condition->type != OPERATION_EXPR)
+    {
+        return false;
+    }
+    OperationExpr *compare = condition->operation;
+    Operator test = compare->operator;
+    *counterSlot = &compare->op1;
+    *limitSlot = &compare->op2;
+    if (isCounter(compare->op2, counter))
+    {
+        *counterSlot = &compare->op2;
+        *limitSlot = &compare->op1;
+        test = test == LT ? GT : test == GT ? LT : test == LE ? GE : test == GE ? LE : test;
+    }
+    if (!isCounter(**counterSlot, counter))
+    {
+        return false;
+    }
+    bool upwards = step > 0;
+    if (!(test == NE || ((test == LT || test == LE) && upwards) || ((test == GT || test == GE) && !upwards)))
+    {
+        return false;
+    }
+    DataType limitType = returnType(**limitSlot);
+    *operator= test;
+    return (limitType == INT_TYPE || limitType == SHORT_TYPE || limitType == CHAR_TYPE || limitType == SIGNED_CHAR_TYPE) &&
+           !readsCounterExpr(**limitSlot, counter) && isInvariant(**limitSlot, effects, false);
+}
+
+// linear-function test replacement, once the counter is only used by its own update and the exit
+// test, i < n becomes p < p + (n - i) and the counter no longer has to be kept
+static bool replaceExitTest(Stmt *loop, InductionState *state)
+{
+    ForStmt *forStmt = loop->forStmt;
+    Expr *condition = forStmt->condition->exprStmt->expr;
+    if (readsCounterStmt(forStmt->body, NULL, state->counter) || readsCounterStmt(currentBody, loop, state->counter))
+    {
+        return false;
+    }
+    Operator operator;
+    Expr **counterSlot;
+    Expr **limitSlot;
+    if (!exitTest(condition, state->counter, state->step, &state->effects, &operator, &counterSlot, &limitSlot))
+    {
+        return false;
+    }
+
+    // the distance is taken while the counter still holds its initial value
+    const DerivedPointer *pointer = &state->pointers[0];
+    DataType type = pointer->temp->type.dataType;
+    Expr *distance = operationCreate(SUB, INT_TYPE, *limitSlot, entryRead(state->counter));
+    SymbolEntry *end = createTemp(currentFunc, type);
+    statementListPush(&state->init, assignEntryStmt(end, operationCreate(ADD, type, entryRead(pointer->temp), distance)));
+
+    *limitSlot = entryRead(end);
+    variableExprDestroy((*counterSlot)->variable);
+    makeEntryRead(*counterSlot, pointer->temp);
+    return true;
+}
+
+// strength reduction of a[i] in a counted for-loop, each a + i becomes a pointer bumped by the
+// element size alongside the counter
+static void reduceLoop(Stmt *stmt)
+{
+    ForStmt *forStmt = stmt->forStmt;
+    InductionState state = {NULL, 0, {{NULL, 0, 0}, false, false}, NULL, 0, 0, {0, 0, NULL}};
+    state.counter = loopCounter(forStmt, &state.step);
+    if (state.counter == NULL)
+    {
+        return;
+    }
+
+    collectSymbolsStmt(stmt, &state.effects.assigned, COLLECT_ASSIGNED);
+    collectEffectsStmt(stmt, &state.effects);
+    reduceStmt(forStmt->body, &state);
+
+    if (state.pointersSize != 0)
+    {
+        Expr *modifier = replaceExitTest(stmt, &state) ? NULL : forStmt->modifier;
+        if (modifier == NULL)
+        {
+            exprDestroy(forStmt->modifier);
+        }
+        for (size_t i = 0; i < state.pointersSize; i++)
+        {
+            DerivedPointer *pointer = &state.pointers[i];
+            // the byte offset is added without scaling
+            Expr *offset = intConstantExpr(state.step * (int32_t)pointer->elementSize);
+            Expr *bump = assignEntryExpr(pointer->temp, operationCreate(ADD, INT_TYPE, entryRead(pointer->temp), offset));
+            modifier = modifier == NULL ? bump : operationCreate(COMMA_OP, returnType(bump), modifier, bump);
+        }
+        forStmt->modifier = modifier;
+
+        // { init; pointers; for (; condition; modifier) }
+        Stmt *init = forStmt->init;
+        forStmt->init = emptyStmt(EXPR_STMT);
+        wrapLoop(stmt, init, &state.init);
+    }
+    free(state.init.stmts);
+    symbolSetClear(&state.effects.assigned);
+    free(state.pointers);
+}
+
+static void reduceLoops(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        reduceLoops(stmt->whileStmt->body);
+        break;
+    case FOR_STMT:
+        reduceLoops(stmt->forStmt->body);
+        reduceLoop(stmt);
+        break;
+    case IF_STMT:
+        reduceLoops(stmt->ifStmt->trueBody);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            reduceLoops(stmt->ifStmt->falseBody);
+        }
+        break;
+    case SWITCH_STMT:
+        reduceLoops(stmt->switchStmt->body);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            reduceLoops(stmt->compoundStmt->stmtList.stmts[i]);
+        }
+        break;
+    case LABEL_STMT:
+        reduceLoops(stmt->labelStmt->body);
+        break;
+    default:
+        break;
+    }
+}
+
+// constant-trip loops up to this many iterations are unrolled completely
+#define FULL_UNROLL_TRIPS 16
+
+// growth still allowed in the current function, counted in AST nodes
+static size_t budgetLeft = 0;
+
+// size of an expression in AST nodes
+size_t exprSize(const Expr *expr)
+{
+    switch (expr->type)
+    {
+    case OPERATION_EXPR:
+        return 1 + exprSize(expr->operation->op1) + (expr->operation->op2 == NULL ? 0 : exprSize(expr->operation->op2)) +
+               (expr->operation->op3 == NULL ? 0 : exprSize(expr->operation->op3));
+    case ASSIGN_EXPR:
+        return 1 + exprSize(expr->assignment->op) +
+               (expr->assignment->lvalue == NULL ? 0 : exprSize(expr->assignment->lvalue));
+    case FUNC_EXPR:
+    {
+        size_t size = 1;
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            size += exprSize(expr->function->args[i]);
+        }
+        return size;
+    }
+    default:
+        return 1;
+    }
+}
+
+// size of a loop body that can be copied, 0 if it declares variables, jumps or holds statements
+// that own labels
+static size_t bodySize(const Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case EXPR_STMT:
+        return stmt->exprStmt->expr == NULL ? 1 : exprSize(stmt->exprStmt->expr);
+    case IF_STMT:
+    {
+        size_t trueSize = bodySize(stmt->ifStmt->trueBody);
+        size_t falseSize = stmt->ifStmt->falseBody == NULL ? 1 : bodySize(stmt->ifStmt->falseBody);
+        if (trueSize == 0 || falseSize == 0)
+        {
+            return 0;
+        }
+        return exprSize(stmt->ifStmt->condition) + trueSize + falseSize;
+    }
+    case COMPOUND_STMT:
+    {
+        if (stmt->compoundStmt->declList.size != 0)
+        {
+            return 0;
+        }
+        size_t size = 1;
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            size_t childSize = bodySize(stmt->compoundStmt->stmtList.stmts[i]);
+            if (childSize == 0)
+            {
+                return 0;
+            }
+            size += childSize;
+        }
+        return size;
+    }
+    default:
+        return 0;
+    }
+}
+
+static void replaceCounterExpr(Expr *expr, const SymbolEntry *counter, const Expr *replacement)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        if (expr->variable->symbolEntry == counter)
+        {
+            Expr *copy = exprCopy(replacement);
+            variableExprDestroy(expr->variable);
+            *expr = *copy;
+            free(copy);
+        }
+        break;
+    case OPERATION_EXPR:
+        replaceCounterExpr(expr->operation->op1, counter, replacement);
+        if (expr->operation->op2 != NULL)
+        {
+            replaceCounterExpr(expr->operation->op2, counter, replacement);
+        }
+        if (expr->operation->op3 != NULL)
+        {
+            replaceCounterExpr(expr->operation->op3, counter, replacement);
+        }
+        break;
+    case ASSIGN_EXPR:
+        replaceCounterExpr(expr->assignment->op, counter, replacement);
+        if (expr->assignment->lvalue != NULL)
+        {
+            replaceCounterExpr(expr->assignment->lvalue, counter, replacement);
+        }
+        break;
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            replaceCounterExpr(expr->function->args[i], counter, replacement);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// substitutes the counter in a copied body, folding what becomes constant
+static void replaceCounterStmt(Stmt *stmt, const SymbolEntry *counter, const Expr *replacement)
+{
+    switch (stmt->type)
+    {
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            replaceCounterExpr(stmt->exprStmt->expr, counter, replacement);
+            foldExpr(stmt->exprStmt->expr);
+        }
+        break;
+    case IF_STMT:
+        replaceCounterExpr(stmt->ifStmt->condition, counter, replacement);
+        foldExpr(stmt->ifStmt->condition);
+        replaceCounterStmt(stmt->ifStmt->trueBody, counter, replacement);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            replaceCounterStmt(stmt->ifStmt->falseBody, counter, replacement);
+        }
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            replaceCounterStmt(stmt->compoundStmt->stmtList.stmts[i], counter, replacement);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static bool constantStart(const Stmt *init, const SymbolEntry *counter, int32_t *start)
+{
+    if (!resetsCounter(init, counter))
+    {
+        return false;
+    }
+    const Expr *value = init->exprStmt->expr->assignment->op;
+    if (value->type != CONSTANT_EXPR || value->constant->isString || value->constant->type != INT_TYPE)
+    {
+        return false;
+    }
+    *start = value->constant->int_const;
+    return true;
+}
+
+// number of iterations of counter op limit stepping from start, false if the loop never ends
+static bool tripCount(int32_t start, int32_t limit, Operator operator, int32_t step, int64_t *trips)
+{
+    int64_t distance = (int64_t)limit - start;
+    switch (operator)
+    {
+    case LT:
+        *trips = distance > 0 ? (distance + step - 1) / step : 0;
+        return true;
+    case LE:
+        *trips = distance >= 0 ? distance / step + 1 : 0;
+        return true;
+    case GT:
+        *trips = distance < 0 ? (distance + step + 1) / step : 0;
+        return true;
+    case GE:
+        *trips = distance <= 0 ? distance / step + 1 : 0;
+        return true;
+    case NE:
+        *trips = distance / step;
+        return distance % step == 0 && *trips >= 0;
+    default:
+        return false;
+    }
+}
+
+// { body[i = start]; ...; body[i = start + (trips - 1) * step]; i = start + trips * step; }, the
+// final assignment is only kept if the counter is read after the loop
+static void unrollFully(Stmt *stmt, SymbolEntry *counter, int32_t start, int32_t step, int64_t trips)
+{
+    ForStmt *forStmt = stmt->forStmt;
+    Stmt *unrolled = emptyStmt(COMPOUND_STMT);
+    for (int64_t i = 0; i < trips; i++)
+    {
+        Stmt *copy = stmtCopy(forStmt->body);
+        Expr *value = intConstantExpr(start + (int32_t)i * step);
+        replaceCounterStmt(copy, counter, value);
+        exprDestroy(value);
+        statementListPush(&unrolled->compoundStmt->stmtList, copy);
+    }
+    if (readsCounterStmt(currentBody, stmt, counter))
+    {
+        statementListPush(&unrolled->compoundStmt->stmtList,
+                          assignEntryStmt(counter, intConstantExpr(start + (int32_t)trips * step)));
+    }
+
+    Stmt *loop = stmtCreate(FOR_STMT);
+    *loop = *stmt;
+    stmtDestroy(loop);
+    *stmt = *unrolled;
+    free(unrolled);
+}
+
+// n - reach for a constant n, the unrolled loop tests i < n - reach because i + reach < n wraps when n is near
+// INT_MAX, false if the bound is out of range and the unrolled loop could never run
+static bool guardBound(const Expr *limit, int32_t step, int64_t *bound)
+{
+    *bound = (int64_t)limit->constant->int_const - ((int64_t)unrollFactor - 1) * step;
+    return *bound >= INT32_MIN && *bound <= INT32_MAX;
+}
+
+// { init; if (n - reach fits) for (; i < n - reach; i += factor * step) { body[i]; ...; body[i + reach]; }
+// for (; i < n; i += step) body; } with reach = (factor - 1) * step, the second loop runs what is left over
+// and is not needed when the factor divides a known trip count, a constant bound needs no test
+static void unrollPartially(Stmt *stmt, SymbolEntry *counter, int32_t step, Operator operator, const Expr *limit, bool exact)
+{
+    ForStmt *forStmt = stmt->forStmt;
+    int32_t factor = (int32_t)unrollFactor;
+    Stmt *body = emptyStmt(COMPOUND_STMT);
+    for (int32_t i = 0; i < factor; i++)
+    {
+        Stmt *copy = stmtCopy(forStmt->body);
+        if (i != 0)
+        {
+            Expr *next = operationCreate(ADD, INT_TYPE, entryRead(counter), intConstantExpr(i * step));
+            replaceCounterStmt(copy, counter, next);
+            exprDestroy(next);
+        }
+        statementListPush(&body->compoundStmt->stmtList, copy);
+    }
+    AssignExpr *bump = assignExprCreate(intConstantExpr(factor * step), ADD);
+    bump->ident = copyIdent(counter->ident);
+    bump->symbolEntry = counter;
+    bump->type = INT_TYPE;
+    Expr *modifier = exprCreate(ASSIGN_EXPR);
+    modifier->assignment = bump;
+
+    if (exact)
+    {
+        stmtDestroy(forStmt->body);
+        exprDestroy(forStmt->modifier);
+        forStmt->body = body;
+        forStmt->modifier = modifier;
+        return;
+    }
+
+    int32_t reach = (factor - 1) * step;
+    int64_t constantBound;
+    Expr *bound;
+    Expr *fits = NULL;
+    if (limit->type == CONSTANT_EXPR && limit->constant->type == INT_TYPE)
+    {
+        guardBound(limit, step, &constantBound);
+        bound = intConstantExpr((int32_t)constantBound);
+    }
+    else
+    {
+        bound = operationCreate(SUB, INT_TYPE, exprCopy(limit), intConstantExpr(reach));
+        fits = step > 0 ? operationCreate(GE, INT_TYPE, exprCopy(limit), intConstantExpr(INT32_MIN + reach))
+                        : operationCreate(LE, INT_TYPE, exprCopy(limit), intConstantExpr(INT32_MAX + reach));
+    }
+    Stmt *condition = emptyStmt(EXPR_STMT);
+    condition->exprStmt->expr = operationCreate(operator, INT_TYPE, entryRead(counter), bound);
+    Stmt *unrolled = stmtCreate(FOR_STMT);
+    unrolled->forStmt = forStmtCreate(emptyStmt(EXPR_STMT), condition, body);
+    unrolled->forStmt->modifier = modifier;
+    unrolled->forStmt->symbolEntry = forEntryCreate();
+    registerEntry(unrolled->forStmt->symbolEntry);
+    if (fits != NULL)
+    {
+        Stmt *guarded = stmtCreate(IF_STMT);
+        guarded->ifStmt = ifStmtCreate(fits, unrolled);
+        unrolled = guarded;
+    }
+
+    StatementList before;
+    statementListInit(&before, 0);
+    statementListPush(&before, unrolled);
+    Stmt *init = forStmt->init;
+    forStmt->init = emptyStmt(EXPR_STMT);
+    wrapLoop(stmt, init, &before);
+    free(before.stmts);
+}
+
+static void unrollLoop(Stmt *stmt)
+{
+    ForStmt *forStmt = stmt->forStmt;
+    int32_t step;
+    SymbolEntry *counter = loopCounter(forStmt, &step);
+    size_t size = counter == NULL ? 0 : bodySize(forStmt->body);
+    if (size == 0)
+    {
+        return;
+    }
+
+    LoopEffects effects = {{NULL, 0, 0}, false, false};
+    collectSymbolsStmt(stmt, &effects.assigned, COLLECT_ASSIGNED);
+    collectEffectsStmt(stmt, &effects);
+    Operator operator;
+    Expr **counterSlot;
+    Expr **limitSlot;
+    bool counted = exitTest(forStmt->condition->exprStmt->expr, counter, step, &effects, &operator, &counterSlot, &limitSlot);
+    symbolSetClear(&effects.assigned);
+    if (!counted)
+    {
+        return;
+    }
+
+    int32_t start;
+    int64_t trips = 0;
+    const Expr *limit = *limitSlot;
+    bool known = constantStart(forStmt->init, counter, &start) && limit->type == CONSTANT_EXPR &&
+                 limit->constant->type == INT_TYPE && tripCount(start, limit->constant->int_const, operator, step, &trips);
+    if (known && trips <= FULL_UNROLL_TRIPS && (size_t)trips * size <= budgetLeft)
+    {
+        unrollFully(stmt, counter, start, step, trips);
+        budgetLeft -= (size_t)trips * size;
+        return;
+    }
+    bool exact = known && trips % (int64_t)unrollFactor == 0;
+    int64_t bound;
+    if (operator== NE || unrollFactor < 2 || unrollFactor * size > budgetLeft || (known && trips < (int64_t)unrollFactor) ||
+        (!exact && limit->type == CONSTANT_EXPR && limit->constant->type == INT_TYPE && !guardBound(limit, step, &bound)))
+    {
+        return;
+    }
+    unrollPartially(stmt, counter, step, operator, limit, exact);
+    budgetLeft -= unrollFactor * size;
+}
+
+// only innermost loops qualify, their bodies cannot hold another loop
+static void unrollStmt(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        unrollStmt(stmt->whileStmt->body);
+        break;
+    case FOR_STMT:
+        unrollStmt(stmt->forStmt->body);
+        unrollLoop(stmt);
+        break;
+    case IF_STMT:
+        unrollStmt(stmt->ifStmt->trueBody);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            unrollStmt(stmt->ifStmt->falseBody);
+        }
+        break;
+    case SWITCH_STMT:
+        unrollStmt(stmt->switchStmt->body);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            unrollStmt(stmt->compoundStmt->stmtList.stmts[i]);
+        }
+        break;
+    case LABEL_STMT:
+        unrollStmt(stmt->labelStmt->body);
+        break;
+    default:
+        break;
+    }
+}
+
+// loop unrolling, run before the other loop passes so the copies are strength-reduced and hoisted too
+void unrollLoops(FuncDef *func)
+{
+    if (!unrollEnabled || func->body == NULL || containsGoto(func->body) || isColdFunc(func->ident))
+    {
+        return;
+    }
+    currentFunc = func->symbolEntry;
+    currentBody = func->body;
+    budgetLeft = unrollBudget;
+    collectSymbolsStmt(func->body, &addressTaken, COLLECT_ADDRESS_TAKEN);
+    unrollStmt(func->body);
+    symbolSetClear(&addressTaken);
+    currentBody = NULL;
+    currentFunc = NULL;
+}
+
+// induction-variable strength reduction, run before hoisting so the start values of the new pointers can move out too
+void reduceInductionVariables(FuncDef *func)
+{
+    if (func->body == NULL || containsGoto(func->body))
+    {
+        // a jump into a loop would skip the setup of its pointers
+        return;
+    }
+    currentFunc = func->symbolEntry;
+    currentBody = func->body;
+    collectSymbolsStmt(func->body, &addressTaken, COLLECT_ADDRESS_TAKEN);
+    reduceLoops(func->body);
+    symbolSetClear(&addressTaken);
+    currentBody = NULL;
+    currentFunc = NULL;
+}
+
+// loop-invariant code motion, values that do not change in a loop are computed once in front of it
+void hoistLoopInvariants(FuncDef *func)
+{
+    if (func->body == NULL)
+    {
+        return;
+    }
+    currentFunc = func->symbolEntry;
+    collectSymbolsStmt(func->body, &addressTaken, COLLECT_ADDRESS_TAKEN);
+    licmStmt(func->body);
+    symbolSetClear(&addressTaken);
+    currentFunc = NULL;
+}
@@ -0,0 +1,31 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ast.h"
+#include "optimise.h"
+
+// What a loop may change, a simple mod/ref summary
+typedef struct LoopEffects
+{
+    SymbolSet assigned; // variables written by name, declarations included
+    bool storesMemory;  // writes through a pointer
+    bool calls;         // calls may write any global or escaped local
+} LoopEffects;
+
+extern bool unrollEnabled;
+extern size_t unrollFactor;
+extern size_t unrollBudget;
+
+void collectEffectsExpr(const Expr *expr, LoopEffects *effects);
+void collectEffectsStmt(const Stmt *stmt, LoopEffects *effects);
+DataType tempType(Expr *expr);
+size_t exprSize(const Expr *expr);
+
+void unrollLoops(FuncDef *func);
+void reduceInductionVariables(FuncDef *func);
+void hoistLoopInvariants(FuncDef *func);
+
+#endif
@@ -0,0 +1,654 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "codegen.h"
+#include "mir.h"
+#include "peephole.h"
+
+// symbolEntryCreate reserves the frame bytes from 88 to 176 below fp for ft0-ft11 around calls, temporaries
+// are no longer kept there so they take the first spill slots, and any further ones extend the frame
+#define SPILL_AREA 88
+#define SPILL_AREA_SLOTS 12
+#define SPILL_SLOT_SIZE 8
+
+static const struct
+{
+    const char *name;
+    unsigned flags;
+} opcodeInfo[MOP_COUNT] = {
+    [MOP_LABEL] = {"", 0},
+    [MOP_DIRECTIVE] = {"", 0},
+    [MOP_OTHER] = {"", MF_DEFINES},
+    [MOP_ADD] = {"add", MF_DEFINES},
+    [MOP_ADDI] = {"addi", MF_DEFINES},
+    [MOP_SUB] = {"sub", MF_DEFINES},
+    [MOP_NEG] = {"neg", MF_DEFINES},
+    [MOP_MUL] = {"mul", MF_DEFINES},
+    [MOP_MULH] = {"mulh", MF_DEFINES},
+    [MOP_MULHU] = {"mulhu", MF_DEFINES},
+    [MOP_DIV] = {"div", MF_DEFINES},
+    [MOP_DIVU] = {"divu", MF_DEFINES},
+    [MOP_REM] = {"rem", MF_DEFINES},
+    [MOP_REMU] = {"remu", MF_DEFINES},
+    [MOP_AND] = {"and", MF_DEFINES},
+    [MOP_ANDI] = {"andi", MF_DEFINES},
+    [MOP_OR] = {"or", MF_DEFINES},
+    [MOP_ORI] = {"ori", MF_DEFINES},
+    [MOP_XOR] = {"xor", MF_DEFINES},
+    [MOP_XORI] = {"xori", MF_DEFINES},
+    [MOP_NOT] = {"not", MF_DEFINES},
+    [MOP_SLL] = {"sll", MF_DEFINES},
+    [MOP_SLLI] = {"slli", MF_DEFINES},
+    [MOP_SRL] = {"srl", MF_DEFINES},
+    [MOP_SRLI] = {"srli", MF_DEFINES},
+    [MOP_SRA] = {"sra", MF_DEFINES},
+    [MOP_SRAI] = {"srai", MF_DEFINES},
+    [MOP_SLT] = {"slt", MF_DEFINES},
+    [MOP_SLTI] = {"slti", MF_DEFINES},
+    [MOP_SLTU] = {"sltu", MF_DEFINES},
+    [MOP_SLTIU] = {"sltiu", MF_DEFINES},
+    [MOP_SEQZ] = {"seqz", MF_DEFINES},
+    [MOP_SNEZ] = {"snez", MF_DEFINES},
+    [MOP_LI] = {"li", MF_DEFINES},
+    [MOP_LUI] = {"lui", MF_DEFINES},
+    [MOP_LA] = {"la", MF_DEFINES},
+    [MOP_MV] = {"mv", MF_DEFINES},
+    [MOP_LB] = {"lb", MF_DEFINES | MF_LOAD},
+    [MOP_LBU] = {"lbu", MF_DEFINES | MF_LOAD},
+    [MOP_LH] = {"lh", MF_DEFINES | MF_LOAD},
+    [MOP_LHU] = {"lhu", MF_DEFINES | MF_LOAD},
+    [MOP_LW] = {"lw", MF_DEFINES | MF_LOAD},
+    [MOP_FLW] = {"flw", MF_DEFINES | MF_LOAD},
+    [MOP_FLD] = {"fld", MF_DEFINES | MF_LOAD},
+    [MOP_SB] = {"sb", MF_STORE},
+    [MOP_SH] = {"sh", MF_STORE},
+    [MOP_SW] = {"sw", MF_STORE},
+    [MOP_FSW] = {"fsw", MF_STORE},
+    [MOP_FSD] = {"fsd", MF_STORE},
+    [MOP_FADD_S] = {"fadd.s", MF_DEFINES},
+    [MOP_FSUB_S] = {"fsub.s", MF_DEFINES},
+    [MOP_FMUL_S] = {"fmul.s", MF_DEFINES},
+    [MOP_FDIV_S] = {"fdiv.s", MF_DEFINES},
+    [MOP_FNEG_S] = {"fneg.s", MF_DEFINES},
+    [MOP_FMV_S] = {"fmv.s", MF_DEFINES},
+    [MOP_FADD_D] = {"fadd.d", MF_DEFINES},
+    [MOP_FSUB_D] = {"fsub.d", MF_DEFINES},
+    [MOP_FMUL_D] = {"fmul.d", MF_DEFINES},
+    [MOP_FDIV_D] = {"fdiv.d", MF_DEFINES},
+    [MOP_FNEG_D] = {"fneg.d", MF_DEFINES},
+    [MOP_FMV_D] = {"fmv.d", MF_DEFINES},
+    [MOP_FEQ_S] = {"feq.s", MF_DEFINES},
+    [MOP_FLT_S] = {"flt.s", MF_DEFINES},
+    [MOP_FLE_S] = {"fle.s", MF_DEFINES},
+    [MOP_FEQ_D] = {"feq.d", MF_DEFINES},
+    [MOP_FLT_D] = {"flt.d", MF_DEFINES},
+    [MOP_FLE_D] = {"fle.d", MF_DEFINES},
+    [MOP_FMV_W_X] = {"fmv.w.x", MF_DEFINES},
+    [MOP_FMV_X_W] = {"fmv.x.w", MF_DEFINES},
+    [MOP_FCVT_S_W] = {"fcvt.s.w", MF_DEFINES},
+    [MOP_FCVT_W_S] = {"fcvt.w.s", MF_DEFINES},
+    [MOP_FCVT_D_W] = {"fcvt.d.w", MF_DEFINES},
+    [MOP_FCVT_W_D] = {"fcvt.w.d", MF_DEFINES},
+    [MOP_FCVT_S_D] = {"fcvt.s.d", MF_DEFINES},
+    [MOP_FCVT_D_S] = {"fcvt.d.s", MF_DEFINES},
+    [MOP_RDCYCLE] = {"rdcycle", MF_DEFINES},
+    [MOP_RDINSTRET] = {"rdinstret", MF_DEFINES},
+    [MOP_BEQ] = {"beq", MF_BRANCH},
+    [MOP_BNE] = {"bne", MF_BRANCH},
+    [MOP_BLT] = {"blt", MF_BRANCH},
+    [MOP_BGE] = {"bge", MF_BRANCH},
+    [MOP_BLTU] = {"bltu", MF_BRANCH},
+    [MOP_BGEU] = {"bgeu", MF_BRANCH},
+    [MOP_BEQZ] = {"beqz", MF_BRANCH},
+    [MOP_BNEZ] = {"bnez", MF_BRANCH},
+    [MOP_J] = {"j", MF_JUMP},
+    [MOP_JR] = {"jr", MF_EXIT},
+    [MOP_CALL] = {"call", MF_CALL},
+    [MOP_TAIL] = {"tail", MF_EXIT},
+    [MOP_RET] = {"ret", MF_EXIT},
+    [MOP_NOP] = {"nop", 0},
+};
+
+bool isVirtualReg(Reg reg)
+{
+    return reg >= VREG_BASE;
+}
+
+bool isFloatReg(Reg reg)
+{
+    return isVirtualReg(reg) ? (reg - VREG_BASE) % 2 == 1 : reg >= FT0;
+}
+
+void mirCreate(MachineFunc *func, size_t frameSize)
+{
+    memset(func, 0, sizeof(MachineFunc));
+    func->frameSize = frameSize;
+}
+
+void mirDestroy(MachineFunc *func)
+{
+    for (size_t i = 0; i < func->stringCount; i++)
+    {
+        free(func->strings[i]);
+    }
+    free(func->strings);
+    free(func->opcodes);
+    free(func->operandCounts);
+    free(func->texts);
+    free(func->operands);
+    free(func->frame);
+    memset(func, 0, sizeof(MachineFunc));
+}
+
+static size_t addString(MachineFunc *func, const char *text, size_t length)
+{
+    for (size_t i = 0; i < func->stringCount; i++)
+    {
+        if (strncmp(func->strings[i], text, length) == 0 && func->strings[i][length] == '\0')
+        {
+            return i;
+        }
+    }
+    if (func->stringCount == func->stringCapacity)
+    {
+        func->stringCapacity = func->stringCapacity == 0 ? 16 : func->stringCapacity * 2;
+        func->strings = realloc(func->strings, sizeof(char *) * func->stringCapacity);
+        if (func->strings == NULL)
+        {
+            abort();
+        }
+    }
+    char *string = malloc(length + 1);
+    if (string == NULL)
+    {
+        abort();
+    }
+    memcpy(string, text, length);
+    string[length] = '\0';
+    func->strings[func->stringCount] = string;
+    return func->stringCount++;
+}
+
+size_t mirAddString(MachineFunc *func, const char *text)
+{
+    return addString(func, text, strlen(text));
+}
+
+const char *mirString(const MachineFunc *func, size_t string)
+{
+    return func->strings[string];
+}
+
+const char *mirOpcodeName(MachineOpcode opcode)
+{
+    return opcodeInfo[opcode].name;
+}
+
+unsigned mirFlags(const MachineFunc *func, size_t index)
+{
+    return opcodeInfo[func->opcodes[index]].flags;
+}
+
+MachineOperand *mirOperand(const MachineFunc *func, size_t index, size_t operand)
+{
+    return &func->operands[index * MIR_MAX_OPERANDS + operand];
+}
+
+// makes room for an instruction without operands at index, those after it move up by one
+size_t mirInsert(MachineFunc *func, size_t index, MachineOpcode opcode)
+{
+    if (func->size == func->capacity)
+    {
+        func->capacity = func->capacity == 0 ? 64 : func->capacity * 2;
+        func->opcodes = realloc(func->opcodes, sizeof(uint8_t) * func->capacity);
+        func->operandCounts = realloc(func->operandCounts, sizeof(uint8_t) * func->capacity);
+        func->texts = realloc(func->texts, sizeof(size_t) * func->capacity);
+        func->operands = realloc(func->operands, sizeof(MachineOperand) * MIR_MAX_OPERANDS * func->capacity);
+        if (func->opcodes == NULL || func->operandCounts == NULL || func->texts == NULL || func->operands == NULL)
+        {
+            abort();
+        }
+    }
+    size_t moved = func->size - index;
+    memmove(&func->opcodes[index + 1], &func->opcodes[index], sizeof(uint8_t) * moved);
+    memmove(&func->operandCounts[index + 1], &func->operandCounts[index], sizeof(uint8_t) * moved);
+    memmove(&func->texts[index + 1], &func->texts[index], sizeof(size_t) * moved);
+    memmove(mirOperand(func, index + 1, 0), mirOperand(func, index, 0), sizeof(MachineOperand) * MIR_MAX_OPERANDS * moved);
+    func->size++;
+    func->opcodes[index] = opcode;
+    func->operandCounts[index] = 0;
+    func->texts[index] = NO_STRING;
+    return index;
+}
+
+size_t mirAppend(MachineFunc *func, MachineOpcode opcode)
+{
+    return mirInsert(func, func->size, opcode);
+}
+
+// appends a copy of an instruction of the same function
+size_t mirAppendCopy(MachineFunc *func, size_t index)
+{
+    size_t copy = mirAppend(func, func->opcodes[index]);
+    func->operandCounts[copy] = func->operandCounts[index];
+    func->texts[copy] = func->texts[index];
+    memcpy(mirOperand(func, copy, 0), mirOperand(func, index, 0), sizeof(MachineOperand) * MIR_MAX_OPERANDS);
+    return copy;
+}
+
+void mirRemove(MachineFunc *func, size_t first, size_t count)
+{
+    size_t moved = func->size - first - count;
+    memmove(&func->opcodes[first], &func->opcodes[first + count], sizeof(uint8_t) * moved);
+    memmove(&func->operandCounts[first], &func->operandCounts[first + count], sizeof(uint8_t) * moved);
+    memmove(&func->texts[first], &func->texts[first + count], sizeof(size_t) * moved);
+    memmove(mirOperand(func, first, 0), mirOperand(func, first + count, 0), sizeof(MachineOperand) * MIR_MAX_OPERANDS * moved);
+    func->size -= count;
+}
+
+MachineOperand *mirAddOperand(MachineFunc *func, size_t index, OperandKind kind)
+{
+    MachineOperand *operand = mirOperand(func, index, func->operandCounts[index]++);
+    operand->kind = kind;
+    operand->reg = ZERO;
+    operand->imm = 0;
+    operand->symbol = NO_STRING;
+    return operand;
+}
+
+Reg mirNewVreg(MachineFunc *func, bool isFloat)
+{
+    size_t number = func->vregLimit + (func->vregLimit % 2 != isFloat);
+    func->vregLimit = number + 1;
+    return VREG_BASE + number;
+}
+
+size_t mirNewSpillSlot(MachineFunc *func)
+{
+    func->frame = realloc(func->frame, sizeof(FrameObject) * (func->frameCount + 1));
+    if (func->frame == NULL)
+    {
+        abort();
+    }
+    func->frame[func->frameCount] = (FrameObject){0, true};
+    return func->frameCount++;
+}
+
+static size_t fixedSlot(MachineFunc *func, long displacement)
+{
+    for (size_t i = 0; i < func->frameCount; i++)
+    {
+        if (!func->frame[i].spill && func->frame[i].displacement == displacement)
+        {
+            return i;
+        }
+    }
+    size_t slot = mirNewSpillSlot(func);
+    func->frame[slot] = (FrameObject){displacement, false};
+    return slot;
+}
+
+static bool parseReg(MachineFunc *func, const char *text, Reg *reg)
+{
+    const char *digits = text[0] == 'v' ? text + 1 : text[0] == 'f' && text[1] == 'v' ? text + 2 : NULL;
+    if (digits != NULL && *digits >= '0' && *digits <= '9')
+    {
+        char *end;
+        long number = strtol(digits, &end, 10);
+        if (*end == '\0')
+        {
+            *reg = VREG_BASE + number;
+            if ((size_t)number >= func->vregLimit)
+            {
+                func->vregLimit = number + 1;
+            }
+            return true;
+        }
+    }
+    for (size_t i = 0; i < VREG_BASE; i++)
+    {
+        if (strcmp(regStr(i), text) == 0)
+        {
+            *reg = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseImm(const char *text, long *imm)
+{
+    char *end;
+    *imm = strtol(text, &end, 10);
+    return end != text && *end == '\0';
+}
+
+// labels, calls and jumps name symbols even where they look like registers
+static void parseOperand(MachineFunc *func, size_t index, const char *text, bool isSymbol)
+{
+    Reg reg;
+    long imm;
+    size_t length = strlen(text);
+    const char *base = strrchr(text, '(');
+    if (!isSymbol && parseReg(func, text, &reg))
+    {
+        mirAddOperand(func, index, MO_REG)->reg = reg;
+    }
+    else if (!isSymbol && parseImm(text, &imm))
+    {
+        mirAddOperand(func, index, MO_IMM)->imm = imm;
+    }
+    else if (!isSymbol && base != NULL && text[length - 1] == ')')
+    {
+        char name[OPERAND_LENGTH] = {0};
+        char displacement[OPERAND_LENGTH] = {0};
+        memcpy(name, base + 1, text + length - 1 - (base + 1));
+        memcpy(displacement, text, base - text);
+        if (!parseReg(func, name, &reg))
+        {
+            mirAddOperand(func, index, MO_SYMBOL)->symbol = addString(func, text, length);
+            return;
+        }
+        imm = 0;
+        bool numeric = displacement[0] == '\0' || parseImm(displacement, &imm);
+        if (numeric && reg == FP)
+        {
+            mirAddOperand(func, index, MO_FRAME)->symbol = fixedSlot(func, imm);
+            return;
+        }
+        MachineOperand *operand = mirAddOperand(func, index, MO_MEM);
+        operand->reg = reg;
+        if (numeric)
+        {
+            operand->imm = imm;
+        }
+        else
+        {
+            operand->symbol = addString(func, displacement, strlen(displacement));
+        }
+    }
+    else
+    {
+        mirAddOperand(func, index, MO_SYMBOL)->symbol = addString(func, text, length);
+    }
+}
+
+static MachineOpcode opcodeOf(const char *name)
+{
+    for (size_t i = MOP_ADD; i < MOP_COUNT; i++)
+    {
+        if (strcmp(opcodeInfo[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return MOP_OTHER;
+}
+
+// lowers the assembly codegen wrote for a function, virtual registers included
+// the branch taken exactly when the given one is not, MOP_OTHER if there is none
+MachineOpcode mirInvertBranch(MachineOpcode opcode)
+{
+    const char *inverse = invertBranch(mirOpcodeName(opcode));
+    return inverse == NULL ? MOP_OTHER : opcodeOf(inverse);
+}
+
+void mirBuild(MachineFunc *func, const InstrList *list)
+{
+    for (size_t i = 0; i < list->size; i++)
+    {
+        const Instr *instr = &list->instrs[i];
+        if (instr->deleted)
+        {
+            continue;
+        }
+        if (instr->kind == INSTR_LABEL)
+        {
+            size_t index = mirAppend(func, MOP_LABEL);
+            func->texts[index] = addString(func, instr->operands[0], strlen(instr->operands[0]));
+            continue;
+        }
+        if (instr->kind == INSTR_DIRECTIVE)
+        {
+            const char *text = instr->text + strspn(instr->text, " \t");
+            if (*text != '.' && *text != '#' && *text != '\n' && *text != '\0')
+            {
+                fprintf(stderr, "Unable to lower instruction %s, exiting...\n", text);
+                exit(EXIT_FAILURE);
+            }
+            size_t index = mirAppend(func, MOP_DIRECTIVE);
+            func->texts[index] = addString(func, instr->text, strcspn(instr->text, "\n"));
+            continue;
+        }
+        MachineOpcode opcode = opcodeOf(instr->opcode);
+        size_t index = mirAppend(func, opcode);
+        if (opcode == MOP_OTHER)
+        {
+            func->texts[index] = addString(func, instr->opcode, strlen(instr->opcode));
+        }
+        unsigned flags = opcodeInfo[opcode].flags;
+        for (size_t j = 0; j < instr->operandCount; j++)
+        {
+            bool isTarget = (flags & MF_BRANCH) && j == instr->operandCount - 1;
+            bool isSymbol = (flags & (MF_JUMP | MF_CALL)) || opcode == MOP_TAIL || opcode == MOP_LA || isTarget;
+            if (opcode == MOP_LA && j == 0)
+            {
+                isSymbol = false;
+            }
+            parseOperand(func, index, instr->operands[j], isSymbol);
+        }
+    }
+}
+
+static void writeOperand(const MachineFunc *func, const MachineOperand *operand, FILE *file)
+{
+    switch (operand->kind)
+    {
+    case MO_REG:
+        fputs(regStr(operand->reg), file);
+        break;
+    case MO_IMM:
+        fprintf(file, "%ld", operand->imm);
+        break;
+    case MO_SYMBOL:
+        fputs(func->strings[operand->symbol], file);
+        break;
+    case MO_MEM:
+        if (operand->symbol != NO_STRING)
+        {
+            fprintf(file, "%s(%s)", func->strings[operand->symbol], regStr(operand->reg));
+        }
+        else
+        {
+            fprintf(file, "%ld(%s)", operand->imm, regStr(operand->reg));
+        }
+        break;
+    case MO_FRAME:
+        fprintf(file, "%ld(fp)", func->frame[operand->symbol].displacement);
+        break;
+    }
+}
+
+void mirWrite(const MachineFunc *func, FILE *file)
+{
+    for (size_t i = 0; i < func->size; i++)
+    {
+        switch (func->opcodes[i])
+        {
+        case MOP_LABEL:
+            fprintf(file, "%s:\n", func->strings[func->texts[i]]);
+            break;
+        case MOP_DIRECTIVE:
+            fprintf(file, "%s\n", func->strings[func->texts[i]]);
+            break;
+        default:
+            fprintf(file, "\t%s", func->opcodes[i] == MOP_OTHER ? func->strings[func->texts[i]] : opcodeInfo[func->opcodes[i]].name);
+            for (size_t j = 0; j < func->operandCounts[i]; j++)
+            {
+                fputs(j == 0 ? " " : ", ", file);
+                writeOperand(func, mirOperand(func, i, j), file);
+            }
+            fputc('\n', file);
+            break;
+        }
+    }
+}
+
+static void addRef(RegRefs *refs, Reg reg)
+{
+    for (size_t i = 0; i < refs->count; i++)
+    {
+        if (refs->regs[i] == reg)
+        {
+            return;
+        }
+    }
+    refs->regs[refs->count++] = reg;
+}
+
+// an opcode outside the description reads every register it names, its first one included
+void mirUses(const MachineFunc *func, size_t index, RegRefs *uses)
+{
+    bool defines = (mirFlags(func, index) & MF_DEFINES) && func->opcodes[index] != MOP_OTHER;
+    uses->count = 0;
+    for (size_t i = 0; i < func->operandCounts[index]; i++)
+    {
+        const MachineOperand *operand = mirOperand(func, index, i);
+        if ((operand->kind == MO_REG && !(i == 0 && defines)) || operand->kind == MO_MEM)
+        {
+            addRef(uses, operand->reg);
+        }
+    }
+}
+
+void mirDefs(const MachineFunc *func, size_t index, RegRefs *defs)
+{
+    defs->count = 0;
+    if ((mirFlags(func, index) & MF_DEFINES) && func->operandCounts[index] != 0 && mirOperand(func, index, 0)->kind == MO_REG)
+    {
+        addRef(defs, mirOperand(func, index, 0)->reg);
+    }
+}
+
+static size_t labelBlock(const MachineFunc *func, const Cfg *cfg, const MachineOperand *target)
+{
+    if (target->kind != MO_SYMBOL)
+    {
+        return NO_BLOCK;
+    }
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        for (size_t i = cfg->blocks[block].first; i < cfg->blocks[block].end; i++)
+        {
+            if (func->opcodes[i] == MOP_LABEL && func->texts[i] == target->symbol)
+            {
+                return block;
+            }
+        }
+    }
+    return NO_BLOCK;
+}
+
+static bool endsBlock(const MachineFunc *func, size_t index)
+{
+    return mirFlags(func, index) & (MF_BRANCH | MF_JUMP | MF_EXIT);
+}
+
+// the same blocks cfgBuild finds in the written assembly, cfg->list is left NULL
+void mirCfg(const MachineFunc *func, Cfg *cfg)
+{
+    memset(cfg, 0, sizeof(Cfg));
+    size_t capacity = 0;
+    bool hasOps = false;
+    bool ended = false;
+    cfgAddBlock(cfg, 0, &capacity);
+    for (size_t i = 0; i < func->size; i++)
+    {
+        bool isOp = func->opcodes[i] != MOP_LABEL && func->opcodes[i] != MOP_DIRECTIVE;
+        if (ended || (func->opcodes[i] == MOP_LABEL && hasOps))
+        {
+            cfg->blocks[cfg->size - 1].end = i;
+            cfgAddBlock(cfg, i, &capacity);
+            hasOps = false;
+            ended = false;
+        }
+        if (isOp)
+        {
+            hasOps = true;
+            ended = endsBlock(func, i);
+        }
+    }
+    cfg->blocks[cfg->size - 1].end = func->size;
+
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        size_t last = NO_BLOCK;
+        for (size_t i = cfg->blocks[block].first; i < cfg->blocks[block].end; i++)
+        {
+            if (func->opcodes[i] != MOP_LABEL && func->opcodes[i] != MOP_DIRECTIVE)
+            {
+                last = i;
+            }
+        }
+        size_t next = block + 1 < cfg->size ? block + 1 : NO_BLOCK;
+        unsigned flags = last == NO_BLOCK ? 0 : mirFlags(func, last);
+        if (flags & MF_JUMP)
+        {
+            cfgAddEdge(cfg, block, labelBlock(func, cfg, mirOperand(func, last, 0)));
+        }
+        else if (flags & MF_BRANCH)
+        {
+            cfgAddEdge(cfg, block, labelBlock(func, cfg, mirOperand(func, last, func->operandCounts[last] - 1)));
+            cfgAddEdge(cfg, block, next);
+        }
+        else if (!(flags & MF_EXIT))
+        {
+            cfgAddEdge(cfg, block, next);
+        }
+    }
+    cfgAnalyse(cfg);
+}
+
+// places the spill slots, then moves sp by the size of the grown frame
+void mirFinalizeFrame(MachineFunc *func)
+{
+    size_t spills = 0;
+    size_t base = (func->frameSize + SPILL_SLOT_SIZE - 1) / SPILL_SLOT_SIZE * SPILL_SLOT_SIZE;
+    size_t frameSize = func->frameSize;
+    for (size_t i = 0; i < func->frameCount; i++)
+    {
+        if (!func->frame[i].spill)
+        {
+            continue;
+        }
+        if (spills < SPILL_AREA_SLOTS)
+        {
+            func->frame[i].displacement = -(long)(SPILL_AREA + spills * SPILL_SLOT_SIZE);
+        }
+        else
+        {
+            frameSize = base + (spills - SPILL_AREA_SLOTS + 1) * SPILL_SLOT_SIZE;
+            func->frame[i].displacement = -(long)frameSize;
+        }
+        spills++;
+    }
+    if (frameSize == func->frameSize)
+    {
+        return;
+    }
+    for (size_t i = 0; i < func->size; i++)
+    {
+        MachineOperand *operands = mirOperand(func, i, 0);
+        if (func->opcodes[i] == MOP_ADDI && func->operandCounts[i] == 3 && operands[0].kind == MO_REG &&
+            operands[0].reg == SP && operands[1].kind == MO_REG && operands[1].reg == SP && operands[2].kind == MO_IMM &&
+            (operands[2].imm == (long)func->frameSize || operands[2].imm == -(long)func->frameSize))
+        {
+            operands[2].imm = operands[2].imm < 0 ? -(long)frameSize : (long)frameSize;
+        }
+    }
+    func->frameSize = frameSize;
+}
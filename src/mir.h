@@ -0,0 +1,204 @@
+#ifndef MIR_H
+#define MIR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cfg.h"
+#include "codegen.h"
+#include "peephole.h"
+
+#define MIR_MAX_OPERANDS 3
+#define NO_STRING ((size_t)-1)
+
+typedef enum
+{
+    MOP_LABEL,
+    MOP_DIRECTIVE,
+    MOP_OTHER, // an opcode outside the description, kept as text and assumed to read and write anything it names
+    MOP_ADD,
+    MOP_ADDI,
+    MOP_SUB,
+    MOP_NEG,
+    MOP_MUL,
+    MOP_MULH,
+    MOP_MULHU,
+    MOP_DIV,
+    MOP_DIVU,
+    MOP_REM,
+    MOP_REMU,
+    MOP_AND,
+    MOP_ANDI,
+    MOP_OR,
+    MOP_ORI,
+    MOP_XOR,
+    MOP_XORI,
+    MOP_NOT,
+    MOP_SLL,
+    MOP_SLLI,
+    MOP_SRL,
+    MOP_SRLI,
+    MOP_SRA,
+    MOP_SRAI,
+    MOP_SLT,
+    MOP_SLTI,
+    MOP_SLTU,
+    MOP_SLTIU,
+    MOP_SEQZ,
+    MOP_SNEZ,
+    MOP_LI,
+    MOP_LUI,
+    MOP_LA,
+    MOP_MV,
+    MOP_LB,
+    MOP_LBU,
+    MOP_LH,
+    MOP_LHU,
+    MOP_LW,
+    MOP_FLW,
+    MOP_FLD,
+    MOP_SB,
+    MOP_SH,
+    MOP_SW,
+    MOP_FSW,
+    MOP_FSD,
+    MOP_FADD_S,
+    MOP_FSUB_S,
+    MOP_FMUL_S,
+    MOP_FDIV_S,
+    MOP_FNEG_S,
+    MOP_FMV_S,
+    MOP_FADD_D,
+    MOP_FSUB_D,
+    MOP_FMUL_D,
+    MOP_FDIV_D,
+    MOP_FNEG_D,
+    MOP_FMV_D,
+    MOP_FEQ_S,
+    MOP_FLT_S,
+    MOP_FLE_S,
+    MOP_FEQ_D,
+    MOP_FLT_D,
+    MOP_FLE_D,
+    MOP_FMV_W_X,
+    MOP_FMV_X_W,
+    MOP_FCVT_S_W,
+    MOP_FCVT_W_S,
+    MOP_FCVT_D_W,
+    MOP_FCVT_W_D,
+    MOP_FCVT_S_D,
+    MOP_FCVT_D_S,
+    MOP_RDCYCLE,
+    MOP_RDINSTRET,
+    MOP_BEQ,
+    MOP_BNE,
+    MOP_BLT,
+    MOP_BGE,
+    MOP_BLTU,
+    MOP_BGEU,
+    MOP_BEQZ,
+    MOP_BNEZ,
+    MOP_J,
+    MOP_JR,
+    MOP_CALL,
+    MOP_TAIL,
+    MOP_RET,
+    MOP_NOP,
+    MOP_COUNT
+} MachineOpcode;
+
+// what an opcode does besides computing into its first operand
+typedef enum
+{
+    MF_DEFINES = 1, // the first operand is written
+    MF_LOAD = 2,
+    MF_STORE = 4,
+    MF_BRANCH = 8, // the last operand is the label taken
+    MF_JUMP = 16,
+    MF_CALL = 32,
+    MF_EXIT = 64 // control leaves the function
+} MachineFlags;
+
+typedef enum
+{
+    MO_REG,    // a physical register below VREG_BASE, a virtual one from it
+    MO_IMM,
+    MO_SYMBOL, // a label, a function or a relocation such as %hi(x)
+    MO_MEM,    // a displacement, immediate or symbolic, off a base register
+    MO_FRAME   // a frame slot, addressed off fp once the frame is laid out
+} OperandKind;
+
+typedef struct MachineOperand
+{
+    OperandKind kind;
+    Reg reg;       // the register, or the base of a memory operand
+    long imm;      // immediate or displacement
+    size_t symbol; // string of a symbol or symbolic displacement, frame index of a frame slot
+} MachineOperand;
+
+// A slot of the frame, fixed ones are where codegen put them and spill slots are placed by mirFinalizeFrame
+typedef struct FrameObject
+{
+    long displacement; // off fp
+    bool spill;
+} FrameObject;
+
+// The instructions of one function as parallel arrays, registers virtual until allocation
+typedef struct MachineFunc
+{
+    size_t size;
+    size_t capacity;
+    uint8_t *opcodes;
+    uint8_t *operandCounts;
+    size_t *texts;            // string of a label, a directive or an opcode outside the description
+    MachineOperand *operands; // MIR_MAX_OPERANDS per instruction
+
+    char **strings;
+    size_t stringCount;
+    size_t stringCapacity;
+
+    FrameObject *frame;
+    size_t frameCount;
+    size_t frameSize; // bytes between fp and sp
+
+    size_t vregLimit; // one past the highest virtual register number
+} MachineFunc;
+
+// the registers an instruction reads or writes
+typedef struct RegRefs
+{
+    Reg regs[MIR_MAX_OPERANDS];
+    size_t count;
+} RegRefs;
+
+bool isVirtualReg(Reg reg);
+bool isFloatReg(Reg reg);
+
+void mirCreate(MachineFunc *func, size_t frameSize);
+void mirDestroy(MachineFunc *func);
+void mirBuild(MachineFunc *func, const InstrList *list);
+void mirWrite(const MachineFunc *func, FILE *file);
+
+size_t mirInsert(MachineFunc *func, size_t index, MachineOpcode opcode);
+size_t mirAppend(MachineFunc *func, MachineOpcode opcode);
+size_t mirAppendCopy(MachineFunc *func, size_t index);
+void mirRemove(MachineFunc *func, size_t first, size_t count);
+MachineOperand *mirAddOperand(MachineFunc *func, size_t index, OperandKind kind);
+MachineOperand *mirOperand(const MachineFunc *func, size_t index, size_t operand);
+size_t mirAddString(MachineFunc *func, const char *text);
+const char *mirString(const MachineFunc *func, size_t string);
+const char *mirOpcodeName(MachineOpcode opcode);
+MachineOpcode mirInvertBranch(MachineOpcode opcode);
+unsigned mirFlags(const MachineFunc *func, size_t index);
+Reg mirNewVreg(MachineFunc *func, bool isFloat);
+size_t mirNewSpillSlot(MachineFunc *func);
+
+void mirUses(const MachineFunc *func, size_t index, RegRefs *uses);
+void mirDefs(const MachineFunc *func, size_t index, RegRefs *defs);
+
+void mirCfg(const MachineFunc *func, Cfg *cfg);
+void mirFinalizeFrame(MachineFunc *func);
+
+#endif
@@ -0,0 +1,1721 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alias.h"
+#include "ast.h"
+#include "cse.h"
+#include "dce.h"
+#include "inline.h"
+#include "loop.h"
+#include "optimise.h"
+#include "recursion.h"
+#include "symbol.h"
+
+// A local variable known to hold a constant value
+typedef struct ConstBinding
+{
+    SymbolEntry *symbolEntry;
+    ConstantExpr value;
+} ConstBinding;
+
+// The locals with a known value at a point in a function
+typedef struct ConstEnv
+{
+    ConstBinding *bindings;
+    size_t size;
+    size_t capacity;
+    bool unreachable; // set after return, break and continue
+} ConstEnv;
+
+// locals of the current function that have their address taken, these are never propagated
+static SymbolSet addressTaken;
+// false while optimising a function with goto labels, which the propagation does not model
+static bool propagateLocals = false;
+// state on entry to the innermost switch body, case labels are reached from there
+static ConstEnv *switchEntryEnv = NULL;
+
+static void optimiseExpr(Expr *expr, ConstEnv *env);
+static void optimiseStmt(Stmt *stmt, ConstEnv *env);
+
+// returns true if a symbol set contains an entry
+bool symbolSetContains(const SymbolSet *set, const SymbolEntry *symbolEntry)
+{
+    for (size_t i = 0; i < set->size; i++)
+    {
+        if (set->entries[i] == symbolEntry)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// adds an entry to a symbol set
+void symbolSetPush(SymbolSet *set, SymbolEntry *symbolEntry)
+{
+    if (symbolEntry == NULL || symbolSetContains(set, symbolEntry))
+    {
+        return;
+    }
+    if (set->size == set->capacity)
+    {
+        set->capacity = set->capacity == 0 ? 8 : set->capacity * 2;
+        set->entries = realloc(set->entries, sizeof(SymbolEntry *) * set->capacity);
+        if (set->entries == NULL)
+        {
+            abort();
+        }
+    }
+    set->entries[set->size++] = symbolEntry;
+}
+
+// empties a symbol set and releases its memory
+void symbolSetClear(SymbolSet *set)
+{
+    free(set->entries);
+    set->entries = NULL;
+    set->size = 0;
+    set->capacity = 0;
+}
+
+// returns an independent copy of an environment
+static ConstEnv envCopy(const ConstEnv *env)
+{
+    ConstEnv copy = {NULL, env->size, env->size, env->unreachable};
+    if (env->size != 0)
+    {
+        copy.bindings = malloc(sizeof(ConstBinding) * env->size);
+        if (copy.bindings == NULL)
+        {
+            abort();
+        }
+        for (size_t i = 0; i < env->size; i++)
+        {
+            copy.bindings[i] = env->bindings[i];
+        }
+    }
+    return copy;
+}
+
+static void envDestroy(ConstEnv *env)
+{
+    free(env->bindings);
+    env->bindings = NULL;
+    env->size = 0;
+    env->capacity = 0;
+}
+
+static ConstBinding *envLookup(ConstEnv *env, const SymbolEntry *symbolEntry)
+{
+    for (size_t i = 0; i < env->size; i++)
+    {
+        if (env->bindings[i].symbolEntry == symbolEntry)
+        {
+            return &env->bindings[i];
+        }
+    }
+    return NULL;
+}
+
+static void envBind(ConstEnv *env, SymbolEntry *symbolEntry, ConstantExpr value)
+{
+    ConstBinding *binding = envLookup(env, symbolEntry);
+    if (binding != NULL)
+    {
+        binding->value = value;
+        return;
+    }
+    if (env->size == env->capacity)
+    {
+        env->capacity = env->capacity == 0 ? 8 : env->capacity * 2;
+        env->bindings = realloc(env->bindings, sizeof(ConstBinding) * env->capacity);
+        if (env->bindings == NULL)
+        {
+            abort();
+        }
+    }
+    env->bindings[env->size].symbolEntry = symbolEntry;
+    env->bindings[env->size].value = value;
+    env->size++;
+}
+
+// forgets the value of a local
+static void envKill(ConstEnv *env, const SymbolEntry *symbolEntry)
+{
+    for (size_t i = 0; i < env->size; i++)
+    {
+        if (env->bindings[i].symbolEntry == symbolEntry)
+        {
+            env->bindings[i] = env->bindings[env->size - 1];
+            env->size--;
+            return;
+        }
+    }
+}
+
+static void envKillSet(ConstEnv *env, const SymbolSet *set)
+{
+    for (size_t i = 0; i < set->size; i++)
+    {
+        envKill(env, set->entries[i]);
+    }
+}
+
+static bool constantsEqual(const ConstantExpr *a, const ConstantExpr *b)
+{
+    if (a->type != b->type)
+    {
+        return false;
+    }
+    if (a->type == FLOAT_TYPE)
+    {
+        // compare representations so that 0.0 and -0.0 stay distinct
+        union
+        {
+            float value;
+            uint32_t bits;
+        } x = {a->float_const}, y = {b->float_const};
+        return x.bits == y.bits;
+    }
+    return a->int_const == b->int_const;
+}
+
+// joins two paths, env keeps the bindings that hold on both of them
+static void envMerge(ConstEnv *env, const ConstEnv *other)
+{
+    if (other->unreachable)
+    {
+        return;
+    }
+    if (env->unreachable)
+    {
+        envDestroy(env);
+        *env = envCopy(other);
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < env->size; i++)
+    {
+        ConstBinding *otherBinding = envLookup((ConstEnv *)other, env->bindings[i].symbolEntry);
+        if (otherBinding != NULL && constantsEqual(&env->bindings[i].value, &otherBinding->value))
+        {
+            env->bindings[kept++] = env->bindings[i];
+        }
+    }
+    env->size = kept;
+}
+
+static bool isIntegerType(DataType type)
+{
+    return type == INT_TYPE || type == CHAR_TYPE || type == SIGNED_CHAR_TYPE || type == SHORT_TYPE ||
+           type == UNSIGNED_SHORT_TYPE || type == UNSIGNED_INT_TYPE;
+}
+
+static bool isUnsignedType(DataType type)
+{
+    return type == UNSIGNED_INT_TYPE || type == UNSIGNED_SHORT_TYPE;
+}
+
+// true for constants whose value is known at compile time (string literals are addresses)
+static bool isFoldable(const Expr *expr)
+{
+    return expr->type == CONSTANT_EXPR && !expr->constant->isString &&
+           (isIntegerType(expr->constant->type) || expr->constant->type == FLOAT_TYPE);
+}
+
+static int32_t intValue(const ConstantExpr *constant)
+{
+    switch (constant->type)
+    {
+    case CHAR_TYPE:
+    case SIGNED_CHAR_TYPE:
+        return (int8_t)constant->char_const;
+    case FLOAT_TYPE:
+        return (int32_t)constant->float_const;
+    default:
+        return constant->int_const;
+    }
+}
+
+static float floatValue(const ConstantExpr *constant)
+{
+    if (constant->type == FLOAT_TYPE)
+    {
+        return constant->float_const;
+    }
+    if (isUnsignedType(constant->type))
+    {
+        return (float)(uint32_t)constant->int_const;
+    }
+    return (float)intValue(constant);
+}
+
+static ConstantExpr *intConstant(DataType type, int32_t value)
+{
+    ConstantExpr *constant = constantExprCreate(isUnsignedType(type) ? UNSIGNED_INT_TYPE : INT_TYPE, false);
+    constant->int_const = value;
+    return constant;
+}
+
+static ConstantExpr *floatConstant(float value)
+{
+    ConstantExpr *constant = constantExprCreate(FLOAT_TYPE, false);
+    constant->float_const = value;
+    return constant;
+}
+
+// the value a variable of the given type holds after a constant is stored to it
+static ConstantExpr storedValue(const ConstantExpr *constant, DataType type)
+{
+    ConstantExpr value;
+    value.isString = false;
+    if (type == FLOAT_TYPE)
+    {
+        value.type = FLOAT_TYPE;
+        value.float_const = floatValue(constant);
+    }
+    else
+    {
+        int32_t integer = intValue(constant);
+        if (type == CHAR_TYPE || type == SIGNED_CHAR_TYPE)
+        {
+            integer = (int8_t)integer;
+        }
+        value.type = isUnsignedType(type) ? UNSIGNED_INT_TYPE : INT_TYPE;
+        value.int_const = integer;
+    }
+    return value;
+}
+
+// frees the contents of an expression but not the node itself
+void clearExpr(Expr *expr)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        variableExprDestroy(expr->variable);
+        break;
+    case CONSTANT_EXPR:
+        constantExprDestroy(expr->constant);
+        break;
+    case OPERATION_EXPR:
+        operationExprDestroy(expr->operation);
+        break;
+    case ASSIGN_EXPR:
+        assignExprDestroy(expr->assignment);
+        break;
+    case FUNC_EXPR:
+        funcExprDestroy(expr->function);
+        break;
+    }
+}
+
+static void replaceWithConstant(Expr *expr, ConstantExpr *constant)
+{
+    clearExpr(expr);
+    expr->type = CONSTANT_EXPR;
+    expr->constant = constant;
+}
+
+// replaces an expression with one of its operands, the operand must already be detached
+static void replaceExpr(Expr *expr, Expr *replacement)
+{
+    clearExpr(expr);
+    *expr = *replacement;
+    free(replacement);
+}
+
+bool hasSideEffects(const Expr *expr)
+{
+    switch (expr->type)
+    {
+    case ASSIGN_EXPR:
+    case FUNC_EXPR:
+        return true;
+    case OPERATION_EXPR:
+    {
+        Operator operator = expr->operation->operator;
+        if (operator == INC || operator == DEC || operator == INC_POST || operator == DEC_POST)
+        {
+            return true;
+        }
+        return (expr->operation->op1 != NULL && hasSideEffects(expr->operation->op1)) ||
+               (expr->operation->op2 != NULL && hasSideEffects(expr->operation->op2)) ||
+               (expr->operation->op3 != NULL && hasSideEffects(expr->operation->op3));
+    }
+    default:
+        return false;
+    }
+}
+
+// evaluates an integer operator with the wrap-around behaviour of RV32, false if the result is undefined
+static bool evalIntOp(Operator operator, bool isUnsigned, int32_t a, int32_t b, int32_t *result)
+{
+    uint32_t ua = (uint32_t)a;
+    uint32_t ub = (uint32_t)b;
+    switch (operator)
+    {
+    case ADD:
+        *result = (int32_t)(ua + ub);
+        return true;
+    case SUB:
+        *result = (int32_t)(ua - ub);
+        return true;
+    case MUL:
+        *result = (int32_t)(ua * ub);
+        return true;
+    case DIV:
+    case MOD:
+    {
+        if (b == 0 || (!isUnsigned && a == INT32_MIN && b == -1))
+        {
+            return false;
+        }
+        if (isUnsigned)
+        {
+            *result = (int32_t)(operator== DIV ? ua / ub : ua % ub);
+        }
+        else
+        {
+            *result = operator== DIV ? a / b : a % b;
+        }
+        return true;
+    }
+    case AND:
+        *result = a && b;
+        return true;
+    case OR:
+        *result = a || b;
+        return true;
+    case AND_BIT:
+        *result = a & b;
+        return true;
+    case OR_BIT:
+        *result = a | b;
+        return true;
+    case XOR:
+        *result = a ^ b;
+        return true;
+    case EQ:
+        *result = a == b;
+        return true;
+    case NE:
+        *result = a != b;
+        return true;
+    case LT:
+        *result = isUnsigned ? ua < ub : a < b;
+        return true;
+    case GT:
+        *result = isUnsigned ? ua > ub : a > b;
+        return true;
+    case LE:
+        *result = isUnsigned ? ua <= ub : a <= b;
+        return true;
+    case GE:
+        *result = isUnsigned ? ua >= ub : a >= b;
+        return true;
+    case LEFT_SHIFT:
+        // shift amounts are taken modulo 32 like sll/srl/sra
+        *result = (int32_t)(ua << (ub & 31));
+        return true;
+    case RIGHT_SHIFT:
+        *result = isUnsigned ? (int32_t)(ua >> (ub & 31)) : a >> (b & 31);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool evalIntUnary(Operator operator, int32_t a, int32_t *result)
+{
+    switch (operator)
+    {
+    case ADD:
+        *result = a;
+        return true;
+    case SUB:
+        *result = (int32_t)(0u - (uint32_t)a);
+        return true;
+    case NOT:
+        *result = !a;
+        return true;
+    case NOT_BIT:
+        *result = ~a;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// evaluates a single precision operator, comparisons and logical operators produce an int
+static ConstantExpr *evalFloatOp(Operator operator, float a, float b)
+{
+    switch (operator)
+    {
+    case ADD:
+        return floatConstant(a + b);
+    case SUB:
+        return floatConstant(a - b);
+    case MUL:
+        return floatConstant(a * b);
+    case DIV:
+        return floatConstant(a / b);
+    case AND:
+        return intConstant(INT_TYPE, a && b);
+    case OR:
+        return intConstant(INT_TYPE, a || b);
+    case EQ:
+        return intConstant(INT_TYPE, a == b);
+    case NE:
+        return intConstant(INT_TYPE, a != b);
+    case LT:
+        return intConstant(INT_TYPE, a < b);
+    case GT:
+        return intConstant(INT_TYPE, a > b);
+    case LE:
+        return intConstant(INT_TYPE, a <= b);
+    case GE:
+        return intConstant(INT_TYPE, a >= b);
+    default:
+        return NULL;
+    }
+}
+
+static ConstantExpr *evalFloatUnary(Operator operator, float a)
+{
+    switch (operator)
+    {
+    case ADD:
+        return floatConstant(a);
+    case SUB:
+        return floatConstant(-a);
+    case NOT:
+        return intConstant(INT_TYPE, !a);
+    default:
+        return NULL;
+    }
+}
+
+// evaluates an operator applied to constants, NULL if it cannot be done at compile time
+static ConstantExpr *evalConstantOp(Operator operator, const ConstantExpr *op1, const ConstantExpr *op2)
+{
+    bool useFloat = op1->type == FLOAT_TYPE || (op2 != NULL && op2->type == FLOAT_TYPE);
+    if (useFloat)
+    {
+        if (op2 == NULL)
+        {
+            return evalFloatUnary(operator, floatValue(op1));
+        }
+        return evalFloatOp(operator, floatValue(op1), floatValue(op2));
+    }
+
+    int32_t result;
+    if (op2 == NULL)
+    {
+        if (!evalIntUnary(operator, intValue(op1), &result))
+        {
+            return NULL;
+        }
+        return intConstant(operator== NOT ? INT_TYPE : op1->type, result);
+    }
+    // usual arithmetic conversions, the result of a shift has the type of its left operand
+    bool isUnsigned = isUnsignedType(op1->type) ||
+                      (operator!= LEFT_SHIFT && operator!= RIGHT_SHIFT && isUnsignedType(op2->type));
+    if (!evalIntOp(operator, isUnsigned, intValue(op1), intValue(op2), &result))
+    {
+        return NULL;
+    }
+    bool isBoolean = operator== AND || operator== OR || operator== EQ || operator== NE ||
+                     operator== LT || operator== GT || operator== LE || operator== GE;
+    return intConstant(isUnsigned && !isBoolean ? UNSIGNED_INT_TYPE : INT_TYPE, result);
+}
+
+static bool isIntConstant(const Expr *expr, int32_t value)
+{
+    return isFoldable(expr) && expr->constant->type != FLOAT_TYPE && intValue(expr->constant) == value;
+}
+
+// value of sizeof, never evaluates its operand
+static size_t sizeofExpr(Expr *expr)
+{
+    if (expr->type == CONSTANT_EXPR)
+    {
+        return typeSize(expr->constant->type);
+    }
+    if (expr->type == VARIABLE_EXPR && expr->variable->symbolEntry != NULL)
+    {
+        SymbolEntry *symbolEntry = expr->variable->symbolEntry;
+        if (symbolEntry->entryType == ARRAY_ENTRY)
+        {
+            // arrays are given storage size slots, sizeof counts the elements
+            DataType elementType = removerPtrFromType(symbolEntry->type.dataType);
+            return symbolEntry->storageSize / storageSize(elementType) * symbolEntry->typeSize;
+        }
+        return symbolEntry->typeSize;
+    }
+    return typeSize(returnType(expr));
+}
+
+// applies algebraic identities of integer operators with one constant operand
+static bool simplifyOperation(Expr *expr)
+{
+    OperationExpr *operation = expr->operation;
+    Expr *op1 = operation->op1;
+    Expr *op2 = operation->op2;
+    if (op2 == NULL || !isIntegerType(operation->type) || !isIntegerType(returnType(op1)) ||
+        !isIntegerType(returnType(op2)))
+    {
+        return false;
+    }
+    Expr *keep = NULL;
+    bool zero = false;
+    switch (operation->operator)
+    {
+    case ADD:
+    case OR_BIT:
+    case XOR:
+        keep = isIntConstant(op2, 0) ? op1 : isIntConstant(op1, 0) ? op2
+                                                                     : NULL;
+        break;
+    case SUB:
+    case LEFT_SHIFT:
+    case RIGHT_SHIFT:
+        keep = isIntConstant(op2, 0) ? op1 : NULL;
+        break;
+    case MUL:
+        keep = isIntConstant(op2, 1) ? op1 : isIntConstant(op1, 1) ? op2
+                                                                     : NULL;
+        zero = (isIntConstant(op2, 0) && !hasSideEffects(op1)) || (isIntConstant(op1, 0) && !hasSideEffects(op2));
+        break;
+    case DIV:
+        keep = isIntConstant(op2, 1) ? op1 : NULL;
+        break;
+    case AND_BIT:
+        zero = (isIntConstant(op2, 0) && !hasSideEffects(op1)) || (isIntConstant(op1, 0) && !hasSideEffects(op2));
+        break;
+    default:
+        break;
+    }
+    if (zero)
+    {
+        replaceWithConstant(expr, intConstant(operation->type, 0));
+        return true;
+    }
+    if (keep != NULL)
+    {
+        if (keep == op1)
+        {
+            operation->op1 = NULL;
+        }
+        else
+        {
+            operation->op2 = NULL;
+        }
+        replaceExpr(expr, keep);
+        return true;
+    }
+    return false;
+}
+
+// folds an operation whose operands have already been folded, returns true if the node changed
+static bool foldOperation(Expr *expr)
+{
+    OperationExpr *operation = expr->operation;
+    switch (operation->operator)
+    {
+    case SIZEOF_OP:
+    {
+        replaceWithConstant(expr, intConstant(UNSIGNED_INT_TYPE, sizeofExpr(operation->op1)));
+        return true;
+    }
+    case TERN:
+    {
+        bool value;
+        if (!constantCondition(operation->op1, &value))
+        {
+            return false;
+        }
+        Expr *taken = value ? operation->op2 : operation->op3;
+        if (value)
+        {
+            operation->op2 = NULL;
+        }
+        else
+        {
+            operation->op3 = NULL;
+        }
+        replaceExpr(expr, taken);
+        return true;
+    }
+    case COMMA_OP:
+    {
+        if (hasSideEffects(operation->op1))
+        {
+            return false;
+        }
+        Expr *op2 = operation->op2;
+        operation->op2 = NULL;
+        replaceExpr(expr, op2);
+        return true;
+    }
+    case AND:
+    case OR:
+    {
+        // the right operand is never evaluated once the left one decides the result
+        bool value;
+        if (constantCondition(operation->op1, &value) && value == (operation->operator== OR))
+        {
+            replaceWithConstant(expr, intConstant(INT_TYPE, value));
+            return true;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (operation->type == DOUBLE_TYPE || isPtr(operation->type) || operation->op3 != NULL)
+    {
+        return false;
+    }
+    if (!isFoldable(operation->op1) || (operation->op2 != NULL && !isFoldable(operation->op2)))
+    {
+        return simplifyOperation(expr);
+    }
+    ConstantExpr *result = evalConstantOp(operation->operator, operation->op1->constant,
+                                          operation->op2 == NULL ? NULL : operation->op2->constant);
+    if (result == NULL)
+    {
+        return false;
+    }
+    // keep the node in the register class the rest of the tree expects
+    if (operation->type == FLOAT_TYPE && result->type != FLOAT_TYPE)
+    {
+        float value = floatValue(result);
+        constantExprDestroy(result);
+        result = floatConstant(value);
+    }
+    else if (operation->type != FLOAT_TYPE && result->type == FLOAT_TYPE)
+    {
+        int32_t value = intValue(result);
+        constantExprDestroy(result);
+        result = intConstant(operation->type, value);
+    }
+    replaceWithConstant(expr, result);
+    return true;
+}
+
+// returns true if the condition is known at compile time
+bool constantCondition(Expr *expr, bool *value)
+{
+    if (expr == NULL || expr->type != CONSTANT_EXPR)
+    {
+        return false;
+    }
+    if (expr->constant->isString)
+    {
+        *value = true;
+        return true;
+    }
+    if (!isFoldable(expr))
+    {
+        return false;
+    }
+    if (expr->constant->type == FLOAT_TYPE)
+    {
+        *value = expr->constant->float_const != 0.0f;
+    }
+    else
+    {
+        *value = intValue(expr->constant) != 0;
+    }
+    return true;
+}
+
+// only scalar locals whose address never escapes are propagated
+static bool isTrackable(const SymbolEntry *symbolEntry)
+{
+    if (!propagateLocals || symbolEntry == NULL || symbolEntry->isGlobal || symbolEntry->entryType != VARIABLE_ENTRY ||
+        symbolEntry->type.isStruct)
+    {
+        return false;
+    }
+    DataType type = symbolEntry->type.dataType;
+    if (type != INT_TYPE && type != UNSIGNED_INT_TYPE && type != CHAR_TYPE && type != SIGNED_CHAR_TYPE && type != FLOAT_TYPE)
+    {
+        return false;
+    }
+    return !symbolSetContains(&addressTaken, symbolEntry);
+}
+
+// the stored constant must be in the register class of the variable
+static bool matchesClass(DataType type, const ConstantExpr *constant)
+{
+    return (type == FLOAT_TYPE) == (constant->type == FLOAT_TYPE);
+}
+
+void collectSymbolsExpr(Expr *expr, SymbolSet *set, CollectMode mode)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        if (mode == COLLECT_NAMED)
+        {
+            symbolSetPush(set, expr->variable->symbolEntry);
+        }
+        break;
+    case OPERATION_EXPR:
+    {
+        OperationExpr *operation = expr->operation;
+        Operator operator = operation->operator;
+        bool writes = operator== INC || operator== DEC || operator== INC_POST || operator== DEC_POST;
+        if (operation->op1 != NULL && operation->op1->type == VARIABLE_EXPR &&
+            ((mode == COLLECT_ASSIGNED && writes) || (mode == COLLECT_ADDRESS_TAKEN && operator== ADDRESS)))
+        {
+            symbolSetPush(set, operation->op1->variable->symbolEntry);
+        }
+        if (operation->op1 != NULL)
+        {
+            collectSymbolsExpr(operation->op1, set, mode);
+        }
+        if (operation->op2 != NULL)
+        {
+            collectSymbolsExpr(operation->op2, set, mode);
+        }
+        if (operation->op3 != NULL)
+        {
+            collectSymbolsExpr(operation->op3, set, mode);
+        }
+        break;
+    }
+    case ASSIGN_EXPR:
+    {
+        if (mode == COLLECT_ASSIGNED && expr->assignment->lvalue == NULL)
+        {
+            symbolSetPush(set, expr->assignment->symbolEntry);
+        }
+        collectSymbolsExpr(expr->assignment->op, set, mode);
+        if (expr->assignment->lvalue != NULL)
+        {
+            collectSymbolsExpr(expr->assignment->lvalue, set, mode);
+        }
+        break;
+    }
+    case FUNC_EXPR:
+    {
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            collectSymbolsExpr(expr->function->args[i], set, mode);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// collects the locals a statement writes to (declarations included), takes the address of or names
+void collectSymbolsStmt(Stmt *stmt, SymbolSet *set, CollectMode mode)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        if (stmt->whileStmt->preheader != NULL)
+        {
+            collectSymbolsStmt(stmt->whileStmt->preheader, set, mode);
+        }
+        collectSymbolsExpr(stmt->whileStmt->condition, set, mode);
+        collectSymbolsStmt(stmt->whileStmt->body, set, mode);
+        break;
+    case FOR_STMT:
+        if (stmt->forStmt->preheader != NULL)
+        {
+            collectSymbolsStmt(stmt->forStmt->preheader, set, mode);
+        }
+        collectSymbolsStmt(stmt->forStmt->init, set, mode);
+        collectSymbolsStmt(stmt->forStmt->condition, set, mode);
+        collectSymbolsStmt(stmt->forStmt->body, set, mode);
+        if (stmt->forStmt->modifier != NULL)
+        {
+            collectSymbolsExpr(stmt->forStmt->modifier, set, mode);
+        }
+        break;
+    case IF_STMT:
+        collectSymbolsExpr(stmt->ifStmt->condition, set, mode);
+        collectSymbolsStmt(stmt->ifStmt->trueBody, set, mode);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            collectSymbolsStmt(stmt->ifStmt->falseBody, set, mode);
+        }
+        break;
+    case SWITCH_STMT:
+        collectSymbolsExpr(stmt->switchStmt->selector, set, mode);
+        collectSymbolsStmt(stmt->switchStmt->body, set, mode);
+        break;
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            collectSymbolsExpr(stmt->exprStmt->expr, set, mode);
+        }
+        break;
+    case COMPOUND_STMT:
+    {
+        CompoundStmt *compoundStmt = stmt->compoundStmt;
+        for (size_t i = 0; i < compoundStmt->declList.size; i++)
+        {
+            Decl *decl = compoundStmt->declList.decls[i];
+            if (mode == COLLECT_ASSIGNED)
+            {
+                symbolSetPush(set, decl->symbolEntry);
+            }
+            if (decl->declInit != NULL && decl->declInit->initExpr != NULL)
+            {
+                collectSymbolsExpr(decl->declInit->initExpr, set, mode);
+            }
+        }
+        for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+        {
+            collectSymbolsStmt(compoundStmt->stmtList.stmts[i], set, mode);
+        }
+        break;
+    }
+    case LABEL_STMT:
+        collectSymbolsStmt(stmt->labelStmt->body, set, mode);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            collectSymbolsExpr(stmt->jumpStmt->expr, set, mode);
+        }
+        break;
+    }
+}
+
+// true if removing the statement would remove a jump target, case labels of nested switches are their own
+bool containsLabel(const Stmt *stmt, bool insideSwitch)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return containsLabel(stmt->whileStmt->body, insideSwitch);
+    case FOR_STMT:
+        return containsLabel(stmt->forStmt->body, insideSwitch);
+    case IF_STMT:
+        return containsLabel(stmt->ifStmt->trueBody, insideSwitch) ||
+               (stmt->ifStmt->falseBody != NULL && containsLabel(stmt->ifStmt->falseBody, insideSwitch));
+    case SWITCH_STMT:
+        return containsLabel(stmt->switchStmt->body, true);
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            if (containsLabel(stmt->compoundStmt->stmtList.stmts[i], insideSwitch))
+            {
+                return true;
+            }
+        }
+        return false;
+    case LABEL_STMT:
+        return stmt->labelStmt->ident != NULL || !insideSwitch || containsLabel(stmt->labelStmt->body, insideSwitch);
+    default:
+        return false;
+    }
+}
+
+bool containsGoto(const Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return containsGoto(stmt->whileStmt->body);
+    case FOR_STMT:
+        return containsGoto(stmt->forStmt->body);
+    case IF_STMT:
+        return containsGoto(stmt->ifStmt->trueBody) ||
+               (stmt->ifStmt->falseBody != NULL && containsGoto(stmt->ifStmt->falseBody));
+    case SWITCH_STMT:
+        return containsGoto(stmt->switchStmt->body);
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            if (containsGoto(stmt->compoundStmt->stmtList.stmts[i]))
+            {
+                return true;
+            }
+        }
+        return false;
+    case LABEL_STMT:
+        return stmt->labelStmt->ident != NULL || containsGoto(stmt->labelStmt->body);
+    case JUMP_STMT:
+        return stmt->jumpStmt->type == GOTO_JUMP;
+    default:
+        return false;
+    }
+}
+
+// temporaries and loops created by the optimiser, they outlive the AST until code generation is done
+static SymbolEntry **temps = NULL;
+static size_t tempsSize = 0;
+static size_t tempsCapacity = 0;
+
+void registerEntry(SymbolEntry *symbolEntry)
+{
+    if (tempsSize == tempsCapacity)
+    {
+        tempsCapacity = tempsCapacity == 0 ? 16 : tempsCapacity * 2;
+        temps = realloc(temps, sizeof(SymbolEntry *) * tempsCapacity);
+        if (temps == NULL)
+        {
+            abort();
+        }
+    }
+    temps[tempsSize++] = symbolEntry;
+}
+
+SymbolEntry *createTemp(SymbolEntry *func, DataType type)
+{
+    char *ident = malloc(32);
+    if (ident == NULL)
+    {
+        abort();
+    }
+    sprintf(ident, ".tmp%lu", tempsSize);
+    SymbolEntry *temp = symbolEntryCreate(ident, storageSize(type), typeSize(type), VARIABLE_ENTRY);
+    temp->type.isStruct = false;
+    temp->type.dataType = type;
+    temp->type.structSpecifier = NULL;
+
+    // give the temporary a new slot in the frame of the function
+    func->storageSize += temp->storageSize;
+    temp->stackOffset = func->storageSize;
+
+    registerEntry(temp);
+    return temp;
+}
+
+char *copyIdent(const char *ident)
+{
+    char *copy = malloc(strlen(ident) + 1);
+    if (copy == NULL)
+    {
+        abort();
+    }
+    strcpy(copy, ident);
+    return copy;
+}
+
+Stmt *emptyStmt(StmtType type)
+{
+    Stmt *stmt = stmtCreate(type);
+    if (type == COMPOUND_STMT)
+    {
+        stmt->compoundStmt = compoundStmtCreate();
+    }
+    else
+    {
+        stmt->exprStmt = exprStmtCreate();
+    }
+    return stmt;
+}
+
+void makeEntryRead(Expr *expr, SymbolEntry *symbolEntry)
+{
+    expr->type = VARIABLE_EXPR;
+    expr->variable = variableExprCreate(copyIdent(symbolEntry->ident));
+    expr->variable->symbolEntry = symbolEntry;
+    expr->variable->type = symbolEntry->type.dataType;
+}
+
+Expr *entryRead(SymbolEntry *symbolEntry)
+{
+    Expr *expr = exprCreate(VARIABLE_EXPR);
+    makeEntryRead(expr, symbolEntry);
+    return expr;
+}
+
+Expr *assignEntryExpr(SymbolEntry *symbolEntry, Expr *value)
+{
+    AssignExpr *assign = assignExprCreate(value, NOT);
+    assign->ident = copyIdent(symbolEntry->ident);
+    assign->symbolEntry = symbolEntry;
+    assign->type = symbolEntry->type.dataType;
+    Expr *expr = exprCreate(ASSIGN_EXPR);
+    expr->assignment = assign;
+    return expr;
+}
+
+Stmt *assignEntryStmt(SymbolEntry *symbolEntry, Expr *value)
+{
+    Stmt *stmt = emptyStmt(EXPR_STMT);
+    stmt->exprStmt->expr = assignEntryExpr(symbolEntry, value);
+    return stmt;
+}
+
+Expr *intConstantExpr(int32_t value)
+{
+    Expr *expr = exprCreate(CONSTANT_EXPR);
+    expr->constant = constantExprCreate(INT_TYPE, false);
+    expr->constant->int_const = value;
+    return expr;
+}
+
+// break or continue bound to the given loop, wherever it ends up nested
+Stmt *loopJump(JumpType type, SymbolEntry *loop)
+{
+    Stmt *stmt = stmtCreate(JUMP_STMT);
+    stmt->jumpStmt = jumpStmtCreate(type);
+    stmt->jumpStmt->symbolEntry = loop;
+    return stmt;
+}
+
+// takes an expression out of the tree, leaving a constant in its place
+Expr *takeExpr(Expr **slot)
+{
+    Expr *expr = *slot;
+    *slot = intConstantExpr(0);
+    return expr;
+}
+
+Expr *operationCreate(Operator operator, DataType type, Expr *op1, Expr *op2)
+{
+    Expr *expr = exprCreate(OPERATION_EXPR);
+    expr->operation = operationExprCreate(operator);
+    expr->operation->type = type;
+    expr->operation->op1 = op1;
+    expr->operation->op2 = op2;
+    return expr;
+}
+
+void optimiserEntriesDestroy(void)
+{
+    for (size_t i = 0; i < tempsSize; i++)
+    {
+        if (temps[i]->entryType == VARIABLE_ENTRY)
+        {
+            // loop entries free their own identifiers
+            free(temps[i]->ident);
+        }
+        symbolEntryDestroy(temps[i]);
+    }
+    free(temps);
+    temps = NULL;
+    tempsSize = 0;
+    tempsCapacity = 0;
+}
+
+// takes a statement out of the tree, leaving an empty statement in its place
+static Stmt *detachStmt(Stmt **slot)
+{
+    Stmt *stmt = *slot;
+    *slot = emptyStmt(COMPOUND_STMT);
+    return stmt;
+}
+
+// replaces a statement in place, the replacement must already be detached
+static void replaceStmt(Stmt *stmt, Stmt *replacement)
+{
+    Stmt *old = stmtCreate(stmt->type);
+    *old = *stmt;
+    stmtDestroy(old);
+    *stmt = *replacement;
+    free(replacement);
+}
+
+static void optimiseOperationExpr(Expr *expr, ConstEnv *env)
+{
+    OperationExpr *operation = expr->operation;
+    switch (operation->operator)
+    {
+    case INC:
+    case DEC:
+    case INC_POST:
+    case DEC_POST:
+    {
+        // the operand is an lvalue
+        if (operation->op1->type == VARIABLE_EXPR)
+        {
+            envKill(env, operation->op1->variable->symbolEntry);
+        }
+        return;
+    }
+    case ADDRESS:
+        return;
+    case SIZEOF_OP:
+        foldOperation(expr);
+        return;
+    case TERN:
+    {
+        optimiseExpr(operation->op1, env);
+        if (isFoldable(operation->op1) || (operation->op1->type == CONSTANT_EXPR && operation->op1->constant->isString))
+        {
+            foldOperation(expr);
+            optimiseExpr(expr, env);
+            return;
+        }
+        ConstEnv falseEnv = envCopy(env);
+        optimiseExpr(operation->op2, env);
+        optimiseExpr(operation->op3, &falseEnv);
+        envMerge(env, &falseEnv);
+        envDestroy(&falseEnv);
+        return;
+    }
+    case AND:
+    case OR:
+    {
+        optimiseExpr(operation->op1, env);
+        if (foldOperation(expr))
+        {
+            return;
+        }
+        if (isFoldable(operation->op1))
+        {
+            optimiseExpr(operation->op2, env);
+        }
+        else
+        {
+            ConstEnv skipped = envCopy(env);
+            optimiseExpr(operation->op2, env);
+            envMerge(env, &skipped);
+            envDestroy(&skipped);
+        }
+        foldOperation(expr);
+        return;
+    }
+    default:
+    {
+        optimiseExpr(operation->op1, env);
+        if (operation->op2 != NULL)
+        {
+            optimiseExpr(operation->op2, env);
+        }
+        if (operation->op3 != NULL)
+        {
+            optimiseExpr(operation->op3, env);
+        }
+        foldOperation(expr);
+        return;
+    }
+    }
+}
+
+static void optimiseAssignExpr(AssignExpr *assign, ConstEnv *env)
+{
+    optimiseExpr(assign->op, env);
+    if (assign->lvalue != NULL)
+    {
+        optimiseExpr(assign->lvalue, env);
+        return;
+    }
+    SymbolEntry *symbolEntry = assign->symbolEntry;
+    if (!isTrackable(symbolEntry))
+    {
+        return;
+    }
+    DataType type = symbolEntry->type.dataType;
+    if (isFoldable(assign->op) && matchesClass(type, assign->op->constant))
+    {
+        if (assign->operator== NOT)
+        {
+            envBind(env, symbolEntry, storedValue(assign->op->constant, type));
+            return;
+        }
+        // compound assignments are only tracked where codegen computes them as (variable op value)
+        ConstBinding *binding = envLookup(env, symbolEntry);
+        if (binding != NULL && (assign->type == INT_TYPE || assign->type == CHAR_TYPE))
+        {
+            ConstantExpr *result = evalConstantOp(assign->operator, &binding->value, assign->op->constant);
+            if (result != NULL)
+            {
+                envBind(env, symbolEntry, storedValue(result, type));
+                constantExprDestroy(result);
+                return;
+            }
+        }
+    }
+    envKill(env, symbolEntry);
+}
+
+static void optimiseExpr(Expr *expr, ConstEnv *env)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+    {
+        ConstBinding *binding = envLookup(env, expr->variable->symbolEntry);
+        if (binding != NULL)
+        {
+            ConstantExpr *constant = constantExprCreate(binding->value.type, false);
+            *constant = binding->value;
+            replaceWithConstant(expr, constant);
+        }
+        break;
+    }
+    case OPERATION_EXPR:
+        optimiseOperationExpr(expr, env);
+        break;
+    case ASSIGN_EXPR:
+        optimiseAssignExpr(expr->assignment, env);
+        break;
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            optimiseExpr(expr->function->args[i], env);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void optimiseDecl(Decl *decl, ConstEnv *env)
+{
+    if (decl->declInit == NULL)
+    {
+        return;
+    }
+    Expr *initExpr = decl->declInit->initExpr;
+    SymbolEntry *symbolEntry = decl->symbolEntry;
+    if (initExpr != NULL)
+    {
+        optimiseExpr(initExpr, env);
+        if (isTrackable(symbolEntry) && isFoldable(initExpr) && matchesClass(symbolEntry->type.dataType, initExpr->constant))
+        {
+            envBind(env, symbolEntry, storedValue(initExpr->constant, symbolEntry->type.dataType));
+            return;
+        }
+    }
+    envKill(env, symbolEntry);
+}
+
+static void optimiseIfStmt(Stmt *stmt, ConstEnv *env)
+{
+    IfStmt *ifStmt = stmt->ifStmt;
+    optimiseExpr(ifStmt->condition, env);
+    bool value;
+    if (constantCondition(ifStmt->condition, &value))
+    {
+        Stmt *dead = value ? ifStmt->falseBody : ifStmt->trueBody;
+        if (dead == NULL || !containsLabel(dead, false))
+        {
+            Stmt *live;
+            if (value)
+            {
+                live = detachStmt(&ifStmt->trueBody);
+            }
+            else
+            {
+                live = ifStmt->falseBody == NULL ? emptyStmt(COMPOUND_STMT) : detachStmt(&ifStmt->falseBody);
+            }
+            replaceStmt(stmt, live);
+            optimiseStmt(stmt, env);
+            return;
+        }
+    }
+    ConstEnv falseEnv = envCopy(env);
+    optimiseStmt(ifStmt->trueBody, env);
+    if (ifStmt->falseBody != NULL)
+    {
+        optimiseStmt(ifStmt->falseBody, &falseEnv);
+    }
+    envMerge(env, &falseEnv);
+    envDestroy(&falseEnv);
+}
+
+static void optimiseWhileStmt(Stmt *stmt, ConstEnv *env)
+{
+    WhileStmt *whileStmt = stmt->whileStmt;
+    // values written inside the loop are unknown at its head
+    SymbolSet assigned = {NULL, 0, 0};
+    collectSymbolsExpr(whileStmt->condition, &assigned, COLLECT_ASSIGNED);
+    collectSymbolsStmt(whileStmt->body, &assigned, COLLECT_ASSIGNED);
+    envKillSet(env, &assigned);
+
+    ConstEnv bodyEnv;
+    if (whileStmt->doWhile)
+    {
+        bodyEnv = envCopy(env);
+        optimiseStmt(whileStmt->body, &bodyEnv);
+        optimiseExpr(whileStmt->condition, env);
+    }
+    else
+    {
+        optimiseExpr(whileStmt->condition, env);
+        bool value;
+        if (constantCondition(whileStmt->condition, &value) && !value && !containsLabel(whileStmt->body, false))
+        {
+            replaceStmt(stmt, emptyStmt(COMPOUND_STMT));
+            symbolSetClear(&assigned);
+            return;
+        }
+        bodyEnv = envCopy(env);
+        optimiseStmt(whileStmt->body, &bodyEnv);
+    }
+    envDestroy(&bodyEnv);
+    envKillSet(env, &assigned);
+    symbolSetClear(&assigned);
+}
+
+static void optimiseForStmt(Stmt *stmt, ConstEnv *env)
+{
+    ForStmt *forStmt = stmt->forStmt;
+    optimiseStmt(forStmt->init, env);
+
+    SymbolSet assigned = {NULL, 0, 0};
+    collectSymbolsStmt(forStmt->condition, &assigned, COLLECT_ASSIGNED);
+    collectSymbolsStmt(forStmt->body, &assigned, COLLECT_ASSIGNED);
+    if (forStmt->modifier != NULL)
+    {
+        collectSymbolsExpr(forStmt->modifier, &assigned, COLLECT_ASSIGNED);
+    }
+    envKillSet(env, &assigned);
+
+    Expr *condition = forStmt->condition->exprStmt->expr;
+    if (condition != NULL)
+    {
+        optimiseExpr(condition, env);
+        bool value;
+        if (constantCondition(condition, &value) && !value && !containsLabel(forStmt->body, false))
+        {
+            // the loop never runs, only the initialiser remains
+            replaceStmt(stmt, detachStmt(&forStmt->init));
+            symbolSetClear(&assigned);
+            return;
+        }
+    }
+
+    ConstEnv bodyEnv = envCopy(env);
+    optimiseStmt(forStmt->body, &bodyEnv);
+    envDestroy(&bodyEnv);
+    if (forStmt->modifier != NULL)
+    {
+        ConstEnv modifierEnv = envCopy(env);
+        optimiseExpr(forStmt->modifier, &modifierEnv);
+        envDestroy(&modifierEnv);
+    }
+    envKillSet(env, &assigned);
+    symbolSetClear(&assigned);
+}
+
+// folds the case labels of a switch to int constants
+static void foldCaseLabels(Stmt *stmt, const SymbolEntry *switchEntry)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        foldCaseLabels(stmt->whileStmt->body, switchEntry);
+        break;
+    case FOR_STMT:
+        foldCaseLabels(stmt->forStmt->body, switchEntry);
+        break;
+    case IF_STMT:
+        foldCaseLabels(stmt->ifStmt->trueBody, switchEntry);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            foldCaseLabels(stmt->ifStmt->falseBody, switchEntry);
+        }
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            foldCaseLabels(stmt->compoundStmt->stmtList.stmts[i], switchEntry);
+        }
+        break;
+    case LABEL_STMT:
+    {
+        LabelStmt *labelStmt = stmt->labelStmt;
+        if (labelStmt->caseLabel != NULL && labelStmt->symbolEntry == switchEntry)
+        {
+            if (!foldExpr(labelStmt->caseLabel))
+            {
+                fprintf(stderr, "Case label is not an integer constant expression, exiting...\n");
+                exit(EXIT_FAILURE);
+            }
+            ConstantExpr value = storedValue(labelStmt->caseLabel->constant, INT_TYPE);
+            replaceWithConstant(labelStmt->caseLabel, intConstant(INT_TYPE, value.int_const));
+        }
+        foldCaseLabels(labelStmt->body, switchEntry);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// counts the case and default labels that belong to a switch
+static size_t countCaseLabels(const Stmt *stmt, const SymbolEntry *switchEntry)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        return countCaseLabels(stmt->whileStmt->body, switchEntry);
+    case FOR_STMT:
+        return countCaseLabels(stmt->forStmt->body, switchEntry);
+    case IF_STMT:
+        return countCaseLabels(stmt->ifStmt->trueBody, switchEntry) +
+               (stmt->ifStmt->falseBody != NULL ? countCaseLabels(stmt->ifStmt->falseBody, switchEntry) : 0);
+    case COMPOUND_STMT:
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            count += countCaseLabels(stmt->compoundStmt->stmtList.stmts[i], switchEntry);
+        }
+        return count;
+    }
+    case LABEL_STMT:
+        return (stmt->labelStmt->symbolEntry == switchEntry) + countCaseLabels(stmt->labelStmt->body, switchEntry);
+    default:
+        return 0;
+    }
+}
+
+// true if control never falls out of the statement
+static bool endsControl(const Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case LABEL_STMT:
+        return endsControl(stmt->labelStmt->body);
+    case COMPOUND_STMT:
+    {
+        const StatementList *stmtList = &stmt->compoundStmt->stmtList;
+        return stmtList->size != 0 && endsControl(stmtList->stmts[stmtList->size - 1]);
+    }
+    case IF_STMT:
+        return stmt->ifStmt->falseBody != NULL && endsControl(stmt->ifStmt->trueBody) &&
+               endsControl(stmt->ifStmt->falseBody);
+    default:
+        return stmt->type == JUMP_STMT;
+    }
+}
+
+// finds where a switch with a constant selector enters its body, returns the top level statement index
+size_t switchTarget(SwitchStmt *switchStmt, LabelStmt **target)
+{
+    StatementList *stmtList = &switchStmt->body->compoundStmt->stmtList;
+    int32_t selector = intValue(switchStmt->selector->constant);
+    size_t defaultIndex = stmtList->size;
+    LabelStmt *defaultLabel = NULL;
+    for (size_t i = 0; i < stmtList->size; i++)
+    {
+        for (Stmt *stmt = stmtList->stmts[i]; stmt->type == LABEL_STMT; stmt = stmt->labelStmt->body)
+        {
+            LabelStmt *labelStmt = stmt->labelStmt;
+            if (labelStmt->symbolEntry != switchStmt->symbolEntry)
+            {
+                continue;
+            }
+            if (labelStmt->caseLabel == NULL)
+            {
+                if (defaultLabel == NULL)
+                {
+                    defaultIndex = i;
+                    defaultLabel = labelStmt;
+                }
+            }
+            else if (intValue(labelStmt->caseLabel->constant) == selector)
+            {
+                *target = labelStmt;
+                return i;
+            }
+        }
+    }
+    *target = defaultLabel;
+    return defaultIndex;
+}
+
+// keeps only the statements of a switch with a constant selector that can run
+static void pruneSwitch(SwitchStmt *switchStmt)
+{
+    StatementList *stmtList = &switchStmt->body->compoundStmt->stmtList;
+    size_t topLevel = 0;
+    for (size_t i = 0; i < stmtList->size; i++)
+    {
+        for (Stmt *stmt = stmtList->stmts[i]; stmt->type == LABEL_STMT; stmt = stmt->labelStmt->body)
+        {
+            topLevel++;
+        }
+    }
+    if (topLevel != countCaseLabels(switchStmt->body, switchStmt->symbolEntry))
+    {
+        return;
+    }
+
+    LabelStmt *target;
+    size_t start = switchTarget(switchStmt, &target);
+    size_t end = start;
+    while (end < stmtList->size && !endsControl(stmtList->stmts[end]))
+    {
+        end++;
+    }
+    if (end < stmtList->size)
+    {
+        end++;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < stmtList->size; i++)
+    {
+        if (i >= start && i < end)
+        {
+            stmtList->stmts[kept++] = stmtList->stmts[i];
+        }
+        else
+        {
+            stmtDestroy(stmtList->stmts[i]);
+        }
+    }
+    stmtList->size = kept;
+}
+
+static void optimiseSwitchStmt(Stmt *stmt, ConstEnv *env)
+{
+    SwitchStmt *switchStmt = stmt->switchStmt;
+    optimiseExpr(switchStmt->selector, env);
+    foldCaseLabels(switchStmt->body, switchStmt->symbolEntry);
+
+    SymbolSet assigned = {NULL, 0, 0};
+    collectSymbolsStmt(switchStmt->body, &assigned, COLLECT_ASSIGNED);
+    envKillSet(env, &assigned);
+    symbolSetClear(&assigned);
+
+    if (isFoldable(switchStmt->selector) && switchStmt->body->type == COMPOUND_STMT)
+    {
+        pruneSwitch(switchStmt);
+    }
+
+    // the body is only entered through its labels
+    ConstEnv *outerEntryEnv = switchEntryEnv;
+    switchEntryEnv = env;
+    ConstEnv bodyEnv = envCopy(env);
+    bodyEnv.unreachable = true;
+    optimiseStmt(switchStmt->body, &bodyEnv);
+    envDestroy(&bodyEnv);
+    switchEntryEnv = outerEntryEnv;
+}
+
+static void optimiseCompoundStmt(CompoundStmt *compoundStmt, ConstEnv *env)
+{
+    for (size_t i = 0; i < compoundStmt->declList.size; i++)
+    {
+        optimiseDecl(compoundStmt->declList.decls[i], env);
+    }
+    for (size_t i = 0; i < compoundStmt->stmtList.size; i++)
+    {
+        optimiseStmt(compoundStmt->stmtList.stmts[i], env);
+    }
+}
+
+static void optimiseStmt(Stmt *stmt, ConstEnv *env)
+{
+    switch (stmt->type)
+    {
+    case EXPR_STMT:
+        if (stmt->exprStmt->expr != NULL)
+        {
+            optimiseExpr(stmt->exprStmt->expr, env);
+        }
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->expr != NULL)
+        {
+            optimiseExpr(stmt->jumpStmt->expr, env);
+        }
+        env->unreachable = true;
+        break;
+    case COMPOUND_STMT:
+        optimiseCompoundStmt(stmt->compoundStmt, env);
+        break;
+    case IF_STMT:
+        optimiseIfStmt(stmt, env);
+        break;
+    case WHILE_STMT:
+        optimiseWhileStmt(stmt, env);
+        break;
+    case FOR_STMT:
+        optimiseForStmt(stmt, env);
+        break;
+    case SWITCH_STMT:
+        optimiseSwitchStmt(stmt, env);
+        break;
+    case LABEL_STMT:
+        if (stmt->labelStmt->ident == NULL && switchEntryEnv != NULL)
+        {
+            envMerge(env, switchEntryEnv);
+        }
+        optimiseStmt(stmt->labelStmt->body, env);
+        break;
+    }
+}
+
+// folds constant subexpressions, returns true if the whole expression is now a constant
+bool foldExpr(Expr *expr)
+{
+    ConstEnv env = {NULL, 0, 0, false};
+    bool propagate = propagateLocals;
+    propagateLocals = false;
+    optimiseExpr(expr, &env);
+    propagateLocals = propagate;
+    envDestroy(&env);
+    return isFoldable(expr);
+}
+
+// recursion removal, constant folding, propagation of constant locals, removal of branches that cannot be taken,
+// loop transformations, reuse of common subexpressions and removal of dead code
+void optimiseFunc(FuncDef *func)
+{
+    if (func->body == NULL)
+    {
+        return;
+    }
+    eliminateRecursion(func);
+    collectSymbolsStmt(func->body, &addressTaken, COLLECT_ADDRESS_TAKEN);
+    propagateLocals = !containsGoto(func->body);
+
+    ConstEnv env = {NULL, 0, 0, false};
+    optimiseStmt(func->body, &env);
+    envDestroy(&env);
+
+    propagateLocals = false;
+    symbolSetClear(&addressTaken);
+
+    unrollLoops(func);
+    reduceInductionVariables(func);
+    promoteGlobals(func);
+    hoistLoopInvariants(func);
+    eliminateCommonSubexprs(func);
+    propagateCopies(func);
+    eliminateDeadCode(func);
+}
+
+void optimiseTranslationUnit(TranslationUnit *transUnit)
+{
+    analyseAliases(transUnit);
+    for (size_t i = 0; i < transUnit->size; i++)
+    {
+        ExternDecl *externDecl = transUnit->externDecls[i];
+        if (externDecl->isFunc)
+        {
+            if (!externDecl->funcDef->isPrototype)
+            {
+                inlineCalls(transUnit, i);
+                optimiseFunc(externDecl->funcDef);
+            }
+        }
+        else if (externDecl->decl->declInit != NULL && externDecl->decl->declInit->initExpr != NULL)
+        {
+            // initialisers are emitted as data, store them in the type of the global
+            Expr *initExpr = externDecl->decl->declInit->initExpr;
+            DataType type = externDecl->decl->symbolEntry->type.dataType;
+            if (foldExpr(initExpr) && (type == INT_TYPE || type == FLOAT_TYPE))
+            {
+                ConstantExpr value = storedValue(initExpr->constant, type);
+                ConstantExpr *constant = constantExprCreate(value.type, false);
+                *constant = value;
+                replaceWithConstant(initExpr, constant);
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef OPTIMISE_H
+#define OPTIMISE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "symbol.h"
+
+typedef struct SymbolSet
+{
+    SymbolEntry **entries;
+    size_t size;
+    size_t capacity;
+} SymbolSet;
+
+typedef enum
+{
+    COLLECT_ASSIGNED,
+    COLLECT_ADDRESS_TAKEN,
+    COLLECT_NAMED
+} CollectMode;
+
+bool symbolSetContains(const SymbolSet *set, const SymbolEntry *symbolEntry);
+void symbolSetPush(SymbolSet *set, SymbolEntry *symbolEntry);
+void symbolSetClear(SymbolSet *set);
+
+void collectSymbolsExpr(Expr *expr, SymbolSet *set, CollectMode mode);
+void collectSymbolsStmt(Stmt *stmt, SymbolSet *set, CollectMode mode);
+
+bool containsLabel(const Stmt *stmt, bool insideSwitch);
+bool containsGoto(const Stmt *stmt);
+bool hasSideEffects(const Expr *expr);
+
+void registerEntry(SymbolEntry *symbolEntry);
+SymbolEntry *createTemp(SymbolEntry *func, DataType type);
+void optimiserEntriesDestroy(void);
+
+char *copyIdent(const char *ident);
+Stmt *emptyStmt(StmtType type);
+void makeEntryRead(Expr *expr, SymbolEntry *symbolEntry);
+Expr *entryRead(SymbolEntry *symbolEntry);
+Expr *assignEntryExpr(SymbolEntry *symbolEntry, Expr *value);
+Stmt *assignEntryStmt(SymbolEntry *symbolEntry, Expr *value);
+Stmt *loopJump(JumpType type, SymbolEntry *loop);
+void clearExpr(Expr *expr);
+Expr *intConstantExpr(int32_t value);
+Expr *operationCreate(Operator operator, DataType type, Expr *op1, Expr *op2);
+Expr *takeExpr(Expr **slot);
+
+bool foldExpr(Expr *expr);
+bool constantCondition(Expr *expr, bool *value);
+size_t switchTarget(SwitchStmt *switchStmt, LabelStmt **target);
+
+void optimiseFunc(FuncDef *func);
+void optimiseTranslationUnit(TranslationUnit *transUnit);
+
+#endif
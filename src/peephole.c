@@ -0,0 +1,439 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "peephole.h"
+
+bool peepholeEnabled = true;
+
+static bool storeLoadRule(InstrList *list, size_t index);
+static bool selfMoveRule(InstrList *list, size_t index);
+static bool jumpToNextRule(InstrList *list, size_t index);
+static bool branchToNextRule(InstrList *list, size_t index);
+static bool branchOverJumpRule(InstrList *list, size_t index);
+static bool booleanRule(InstrList *list, size_t index);
+
+// rules are tried in order at every position of the window
+static PeepholeRule rules[] = {
+    {"store-load", storeLoadRule, true, 0},
+    {"self-move", selfMoveRule, true, 0},
+    {"jump-to-next", jumpToNextRule, true, 0},
+    {"branch-to-next", branchToNextRule, true, 0},
+    {"branch-over-jump", branchOverJumpRule, true, 0},
+    {"double-boolean", booleanRule, true, 0},
+};
+
+#define RULE_COUNT (sizeof(rules) / sizeof(rules[0]))
+
+// reads a whole line of any length, NULL at end of file
+static char *readLine(FILE *file)
+{
+    size_t capacity = 128;
+    size_t size = 0;
+    char *line = malloc(capacity);
+    if (line == NULL)
+    {
+        abort();
+    }
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        if (size + 2 > capacity)
+        {
+            capacity *= 2;
+            line = realloc(line, capacity);
+            if (line == NULL)
+            {
+                abort();
+            }
+        }
+        line[size++] = (char)c;
+        if (c == '\n')
+        {
+            break;
+        }
+    }
+    if (size == 0)
+    {
+        free(line);
+        return NULL;
+    }
+    line[size] = '\0';
+    return line;
+}
+
+static bool copyField(char *dest, const char *start, size_t length)
+{
+    if (length == 0 || length >= OPERAND_LENGTH)
+    {
+        return false;
+    }
+    memcpy(dest, start, length);
+    dest[length] = '\0';
+    return true;
+}
+
+// splits a line into a label, a directive or an opcode with its operands
+static void parseLine(Instr *instr, char *line)
+{
+    instr->text = line;
+    instr->deleted = false;
+    instr->operandCount = 0;
+    instr->kind = INSTR_DIRECTIVE;
+
+    const char *start = line;
+    while (*start == ' ' || *start == '\t')
+    {
+        start++;
+    }
+    size_t length = strcspn(start, "\n");
+    if (length == 0 || *start == '.' || *start == '#')
+    {
+        if (length != 0 && start[length - 1] == ':' && strchr(start, ' ') == NULL)
+        {
+            instr->kind = copyField(instr->operands[0], start, length - 1) ? INSTR_LABEL : INSTR_DIRECTIVE;
+        }
+        return;
+    }
+    if (start[length - 1] == ':')
+    {
+        instr->kind = copyField(instr->operands[0], start, length - 1) ? INSTR_LABEL : INSTR_DIRECTIVE;
+        return;
+    }
+
+    size_t opcodeLength = strcspn(start, " \t\n");
+    if (!copyField(instr->opcode, start, opcodeLength))
+    {
+        return;
+    }
+    const char *operand = start + opcodeLength;
+    while (*operand == ' ' || *operand == '\t')
+    {
+        operand++;
+    }
+    while (*operand != '\0' && *operand != '\n')
+    {
+        if (instr->operandCount == MAX_OPERANDS)
+        {
+            return;
+        }
+        size_t operandLength = strcspn(operand, ",\n");
+        if (!copyField(instr->operands[instr->operandCount], operand, operandLength))
+        {
+            return;
+        }
+        instr->operandCount++;
+        operand += operandLength;
+        if (*operand == ',')
+        {
+            operand++;
+        }
+        while (*operand == ' ')
+        {
+            operand++;
+        }
+    }
+    instr->kind = INSTR_OP;
+}
+
+// reads back the assembly of a function that was written to a temporary file
+void instrListRead(InstrList *list, FILE *file)
+{
+    list->instrs = NULL;
+    list->size = 0;
+    list->capacity = 0;
+    rewind(file);
+    char *line;
+    while ((line = readLine(file)) != NULL)
+    {
+        if (list->size == list->capacity)
+        {
+            list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+            list->instrs = realloc(list->instrs, sizeof(Instr) * list->capacity);
+            if (list->instrs == NULL)
+            {
+                abort();
+            }
+        }
+        parseLine(&list->instrs[list->size++], line);
+    }
+}
+
+void instrListWrite(const InstrList *list, FILE *file)
+{
+    for (size_t i = 0; i < list->size; i++)
+    {
+        const Instr *instr = &list->instrs[i];
+        if (!instr->deleted)
+        {
+            fputs(instr->text, file);
+        }
+    }
+}
+
+void instrListDestroy(InstrList *list)
+{
+    for (size_t i = 0; i < list->size; i++)
+    {
+        free(list->instrs[i].text);
+    }
+    free(list->instrs);
+    list->instrs = NULL;
+    list->size = 0;
+    list->capacity = 0;
+}
+
+// regenerates the text of an instruction after a rule changed it
+static void rewriteInstr(Instr *instr)
+{
+    size_t length = strlen(instr->opcode) + 3;
+    for (size_t i = 0; i < instr->operandCount; i++)
+    {
+        length += strlen(instr->operands[i]) + 2;
+    }
+    char *text = malloc(length);
+    if (text == NULL)
+    {
+        abort();
+    }
+    char *end = text + sprintf(text, "\t%s", instr->opcode);
+    for (size_t i = 0; i < instr->operandCount; i++)
+    {
+        end += sprintf(end, "%s%s", i == 0 ? " " : ", ", instr->operands[i]);
+    }
+    sprintf(end, "\n");
+    free(instr->text);
+    instr->text = text;
+}
+
+// the next entry that has not been deleted, NULL at the end of the list
+static Instr *nextInstr(InstrList *list, size_t index)
+{
+    for (size_t i = index + 1; i < list->size; i++)
+    {
+        if (!list->instrs[i].deleted)
+        {
+            return &list->instrs[i];
+        }
+    }
+    return NULL;
+}
+
+static bool isOp(const Instr *instr, const char *opcode)
+{
+    return instr != NULL && instr->kind == INSTR_OP && strcmp(instr->opcode, opcode) == 0;
+}
+
+// true if one of the labels directly after index is the given target
+static bool labelFollows(InstrList *list, size_t index, const char *target)
+{
+    for (size_t i = index + 1; i < list->size; i++)
+    {
+        Instr *instr = &list->instrs[i];
+        if (instr->deleted)
+        {
+            continue;
+        }
+        if (instr->kind != INSTR_LABEL)
+        {
+            return false;
+        }
+        if (strcmp(instr->operands[0], target) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// sw rs, off(base); lw rd, off(base) -> sw rs, off(base); mv rd, rs
+static bool storeLoadRule(InstrList *list, size_t index)
+{
+    static const char *pairs[][3] = {{"sw", "lw", "mv"}, {"fsw", "flw", "fmv.s"}, {"fsd", "fld", "fmv.d"}};
+    Instr *store = &list->instrs[index];
+    Instr *load = nextInstr(list, index);
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++)
+    {
+        if (isOp(store, pairs[i][0]) && isOp(load, pairs[i][1]) && store->operandCount == 2 && load->operandCount == 2 &&
+            strcmp(store->operands[1], load->operands[1]) == 0)
+        {
+            if (strcmp(store->operands[0], load->operands[0]) == 0)
+            {
+                load->deleted = true;
+            }
+            else
+            {
+                strcpy(load->opcode, pairs[i][2]);
+                strcpy(load->operands[1], store->operands[0]);
+                rewriteInstr(load);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// mv x, x
+static bool selfMoveRule(InstrList *list, size_t index)
+{
+    Instr *instr = &list->instrs[index];
+    if ((isOp(instr, "mv") || isOp(instr, "fmv.s") || isOp(instr, "fmv.d")) && instr->operandCount == 2 &&
+        strcmp(instr->operands[0], instr->operands[1]) == 0)
+    {
+        instr->deleted = true;
+        return true;
+    }
+    return false;
+}
+
+// j L; L:
+static bool jumpToNextRule(InstrList *list, size_t index)
+{
+    Instr *instr = &list->instrs[index];
+    if (isOp(instr, "j") && instr->operandCount == 1 && labelFollows(list, index, instr->operands[0]))
+    {
+        instr->deleted = true;
+        return true;
+    }
+    return false;
+}
+
+const char *invertBranch(const char *opcode)
+{
+    static const char *inverses[][2] = {{"beqz", "bnez"}, {"beq", "bne"}, {"blt", "bge"}, {"bltu", "bgeu"}, {"bgt", "ble"}, {"bgtu", "bleu"}, {"bltz", "bgez"}, {"blez", "bgtz"}};
+    for (size_t i = 0; i < sizeof(inverses) / sizeof(inverses[0]); i++)
+    {
+        if (strcmp(opcode, inverses[i][0]) == 0)
+        {
+            return inverses[i][1];
+        }
+        if (strcmp(opcode, inverses[i][1]) == 0)
+        {
+            return inverses[i][0];
+        }
+    }
+    return NULL;
+}
+
+bool isBranch(const Instr *instr)
+{
+    return instr != NULL && instr->kind == INSTR_OP && instr->operandCount >= 2 && invertBranch(instr->opcode) != NULL;
+}
+
+// beqz r, L; L:
+static bool branchToNextRule(InstrList *list, size_t index)
+{
+    Instr *instr = &list->instrs[index];
+    if (isBranch(instr) && labelFollows(list, index, instr->operands[instr->operandCount - 1]))
+    {
+        instr->deleted = true;
+        return true;
+    }
+    return false;
+}
+
+// beqz r, L1; j L2; L1: -> bnez r, L2; L1:
+static bool branchOverJumpRule(InstrList *list, size_t index)
+{
+    Instr *branch = &list->instrs[index];
+    if (!isBranch(branch))
+    {
+        return false;
+    }
+    Instr *jump = nextInstr(list, index);
+    if (!isOp(jump, "j") || jump->operandCount != 1 ||
+        !labelFollows(list, (size_t)(jump - list->instrs), branch->operands[branch->operandCount - 1]))
+    {
+        return false;
+    }
+    strcpy(branch->opcode, invertBranch(branch->opcode));
+    strcpy(branch->operands[branch->operandCount - 1], jump->operands[0]);
+    rewriteInstr(branch);
+    jump->deleted = true;
+    return true;
+}
+
+// sgtz d, x; sgtz d, d, normalising a value that is already 0 or 1
+static bool booleanRule(InstrList *list, size_t index)
+{
+    static const char *booleans[] = {"sgtz", "snez", "seqz", "sltz", "slt", "sltu", "slti", "sltiu", "sgt", "sgtu", "feq.s", "flt.s", "fle.s", "feq.d", "flt.d", "fle.d"};
+    Instr *first = &list->instrs[index];
+    Instr *second = nextInstr(list, index);
+    if (first->kind != INSTR_OP || first->operandCount == 0 || !(isOp(second, "sgtz") || isOp(second, "snez")) ||
+        second->operandCount != 2 || strcmp(second->operands[0], second->operands[1]) != 0 ||
+        strcmp(first->operands[0], second->operands[0]) != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(booleans) / sizeof(booleans[0]); i++)
+    {
+        if (strcmp(first->opcode, booleans[i]) == 0)
+        {
+            second->deleted = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// slides over the function until no rule applies, stepping back after each hit so rewrites can cascade
+void runPeephole(InstrList *list)
+{
+    if (!peepholeEnabled)
+    {
+        return;
+    }
+    size_t index = 0;
+    while (index < list->size)
+    {
+        bool changed = false;
+        if (!list->instrs[index].deleted)
+        {
+            for (size_t i = 0; i < RULE_COUNT && !changed; i++)
+            {
+                if (rules[i].enabled && rules[i].apply(list, index))
+                {
+                    rules[i].hits++;
+                    changed = true;
+                }
+            }
+        }
+        if (!changed)
+        {
+            index++;
+            continue;
+        }
+        // revisit the previous live instruction, it may now form a new pattern
+        while (index > 0)
+        {
+            index--;
+            if (!list->instrs[index].deleted)
+            {
+                break;
+            }
+        }
+    }
+}
+
+// enables or disables a rule by name, returns false if there is no such rule
+bool setPeepholeRule(const char *name, bool enabled)
+{
+    for (size_t i = 0; i < RULE_COUNT; i++)
+    {
+        if (strcmp(rules[i].name, name) == 0)
+        {
+            rules[i].enabled = enabled;
+            return true;
+        }
+    }
+    return false;
+}
+
+void printPeepholeStats(FILE *file)
+{
+    for (size_t i = 0; i < RULE_COUNT; i++)
+    {
+        fprintf(file, "peephole %-18s %lu\n", rules[i].name, rules[i].hits);
+    }
+}
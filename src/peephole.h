@@ -0,0 +1,56 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define MAX_OPERANDS 3
+#define OPERAND_LENGTH 64
+
+typedef enum
+{
+    INSTR_OP,
+    INSTR_LABEL,
+    INSTR_DIRECTIVE // anything the rules do not look into
+} InstrKind;
+
+typedef struct Instr
+{
+    InstrKind kind;
+    char *text; // original line, written back unchanged unless the instruction is rewritten
+    char opcode[OPERAND_LENGTH];
+    char operands[MAX_OPERANDS][OPERAND_LENGTH]; // label name in operands[0] for labels
+    size_t operandCount;
+    bool deleted;
+} Instr;
+
+typedef struct InstrList
+{
+    Instr *instrs;
+    size_t size;
+    size_t capacity;
+} InstrList;
+
+typedef struct PeepholeRule
+{
+    const char *name;
+    bool (*apply)(InstrList *list, size_t index); // tries the rule on the window starting at index
+    bool enabled;
+    size_t hits;
+} PeepholeRule;
+
+extern bool peepholeEnabled;
+
+void instrListRead(InstrList *list, FILE *file);
+void instrListWrite(const InstrList *list, FILE *file);
+void instrListDestroy(InstrList *list);
+
+bool isBranch(const Instr *instr);
+const char *invertBranch(const char *opcode);
+
+void runPeephole(InstrList *list);
+bool setPeepholeRule(const char *name, bool enabled);
+void printPeepholeStats(FILE *file);
+
+#endif
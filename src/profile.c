@@ -0,0 +1,821 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "codegen.h"
+#include "mir.h"
+#include "profile.h"
+
+#define PROFILE_MAGIC 0x464f5250 // "PROF" read as a little-endian word
+#define PROFILE_SECTION "profile_counters"
+#define FUNC_PROFILE_SECTION "function_profiles" // the name and table entry of each timed function
+#define MAX_WEIGHT_DEPTH 10 // edges of deeper loops weigh the same
+#define RECORD_INLINED 1    // copies of the function were inlined, so its calls are not all counted
+
+// AT_FDCWD, O_WRONLY | O_CREAT | O_TRUNC and 0644 for the openat the runtime makes
+#define AT_FDCWD -100
+#define OPEN_FLAGS 577
+#define OPEN_MODE 420
+
+bool profileGenerate = false;
+const char *profileUsePath = NULL;
+bool profileFunctions = false;
+
+// The counters of one function as read back from a profile
+typedef struct FuncProfile
+{
+    char *name;
+    uint32_t checksum;
+    uint32_t flags;
+    size_t counterCount;
+    uint64_t *counters; // counters[0] counts calls
+} FuncProfile;
+
+static FuncProfile *profiles = NULL;
+static size_t profileCount = 0;
+
+// functions with copies inlined somewhere in the translation unit being instrumented
+static const char **inlinedFuncs = NULL;
+static size_t inlinedCount = 0;
+
+// functions of the translation unit given entry and exit hooks by -fprofile-functions
+static const char **profiledFuncs = NULL;
+static size_t profiledCount = 0;
+
+// the records of the functions instrumented so far, written out after the last of the translation unit
+static FILE *records = NULL;
+
+// An edge of the graph the counters are placed on
+typedef struct ProfileEdge
+{
+    size_t from;
+    size_t to;
+    uint64_t weight; // how often the edge is expected to run, the heaviest are left to the spanning tree
+    bool inTree;
+    size_t counter; // for an edge off the tree
+} ProfileEdge;
+
+// The blocks of a function and a node that every exit runs into, edges[0] runs from that node back to the entry
+typedef struct ProfileGraph
+{
+    size_t nodes;
+    ProfileEdge *edges;
+    size_t size;
+    size_t counterCount;
+    uint32_t checksum;
+} ProfileGraph;
+
+// An update of a counter to be put in front of an instruction
+typedef struct CounterSite
+{
+    size_t position;
+    size_t counter;
+} CounterSite;
+
+static const char *funcName(const MachineFunc *func)
+{
+    for (size_t i = 0; i < func->size; i++)
+    {
+        if (func->opcodes[i] == MOP_LABEL)
+        {
+            return mirString(func, func->texts[i]);
+        }
+    }
+    return "";
+}
+
+static void addEdge(ProfileGraph *graph, size_t from, size_t to, uint64_t weight)
+{
+    graph->edges = realloc(graph->edges, sizeof(ProfileEdge) * (graph->size + 1));
+    if (graph->edges == NULL)
+    {
+        abort();
+    }
+    graph->edges[graph->size++] = (ProfileEdge){from, to, weight, false, 0};
+}
+
+static int compareWeights(const void *a, const void *b)
+{
+    const ProfileEdge *first = *(ProfileEdge *const *)a;
+    const ProfileEdge *second = *(ProfileEdge *const *)b;
+    if (first->weight != second->weight)
+    {
+        return first->weight > second->weight ? -1 : 1;
+    }
+    return first < second ? -1 : first > second;
+}
+
+static size_t findSet(size_t *parents, size_t node)
+{
+    while (parents[node] != node)
+    {
+        parents[node] = parents[parents[node]];
+        node = parents[node];
+    }
+    return node;
+}
+
+// FNV-1a over the shape of the graph, a profile taken from different code is not trusted
+static uint32_t graphChecksum(const ProfileGraph *graph)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t words[2] = {(uint32_t)graph->nodes, (uint32_t)graph->size};
+    for (size_t i = 0; i < 2 * graph->size + 2; i++)
+    {
+        uint32_t word = i < 2 ? words[i] : i % 2 == 0 ? (uint32_t)graph->edges[i / 2 - 1].from : (uint32_t)graph->edges[i / 2 - 1].to;
+        for (size_t j = 0; j < 4; j++)
+        {
+            hash ^= (word >> (8 * j)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Knuth, counting only the edges off a maximum spanning tree is enough to work out the others by conservation of
+// flow, and the edges kept on the tree are those of the deepest loops
+static void buildGraph(const Cfg *cfg, ProfileGraph *graph)
+{
+    size_t exitNode = cfg->size;
+    graph->nodes = cfg->size + 1;
+    graph->edges = NULL;
+    graph->size = 0;
+    addEdge(graph, exitNode, 0, 0);
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        const BasicBlock *basicBlock = &cfg->blocks[block];
+        size_t depth = basicBlock->loopDepth < MAX_WEIGHT_DEPTH ? basicBlock->loopDepth : MAX_WEIGHT_DEPTH;
+        uint64_t weight = (uint64_t)1 << (3 * depth);
+        for (size_t i = 0; i < basicBlock->succs.size; i++)
+        {
+            addEdge(graph, block, basicBlock->succs.blocks[i], weight);
+        }
+        if (basicBlock->succs.size == 0)
+        {
+            addEdge(graph, block, exitNode, weight);
+        }
+    }
+
+    ProfileEdge **sorted = malloc(sizeof(ProfileEdge *) * graph->size);
+    size_t *parents = malloc(sizeof(size_t) * graph->nodes);
+    if (sorted == NULL || parents == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < graph->size; i++)
+    {
+        sorted[i] = &graph->edges[i];
+    }
+    for (size_t node = 0; node < graph->nodes; node++)
+    {
+        parents[node] = node;
+    }
+    // the edge back into the entry is always counted, it is the call count
+    qsort(sorted + 1, graph->size - 1, sizeof(ProfileEdge *), compareWeights);
+    for (size_t i = 1; i < graph->size; i++)
+    {
+        size_t from = findSet(parents, sorted[i]->from);
+        size_t to = findSet(parents, sorted[i]->to);
+        if (from != to)
+        {
+            parents[from] = to;
+            sorted[i]->inTree = true;
+        }
+    }
+    free(sorted);
+    free(parents);
+
+    graph->counterCount = 0;
+    for (size_t i = 0; i < graph->size; i++)
+    {
+        if (!graph->edges[i].inTree)
+        {
+            graph->edges[i].counter = graph->counterCount++;
+        }
+    }
+    graph->checksum = graphChecksum(graph);
+}
+
+// past the labels a block starts with, and in the entry past the prologue so that no counter runs before the saves
+static size_t safeStart(const MachineFunc *func, const Cfg *cfg, size_t block)
+{
+    const BasicBlock *basicBlock = &cfg->blocks[block];
+    if (block == 0)
+    {
+        for (size_t i = basicBlock->first; i < basicBlock->end; i++)
+        {
+            if (func->opcodes[i] == MOP_ADDI && mirOperand(func, i, 0)->reg == SP && mirOperand(func, i, 1)->reg == SP)
+            {
+                return i + 1;
+            }
+        }
+    }
+    size_t start = basicBlock->first;
+    while (start < basicBlock->end && (func->opcodes[start] == MOP_LABEL || func->opcodes[start] == MOP_DIRECTIVE))
+    {
+        start++;
+    }
+    return start;
+}
+
+// the instruction a block ends in, NO_BLOCK for one of only labels
+static size_t lastInstr(const MachineFunc *func, const BasicBlock *block)
+{
+    size_t last = NO_BLOCK;
+    for (size_t i = block->first; i < block->end; i++)
+    {
+        if (func->opcodes[i] != MOP_LABEL && func->opcodes[i] != MOP_DIRECTIVE)
+        {
+            last = i;
+        }
+    }
+    return last;
+}
+
+static size_t firstLabel(const MachineFunc *func, const BasicBlock *block)
+{
+    for (size_t i = block->first; i < block->end; i++)
+    {
+        if (func->opcodes[i] == MOP_LABEL)
+        {
+            return func->texts[i];
+        }
+    }
+    return NO_STRING;
+}
+
+// la, lw, addi, sw on virtual registers, returns the index after the update
+static size_t insertCounter(MachineFunc *func, size_t at, size_t symbol, size_t counter)
+{
+    Reg base = mirNewVreg(func, false);
+    Reg value = mirNewVreg(func, false);
+    size_t address = mirInsert(func, at++, MOP_LA);
+    mirAddOperand(func, address, MO_REG)->reg = base;
+    mirAddOperand(func, address, MO_SYMBOL)->symbol = symbol;
+    for (size_t i = 0; i < 3; i++)
+    {
+        MachineOpcode opcode = i == 0 ? MOP_LW : i == 1 ? MOP_ADDI : MOP_SW;
+        size_t index = mirInsert(func, at++, opcode);
+        mirAddOperand(func, index, MO_REG)->reg = value;
+        if (opcode == MOP_ADDI)
+        {
+            mirAddOperand(func, index, MO_REG)->reg = value;
+            mirAddOperand(func, index, MO_IMM)->imm = 1;
+        }
+        else
+        {
+            MachineOperand *operand = mirAddOperand(func, index, MO_MEM);
+            operand->reg = base;
+            operand->imm = 4 * (long)counter;
+        }
+    }
+    return at;
+}
+
+static int compareSites(const void *a, const void *b)
+{
+    const CounterSite *first = a;
+    const CounterSite *second = b;
+    if (first->position != second->position)
+    {
+        return first->position > second->position ? -1 : 1;
+    }
+    return first->counter < second->counter ? -1 : first->counter > second->counter;
+}
+
+// A counter on an edge goes where only that edge runs: at the bottom of a block with one successor, at the top of a
+// block with one predecessor, right after a branch for the way it falls through and in a stub at the end of the
+// function for the way it is taken
+static size_t placeCounter(MachineFunc *func, const Cfg *cfg, const ProfileEdge *edge, size_t symbol, size_t stubs)
+{
+    if (edge->from == cfg->size)
+    {
+        return safeStart(func, cfg, 0);
+    }
+    const BasicBlock *from = &cfg->blocks[edge->from];
+    if (edge->to == cfg->size)
+    {
+        return safeStart(func, cfg, edge->from);
+    }
+    size_t last = lastInstr(func, from);
+    unsigned flags = last == NO_BLOCK ? 0 : mirFlags(func, last);
+    if (from->succs.size == 1)
+    {
+        return flags & (MF_BRANCH | MF_JUMP) ? last : from->end;
+    }
+    if (edge->to != 0 && cfg->blocks[edge->to].preds.size == 1)
+    {
+        return safeStart(func, cfg, edge->to);
+    }
+    // two successors, so the next block is the one the branch falls through to
+    if (edge->to == edge->from + 1)
+    {
+        return from->end;
+    }
+    size_t label = firstLabel(func, &cfg->blocks[edge->to]);
+
+    char stub[256];
+    snprintf(stub, sizeof(stub), ".PROF%s_%zu", funcName(func), stubs);
+    size_t stubLabel = mirAddString(func, stub);
+    size_t index = mirAppend(func, MOP_LABEL);
+    func->texts[index] = stubLabel;
+    insertCounter(func, func->size, symbol, edge->counter);
+    index = mirAppend(func, MOP_J);
+    mirAddOperand(func, index, MO_SYMBOL)->symbol = label;
+    mirOperand(func, last, func->operandCounts[last] - 1)->symbol = stubLabel;
+    return NO_BLOCK;
+}
+
+static bool wasInlined(const char *name)
+{
+    for (size_t i = 0; i < inlinedCount; i++)
+    {
+        if (strcmp(inlinedFuncs[i], name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void noteInlined(const char *name)
+{
+    if (!profileGenerate || wasInlined(name))
+    {
+        return;
+    }
+    inlinedFuncs = realloc(inlinedFuncs, sizeof(const char *) * (inlinedCount + 1));
+    if (inlinedFuncs == NULL)
+    {
+        abort();
+    }
+    inlinedFuncs[inlinedCount++] = name;
+}
+
+void noteProfiledFunc(const char *name)
+{
+    profiledFuncs = realloc(profiledFuncs, sizeof(const char *) * (profiledCount + 1));
+    if (profiledFuncs == NULL)
+    {
+        abort();
+    }
+    profiledFuncs[profiledCount++] = name;
+}
+
+static void writeRecord(const char *name, const ProfileGraph *graph)
+{
+    if (records == NULL)
+    {
+        records = tmpfile();
+        if (records == NULL)
+        {
+            fprintf(stderr, "Unable to create temporary file, exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    size_t length = strlen(name);
+    fprintf(records, "\t.p2align 2\n");
+    fprintf(records, "\t.word %u\n", PROFILE_MAGIC);
+    fprintf(records, "\t.word %u\n", graph->checksum);
+    fprintf(records, "\t.word %zu\n", graph->counterCount);
+    fprintf(records, "\t.word %d\n", wasInlined(name) ? RECORD_INLINED : 0);
+    fprintf(records, "\t.word %zu\n", length);
+    fprintf(records, "\t.ascii \"%s\"\n", name);
+    if (length % 4 != 0)
+    {
+        fprintf(records, "\t.zero %zu\n", 4 - length % 4);
+    }
+    fprintf(records, ".PROFC_%s:\n", name);
+    fprintf(records, "\t.zero %zu\n", 4 * graph->counterCount);
+}
+
+// Adds the counters of -fprofile-generate to a function still on virtual registers, with a record of them
+void instrumentProfile(MachineFunc *func, const char *name)
+{
+    Cfg cfg;
+    mirCfg(func, &cfg);
+    ProfileGraph graph;
+    buildGraph(&cfg, &graph);
+
+    char counters[256];
+    snprintf(counters, sizeof(counters), ".PROFC_%s", name);
+    size_t symbol = mirAddString(func, counters);
+    CounterSite *sites = malloc(sizeof(CounterSite) * graph.counterCount);
+    if (sites == NULL)
+    {
+        abort();
+    }
+    // stubs are appended first, the positions of the other counters are in terms of the function before any insertion
+    size_t siteCount = 0;
+    size_t stubs = 0;
+    for (size_t i = 0; i < graph.size; i++)
+    {
+        if (!graph.edges[i].inTree)
+        {
+            size_t position = placeCounter(func, &cfg, &graph.edges[i], symbol, stubs);
+            if (position == NO_BLOCK)
+            {
+                stubs++;
+            }
+            else
+            {
+                sites[siteCount++] = (CounterSite){position, graph.edges[i].counter};
+            }
+        }
+    }
+    qsort(sites, siteCount, sizeof(CounterSite), compareSites);
+    for (size_t i = 0; i < siteCount; i++)
+    {
+        insertCounter(func, sites[i].position, symbol, sites[i].counter);
+    }
+    writeRecord(name, &graph);
+    free(sites);
+    free(graph.edges);
+    cfgDestroy(&cfg);
+}
+
+static FuncProfile *findProfile(const char *name)
+{
+    for (size_t i = 0; i < profileCount; i++)
+    {
+        if (strcmp(profiles[i].name, name) == 0)
+        {
+            return &profiles[i];
+        }
+    }
+    return NULL;
+}
+
+// Never run in the profiled runs, so kept out of the way of the hot code. A function inlined anywhere is never
+// cold, its copies ran uncounted and the inliner has to make the same choices as in the instrumented build
+bool isColdFunc(const char *name)
+{
+    const FuncProfile *profile = profileUsePath == NULL ? NULL : findProfile(name);
+    return profile != NULL && profile->counters[0] == 0 && !(profile->flags & RECORD_INLINED);
+}
+
+// the edges on the tree are worked out from the counted ones, a node with one edge left unknown balances on it
+static void solveFlow(ProfileGraph *graph, uint64_t *counts, bool *known)
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t node = 0; node < graph->nodes; node++)
+        {
+            int64_t in = 0;
+            int64_t out = 0;
+            size_t unknown = NO_BLOCK;
+            size_t unknownCount = 0;
+            for (size_t i = 0; i < graph->size; i++)
+            {
+                const ProfileEdge *edge = &graph->edges[i];
+                if (edge->to == node || edge->from == node)
+                {
+                    if (!known[i])
+                    {
+                        unknown = i;
+                        unknownCount++;
+                        continue;
+                    }
+                    in += edge->to == node ? (int64_t)counts[i] : 0;
+                    out += edge->from == node ? (int64_t)counts[i] : 0;
+                }
+            }
+            if (unknownCount == 1)
+            {
+                int64_t count = graph->edges[unknown].to == node ? out - in : in - out;
+                counts[unknown] = count < 0 ? 0 : (uint64_t)count;
+                known[unknown] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+// The runs of every edge of a function as -fprofile-use measured them, false without a profile that matches it
+bool profileCounts(const MachineFunc *func, const Cfg *cfg, ProfileCounts *counts)
+{
+    const char *name = funcName(func);
+    const FuncProfile *profile = profileUsePath == NULL ? NULL : findProfile(name);
+    if (profile == NULL || profile->counters[0] == 0)
+    {
+        return false;
+    }
+    ProfileGraph graph;
+    buildGraph(cfg, &graph);
+    if (graph.checksum != profile->checksum || graph.counterCount != profile->counterCount)
+    {
+        fprintf(stderr, "Profile of %s does not match its code, ignoring it\n", name);
+        free(graph.edges);
+        return false;
+    }
+    uint64_t *values = calloc(graph.size, sizeof(uint64_t));
+    bool *known = calloc(graph.size, sizeof(bool));
+    if (values == NULL || known == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < graph.size; i++)
+    {
+        if (!graph.edges[i].inTree)
+        {
+            values[i] = profile->counters[graph.edges[i].counter];
+            known[i] = true;
+        }
+    }
+    solveFlow(&graph, values, known);
+
+    counts->size = graph.size - 1;
+    counts->from = malloc(sizeof(size_t) * counts->size);
+    counts->to = malloc(sizeof(size_t) * counts->size);
+    counts->counts = malloc(sizeof(uint64_t) * counts->size);
+    if (counts->from == NULL || counts->to == NULL || counts->counts == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 1; i < graph.size; i++)
+    {
+        counts->from[i - 1] = graph.edges[i].from;
+        counts->to[i - 1] = graph.edges[i].to == cfg->size ? NO_BLOCK : graph.edges[i].to;
+        counts->counts[i - 1] = values[i];
+    }
+    counts->entries = values[0];
+    free(values);
+    free(known);
+    free(graph.edges);
+    return true;
+}
+
+uint64_t profileEdgeCount(const ProfileCounts *counts, size_t from, size_t to)
+{
+    uint64_t count = 0;
+    for (size_t i = 0; i < counts->size; i++)
+    {
+        if (counts->from[i] == from && counts->to[i] == to)
+        {
+            count += counts->counts[i];
+        }
+    }
+    return count;
+}
+
+void profileCountsDestroy(ProfileCounts *counts)
+{
+    free(counts->from);
+    free(counts->to);
+    free(counts->counts);
+}
+
+static uint32_t readWord(const unsigned char *data)
+{
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static void malformedProfile(const char *path)
+{
+    fprintf(stderr, "Malformed profile %s, exiting...\n", path);
+    exit(EXIT_FAILURE);
+}
+
+// Reads the records a profiled run dumped, the counts of a function listed twice are added together
+void loadProfile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Unable to read profile %s, exiting...\n", path);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = 0;
+    size_t capacity = 4096;
+    unsigned char *data = malloc(capacity);
+    if (data == NULL)
+    {
+        abort();
+    }
+    size_t read;
+    while ((read = fread(data + size, 1, capacity - size, file)) != 0)
+    {
+        size += read;
+        if (size == capacity)
+        {
+            capacity *= 2;
+            data = realloc(data, capacity);
+            if (data == NULL)
+            {
+                abort();
+            }
+        }
+    }
+    fclose(file);
+
+    size_t offset = 0;
+    while (offset < size)
+    {
+        if (size - offset < 20 || readWord(data + offset) != PROFILE_MAGIC)
+        {
+            malformedProfile(path);
+        }
+        uint32_t checksum = readWord(data + offset + 4);
+        size_t counterCount = readWord(data + offset + 8);
+        uint32_t flags = readWord(data + offset + 12);
+        size_t length = readWord(data + offset + 16);
+        size_t padded = (length + 3) / 4 * 4;
+        offset += 20;
+        if (counterCount == 0 || size - offset < padded || (size - offset - padded) / 4 < counterCount)
+        {
+            malformedProfile(path);
+        }
+        char *name = malloc(length + 1);
+        if (name == NULL)
+        {
+            abort();
+        }
+        memcpy(name, data + offset, length);
+        name[length] = '\0';
+        offset += padded;
+
+        FuncProfile *profile = findProfile(name);
+        if (profile == NULL)
+        {
+            profiles = realloc(profiles, sizeof(FuncProfile) * (profileCount + 1));
+            if (profiles == NULL)
+            {
+                abort();
+            }
+            profile = &profiles[profileCount++];
+            *profile = (FuncProfile){name, checksum, flags, counterCount, calloc(counterCount, sizeof(uint64_t))};
+            if (profile->counters == NULL)
+            {
+                abort();
+            }
+        }
+        else
+        {
+            free(name);
+            if (profile->checksum != checksum || profile->counterCount != counterCount)
+            {
+                malformedProfile(path);
+            }
+            profile->flags |= flags;
+        }
+        for (size_t i = 0; i < counterCount; i++)
+        {
+            profile->counters[i] += readWord(data + offset + 4 * i);
+        }
+        offset += 4 * counterCount;
+    }
+    free(data);
+}
+
+void profileDestroy(void)
+{
+    for (size_t i = 0; i < profileCount; i++)
+    {
+        free(profiles[i].name);
+        free(profiles[i].counters);
+    }
+    free(profiles);
+    profiles = NULL;
+    profileCount = 0;
+    free(inlinedFuncs);
+    inlinedFuncs = NULL;
+    inlinedCount = 0;
+    free(profiledFuncs);
+    profiledFuncs = NULL;
+    profiledCount = 0;
+}
+
+// writes the counters of every function run to the profile file, called by main before it returns
+static void emitRuntime(FILE *file)
+{
+    fprintf(file, "__profile_dump:\n");
+    fprintf(file, "\tli a0, %d\n", AT_FDCWD);
+    fprintf(file, "\tla a1, .PROFILE_PATH\n");
+    fprintf(file, "\tli a2, %d\n", OPEN_FLAGS);
+    fprintf(file, "\tli a3, %d\n", OPEN_MODE);
+    fprintf(file, "\tli a7, 56\n"); // openat
+    fprintf(file, "\tecall\n");
+    fprintf(file, "\tbltz a0, .PROFILE_DONE\n");
+    fprintf(file, "\tmv t0, a0\n");
+    fprintf(file, "\tla a1, __start_" PROFILE_SECTION "\n");
+    fprintf(file, "\tla a2, __stop_" PROFILE_SECTION "\n");
+    fprintf(file, "\tsub a2, a2, a1\n");
+    fprintf(file, "\tli a7, 64\n"); // write
+    fprintf(file, "\tecall\n");
+    fprintf(file, "\tmv a0, t0\n");
+    fprintf(file, "\tli a7, 57\n"); // close
+    fprintf(file, "\tecall\n");
+    fprintf(file, ".PROFILE_DONE:\n");
+    fprintf(file, "\tret\n");
+    fprintf(file, ".section .rodata\n");
+    fprintf(file, ".PROFILE_PATH:\n");
+    fprintf(file, "\t.string \"%s\"\n", DEFAULT_PROFILE_PATH);
+    fprintf(file, ".text\n");
+}
+
+// the table entries of the timed functions, zeroed in .bss, and their names for the report
+static void emitFuncTable(FILE *file)
+{
+    fprintf(file, "\t.section .bss\n");
+    fprintf(file, "\t.p2align 2\n");
+    for (size_t i = 0; i < profiledCount; i++)
+    {
+        fprintf(file, ".FPROF_%s:\n", profiledFuncs[i]);
+        fprintf(file, "\t.zero %d\n", FUNC_PROFILE_SIZE);
+    }
+    fprintf(file, ".section .rodata\n");
+    for (size_t i = 0; i < profiledCount; i++)
+    {
+        fprintf(file, ".FPROFN_%s:\n", profiledFuncs[i]);
+        fprintf(file, "\t.string \"%s\"\n", profiledFuncs[i]);
+    }
+    fprintf(file, "\t.section " FUNC_PROFILE_SECTION ",\"aw\"\n");
+    fprintf(file, "\t.p2align 2\n");
+    for (size_t i = 0; i < profiledCount; i++)
+    {
+        fprintf(file, "\t.word .FPROFN_%s\n", profiledFuncs[i]);
+        fprintf(file, "\t.word .FPROF_%s\n", profiledFuncs[i]);
+    }
+    fprintf(file, ".text\n");
+}
+
+// prints the table of every timed function in the program with printf, called by main before it returns
+static void emitFuncReport(FILE *file)
+{
+    // the cycles and instructions of the callees of the function running, for its exclusive counts
+    fprintf(file, "\t.section .bss\n");
+    fprintf(file, "\t.p2align 2\n");
+    fprintf(file, ".globl __profile_children\n");
+    fprintf(file, "__profile_children:\n");
+    fprintf(file, "\t.zero 8\n");
+    fprintf(file, ".text\n");
+    fprintf(file, "__profile_report:\n");
+    fprintf(file, "\taddi sp, sp, -16\n");
+    fprintf(file, "\tsw ra, 12(sp)\n");
+    fprintf(file, "\tsw s1, 8(sp)\n");
+    fprintf(file, "\tsw s2, 4(sp)\n");
+    fprintf(file, "\tla a0, .FPROF_HEADER\n");
+    fprintf(file, "\tcall printf\n");
+    fprintf(file, "\tla s1, __start_" FUNC_PROFILE_SECTION "\n");
+    fprintf(file, "\tla s2, __stop_" FUNC_PROFILE_SECTION "\n");
+    fprintf(file, ".FPROF_NEXT:\n");
+    fprintf(file, "\tbgeu s1, s2, .FPROF_DONE\n");
+    fprintf(file, "\tlw a1, 0(s1)\n");
+    fprintf(file, "\tlw t0, 4(s1)\n");
+    fprintf(file, "\tlw a2, %d(t0)\n", FUNC_PROFILE_CALLS);
+    fprintf(file, "\tlw a3, %d(t0)\n", FUNC_PROFILE_CYCLES);
+    fprintf(file, "\tlw a4, %d(t0)\n", FUNC_PROFILE_SELF_CYCLES);
+    fprintf(file, "\tlw a5, %d(t0)\n", FUNC_PROFILE_INSTRS);
+    fprintf(file, "\tlw a6, %d(t0)\n", FUNC_PROFILE_SELF_INSTRS);
+    fprintf(file, "\tla a0, .FPROF_ROW\n");
+    fprintf(file, "\tcall printf\n");
+    fprintf(file, "\taddi s1, s1, 8\n");
+    fprintf(file, "\tj .FPROF_NEXT\n");
+    fprintf(file, ".FPROF_DONE:\n");
+    fprintf(file, "\tlw s2, 4(sp)\n");
+    fprintf(file, "\tlw s1, 8(sp)\n");
+    fprintf(file, "\tlw ra, 12(sp)\n");
+    fprintf(file, "\taddi sp, sp, 16\n");
+    fprintf(file, "\tret\n");
+    fprintf(file, ".section .rodata\n");
+    fprintf(file, ".FPROF_HEADER:\n");
+    fprintf(file, "\t.string \"function calls cycles self-cycles instructions self-instructions\\n\"\n");
+    fprintf(file, ".FPROF_ROW:\n");
+    fprintf(file, "\t.string \"%%s %%u %%u %%u %%u %%u\\n\"\n");
+    fprintf(file, ".text\n");
+}
+
+// The records of the translation unit in the sections the runtimes read, and the runtimes themselves next to main
+void emitProfileData(FILE *file, bool hasMain)
+{
+    if (records != NULL)
+    {
+        fprintf(file, "\t.section " PROFILE_SECTION ",\"aw\"\n");
+        rewind(records);
+        int c;
+        while ((c = fgetc(records)) != EOF)
+        {
+            fputc(c, file);
+        }
+        fclose(records);
+        records = NULL;
+        fprintf(file, ".text\n");
+    }
+    if (profiledCount != 0)
+    {
+        emitFuncTable(file);
+    }
+    if (profileGenerate && hasMain)
+    {
+        emitRuntime(file);
+    }
+    if (profileFunctions && hasMain)
+    {
+        emitFuncReport(file);
+    }
+}
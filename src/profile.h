@@ -0,0 +1,48 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cfg.h"
+#include "mir.h"
+
+#define DEFAULT_PROFILE_PATH "profile.data"
+
+extern bool profileGenerate;       // count edges and dump the counts when main returns
+extern const char *profileUsePath; // NULL unless a profile is read back
+extern bool profileFunctions;      // time every function with rdcycle and rdinstret, printed when main returns
+
+// the words of the table entry -fprofile-functions keeps for each function
+#define FUNC_PROFILE_CALLS 0
+#define FUNC_PROFILE_CYCLES 4
+#define FUNC_PROFILE_SELF_CYCLES 8
+#define FUNC_PROFILE_INSTRS 12
+#define FUNC_PROFILE_SELF_INSTRS 16
+#define FUNC_PROFILE_SIZE 20
+
+// The measured runs of the edges of one function, rebuilt from the counters of a profile
+typedef struct ProfileCounts
+{
+    size_t size;
+    size_t *from;
+    size_t *to; // NO_BLOCK for leaving the function
+    uint64_t *counts;
+    uint64_t entries; // calls of the function
+} ProfileCounts;
+
+void loadProfile(const char *path);
+void profileDestroy(void);
+bool isColdFunc(const char *name);
+void noteInlined(const char *name);
+void noteProfiledFunc(const char *name);
+
+void instrumentProfile(MachineFunc *func, const char *name);
+bool profileCounts(const MachineFunc *func, const Cfg *cfg, ProfileCounts *counts);
+uint64_t profileEdgeCount(const ProfileCounts *counts, size_t from, size_t to);
+void profileCountsDestroy(ProfileCounts *counts);
+void emitProfileData(FILE *file, bool hasMain);
+
+#endif
@@ -0,0 +1,380 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "optimise.h"
+#include "recursion.h"
+#include "symbol.h"
+
+typedef enum
+{
+    BASE_RETURN,       // returns a value without calling the function again
+    TAIL_RETURN,       // return f(args)
+    ACCUMULATOR_RETURN // return x + f(args), return x * f(args) or the other way round
+} ReturnKind;
+
+// How the self calls of a function are turned into jumps back to the start of its body
+typedef struct RecursionState
+{
+    FuncDef *func;
+    SymbolEntry *loop;        // the body is wrapped in a loop, self calls continue it
+    SymbolEntry *accumulator; // what the pending operations of the removed calls add up to, can be NULL
+    Operator operator;        // ADD or MUL, the first accumulating return decides
+    bool recurses;            // some return can become a jump
+    bool accumulates;         // some return needs the accumulator
+} RecursionState;
+
+// true if the frame has to outlive the body, so locals may be reachable from a callee
+bool frameEscapes(Stmt *body)
+{
+    bool escapes = false;
+    SymbolSet symbols = {NULL, 0, 0};
+    collectSymbolsStmt(body, &symbols, COLLECT_ASSIGNED);
+    for (size_t i = 0; i < symbols.size && !escapes; i++)
+    {
+        // the value of an array is its address
+        escapes = symbols.entries[i] != NULL && symbols.entries[i]->entryType == ARRAY_ENTRY && !symbols.entries[i]->isGlobal;
+    }
+    symbolSetClear(&symbols);
+
+    collectSymbolsStmt(body, &symbols, COLLECT_ADDRESS_TAKEN);
+    for (size_t i = 0; i < symbols.size && !escapes; i++)
+    {
+        escapes = symbols.entries[i] != NULL && !symbols.entries[i]->isGlobal;
+    }
+    symbolSetClear(&symbols);
+    return escapes;
+}
+
+static size_t paramCount(const FuncDef *func)
+{
+    return func->isParam ? func->args.size : 0;
+}
+
+static SymbolEntry *param(const FuncDef *func, size_t index)
+{
+    return func->args.decls[index]->symbolEntry;
+}
+
+// parameters are reassigned when a call becomes a jump, only types an assignment handles qualify
+static bool assignableParams(const FuncDef *func)
+{
+    for (size_t i = 0; i < paramCount(func); i++)
+    {
+        const SymbolEntry *symbolEntry = param(func, i);
+        if (symbolEntry == NULL || symbolEntry->entryType != VARIABLE_ENTRY || symbolEntry->type.isStruct ||
+            (symbolEntry->type.dataType != INT_TYPE && symbolEntry->type.dataType != CHAR_TYPE &&
+             symbolEntry->type.dataType != FLOAT_TYPE))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readsEntry(const Expr *expr, const SymbolEntry *symbolEntry)
+{
+    switch (expr->type)
+    {
+    case VARIABLE_EXPR:
+        return expr->variable->symbolEntry == symbolEntry;
+    case OPERATION_EXPR:
+        return (expr->operation->op1 != NULL && readsEntry(expr->operation->op1, symbolEntry)) ||
+               (expr->operation->op2 != NULL && readsEntry(expr->operation->op2, symbolEntry)) ||
+               (expr->operation->op3 != NULL && readsEntry(expr->operation->op3, symbolEntry));
+    case ASSIGN_EXPR:
+        return readsEntry(expr->assignment->op, symbolEntry) ||
+               (expr->assignment->lvalue != NULL && readsEntry(expr->assignment->lvalue, symbolEntry));
+    case FUNC_EXPR:
+        for (size_t i = 0; i < expr->function->argsSize; i++)
+        {
+            if (readsEntry(expr->function->args[i], symbolEntry))
+            {
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+// a call of the function itself whose arguments can be assigned straight to its parameters
+static bool isSelfCall(Expr *expr, const FuncDef *func)
+{
+    if (expr->type != FUNC_EXPR || strcmp(expr->function->ident, func->ident) != 0 ||
+        expr->function->argsSize != paramCount(func))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < expr->function->argsSize; i++)
+    {
+        if (returnType(expr->function->args[i]) != param(func, i)->type.dataType)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static ReturnKind classifyReturn(Expr *expr, const FuncDef *func, Operator *operator)
+{
+    if (expr == NULL)
+    {
+        return BASE_RETURN;
+    }
+    if (isSelfCall(expr, func))
+    {
+        return TAIL_RETURN;
+    }
+    if (expr->type != OPERATION_EXPR || func->symbolEntry->type.dataType != INT_TYPE)
+    {
+        return BASE_RETURN;
+    }
+    // integer addition and multiplication wrap around, so the pending operations can be regrouped
+    OperationExpr *operation = expr->operation;
+    if ((operation->operator!= ADD && operation->operator!= MUL) || operation->type != INT_TYPE)
+    {
+        return BASE_RETURN;
+    }
+    Expr *other;
+    if (isSelfCall(operation->op2, func))
+    {
+        other = operation->op1;
+    }
+    else if (isSelfCall(operation->op1, func))
+    {
+        other = operation->op2;
+    }
+    else
+    {
+        return BASE_RETURN;
+    }
+    if (hasSideEffects(other) || returnType(other) != INT_TYPE)
+    {
+        return BASE_RETURN;
+    }
+    *operator= operation->operator;
+    return ACCUMULATOR_RETURN;
+}
+
+static void scanStmt(Stmt *stmt, RecursionState *state)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        scanStmt(stmt->whileStmt->body, state);
+        break;
+    case FOR_STMT:
+        scanStmt(stmt->forStmt->body, state);
+        break;
+    case IF_STMT:
+        scanStmt(stmt->ifStmt->trueBody, state);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            scanStmt(stmt->ifStmt->falseBody, state);
+        }
+        break;
+    case SWITCH_STMT:
+        scanStmt(stmt->switchStmt->body, state);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            scanStmt(stmt->compoundStmt->stmtList.stmts[i], state);
+        }
+        break;
+    case LABEL_STMT:
+        scanStmt(stmt->labelStmt->body, state);
+        break;
+    case JUMP_STMT:
+    {
+        if (stmt->jumpStmt->type != RETURN_JUMP)
+        {
+            break;
+        }
+        Operator operator;
+        switch (classifyReturn(stmt->jumpStmt->expr, state->func, &operator))
+        {
+        case TAIL_RETURN:
+            state->recurses = true;
+            break;
+        case ACCUMULATOR_RETURN:
+            if (!state->accumulates)
+            {
+                state->accumulates = true;
+                state->operator= operator;
+            }
+            state->recurses = state->recurses || operator== state->operator;
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// p0 = a0; t1 = a1; ...; p1 = t1, an argument goes through a temporary only if a later one reads its parameter
+static void passArguments(FuncExpr *call, RecursionState *state, StatementList *stmts)
+{
+    size_t count = call->argsSize;
+    SymbolEntry **temps = calloc(count, sizeof(SymbolEntry *));
+    if (count != 0 && temps == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        SymbolEntry *symbolEntry = param(state->func, i);
+        Expr *arg = call->args[i];
+        if (arg->type == VARIABLE_EXPR && arg->variable->symbolEntry == symbolEntry)
+        {
+            continue;
+        }
+        bool readLater = false;
+        for (size_t j = i + 1; j < count && !readLater; j++)
+        {
+            readLater = readsEntry(call->args[j], symbolEntry);
+        }
+        if (readLater)
+        {
+            temps[i] = createTemp(state->func->symbolEntry, symbolEntry->type.dataType);
+            statementListPush(stmts, assignEntryStmt(temps[i], takeExpr(&call->args[i])));
+        }
+        else
+        {
+            statementListPush(stmts, assignEntryStmt(symbolEntry, takeExpr(&call->args[i])));
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (temps[i] != NULL)
+        {
+            statementListPush(stmts, assignEntryStmt(param(state->func, i), entryRead(temps[i])));
+        }
+    }
+    free(temps);
+}
+
+// return f(args) -> { params = args; continue; }, return x + f(args) -> { acc = acc + x; params = args; continue; }
+// and any other return -> return acc + value
+static void rewriteReturn(Stmt *stmt, RecursionState *state)
+{
+    JumpStmt *jumpStmt = stmt->jumpStmt;
+    Operator operator;
+    ReturnKind kind = classifyReturn(jumpStmt->expr, state->func, &operator);
+    if (kind == ACCUMULATOR_RETURN && operator!= state->operator)
+    {
+        kind = BASE_RETURN;
+    }
+    if (kind == BASE_RETURN)
+    {
+        if (state->accumulator != NULL && jumpStmt->expr != NULL)
+        {
+            jumpStmt->expr = operationCreate(state->operator, INT_TYPE, entryRead(state->accumulator), jumpStmt->expr);
+        }
+        return;
+    }
+
+    Stmt *jump = emptyStmt(COMPOUND_STMT);
+    Expr *call = jumpStmt->expr;
+    if (kind == ACCUMULATOR_RETURN)
+    {
+        OperationExpr *operation = jumpStmt->expr->operation;
+        Expr **other = isSelfCall(operation->op2, state->func) ? &operation->op1 : &operation->op2;
+        call = other == &operation->op1 ? operation->op2 : operation->op1;
+        Expr *value = operationCreate(operator, INT_TYPE, entryRead(state->accumulator), takeExpr(other));
+        statementListPush(&jump->compoundStmt->stmtList, assignEntryStmt(state->accumulator, value));
+    }
+    passArguments(call->function, state, &jump->compoundStmt->stmtList);
+    statementListPush(&jump->compoundStmt->stmtList, loopJump(CONTINUE_JUMP, state->loop));
+
+    Stmt *old = stmtCreate(JUMP_STMT);
+    *old = *stmt;
+    stmtDestroy(old);
+    *stmt = *jump;
+    free(jump);
+}
+
+static void rewriteStmt(Stmt *stmt, RecursionState *state)
+{
+    switch (stmt->type)
+    {
+    case WHILE_STMT:
+        rewriteStmt(stmt->whileStmt->body, state);
+        break;
+    case FOR_STMT:
+        rewriteStmt(stmt->forStmt->body, state);
+        break;
+    case IF_STMT:
+        rewriteStmt(stmt->ifStmt->trueBody, state);
+        if (stmt->ifStmt->falseBody != NULL)
+        {
+            rewriteStmt(stmt->ifStmt->falseBody, state);
+        }
+        break;
+    case SWITCH_STMT:
+        rewriteStmt(stmt->switchStmt->body, state);
+        break;
+    case COMPOUND_STMT:
+        for (size_t i = 0; i < stmt->compoundStmt->stmtList.size; i++)
+        {
+            rewriteStmt(stmt->compoundStmt->stmtList.stmts[i], state);
+        }
+        break;
+    case LABEL_STMT:
+        rewriteStmt(stmt->labelStmt->body, state);
+        break;
+    case JUMP_STMT:
+        if (stmt->jumpStmt->type == RETURN_JUMP)
+        {
+            rewriteReturn(stmt, state);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// turns self tail calls, and linear recursion whose pending work is a sum or product, into a loop:
+// { acc = 0; while (1) { body; break; } }, the declarations of the body are initialised on every pass
+void eliminateRecursion(FuncDef *func)
+{
+    if (func->body == NULL || func->symbolEntry == NULL || func->ptrCount != 0 || func->symbolEntry->type.isStruct ||
+        func->symbolEntry->type.dataType == VOID_TYPE || containsGoto(func->body) || !assignableParams(func) ||
+        frameEscapes(func->body))
+    {
+        return;
+    }
+    RecursionState state = {func, NULL, NULL, ADD, false, false};
+    scanStmt(func->body, &state);
+    if (!state.recurses)
+    {
+        return;
+    }
+
+    state.loop = whileEntryCreate();
+    registerEntry(state.loop);
+    Stmt *body = emptyStmt(COMPOUND_STMT);
+    if (state.accumulates)
+    {
+        state.accumulator = createTemp(func->symbolEntry, INT_TYPE);
+        statementListPush(&body->compoundStmt->stmtList,
+                          assignEntryStmt(state.accumulator, intConstantExpr(state.operator== MUL ? 1 : 0)));
+    }
+    rewriteStmt(func->body, &state);
+
+    Stmt *iteration = emptyStmt(COMPOUND_STMT);
+    statementListPush(&iteration->compoundStmt->stmtList, func->body);
+    statementListPush(&iteration->compoundStmt->stmtList, loopJump(BREAK_JUMP, state.loop));
+    Stmt *loop = stmtCreate(WHILE_STMT);
+    loop->whileStmt = whileStmtCreate(intConstantExpr(1), iteration, false);
+    loop->whileStmt->symbolEntry = state.loop;
+    statementListPush(&body->compoundStmt->stmtList, loop);
+    func->body = body;
+}
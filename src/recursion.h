@@ -0,0 +1,11 @@
+#ifndef RECURSION_H
+#define RECURSION_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+bool frameEscapes(Stmt *body);
+void eliminateRecursion(FuncDef *func);
+
+#endif
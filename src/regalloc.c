@@ -0,0 +1,440 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cfg.h"
+#include "clobber.h"
+#include "codegen.h"
+#include "dataflow.h"
+#include "mir.h"
+#include "regalloc.h"
+
+#define NO_POSITION ((size_t)-1)
+
+// caller-saved registers first, a value only lands in s1-s9 when it lives across a call or pressure is high
+static const Reg intPool[] = {T0, T1, T2, T3, T4, T5, T6, S1, S2, S3, S4, S5, S6, S7, S8, S9};
+static const Reg floatPool[] = {FT0, FT1, FT2, FT3, FT4, FT5, FT6, FT7, FT8, FT9, FT10, FT11};
+
+// The instructions a virtual register is live over, as one range of the layout
+typedef struct Interval
+{
+    Reg vreg;
+    size_t start;
+    size_t end;
+    uint64_t forbidden; // clobbered by a call the value lives across
+    bool spillable;     // false for the reloads of a spilled register, which live for one instruction
+    bool spilled;
+    Reg reg;
+} Interval;
+
+typedef struct Allocation
+{
+    Interval *intervals;
+    size_t size;
+    Interval **active; // sorted by end
+    size_t activeSize;
+} Allocation;
+
+static size_t vregIndex(Reg reg)
+{
+    return reg - VREG_BASE;
+}
+
+// whether allocateRegisters may hand the register out
+bool isAllocatable(Reg reg)
+{
+    for (size_t i = 0; i < sizeof(intPool) / sizeof(intPool[0]); i++)
+    {
+        if (intPool[i] == reg)
+        {
+            return true;
+        }
+    }
+    for (size_t i = 0; i < sizeof(floatPool) / sizeof(floatPool[0]); i++)
+    {
+        if (floatPool[i] == reg)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a backward union problem, in = uses before any def | (out & ~defs)
+static void liveness(const MachineFunc *func, const Cfg *cfg, Dataflow *live)
+{
+    dataflowCreate(live, cfg, DATAFLOW_BACKWARD, func->vregLimit);
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        for (size_t i = cfg->blocks[block].end; i-- > cfg->blocks[block].first;)
+        {
+            RegRefs refs;
+            mirDefs(func, i, &refs);
+            for (size_t j = 0; j < refs.count; j++)
+            {
+                if (isVirtualReg(refs.regs[j]))
+                {
+                    bitSetRemove(&live->gen[block], vregIndex(refs.regs[j]));
+                    bitSetAdd(&live->kill[block], vregIndex(refs.regs[j]));
+                }
+            }
+            mirUses(func, i, &refs);
+            for (size_t j = 0; j < refs.count; j++)
+            {
+                if (isVirtualReg(refs.regs[j]))
+                {
+                    bitSetAdd(&live->gen[block], vregIndex(refs.regs[j]));
+                }
+            }
+        }
+    }
+    dataflowSolve(live, cfg);
+}
+
+static void extend(Interval *interval, size_t position)
+{
+    if (interval->start == NO_POSITION || position < interval->start)
+    {
+        interval->start = position;
+    }
+    if (interval->end == NO_POSITION || position > interval->end)
+    {
+        interval->end = position;
+    }
+}
+
+// every position a register is live at lies between its first and last, the holes are not kept
+static void buildIntervals(const MachineFunc *func, const Cfg *cfg, const Dataflow *live, Interval *intervals)
+{
+    for (size_t block = 0; block < cfg->size; block++)
+    {
+        const BasicBlock *basicBlock = &cfg->blocks[block];
+        size_t last = basicBlock->end > basicBlock->first ? basicBlock->end - 1 : basicBlock->first;
+        for (size_t v = 0; v < func->vregLimit; v++)
+        {
+            if (bitSetContains(&live->in[block], v))
+            {
+                extend(&intervals[v], basicBlock->first);
+            }
+            if (bitSetContains(&live->out[block], v))
+            {
+                extend(&intervals[v], last);
+            }
+        }
+        for (size_t i = basicBlock->first; i < basicBlock->end; i++)
+        {
+            RegRefs refs;
+            mirUses(func, i, &refs);
+            for (size_t j = 0; j < refs.count; j++)
+            {
+                if (isVirtualReg(refs.regs[j]))
+                {
+                    extend(&intervals[vregIndex(refs.regs[j])], i);
+                }
+            }
+            mirDefs(func, i, &refs);
+            for (size_t j = 0; j < refs.count; j++)
+            {
+                if (isVirtualReg(refs.regs[j]))
+                {
+                    extend(&intervals[vregIndex(refs.regs[j])], i);
+                }
+            }
+        }
+    }
+
+    // a value live across a call may only be kept where the callee leaves it alone
+    for (size_t i = 0; i < func->size; i++)
+    {
+        if (!(mirFlags(func, i) & MF_CALL))
+        {
+            continue;
+        }
+        uint64_t clobbers = funcClobbers(mirString(func, mirOperand(func, i, 0)->symbol));
+        for (size_t v = 0; v < func->vregLimit; v++)
+        {
+            if (intervals[v].start != NO_POSITION && intervals[v].start < i && intervals[v].end > i)
+            {
+                intervals[v].forbidden |= clobbers;
+            }
+        }
+    }
+}
+
+static int compareStarts(const void *a, const void *b)
+{
+    const Interval *first = a;
+    const Interval *second = b;
+    if (first->start != second->start)
+    {
+        return first->start < second->start ? -1 : 1;
+    }
+    return first->vreg < second->vreg ? -1 : first->vreg > second->vreg;
+}
+
+static void activate(Allocation *allocation, Interval *interval)
+{
+    size_t i = allocation->activeSize++;
+    while (i > 0 && allocation->active[i - 1]->end > interval->end)
+    {
+        allocation->active[i] = allocation->active[i - 1];
+        i--;
+    }
+    allocation->active[i] = interval;
+}
+
+static void deactivate(Allocation *allocation, size_t index)
+{
+    for (size_t i = index; i + 1 < allocation->activeSize; i++)
+    {
+        allocation->active[i] = allocation->active[i + 1];
+    }
+    allocation->activeSize--;
+}
+
+// a register of the class that no active interval holds and no call in the way clobbers
+static bool freeRegister(const Allocation *allocation, const Interval *interval, Reg *reg)
+{
+    bool isFloat = isFloatReg(interval->vreg);
+    const Reg *pool = isFloat ? floatPool : intPool;
+    size_t poolSize = isFloat ? sizeof(floatPool) / sizeof(floatPool[0]) : sizeof(intPool) / sizeof(intPool[0]);
+    for (size_t i = 0; i < poolSize; i++)
+    {
+        bool taken = (interval->forbidden & regMask(pool[i])) != 0;
+        for (size_t j = 0; j < allocation->activeSize && !taken; j++)
+        {
+            taken = allocation->active[j]->reg == pool[i];
+        }
+        if (!taken)
+        {
+            *reg = pool[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Poletto and Sarkar, when nothing is free the interval reaching furthest is spilled
+static bool linearScan(Allocation *allocation)
+{
+    bool spilled = false;
+    for (size_t i = 0; i < allocation->size; i++)
+    {
+        Interval *current = &allocation->intervals[i];
+        while (allocation->activeSize != 0 && allocation->active[0]->end <= current->start)
+        {
+            deactivate(allocation, 0);
+        }
+        if (freeRegister(allocation, current, &current->reg))
+        {
+            activate(allocation, current);
+            continue;
+        }
+
+        size_t victim = NO_POSITION;
+        for (size_t j = allocation->activeSize; j-- > 0;)
+        {
+            Interval *candidate = allocation->active[j];
+            if (candidate->spillable && isFloatReg(candidate->vreg) == isFloatReg(current->vreg) &&
+                !(current->forbidden & regMask(candidate->reg)) && (candidate->end > current->end || !current->spillable))
+            {
+                victim = j;
+                break;
+            }
+        }
+        if (victim != NO_POSITION)
+        {
+            Interval *candidate = allocation->active[victim];
+            current->reg = candidate->reg;
+            candidate->spilled = true;
+            deactivate(allocation, victim);
+            activate(allocation, current);
+        }
+        else if (current->spillable)
+        {
+            current->spilled = true;
+        }
+        else
+        {
+            fprintf(stderr, "All registers filled, exiting...\n");
+            exit(EXIT_FAILURE);
+        }
+        spilled = true;
+    }
+    return spilled;
+}
+
+static void addSpillAccess(MachineFunc *func, size_t index, bool isStore, Reg reg, size_t slot)
+{
+    MachineOpcode opcode = isFloatReg(reg) ? (isStore ? MOP_FSD : MOP_FLD) : (isStore ? MOP_SW : MOP_LW);
+    mirInsert(func, index, opcode);
+    mirAddOperand(func, index, MO_REG)->reg = reg;
+    mirAddOperand(func, index, MO_FRAME)->symbol = slot;
+}
+
+static void replaceReg(MachineFunc *func, size_t index, Reg from, Reg to)
+{
+    for (size_t i = 0; i < func->operandCounts[index]; i++)
+    {
+        MachineOperand *operand = mirOperand(func, index, i);
+        if ((operand->kind == MO_REG || operand->kind == MO_MEM) && operand->reg == from)
+        {
+            operand->reg = to;
+        }
+    }
+}
+
+// each use of a spilled register reloads a fresh one from its slot and each def stores one back
+static void insertSpillCode(MachineFunc *func, const Allocation *allocation, size_t *slots, size_t slotCount)
+{
+    for (size_t i = 0; i < allocation->size; i++)
+    {
+        const Interval *interval = &allocation->intervals[i];
+        if (interval->spilled)
+        {
+            slots[vregIndex(interval->vreg)] = mirNewSpillSlot(func);
+        }
+    }
+    for (size_t i = func->size; i-- > 0;)
+    {
+        size_t at = i; // moves up as reloads go in front of it
+        RegRefs uses;
+        RegRefs defs;
+        mirUses(func, i, &uses);
+        mirDefs(func, i, &defs);
+        RegRefs refs = uses;
+        for (size_t j = 0; j < defs.count; j++)
+        {
+            bool seen = false;
+            for (size_t k = 0; k < refs.count; k++)
+            {
+                seen |= refs.regs[k] == defs.regs[j];
+            }
+            if (!seen)
+            {
+                refs.regs[refs.count++] = defs.regs[j];
+            }
+        }
+        for (size_t j = 0; j < refs.count; j++)
+        {
+            Reg reg = refs.regs[j];
+            if (!isVirtualReg(reg) || vregIndex(reg) >= slotCount || slots[vregIndex(reg)] == NO_POSITION)
+            {
+                continue;
+            }
+            size_t slot = slots[vregIndex(reg)];
+            Reg reload = mirNewVreg(func, isFloatReg(reg));
+            replaceReg(func, at, reg, reload);
+            bool isUse = false;
+            bool isDef = false;
+            for (size_t k = 0; k < uses.count; k++)
+            {
+                isUse |= uses.regs[k] == reg;
+            }
+            for (size_t k = 0; k < defs.count; k++)
+            {
+                isDef |= defs.regs[k] == reg;
+            }
+            if (isDef)
+            {
+                addSpillAccess(func, at + 1, true, reload, slot);
+            }
+            if (isUse)
+            {
+                addSpillAccess(func, at, false, reload, slot);
+                at++;
+            }
+        }
+    }
+}
+
+// Linear scan over virtual registers, repeated after spilling until every interval has a register.
+// Registers made for reloads are never spilled themselves, so the loop ends.
+void allocateRegisters(MachineFunc *func)
+{
+    size_t firstReload = func->vregLimit;
+    while (true)
+    {
+        Cfg cfg;
+        Dataflow live;
+        mirCfg(func, &cfg);
+        liveness(func, &cfg, &live);
+
+        Interval *byVreg = malloc(sizeof(Interval) * (func->vregLimit + 1));
+        if (byVreg == NULL)
+        {
+            abort();
+        }
+        for (size_t v = 0; v < func->vregLimit; v++)
+        {
+            byVreg[v] = (Interval){VREG_BASE + v, NO_POSITION, NO_POSITION, 0, v < firstReload, false, ZERO};
+        }
+        buildIntervals(func, &cfg, &live, byVreg);
+        dataflowDestroy(&live);
+        cfgDestroy(&cfg);
+
+        Allocation allocation = {malloc(sizeof(Interval) * (func->vregLimit + 1)), 0,
+                                 malloc(sizeof(Interval *) * (func->vregLimit + 1)), 0};
+        if (allocation.intervals == NULL || allocation.active == NULL)
+        {
+            abort();
+        }
+        for (size_t v = 0; v < func->vregLimit; v++)
+        {
+            if (byVreg[v].start != NO_POSITION)
+            {
+                allocation.intervals[allocation.size++] = byVreg[v];
+            }
+        }
+        free(byVreg);
+        qsort(allocation.intervals, allocation.size, sizeof(Interval), compareStarts);
+
+        bool spilled = linearScan(&allocation);
+        if (spilled)
+        {
+            size_t *slots = malloc(sizeof(size_t) * (func->vregLimit + 1));
+            if (slots == NULL)
+            {
+                abort();
+            }
+            size_t slotCount = func->vregLimit;
+            for (size_t v = 0; v < slotCount; v++)
+            {
+                slots[v] = NO_POSITION;
+            }
+            insertSpillCode(func, &allocation, slots, slotCount);
+            free(slots);
+        }
+        else
+        {
+            Reg *assigned = malloc(sizeof(Reg) * (func->vregLimit + 1));
+            if (assigned == NULL)
+            {
+                abort();
+            }
+            for (size_t i = 0; i < allocation.size; i++)
+            {
+                assigned[vregIndex(allocation.intervals[i].vreg)] = allocation.intervals[i].reg;
+            }
+            for (size_t i = 0; i < func->size; i++)
+            {
+                for (size_t j = 0; j < func->operandCounts[i]; j++)
+                {
+                    MachineOperand *operand = mirOperand(func, i, j);
+                    if ((operand->kind == MO_REG || operand->kind == MO_MEM) && isVirtualReg(operand->reg))
+                    {
+                        operand->reg = assigned[vregIndex(operand->reg)];
+                    }
+                }
+            }
+            free(assigned);
+        }
+        free(allocation.intervals);
+        free(allocation.active);
+        if (!spilled)
+        {
+            return;
+        }
+    }
+}
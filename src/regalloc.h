@@ -0,0 +1,9 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "mir.h"
+
+bool isAllocatable(Reg reg);
+void allocateRegisters(MachineFunc *func);
+
+#endif
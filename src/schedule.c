@@ -0,0 +1,480 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "mir.h"
+#include "regalloc.h"
+#include "schedule.h"
+
+#define MAX_REGION 128 // longer runs are scheduled in pieces, the dependence matrix is quadratic
+#define NO_EDGE -1
+
+bool scheduleEnabled = true;
+bool postScheduleEnabled = true;
+
+typedef enum
+{
+    LAT_ALU,
+    LAT_MUL,
+    LAT_DIV,
+    LAT_LOAD,
+    LAT_STORE,
+    LAT_FP_ADD,
+    LAT_FP_MUL,
+    LAT_FP_DIV,
+    LAT_FP_MISC,
+    LAT_FP_LOAD,
+    LAT_COUNT
+} LatencyClass;
+
+// Cycles until the result of each class of instruction may be used on one in-order core
+typedef struct Tuning
+{
+    const char *name;
+    unsigned latency[LAT_COUNT];
+    bool unpipelinedDiv; // a division waits for the one before it to finish
+} Tuning;
+
+static const Tuning tunings[] = {
+    {"generic", {1, 3, 20, 2, 1, 4, 4, 20, 2, 2}, true},
+    {"rocket", {1, 4, 33, 3, 1, 4, 4, 25, 2, 3}, true},
+    {"sifive-u74", {1, 3, 20, 3, 1, 5, 5, 33, 2, 3}, true},
+};
+
+static const Tuning *tuning = &tunings[0];
+
+// a little short of the sixteen integer and twelve floating-point registers allocateRegisters hands out
+static const size_t pressureLimits[2] = {12, 8};
+
+// What one instruction of a region reads, writes and touches in memory
+typedef struct Node
+{
+    size_t index;
+    LatencyClass latencyClass;
+    Reg uses[MIR_MAX_OPERANDS + 1];
+    size_t useCount;
+    Reg def;
+    bool hasDef;
+    bool loads;
+    bool stores;
+    bool inFrame; // the access is to a frame slot, else anywhere
+    long displacement;
+    long width;
+
+    unsigned height; // longest latency path to the end of the region
+    size_t preds;    // unscheduled predecessors
+    unsigned earliest;
+    bool scheduled;
+} Node;
+
+bool setTuning(const char *name)
+{
+    for (size_t i = 0; i < sizeof(tunings) / sizeof(tunings[0]); i++)
+    {
+        if (strcmp(tunings[i].name, name) == 0)
+        {
+            tuning = &tunings[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static LatencyClass latencyClass(MachineOpcode opcode)
+{
+    switch (opcode)
+    {
+    case MOP_MUL:
+    case MOP_MULH:
+    case MOP_MULHU:
+        return LAT_MUL;
+    case MOP_DIV:
+    case MOP_DIVU:
+    case MOP_REM:
+    case MOP_REMU:
+        return LAT_DIV;
+    case MOP_LB:
+    case MOP_LBU:
+    case MOP_LH:
+    case MOP_LHU:
+    case MOP_LW:
+        return LAT_LOAD;
+    case MOP_FLW:
+    case MOP_FLD:
+        return LAT_FP_LOAD;
+    case MOP_SB:
+    case MOP_SH:
+    case MOP_SW:
+    case MOP_FSW:
+    case MOP_FSD:
+        return LAT_STORE;
+    case MOP_FADD_S:
+    case MOP_FSUB_S:
+    case MOP_FADD_D:
+    case MOP_FSUB_D:
+        return LAT_FP_ADD;
+    case MOP_FMUL_S:
+    case MOP_FMUL_D:
+        return LAT_FP_MUL;
+    case MOP_FDIV_S:
+    case MOP_FDIV_D:
+        return LAT_FP_DIV;
+    case MOP_FNEG_S:
+    case MOP_FMV_S:
+    case MOP_FNEG_D:
+    case MOP_FMV_D:
+    case MOP_FEQ_S:
+    case MOP_FLT_S:
+    case MOP_FLE_S:
+    case MOP_FEQ_D:
+    case MOP_FLT_D:
+    case MOP_FLE_D:
+    case MOP_FMV_W_X:
+    case MOP_FMV_X_W:
+    case MOP_FCVT_S_W:
+    case MOP_FCVT_W_S:
+    case MOP_FCVT_D_W:
+    case MOP_FCVT_W_D:
+    case MOP_FCVT_S_D:
+    case MOP_FCVT_D_S:
+        return LAT_FP_MISC;
+    default:
+        return LAT_ALU;
+    }
+}
+
+static long accessWidth(MachineOpcode opcode)
+{
+    switch (opcode)
+    {
+    case MOP_LB:
+    case MOP_LBU:
+    case MOP_SB:
+        return 1;
+    case MOP_LH:
+    case MOP_LHU:
+    case MOP_SH:
+        return 2;
+    case MOP_FLD:
+    case MOP_FSD:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
+// labels, control flow, counter reads and anything the description does not cover stay where they are, before
+// allocation so do the callee-save spills and reloads, the allocator only keeps virtual registers off them by their
+// position
+static bool isBarrier(const MachineFunc *func, size_t index, bool afterAllocation)
+{
+    MachineOpcode opcode = func->opcodes[index];
+    if (opcode == MOP_LABEL || opcode == MOP_DIRECTIVE || opcode == MOP_OTHER || opcode == MOP_RDCYCLE ||
+        opcode == MOP_RDINSTRET || (mirFlags(func, index) & (MF_BRANCH | MF_JUMP | MF_CALL | MF_EXIT)))
+    {
+        return true;
+    }
+    for (size_t i = 0; i < func->operandCounts[index] && !afterAllocation; i++)
+    {
+        const MachineOperand *operand = mirOperand(func, index, i);
+        if ((operand->kind == MO_REG || operand->kind == MO_MEM) && isAllocatable(operand->reg))
+        {
+            return true;
+        }
+    }
+    // setting up or tearing down the frame fences the region, frame slots below sp are not ours to touch and before
+    // allocation a spill placed above the frame being set up would be stored off the caller's fp
+    RegRefs defs;
+    mirDefs(func, index, &defs);
+    return defs.count != 0 && (defs.regs[0] == FP || defs.regs[0] == SP);
+}
+
+static void describe(const MachineFunc *func, size_t index, Node *node)
+{
+    memset(node, 0, sizeof(Node));
+    node->index = index;
+    node->latencyClass = latencyClass(func->opcodes[index]);
+
+    RegRefs refs;
+    mirUses(func, index, &refs);
+    for (size_t i = 0; i < refs.count; i++)
+    {
+        node->uses[node->useCount++] = refs.regs[i];
+    }
+    mirDefs(func, index, &refs);
+    if (refs.count != 0 && refs.regs[0] != ZERO)
+    {
+        node->def = refs.regs[0];
+        node->hasDef = true;
+    }
+
+    unsigned flags = mirFlags(func, index);
+    node->loads = (flags & MF_LOAD) != 0;
+    node->stores = (flags & MF_STORE) != 0;
+    for (size_t i = 0; i < func->operandCounts[index]; i++)
+    {
+        const MachineOperand *operand = mirOperand(func, index, i);
+        if (operand->kind == MO_FRAME)
+        {
+            // frame slots are addressed off fp, which the prologue sets and the epilogue reloads
+            node->uses[node->useCount++] = FP;
+            node->inFrame = true;
+            node->displacement = func->frame[operand->symbol].displacement;
+            node->width = accessWidth(func->opcodes[index]);
+        }
+    }
+}
+
+static bool reads(const Node *node, Reg reg)
+{
+    for (size_t i = 0; i < node->useCount; i++)
+    {
+        if (node->uses[i] == reg)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// two distinct frame slots never overlap, everything else may
+static bool mayAlias(const Node *first, const Node *second)
+{
+    if (!first->inFrame || !second->inFrame)
+    {
+        return true;
+    }
+    return first->displacement < second->displacement + second->width &&
+           second->displacement < first->displacement + first->width;
+}
+
+// the cycles that must pass between issuing first and second, NO_EDGE when they may be swapped
+static int dependence(const Node *first, const Node *second)
+{
+    int delay = NO_EDGE;
+    if (first->hasDef && reads(second, first->def))
+    {
+        delay = (int)tuning->latency[first->latencyClass];
+    }
+    if (first->hasDef && second->hasDef && first->def == second->def && delay < 1)
+    {
+        delay = 1;
+    }
+    if (second->hasDef && reads(first, second->def) && delay < 0)
+    {
+        delay = 0;
+    }
+    if (((first->stores && (second->loads || second->stores)) || (first->loads && second->stores)) && mayAlias(first, second))
+    {
+        int memoryDelay = first->stores && second->loads ? 1 : 0;
+        delay = memoryDelay > delay ? memoryDelay : delay;
+    }
+    return delay;
+}
+
+// the change in live virtual registers scheduling a node makes, only values defined in the region are counted
+static int pressureChange(const Node *node, const size_t *totalUses, const size_t *seenUses, const bool *definedHere)
+{
+    int change = 0;
+    if (node->hasDef && isVirtualReg(node->def) && totalUses[node->def - VREG_BASE] != 0)
+    {
+        change++;
+    }
+    for (size_t i = 0; i < node->useCount; i++)
+    {
+        Reg reg = node->uses[i];
+        if (isVirtualReg(reg) && definedHere[reg - VREG_BASE] && seenUses[reg - VREG_BASE] + 1 == totalUses[reg - VREG_BASE])
+        {
+            change--;
+        }
+    }
+    return change;
+}
+
+static void permute(MachineFunc *func, size_t first, const size_t *order, size_t size)
+{
+    uint8_t opcodes[MAX_REGION];
+    uint8_t operandCounts[MAX_REGION];
+    size_t texts[MAX_REGION];
+    MachineOperand operands[MAX_REGION * MIR_MAX_OPERANDS];
+    for (size_t i = 0; i < size; i++)
+    {
+        opcodes[i] = func->opcodes[order[i]];
+        operandCounts[i] = func->operandCounts[order[i]];
+        texts[i] = func->texts[order[i]];
+        memcpy(&operands[i * MIR_MAX_OPERANDS], mirOperand(func, order[i], 0), sizeof(MachineOperand) * MIR_MAX_OPERANDS);
+    }
+    memcpy(&func->opcodes[first], opcodes, size);
+    memcpy(&func->operandCounts[first], operandCounts, size);
+    memcpy(&func->texts[first], texts, sizeof(size_t) * size);
+    memcpy(mirOperand(func, first, 0), operands, sizeof(MachineOperand) * MIR_MAX_OPERANDS * size);
+}
+
+// List scheduling of one straight-line run for a single-issue in-order pipeline, the ready instruction on the
+// longest latency path goes first
+static void scheduleRegion(MachineFunc *func, size_t first, size_t size, bool afterAllocation, const size_t *totalUses,
+                           size_t *seenUses, bool *definedHere)
+{
+    Node nodes[MAX_REGION];
+    int *delays = malloc(sizeof(int) * size * size);
+    if (delays == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        describe(func, first + i, &nodes[i]);
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = 0; j < size; j++)
+        {
+            delays[i * size + j] = j > i ? dependence(&nodes[i], &nodes[j]) : NO_EDGE;
+            if (delays[i * size + j] != NO_EDGE)
+            {
+                nodes[j].preds++;
+            }
+        }
+    }
+    for (size_t i = size; i-- > 0;)
+    {
+        nodes[i].height = tuning->latency[nodes[i].latencyClass];
+        for (size_t j = i + 1; j < size; j++)
+        {
+            if (delays[i * size + j] != NO_EDGE && (unsigned)delays[i * size + j] + nodes[j].height > nodes[i].height)
+            {
+                nodes[i].height = (unsigned)delays[i * size + j] + nodes[j].height;
+            }
+        }
+    }
+
+    size_t order[MAX_REGION];
+    size_t live[2] = {0, 0};
+    unsigned cycle = 0;
+    unsigned divFree = 0;
+    for (size_t scheduled = 0; scheduled < size;)
+    {
+        // before allocation, once the live values near what the registers hold, the ones ending them come first
+        bool crowded = !afterAllocation && (live[0] >= pressureLimits[0] || live[1] >= pressureLimits[1]);
+        size_t best = size;
+        int bestChange = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            Node *node = &nodes[i];
+            bool isDiv = node->latencyClass == LAT_DIV || node->latencyClass == LAT_FP_DIV;
+            if (node->scheduled || node->preds != 0 || node->earliest > cycle || (isDiv && tuning->unpipelinedDiv && divFree > cycle))
+            {
+                continue;
+            }
+            int change = crowded ? pressureChange(node, totalUses, seenUses, definedHere) : 0;
+            if (best == size || change < bestChange || (change == bestChange && node->height > nodes[best].height))
+            {
+                best = i;
+                bestChange = change;
+            }
+        }
+        if (best == size)
+        {
+            cycle++;
+            continue;
+        }
+
+        Node *node = &nodes[best];
+        node->scheduled = true;
+        order[scheduled++] = node->index;
+        for (size_t j = best + 1; j < size; j++)
+        {
+            int delay = delays[best * size + j];
+            if (delay != NO_EDGE)
+            {
+                nodes[j].preds--;
+                if (cycle + (unsigned)delay > nodes[j].earliest)
+                {
+                    nodes[j].earliest = cycle + (unsigned)delay;
+                }
+            }
+        }
+        if (node->latencyClass == LAT_DIV || node->latencyClass == LAT_FP_DIV)
+        {
+            divFree = cycle + tuning->latency[node->latencyClass];
+        }
+        if (!afterAllocation)
+        {
+            for (size_t i = 0; i < node->useCount; i++)
+            {
+                Reg reg = node->uses[i];
+                if (isVirtualReg(reg) && ++seenUses[reg - VREG_BASE] == totalUses[reg - VREG_BASE] && definedHere[reg - VREG_BASE])
+                {
+                    live[isFloatReg(reg)]--;
+                    definedHere[reg - VREG_BASE] = false;
+                }
+            }
+            if (node->hasDef && isVirtualReg(node->def) && !definedHere[node->def - VREG_BASE] &&
+                seenUses[node->def - VREG_BASE] < totalUses[node->def - VREG_BASE])
+            {
+                live[isFloatReg(node->def)]++;
+                definedHere[node->def - VREG_BASE] = true;
+            }
+        }
+        cycle++;
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        if (nodes[i].hasDef && isVirtualReg(nodes[i].def))
+        {
+            definedHere[nodes[i].def - VREG_BASE] = false;
+        }
+    }
+    permute(func, first, order, size);
+    free(delays);
+}
+
+// Reorders each straight-line run of instructions to hide load-use and long latency delays on the tuned core
+void scheduleInstructions(MachineFunc *func, bool afterAllocation)
+{
+    size_t *totalUses = calloc(func->vregLimit + 1, sizeof(size_t));
+    size_t *seenUses = calloc(func->vregLimit + 1, sizeof(size_t));
+    bool *definedHere = calloc(func->vregLimit + 1, sizeof(bool));
+    if (totalUses == NULL || seenUses == NULL || definedHere == NULL)
+    {
+        abort();
+    }
+    for (size_t i = 0; i < func->size; i++)
+    {
+        RegRefs uses;
+        mirUses(func, i, &uses);
+        for (size_t j = 0; j < uses.count; j++)
+        {
+            if (isVirtualReg(uses.regs[j]))
+            {
+                totalUses[uses.regs[j] - VREG_BASE]++;
+            }
+        }
+    }
+
+    size_t first = 0;
+    while (first < func->size)
+    {
+        if (isBarrier(func, first, afterAllocation))
+        {
+            first++;
+            continue;
+        }
+        size_t end = first;
+        while (end < func->size && end - first < MAX_REGION && !isBarrier(func, end, afterAllocation))
+        {
+            end++;
+        }
+        if (end - first > 1)
+        {
+            scheduleRegion(func, first, end - first, afterAllocation, totalUses, seenUses, definedHere);
+        }
+        first = end;
+    }
+    free(totalUses);
+    free(seenUses);
+    free(definedHere);
+}
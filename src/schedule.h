@@ -0,0 +1,14 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+
+#include "mir.h"
+
+extern bool scheduleEnabled;     // before register allocation, on virtual registers
+extern bool postScheduleEnabled; // after allocation and the text passes
+
+bool setTuning(const char *name);
+void scheduleInstructions(MachineFunc *func, bool afterAllocation);
+
+#endif
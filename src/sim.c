@@ -0,0 +1,2726 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Small RV32IMFD simulator for the assembly emitted by c_compiler.
+// It assembles the supported subset itself (pseudo-instructions are expanded the
+// same way GNU as does), links any number of files, runs main() and reports
+// dynamic instruction statistics together with an estimated cycle count.
+
+#define MEM_SIZE (32u * 1024u * 1024u)
+#define TEXT_BASE 0x10000u
+#define DATA_BASE 0x400000u
+#define STACK_TOP (MEM_SIZE - 16u)
+#define HOST_BASE 0xFFFF0000u
+#define EXIT_ADDR 0xFFFFFFF0u
+
+typedef enum
+{
+    OP_LUI,
+    OP_AUIPC,
+    OP_JAL,
+    OP_JALR,
+    OP_BEQ,
+    OP_BNE,
+    OP_BLT,
+    OP_BGE,
+    OP_BLTU,
+    OP_BGEU,
+    OP_LB,
+    OP_LH,
+    OP_LW,
+    OP_LBU,
+    OP_LHU,
+    OP_SB,
+    OP_SH,
+    OP_SW,
+    OP_ADDI,
+    OP_SLTI,
+    OP_SLTIU,
+    OP_XORI,
+    OP_ORI,
+    OP_ANDI,
+    OP_SLLI,
+    OP_SRLI,
+    OP_SRAI,
+    OP_ADD,
+    OP_SUB,
+    OP_SLL,
+    OP_SLT,
+    OP_SLTU,
+    OP_XOR,
+    OP_SRL,
+    OP_SRA,
+    OP_OR,
+    OP_AND,
+    OP_MUL,
+    OP_MULH,
+    OP_MULHSU,
+    OP_MULHU,
+    OP_DIV,
+    OP_DIVU,
+    OP_REM,
+    OP_REMU,
+    OP_FLW,
+    OP_FSW,
+    OP_FLD,
+    OP_FSD,
+    OP_FADD_S,
+    OP_FSUB_S,
+    OP_FMUL_S,
+    OP_FDIV_S,
+    OP_FSQRT_S,
+    OP_FSGNJ_S,
+    OP_FSGNJN_S,
+    OP_FSGNJX_S,
+    OP_FMIN_S,
+    OP_FMAX_S,
+    OP_FEQ_S,
+    OP_FLT_S,
+    OP_FLE_S,
+    OP_FCVT_W_S,
+    OP_FCVT_WU_S,
+    OP_FCVT_S_W,
+    OP_FCVT_S_WU,
+    OP_FMV_X_W,
+    OP_FMV_W_X,
+    OP_FMADD_S,
+    OP_FMSUB_S,
+    OP_FADD_D,
+    OP_FSUB_D,
+    OP_FMUL_D,
+    OP_FDIV_D,
+    OP_FSQRT_D,
+    OP_FSGNJ_D,
+    OP_FSGNJN_D,
+    OP_FSGNJX_D,
+    OP_FMIN_D,
+    OP_FMAX_D,
+    OP_FEQ_D,
+    OP_FLT_D,
+    OP_FLE_D,
+    OP_FCVT_W_D,
+    OP_FCVT_WU_D,
+    OP_FCVT_D_W,
+    OP_FCVT_D_WU,
+    OP_FCVT_S_D,
+    OP_FCVT_D_S,
+    OP_FMADD_D,
+    OP_FMSUB_D,
+    OP_RDCYCLE,
+    OP_RDINSTRET,
+    OP_ECALL,
+    OP_EBREAK
+} SimOp;
+
+// Operand signatures, used both for parsing and for register class checks
+typedef enum
+{
+    FMT_U,    // rd, imm20
+    FMT_J,    // rd, label
+    FMT_JR,   // rd, imm(rs1)
+    FMT_B,    // rs1, rs2, label
+    FMT_L,    // rd, imm(rs1)
+    FMT_S,    // rs2, imm(rs1)
+    FMT_I,    // rd, rs1, imm
+    FMT_R,    // rd, rs1, rs2
+    FMT_FL,   // fd, imm(rs1)
+    FMT_FS,   // fs2, imm(rs1)
+    FMT_FR,   // fd, fs1, fs2
+    FMT_FR1,  // fd, fs1
+    FMT_FCMP, // rd, fs1, fs2
+    FMT_FTOI, // rd, fs1
+    FMT_ITOF, // fd, rs1
+    FMT_FR4,  // fd, fs1, fs2, fs3
+    FMT_CSR,  // rd
+    FMT_NONE
+} OpFormat;
+
+typedef enum
+{
+    CLASS_ALU,
+    CLASS_MUL,
+    CLASS_DIV,
+    CLASS_LOAD,
+    CLASS_STORE,
+    CLASS_BRANCH,
+    CLASS_JUMP,
+    CLASS_FP_ADD,
+    CLASS_FP_MUL,
+    CLASS_FP_DIV,
+    CLASS_FP_MISC,
+    CLASS_FP_LOAD,
+    CLASS_FP_STORE,
+    CLASS_SYSTEM,
+    CLASS_COUNT
+} InstrClass;
+
+typedef struct OpInfo
+{
+    const char *name;
+    SimOp op;
+    OpFormat format;
+    InstrClass instrClass;
+} OpInfo;
+
+static const OpInfo opTable[] = {
+    {"lui", OP_LUI, FMT_U, CLASS_ALU},
+    {"auipc", OP_AUIPC, FMT_U, CLASS_ALU},
+    {"jal", OP_JAL, FMT_J, CLASS_JUMP},
+    {"jalr", OP_JALR, FMT_JR, CLASS_JUMP},
+    {"beq", OP_BEQ, FMT_B, CLASS_BRANCH},
+    {"bne", OP_BNE, FMT_B, CLASS_BRANCH},
+    {"blt", OP_BLT, FMT_B, CLASS_BRANCH},
+    {"bge", OP_BGE, FMT_B, CLASS_BRANCH},
+    {"bltu", OP_BLTU, FMT_B, CLASS_BRANCH},
+    {"bgeu", OP_BGEU, FMT_B, CLASS_BRANCH},
+    {"lb", OP_LB, FMT_L, CLASS_LOAD},
+    {"lh", OP_LH, FMT_L, CLASS_LOAD},
+    {"lw", OP_LW, FMT_L, CLASS_LOAD},
+    {"lbu", OP_LBU, FMT_L, CLASS_LOAD},
+    {"lhu", OP_LHU, FMT_L, CLASS_LOAD},
+    {"sb", OP_SB, FMT_S, CLASS_STORE},
+    {"sh", OP_SH, FMT_S, CLASS_STORE},
+    {"sw", OP_SW, FMT_S, CLASS_STORE},
+    {"addi", OP_ADDI, FMT_I, CLASS_ALU},
+    {"slti", OP_SLTI, FMT_I, CLASS_ALU},
+    {"sltiu", OP_SLTIU, FMT_I, CLASS_ALU},
+    {"xori", OP_XORI, FMT_I, CLASS_ALU},
+    {"ori", OP_ORI, FMT_I, CLASS_ALU},
+    {"andi", OP_ANDI, FMT_I, CLASS_ALU},
+    {"slli", OP_SLLI, FMT_I, CLASS_ALU},
+    {"srli", OP_SRLI, FMT_I, CLASS_ALU},
+    {"srai", OP_SRAI, FMT_I, CLASS_ALU},
+    {"add", OP_ADD, FMT_R, CLASS_ALU},
+    {"sub", OP_SUB, FMT_R, CLASS_ALU},
+    {"sll", OP_SLL, FMT_R, CLASS_ALU},
+    {"slt", OP_SLT, FMT_R, CLASS_ALU},
+    {"sltu", OP_SLTU, FMT_R, CLASS_ALU},
+    {"xor", OP_XOR, FMT_R, CLASS_ALU},
+    {"srl", OP_SRL, FMT_R, CLASS_ALU},
+    {"sra", OP_SRA, FMT_R, CLASS_ALU},
+    {"or", OP_OR, FMT_R, CLASS_ALU},
+    {"and", OP_AND, FMT_R, CLASS_ALU},
+    {"mul", OP_MUL, FMT_R, CLASS_MUL},
+    {"mulh", OP_MULH, FMT_R, CLASS_MUL},
+    {"mulhsu", OP_MULHSU, FMT_R, CLASS_MUL},
+    {"mulhu", OP_MULHU, FMT_R, CLASS_MUL},
+    {"div", OP_DIV, FMT_R, CLASS_DIV},
+    {"divu", OP_DIVU, FMT_R, CLASS_DIV},
+    {"rem", OP_REM, FMT_R, CLASS_DIV},
+    {"remu", OP_REMU, FMT_R, CLASS_DIV},
+    {"flw", OP_FLW, FMT_FL, CLASS_FP_LOAD},
+    {"fsw", OP_FSW, FMT_FS, CLASS_FP_STORE},
+    {"fld", OP_FLD, FMT_FL, CLASS_FP_LOAD},
+    {"fsd", OP_FSD, FMT_FS, CLASS_FP_STORE},
+    {"fadd.s", OP_FADD_S, FMT_FR, CLASS_FP_ADD},
+    {"fsub.s", OP_FSUB_S, FMT_FR, CLASS_FP_ADD},
+    {"fmul.s", OP_FMUL_S, FMT_FR, CLASS_FP_MUL},
+    {"fdiv.s", OP_FDIV_S, FMT_FR, CLASS_FP_DIV},
+    {"fsqrt.s", OP_FSQRT_S, FMT_FR1, CLASS_FP_DIV},
+    {"fsgnj.s", OP_FSGNJ_S, FMT_FR, CLASS_FP_MISC},
+    {"fsgnjn.s", OP_FSGNJN_S, FMT_FR, CLASS_FP_MISC},
+    {"fsgnjx.s", OP_FSGNJX_S, FMT_FR, CLASS_FP_MISC},
+    {"fmin.s", OP_FMIN_S, FMT_FR, CLASS_FP_MISC},
+    {"fmax.s", OP_FMAX_S, FMT_FR, CLASS_FP_MISC},
+    {"feq.s", OP_FEQ_S, FMT_FCMP, CLASS_FP_MISC},
+    {"flt.s", OP_FLT_S, FMT_FCMP, CLASS_FP_MISC},
+    {"fle.s", OP_FLE_S, FMT_FCMP, CLASS_FP_MISC},
+    {"fcvt.w.s", OP_FCVT_W_S, FMT_FTOI, CLASS_FP_MISC},
+    {"fcvt.wu.s", OP_FCVT_WU_S, FMT_FTOI, CLASS_FP_MISC},
+    {"fcvt.s.w", OP_FCVT_S_W, FMT_ITOF, CLASS_FP_MISC},
+    {"fcvt.s.wu", OP_FCVT_S_WU, FMT_ITOF, CLASS_FP_MISC},
+    {"fmv.x.w", OP_FMV_X_W, FMT_FTOI, CLASS_FP_MISC},
+    {"fmv.w.x", OP_FMV_W_X, FMT_ITOF, CLASS_FP_MISC},
+    {"fmadd.s", OP_FMADD_S, FMT_FR4, CLASS_FP_MUL},
+    {"fmsub.s", OP_FMSUB_S, FMT_FR4, CLASS_FP_MUL},
+    {"fadd.d", OP_FADD_D, FMT_FR, CLASS_FP_ADD},
+    {"fsub.d", OP_FSUB_D, FMT_FR, CLASS_FP_ADD},
+    {"fmul.d", OP_FMUL_D, FMT_FR, CLASS_FP_MUL},
+    {"fdiv.d", OP_FDIV_D, FMT_FR, CLASS_FP_DIV},
+    {"fsqrt.d", OP_FSQRT_D, FMT_FR1, CLASS_FP_DIV},
+    {"fsgnj.d", OP_FSGNJ_D, FMT_FR, CLASS_FP_MISC},
+    {"fsgnjn.d", OP_FSGNJN_D, FMT_FR, CLASS_FP_MISC},
+    {"fsgnjx.d", OP_FSGNJX_D, FMT_FR, CLASS_FP_MISC},
+    {"fmin.d", OP_FMIN_D, FMT_FR, CLASS_FP_MISC},
+    {"fmax.d", OP_FMAX_D, FMT_FR, CLASS_FP_MISC},
+    {"feq.d", OP_FEQ_D, FMT_FCMP, CLASS_FP_MISC},
+    {"flt.d", OP_FLT_D, FMT_FCMP, CLASS_FP_MISC},
+    {"fle.d", OP_FLE_D, FMT_FCMP, CLASS_FP_MISC},
+    {"fcvt.w.d", OP_FCVT_W_D, FMT_FTOI, CLASS_FP_MISC},
+    {"fcvt.wu.d", OP_FCVT_WU_D, FMT_FTOI, CLASS_FP_MISC},
+    {"fcvt.d.w", OP_FCVT_D_W, FMT_ITOF, CLASS_FP_MISC},
+    {"fcvt.d.wu", OP_FCVT_D_WU, FMT_ITOF, CLASS_FP_MISC},
+    {"fcvt.s.d", OP_FCVT_S_D, FMT_FR1, CLASS_FP_MISC},
+    {"fcvt.d.s", OP_FCVT_D_S, FMT_FR1, CLASS_FP_MISC},
+    {"fmadd.d", OP_FMADD_D, FMT_FR4, CLASS_FP_MUL},
+    {"fmsub.d", OP_FMSUB_D, FMT_FR4, CLASS_FP_MUL},
+    {"rdcycle", OP_RDCYCLE, FMT_CSR, CLASS_SYSTEM},
+    {"rdinstret", OP_RDINSTRET, FMT_CSR, CLASS_SYSTEM},
+    {"ecall", OP_ECALL, FMT_NONE, CLASS_SYSTEM},
+    {"ebreak", OP_EBREAK, FMT_NONE, CLASS_SYSTEM},
+};
+
+static const char *classNames[CLASS_COUNT] = {
+    "alu", "mul", "div", "load", "store", "branch", "jump",
+    "fp-add", "fp-mul", "fp-div", "fp-misc", "fp-load", "fp-store", "system"};
+
+typedef enum
+{
+    RELOC_NONE,
+    RELOC_HI,       // %hi(sym)
+    RELOC_LO,       // %lo(sym)
+    RELOC_PCREL_HI, // auipc half of a pc-relative pair
+    RELOC_PCREL_LO, // second half, the auipc is the previous instruction
+    RELOC_PCREL     // branch and jump targets
+} RelocType;
+
+typedef struct Instr
+{
+    SimOp op;
+    InstrClass instrClass;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    uint8_t rs3;
+    int32_t imm;
+    RelocType reloc;
+    char *symbol;
+    size_t fileIndex;
+    size_t line;
+} Instr;
+
+typedef enum
+{
+    SECTION_TEXT,
+    SECTION_RODATA,
+    SECTION_DATA,
+    SECTION_SDATA,
+    SECTION_SBSS,
+    SECTION_BSS,
+    SECTION_PROFILE,           // the counters of -fprofile-generate
+    SECTION_FUNCTION_PROFILES, // the table of -fprofile-functions
+    SECTION_COUNT
+} SectionId;
+
+typedef struct Section
+{
+    uint8_t *bytes;
+    size_t size;
+    size_t capacity;
+    uint32_t base;
+} Section;
+
+typedef struct Symbol
+{
+    char *name;
+    size_t fileIndex; // SIZE_MAX for globals
+    SectionId section;
+    size_t offset;
+    bool defined;
+    bool isGlobal;
+} Symbol;
+
+// A data word that refers to a symbol, patched once every address is known
+typedef struct DataFixup
+{
+    SectionId section;
+    size_t offset;
+    char *symbol;
+    size_t fileIndex;
+} DataFixup;
+
+typedef struct HostFunc
+{
+    const char *name;
+    void (*func)(void);
+} HostFunc;
+
+typedef struct Stats
+{
+    uint64_t instrs;
+    uint64_t cycles;
+    uint64_t classCounts[CLASS_COUNT];
+    uint64_t loads;
+    uint64_t stores;
+    uint64_t branches;
+    uint64_t branchesTaken;
+    uint64_t mispredicts;
+    uint64_t jumps;
+    uint64_t calls;
+    uint64_t stallCycles;
+} Stats;
+
+// Latencies (in cycles until a result may be consumed) and branch costs of the
+// modelled in-order pipeline
+typedef struct PipelineModel
+{
+    const char *name;
+    unsigned latency[CLASS_COUNT];
+    bool unpipelinedDiv;
+    unsigned mispredictPenalty;
+    unsigned takenJumpPenalty;
+} PipelineModel;
+
+static const PipelineModel models[] = {
+    {"ideal", {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}, false, 0, 0},
+    {"generic", {1, 3, 20, 2, 1, 1, 1, 4, 4, 20, 2, 2, 1, 1}, true, 3, 1},
+    {"rocket", {1, 4, 33, 3, 1, 1, 1, 4, 4, 25, 2, 3, 1, 1}, true, 3, 2},
+    {"sifive-u74", {1, 3, 20, 3, 1, 1, 1, 5, 5, 33, 2, 3, 1, 1}, true, 4, 1},
+};
+
+static Section sections[SECTION_COUNT];
+static Instr *text;
+static size_t textSize;
+static size_t textCapacity;
+static Symbol *symbols;
+static size_t symbolCount;
+static size_t symbolCapacity;
+static DataFixup *fixups;
+static size_t fixupCount;
+static size_t fixupCapacity;
+static const char **fileNames;
+
+static uint8_t *memory;
+static uint32_t regs[32];
+static uint64_t fregs[32];
+static uint32_t pc;
+static Stats stats;
+static PipelineModel model;
+static bool halted;
+static int exitCode;
+
+static void fatal(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "rvsim: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+static void *growArray(void *array, size_t *capacity, size_t needed, size_t elemSize)
+{
+    if (needed <= *capacity)
+    {
+        return array;
+    }
+    size_t newCapacity = *capacity == 0 ? 16 : *capacity;
+    while (newCapacity < needed)
+    {
+        newCapacity *= 2;
+    }
+    array = realloc(array, newCapacity * elemSize);
+    if (array == NULL)
+    {
+        abort();
+    }
+    *capacity = newCapacity;
+    return array;
+}
+
+static char *strDup(const char *str, size_t len)
+{
+    char *copy = malloc(len + 1);
+    if (copy == NULL)
+    {
+        abort();
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// ---------------------------------------------------------------------------
+// Symbols and sections
+
+static Symbol *findSymbol(const char *name, size_t fileIndex)
+{
+    // file-local definitions shadow globals
+    for (size_t i = 0; i < symbolCount; i++)
+    {
+        if (symbols[i].fileIndex == fileIndex && strcmp(symbols[i].name, name) == 0)
+        {
+            return &symbols[i];
+        }
+    }
+    for (size_t i = 0; i < symbolCount; i++)
+    {
+        if (symbols[i].isGlobal && symbols[i].defined && strcmp(symbols[i].name, name) == 0)
+        {
+            return &symbols[i];
+        }
+    }
+    return NULL;
+}
+
+static Symbol *localSymbol(const char *name, size_t fileIndex)
+{
+    for (size_t i = 0; i < symbolCount; i++)
+    {
+        if (symbols[i].fileIndex == fileIndex && strcmp(symbols[i].name, name) == 0)
+        {
+            return &symbols[i];
+        }
+    }
+    symbols = growArray(symbols, &symbolCapacity, symbolCount + 1, sizeof(Symbol));
+    Symbol *symbol = &symbols[symbolCount++];
+    symbol->name = strDup(name, strlen(name));
+    symbol->fileIndex = fileIndex;
+    symbol->defined = false;
+    symbol->isGlobal = false;
+    symbol->section = SECTION_TEXT;
+    symbol->offset = 0;
+    return symbol;
+}
+
+static void sectionAppend(SectionId id, const void *data, size_t size)
+{
+    Section *section = &sections[id];
+    section->bytes = growArray(section->bytes, &section->capacity, section->size + size, 1);
+    if (data == NULL)
+    {
+        memset(section->bytes + section->size, 0, size);
+    }
+    else
+    {
+        memcpy(section->bytes + section->size, data, size);
+    }
+    section->size += size;
+}
+
+static size_t sectionOffset(SectionId id)
+{
+    return id == SECTION_TEXT ? textSize * 4 : sections[id].size;
+}
+
+// ---------------------------------------------------------------------------
+// Operand parsing
+
+typedef struct Line
+{
+    const char *fileName;
+    size_t fileIndex;
+    size_t lineNo;
+} Line;
+
+static Line current;
+
+static void asmError(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s:%zu: error: ", current.fileName, current.lineNo);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+static const char *intRegNames[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+
+static const char *fltRegNames[32] = {
+    "ft0", "ft1", "ft2", "ft3", "ft4", "ft5", "ft6", "ft7", "fs0", "fs1", "fa0", "fa1", "fa2", "fa3", "fa4", "fa5",
+    "fa6", "fa7", "fs2", "fs3", "fs4", "fs5", "fs6", "fs7", "fs8", "fs9", "fs10", "fs11", "ft8", "ft9", "ft10", "ft11"};
+
+static int parseIntReg(const char *str)
+{
+    if (strcmp(str, "fp") == 0)
+    {
+        return 8;
+    }
+    for (int i = 0; i < 32; i++)
+    {
+        if (strcmp(str, intRegNames[i]) == 0)
+        {
+            return i;
+        }
+    }
+    if (str[0] == 'x')
+    {
+        char *end;
+        long num = strtol(str + 1, &end, 10);
+        if (*end == '\0' && end != str + 1 && num >= 0 && num < 32)
+        {
+            return num;
+        }
+    }
+    return -1;
+}
+
+static int parseFltReg(const char *str)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        if (strcmp(str, fltRegNames[i]) == 0)
+        {
+            return i;
+        }
+    }
+    if (str[0] == 'f')
+    {
+        char *end;
+        long num = strtol(str + 1, &end, 10);
+        if (*end == '\0' && end != str + 1 && num >= 0 && num < 32)
+        {
+            return num;
+        }
+    }
+    return -1;
+}
+
+static uint8_t expectIntReg(const char *str)
+{
+    int reg = parseIntReg(str);
+    if (reg < 0)
+    {
+        asmError("illegal operands `%s', expected an integer register", str);
+    }
+    return reg;
+}
+
+static uint8_t expectFltReg(const char *str)
+{
+    int reg = parseFltReg(str);
+    if (reg < 0)
+    {
+        asmError("illegal operands `%s', expected a floating-point register", str);
+    }
+    return reg;
+}
+
+static bool parseNumber(const char *str, int64_t *value)
+{
+    char *end;
+    if (*str == '\0')
+    {
+        return false;
+    }
+    *value = strtoll(str, &end, 0);
+    return *end == '\0';
+}
+
+static bool isSymbolChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '$';
+}
+
+static bool isSymbolName(const char *str)
+{
+    if (*str == '\0' || (*str >= '0' && *str <= '9'))
+    {
+        return false;
+    }
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if (!isSymbolChar(*c))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// An immediate operand: a number, a symbol or a %hi/%lo modifier
+typedef struct Imm
+{
+    int64_t value;
+    RelocType reloc;
+    char *symbol;
+} Imm;
+
+static Imm parseImm(const char *str)
+{
+    Imm imm = {0, RELOC_NONE, NULL};
+    if (parseNumber(str, &imm.value))
+    {
+        return imm;
+    }
+    const char *modifiers[2] = {"%hi(", "%lo("};
+    RelocType relocs[2] = {RELOC_HI, RELOC_LO};
+    for (size_t i = 0; i < 2; i++)
+    {
+        size_t len = strlen(modifiers[i]);
+        if (strncmp(str, modifiers[i], len) == 0 && str[strlen(str) - 1] == ')')
+        {
+            imm.symbol = strDup(str + len, strlen(str) - len - 1);
+            imm.reloc = relocs[i];
+            if (!isSymbolName(imm.symbol))
+            {
+                asmError("bad relocation operand `%s'", str);
+            }
+            return imm;
+        }
+    }
+    if (isSymbolName(str))
+    {
+        imm.symbol = strDup(str, strlen(str));
+        imm.reloc = RELOC_PCREL;
+        return imm;
+    }
+    asmError("illegal immediate `%s'", str);
+    return imm;
+}
+
+// Parses "imm(reg)" memory operands, returns false for a bare symbol
+static bool parseMem(const char *str, Imm *imm, char *reg)
+{
+    size_t len = strlen(str);
+    if (len == 0 || str[len - 1] != ')')
+    {
+        return false;
+    }
+    size_t open = len - 1;
+    while (open > 0 && str[open] != '(')
+    {
+        open--;
+    }
+    if (str[open] != '(')
+    {
+        return false;
+    }
+    char *offset = strDup(str, open);
+    memcpy(reg, str + open + 1, len - open - 2);
+    reg[len - open - 2] = '\0';
+    if (*offset == '\0')
+    {
+        imm->value = 0;
+        imm->reloc = RELOC_NONE;
+        imm->symbol = NULL;
+    }
+    else
+    {
+        *imm = parseImm(offset);
+        if (imm->reloc == RELOC_PCREL)
+        {
+            asmError("bad memory offset `%s'", offset);
+        }
+    }
+    free(offset);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Assembly
+
+static const OpInfo *lookupOp(const char *name)
+{
+    for (size_t i = 0; i < sizeof(opTable) / sizeof(opTable[0]); i++)
+    {
+        if (strcmp(opTable[i].name, name) == 0)
+        {
+            return &opTable[i];
+        }
+    }
+    return NULL;
+}
+
+static Instr *pushInstr(const char *name)
+{
+    const OpInfo *info = lookupOp(name);
+    if (info == NULL)
+    {
+        abort();
+    }
+    text = growArray(text, &textCapacity, textSize + 1, sizeof(Instr));
+    Instr *instr = &text[textSize++];
+    memset(instr, 0, sizeof(Instr));
+    instr->op = info->op;
+    instr->instrClass = info->instrClass;
+    instr->fileIndex = current.fileIndex;
+    instr->line = current.lineNo;
+    return instr;
+}
+
+static void setImm(Instr *instr, Imm imm)
+{
+    instr->imm = imm.value;
+    instr->reloc = imm.reloc;
+    instr->symbol = imm.symbol;
+}
+
+static void checkCount(size_t count, size_t expected, const char *name)
+{
+    if (count != expected)
+    {
+        asmError("illegal operands for `%s'", name);
+    }
+}
+
+static bool fitsImm12(int64_t value)
+{
+    return value >= -2048 && value <= 2047;
+}
+
+static void emitLi(uint8_t rd, int64_t value)
+{
+    int32_t word = (int32_t)value;
+    if (fitsImm12(word))
+    {
+        Instr *addi = pushInstr("addi");
+        addi->rd = rd;
+        addi->imm = word;
+        return;
+    }
+    int32_t lo = ((word & 0xfff) ^ 0x800) - 0x800;
+    int32_t hi = (int32_t)((uint32_t)(word - lo) >> 12);
+    Instr *lui = pushInstr("lui");
+    lui->rd = rd;
+    lui->imm = hi;
+    if (lo != 0)
+    {
+        Instr *addi = pushInstr("addi");
+        addi->rd = rd;
+        addi->rs1 = rd;
+        addi->imm = lo;
+    }
+}
+
+// Emits an auipc based pair used for symbol addressing pseudo-instructions
+static Instr *emitPcrel(const char *secondOp, uint8_t auipcReg, const char *symbol)
+{
+    Instr *auipc = pushInstr("auipc");
+    auipc->rd = auipcReg;
+    auipc->reloc = RELOC_PCREL_HI;
+    auipc->symbol = strDup(symbol, strlen(symbol));
+    Instr *second = pushInstr(secondOp);
+    second->rs1 = auipcReg;
+    second->reloc = RELOC_PCREL_LO;
+    second->symbol = strDup(symbol, strlen(symbol));
+    return second;
+}
+
+static void emitBranch(const char *name, uint8_t rs1, uint8_t rs2, const char *target)
+{
+    Instr *branch = pushInstr(name);
+    branch->rs1 = rs1;
+    branch->rs2 = rs2;
+    setImm(branch, parseImm(target));
+    if (branch->reloc != RELOC_PCREL)
+    {
+        asmError("branch target must be a label");
+    }
+}
+
+static bool assemblePseudo(const char *name, char **ops, size_t count)
+{
+    if (strcmp(name, "nop") == 0)
+    {
+        checkCount(count, 0, name);
+        pushInstr("addi");
+    }
+    else if (strcmp(name, "li") == 0)
+    {
+        checkCount(count, 2, name);
+        int64_t value;
+        if (!parseNumber(ops[1], &value))
+        {
+            asmError("illegal immediate `%s'", ops[1]);
+        }
+        emitLi(expectIntReg(ops[0]), value);
+    }
+    else if (strcmp(name, "la") == 0 || strcmp(name, "lla") == 0)
+    {
+        checkCount(count, 2, name);
+        uint8_t rd = expectIntReg(ops[0]);
+        Instr *addi = emitPcrel("addi", rd, ops[1]);
+        addi->rd = rd;
+    }
+    else if (strcmp(name, "mv") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *addi = pushInstr("addi");
+        addi->rd = expectIntReg(ops[0]);
+        addi->rs1 = expectIntReg(ops[1]);
+    }
+    else if (strcmp(name, "not") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *xori = pushInstr("xori");
+        xori->rd = expectIntReg(ops[0]);
+        xori->rs1 = expectIntReg(ops[1]);
+        xori->imm = -1;
+    }
+    else if (strcmp(name, "neg") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *sub = pushInstr("sub");
+        sub->rd = expectIntReg(ops[0]);
+        sub->rs2 = expectIntReg(ops[1]);
+    }
+    else if (strcmp(name, "seqz") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *sltiu = pushInstr("sltiu");
+        sltiu->rd = expectIntReg(ops[0]);
+        sltiu->rs1 = expectIntReg(ops[1]);
+        sltiu->imm = 1;
+    }
+    else if (strcmp(name, "snez") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *sltu = pushInstr("sltu");
+        sltu->rd = expectIntReg(ops[0]);
+        sltu->rs2 = expectIntReg(ops[1]);
+    }
+    else if (strcmp(name, "sltz") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *slt = pushInstr("slt");
+        slt->rd = expectIntReg(ops[0]);
+        slt->rs1 = expectIntReg(ops[1]);
+    }
+    else if (strcmp(name, "sgtz") == 0)
+    {
+        checkCount(count, 2, name);
+        Instr *slt = pushInstr("slt");
+        slt->rd = expectIntReg(ops[0]);
+        slt->rs2 = expectIntReg(ops[1]);
+    }
+    else if (strcmp(name, "beqz") == 0 || strcmp(name, "bnez") == 0 || strcmp(name, "bltz") == 0 || strcmp(name, "bgez") == 0)
+    {
+        checkCount(count, 2, name);
+        const char *real = name[1] == 'e' ? "beq" : name[1] == 'n' ? "bne"
+                                                : name[1] == 'l'   ? "blt"
+                                                                   : "bge";
+        emitBranch(real, expectIntReg(ops[0]), 0, ops[1]);
+    }
+    else if (strcmp(name, "blez") == 0)
+    {
+        checkCount(count, 2, name);
+        emitBranch("bge", 0, expectIntReg(ops[0]), ops[1]);
+    }
+    else if (strcmp(name, "bgtz") == 0)
+    {
+        checkCount(count, 2, name);
+        emitBranch("blt", 0, expectIntReg(ops[0]), ops[1]);
+    }
+    else if (strcmp(name, "bgt") == 0 || strcmp(name, "ble") == 0 || strcmp(name, "bgtu") == 0 || strcmp(name, "bleu") == 0)
+    {
+        checkCount(count, 3, name);
+        const char *real = strcmp(name, "bgt") == 0 ? "blt" : strcmp(name, "ble") == 0 ? "bge"
+                                                          : strcmp(name, "bgtu") == 0  ? "bltu"
+                                                                                       : "bgeu";
+        emitBranch(real, expectIntReg(ops[1]), expectIntReg(ops[0]), ops[2]);
+    }
+    else if (strcmp(name, "j") == 0)
+    {
+        checkCount(count, 1, name);
+        Instr *jal = pushInstr("jal");
+        setImm(jal, parseImm(ops[0]));
+    }
+    else if (strcmp(name, "jr") == 0)
+    {
+        checkCount(count, 1, name);
+        Instr *jalr = pushInstr("jalr");
+        jalr->rs1 = expectIntReg(ops[0]);
+    }
+    else if (strcmp(name, "ret") == 0)
+    {
+        checkCount(count, 0, name);
+        Instr *jalr = pushInstr("jalr");
+        jalr->rs1 = 1;
+    }
+    else if (strcmp(name, "call") == 0 || strcmp(name, "tail") == 0)
+    {
+        checkCount(count, 1, name);
+        bool isCall = name[0] == 'c';
+        Instr *jalr = emitPcrel("jalr", isCall ? 1 : 6, ops[0]);
+        jalr->rd = isCall ? 1 : 0;
+    }
+    else if (strcmp(name, "fmv.s") == 0 || strcmp(name, "fneg.s") == 0 || strcmp(name, "fabs.s") == 0 ||
+             strcmp(name, "fmv.d") == 0 || strcmp(name, "fneg.d") == 0 || strcmp(name, "fabs.d") == 0)
+    {
+        checkCount(count, 2, name);
+        bool isDouble = name[strlen(name) - 1] == 'd';
+        const char *real;
+        if (name[1] == 'm')
+        {
+            real = isDouble ? "fsgnj.d" : "fsgnj.s";
+        }
+        else if (name[1] == 'n')
+        {
+            real = isDouble ? "fsgnjn.d" : "fsgnjn.s";
+        }
+        else
+        {
+            real = isDouble ? "fsgnjx.d" : "fsgnjx.s";
+        }
+        Instr *instr = pushInstr(real);
+        instr->rd = expectFltReg(ops[0]);
+        instr->rs1 = expectFltReg(ops[1]);
+        instr->rs2 = instr->rs1;
+    }
+    else if (strcmp(name, "fmv.x.s") == 0 || strcmp(name, "fmv.s.x") == 0)
+    {
+        return assemblePseudo(name[4] == 'x' ? "fmv.x.w" : "fmv.w.x", ops, count);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static void assembleInstr(const char *name, char **ops, size_t count)
+{
+    if (assemblePseudo(name, ops, count))
+    {
+        return;
+    }
+    const OpInfo *info = lookupOp(name);
+    if (info == NULL)
+    {
+        asmError("unrecognized opcode `%s'", name);
+    }
+    char reg[64];
+    Imm imm;
+    switch (info->format)
+    {
+    case FMT_U:
+    {
+        checkCount(count, 2, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectIntReg(ops[0]);
+        setImm(instr, parseImm(ops[1]));
+        if (instr->reloc == RELOC_PCREL || instr->reloc == RELOC_LO)
+        {
+            asmError("illegal operands for `%s'", name);
+        }
+        break;
+    }
+    case FMT_J:
+    {
+        if (count == 1)
+        {
+            Instr *instr = pushInstr(name);
+            instr->rd = 1;
+            setImm(instr, parseImm(ops[0]));
+        }
+        else
+        {
+            checkCount(count, 2, name);
+            Instr *instr = pushInstr(name);
+            instr->rd = expectIntReg(ops[0]);
+            setImm(instr, parseImm(ops[1]));
+        }
+        break;
+    }
+    case FMT_JR:
+    {
+        Instr *instr = pushInstr(name);
+        if (count == 1)
+        {
+            instr->rd = 1;
+            instr->rs1 = expectIntReg(ops[0]);
+        }
+        else if (count == 2 && parseMem(ops[1], &imm, reg))
+        {
+            instr->rd = expectIntReg(ops[0]);
+            instr->rs1 = expectIntReg(reg);
+            setImm(instr, imm);
+        }
+        else
+        {
+            checkCount(count, 3, name);
+            instr->rd = expectIntReg(ops[0]);
+            instr->rs1 = expectIntReg(ops[1]);
+            setImm(instr, parseImm(ops[2]));
+        }
+        break;
+    }
+    case FMT_B:
+    {
+        checkCount(count, 3, name);
+        emitBranch(name, expectIntReg(ops[0]), expectIntReg(ops[1]), ops[2]);
+        break;
+    }
+    case FMT_L:
+    case FMT_FL:
+    {
+        bool isFloat = info->format == FMT_FL;
+        if (count == 2 && parseMem(ops[1], &imm, reg))
+        {
+            Instr *instr = pushInstr(name);
+            instr->rd = isFloat ? expectFltReg(ops[0]) : expectIntReg(ops[0]);
+            instr->rs1 = expectIntReg(reg);
+            setImm(instr, imm);
+        }
+        else if ((count == 2 && !isFloat) || count == 3)
+        {
+            // load from a symbol: "lw rd, sym" or "flw fd, sym, rt"
+            if (!isSymbolName(ops[1]))
+            {
+                asmError("illegal operands for `%s'", name);
+            }
+            uint8_t rd = isFloat ? expectFltReg(ops[0]) : expectIntReg(ops[0]);
+            uint8_t tmp = count == 3 ? expectIntReg(ops[2]) : rd;
+            Instr *instr = emitPcrel(name, tmp, ops[1]);
+            instr->rd = rd;
+        }
+        else
+        {
+            asmError("illegal operands for `%s'", name);
+        }
+        break;
+    }
+    case FMT_S:
+    case FMT_FS:
+    {
+        bool isFloat = info->format == FMT_FS;
+        if (count == 2 && parseMem(ops[1], &imm, reg))
+        {
+            Instr *instr = pushInstr(name);
+            instr->rs2 = isFloat ? expectFltReg(ops[0]) : expectIntReg(ops[0]);
+            instr->rs1 = expectIntReg(reg);
+            setImm(instr, imm);
+        }
+        else if (count == 3 && isSymbolName(ops[1]))
+        {
+            // store to a symbol: "sw rs, sym, rt"
+            uint8_t rs2 = isFloat ? expectFltReg(ops[0]) : expectIntReg(ops[0]);
+            Instr *instr = emitPcrel(name, expectIntReg(ops[2]), ops[1]);
+            instr->rs2 = rs2;
+        }
+        else
+        {
+            asmError("illegal operands for `%s'", name);
+        }
+        break;
+    }
+    case FMT_I:
+    {
+        checkCount(count, 3, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectIntReg(ops[0]);
+        instr->rs1 = expectIntReg(ops[1]);
+        setImm(instr, parseImm(ops[2]));
+        if (instr->reloc == RELOC_PCREL || instr->reloc == RELOC_HI)
+        {
+            asmError("illegal operands for `%s'", name);
+        }
+        if (instr->reloc == RELOC_NONE && !fitsImm12(instr->imm) &&
+            instr->op != OP_SLLI && instr->op != OP_SRLI && instr->op != OP_SRAI)
+        {
+            asmError("illegal operands `%s', immediate out of range", ops[2]);
+        }
+        break;
+    }
+    case FMT_R:
+    {
+        checkCount(count, 3, name);
+        if (parseIntReg(ops[2]) < 0)
+        {
+            // GNU as accepts register-immediate forms of ALU instructions
+            char immName[16];
+            snprintf(immName, sizeof(immName), "%si", name);
+            if (strcmp(name, "sltu") == 0)
+            {
+                strcpy(immName, "sltiu");
+            }
+            if (lookupOp(immName) == NULL || info->instrClass != CLASS_ALU || strcmp(name, "sub") == 0)
+            {
+                asmError("illegal operands `%s', expected an integer register", ops[2]);
+            }
+            assembleInstr(immName, ops, count);
+            break;
+        }
+        Instr *instr = pushInstr(name);
+        instr->rd = expectIntReg(ops[0]);
+        instr->rs1 = expectIntReg(ops[1]);
+        instr->rs2 = expectIntReg(ops[2]);
+        break;
+    }
+    case FMT_FR:
+    {
+        checkCount(count, 3, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectFltReg(ops[0]);
+        instr->rs1 = expectFltReg(ops[1]);
+        instr->rs2 = expectFltReg(ops[2]);
+        break;
+    }
+    case FMT_FR1:
+    {
+        checkCount(count, 2, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectFltReg(ops[0]);
+        instr->rs1 = expectFltReg(ops[1]);
+        break;
+    }
+    case FMT_FCMP:
+    {
+        checkCount(count, 3, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectIntReg(ops[0]);
+        instr->rs1 = expectFltReg(ops[1]);
+        instr->rs2 = expectFltReg(ops[2]);
+        break;
+    }
+    case FMT_FTOI:
+    {
+        if (count != 2 && count != 3)
+        {
+            checkCount(count, 2, name);
+        }
+        Instr *instr = pushInstr(name);
+        instr->rd = expectIntReg(ops[0]);
+        instr->rs1 = expectFltReg(ops[1]);
+        break;
+    }
+    case FMT_ITOF:
+    {
+        if (count != 2 && count != 3)
+        {
+            checkCount(count, 2, name);
+        }
+        Instr *instr = pushInstr(name);
+        instr->rd = expectFltReg(ops[0]);
+        instr->rs1 = expectIntReg(ops[1]);
+        break;
+    }
+    case FMT_FR4:
+    {
+        checkCount(count, 4, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectFltReg(ops[0]);
+        instr->rs1 = expectFltReg(ops[1]);
+        instr->rs2 = expectFltReg(ops[2]);
+        instr->rs3 = expectFltReg(ops[3]);
+        break;
+    }
+    case FMT_CSR:
+    {
+        checkCount(count, 1, name);
+        Instr *instr = pushInstr(name);
+        instr->rd = expectIntReg(ops[0]);
+        break;
+    }
+    case FMT_NONE:
+    {
+        checkCount(count, 0, name);
+        pushInstr(name);
+        break;
+    }
+    }
+}
+
+// Splits operands on top-level commas, strips whitespace
+static size_t splitOperands(char *str, char **ops, size_t maxOps)
+{
+    size_t count = 0;
+    int depth = 0;
+    bool inString = false;
+    char *start = str;
+    for (char *c = str;; c++)
+    {
+        if (*c == '"' && (c == str || c[-1] != '\\'))
+        {
+            inString = !inString;
+        }
+        if (!inString && *c == '(')
+        {
+            depth++;
+        }
+        if (!inString && *c == ')')
+        {
+            depth--;
+        }
+        if (*c == '\0' || (!inString && depth == 0 && *c == ','))
+        {
+            bool end = *c == '\0';
+            *c = '\0';
+            while (*start == ' ' || *start == '\t')
+            {
+                start++;
+            }
+            char *last = start + strlen(start);
+            while (last > start && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+            {
+                *--last = '\0';
+            }
+            if (*start != '\0' || count > 0 || !end)
+            {
+                if (count == maxOps)
+                {
+                    asmError("too many operands");
+                }
+                ops[count++] = start;
+            }
+            if (end)
+            {
+                break;
+            }
+            start = c + 1;
+        }
+    }
+    return count;
+}
+
+// sections named like C identifiers, which the linker brackets with __start_ and __stop_ symbols
+static const struct
+{
+    const char *name;
+    SectionId id;
+} namedSections[] = {{"profile_counters", SECTION_PROFILE}, {"function_profiles", SECTION_FUNCTION_PROFILES}};
+
+static SectionId parseSection(const char *name)
+{
+    if (strcmp(name, ".text") == 0 || strncmp(name, ".text.", 6) == 0)
+    {
+        return SECTION_TEXT;
+    }
+    if (strcmp(name, ".rodata") == 0 || strncmp(name, ".rodata.", 8) == 0 || strncmp(name, ".srodata", 8) == 0)
+    {
+        return SECTION_RODATA;
+    }
+    if (strcmp(name, ".data") == 0 || strncmp(name, ".data.", 6) == 0)
+    {
+        return SECTION_DATA;
+    }
+    if (strcmp(name, ".sdata") == 0 || strncmp(name, ".sdata.", 7) == 0)
+    {
+        return SECTION_SDATA;
+    }
+    if (strcmp(name, ".sbss") == 0 || strncmp(name, ".sbss.", 6) == 0)
+    {
+        return SECTION_SBSS;
+    }
+    if (strcmp(name, ".bss") == 0 || strncmp(name, ".bss.", 5) == 0)
+    {
+        return SECTION_BSS;
+    }
+    for (size_t i = 0; i < sizeof(namedSections) / sizeof(namedSections[0]); i++)
+    {
+        if (strcmp(name, namedSections[i].name) == 0)
+        {
+            return namedSections[i].id;
+        }
+    }
+    asmError("unknown section `%s'", name);
+    return SECTION_TEXT;
+}
+
+static void alignSection(SectionId id, size_t alignment)
+{
+    if (id == SECTION_TEXT)
+    {
+        // text is a list of 4-byte instructions, pad with nops
+        while ((textSize * 4) % alignment != 0)
+        {
+            pushInstr("addi");
+        }
+        return;
+    }
+    while (sections[id].size % alignment != 0)
+    {
+        sectionAppend(id, NULL, 1);
+    }
+}
+
+static size_t parseString(const char *str, char *out)
+{
+    size_t len = strlen(str);
+    if (len < 2 || str[0] != '"' || str[len - 1] != '"')
+    {
+        asmError("expected a string");
+    }
+    size_t outLen = 0;
+    for (size_t i = 1; i < len - 1; i++)
+    {
+        char c = str[i];
+        if (c == '\\' && i + 1 < len - 1)
+        {
+            c = str[++i];
+            switch (c)
+            {
+            case 'n':
+                c = '\n';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 'a':
+                c = '\a';
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'v':
+                c = '\v';
+                break;
+            default:
+                if (c >= '0' && c <= '7')
+                {
+                    int value = 0;
+                    for (int digits = 0; digits < 3 && str[i] >= '0' && str[i] <= '7'; digits++)
+                    {
+                        value = value * 8 + (str[i++] - '0');
+                    }
+                    i--;
+                    c = value;
+                }
+                break;
+            }
+        }
+        out[outLen++] = c;
+    }
+    return outLen;
+}
+
+static void dataWord(SectionId section, const char *operand)
+{
+    int64_t value;
+    if (section == SECTION_TEXT)
+    {
+        asmError("data in .text is not supported");
+    }
+    if (parseNumber(operand, &value))
+    {
+        uint32_t word = value;
+        sectionAppend(section, &word, 4);
+        return;
+    }
+    if (!isSymbolName(operand))
+    {
+        asmError("bad expression `%s'", operand);
+    }
+    fixups = growArray(fixups, &fixupCapacity, fixupCount + 1, sizeof(DataFixup));
+    fixups[fixupCount].section = section;
+    fixups[fixupCount].offset = sections[section].size;
+    fixups[fixupCount].symbol = strDup(operand, strlen(operand));
+    fixups[fixupCount].fileIndex = current.fileIndex;
+    fixupCount++;
+    sectionAppend(section, NULL, 4);
+}
+
+static void assembleDirective(SectionId *section, const char *name, char *rest)
+{
+    char *ops[64];
+    if (strcmp(name, ".text") == 0 || strcmp(name, ".data") == 0 || strcmp(name, ".bss") == 0 ||
+        strcmp(name, ".sdata") == 0 || strcmp(name, ".sbss") == 0 || strcmp(name, ".rodata") == 0)
+    {
+        *section = parseSection(name);
+    }
+    else if (strcmp(name, ".section") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        if (count == 0)
+        {
+            asmError("missing section name");
+        }
+        *section = parseSection(ops[0]);
+    }
+    else if (strcmp(name, ".globl") == 0 || strcmp(name, ".global") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        for (size_t i = 0; i < count; i++)
+        {
+            localSymbol(ops[i], current.fileIndex)->isGlobal = true;
+        }
+    }
+    else if (strcmp(name, ".align") == 0 || strcmp(name, ".p2align") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        int64_t value;
+        if (count < 1 || !parseNumber(ops[0], &value) || value < 0 || value > 12)
+        {
+            asmError("bad alignment");
+        }
+        alignSection(*section, (size_t)1 << value);
+    }
+    else if (strcmp(name, ".balign") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        int64_t value;
+        if (count < 1 || !parseNumber(ops[0], &value) || value <= 0)
+        {
+            asmError("bad alignment");
+        }
+        alignSection(*section, value);
+    }
+    else if (strcmp(name, ".word") == 0 || strcmp(name, ".4byte") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        for (size_t i = 0; i < count; i++)
+        {
+            dataWord(*section, ops[i]);
+        }
+    }
+    else if (strcmp(name, ".half") == 0 || strcmp(name, ".byte") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        size_t size = name[1] == 'h' ? 2 : 1;
+        for (size_t i = 0; i < count; i++)
+        {
+            int64_t value;
+            if (!parseNumber(ops[i], &value))
+            {
+                asmError("bad expression `%s'", ops[i]);
+            }
+            uint16_t half = value;
+            uint8_t byte = value;
+            sectionAppend(*section, size == 2 ? (void *)&half : (void *)&byte, size);
+        }
+    }
+    else if (strcmp(name, ".float") == 0 || strcmp(name, ".double") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        for (size_t i = 0; i < count; i++)
+        {
+            char *end;
+            double value = strtod(ops[i], &end);
+            if (*end != '\0')
+            {
+                asmError("bad floating-point constant `%s'", ops[i]);
+            }
+            if (name[1] == 'f')
+            {
+                float single = value;
+                sectionAppend(*section, &single, 4);
+            }
+            else
+            {
+                sectionAppend(*section, &value, 8);
+            }
+        }
+    }
+    else if (strcmp(name, ".zero") == 0 || strcmp(name, ".space") == 0 || strcmp(name, ".skip") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        int64_t value;
+        if (count < 1 || !parseNumber(ops[0], &value) || value < 0)
+        {
+            asmError("bad size");
+        }
+        sectionAppend(*section, NULL, value);
+    }
+    else if (strcmp(name, ".string") == 0 || strcmp(name, ".asciz") == 0 || strcmp(name, ".ascii") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        for (size_t i = 0; i < count; i++)
+        {
+            char *buffer = malloc(strlen(ops[i]) + 1);
+            size_t len = parseString(ops[i], buffer);
+            if (strcmp(name, ".ascii") != 0)
+            {
+                buffer[len++] = '\0';
+            }
+            sectionAppend(*section, buffer, len);
+            free(buffer);
+        }
+    }
+    else if (strcmp(name, ".comm") == 0 || strcmp(name, ".lcomm") == 0)
+    {
+        size_t count = splitOperands(rest, ops, 64);
+        int64_t size;
+        if (count < 2 || !parseNumber(ops[1], &size))
+        {
+            asmError("bad .comm");
+        }
+        alignSection(SECTION_BSS, 8);
+        Symbol *symbol = localSymbol(ops[0], current.fileIndex);
+        symbol->defined = true;
+        symbol->isGlobal = name[1] == 'c';
+        symbol->section = SECTION_BSS;
+        symbol->offset = sections[SECTION_BSS].size;
+        sectionAppend(SECTION_BSS, NULL, size);
+    }
+    // .type, .size, .file, .option, .attribute and friends carry no semantics here
+}
+
+static void assembleFile(const char *path, size_t fileIndex)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fatal("unable to open `%s'", path);
+    }
+    current.fileName = path;
+    current.fileIndex = fileIndex;
+    current.lineNo = 0;
+
+    SectionId section = SECTION_TEXT;
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    {
+        current.lineNo++;
+        // strip comments outside of strings
+        bool inString = false;
+        for (char *c = buffer; *c != '\0'; c++)
+        {
+            if (*c == '"' && (c == buffer || c[-1] != '\\'))
+            {
+                inString = !inString;
+            }
+            if (!inString && *c == '#')
+            {
+                *c = '\0';
+                break;
+            }
+        }
+        char *line = buffer;
+        line[strcspn(line, "\n")] = '\0';
+
+        // labels
+        for (;;)
+        {
+            while (*line == ' ' || *line == '\t')
+            {
+                line++;
+            }
+            char *colon = line;
+            while (isSymbolChar(*colon))
+            {
+                colon++;
+            }
+            if (colon == line || *colon != ':')
+            {
+                break;
+            }
+            *colon = '\0';
+            Symbol *symbol = localSymbol(line, fileIndex);
+            if (symbol->defined)
+            {
+                asmError("symbol `%s' is already defined", line);
+            }
+            symbol->defined = true;
+            symbol->section = section;
+            symbol->offset = sectionOffset(section);
+            line = colon + 1;
+        }
+        if (*line == '\0')
+        {
+            continue;
+        }
+
+        char *nameEnd = line;
+        while (*nameEnd != '\0' && *nameEnd != ' ' && *nameEnd != '\t')
+        {
+            nameEnd++;
+        }
+        char *rest = nameEnd;
+        if (*rest != '\0')
+        {
+            *rest++ = '\0';
+        }
+        if (line[0] == '.')
+        {
+            assembleDirective(&section, line, rest);
+            continue;
+        }
+        if (section != SECTION_TEXT)
+        {
+            asmError("instruction outside of .text");
+        }
+        char *ops[8];
+        size_t count = splitOperands(rest, ops, 8);
+        assembleInstr(line, ops, count);
+    }
+    fclose(file);
+}
+
+// ---------------------------------------------------------------------------
+// Host functions for the few libc routines the tests rely on
+
+static uint32_t hostCount;
+static const HostFunc *hostFuncs[64];
+
+static uint8_t *memAt(uint32_t addr, uint32_t size)
+{
+    if (addr < TEXT_BASE || (uint64_t)addr + size > MEM_SIZE)
+    {
+        // host functions run with pc in the stub range, which has no line to point at
+        if (pc < TEXT_BASE || pc >= TEXT_BASE + textSize * 4)
+        {
+            fatal("memory access out of bounds at 0x%08x (pc 0x%08x, host call)", addr, pc);
+        }
+        const Instr *instr = &text[(pc - TEXT_BASE) / 4];
+        fatal("memory access out of bounds at 0x%08x (pc 0x%08x, %s:%zu)", addr, pc, fileNames[instr->fileIndex],
+              instr->line);
+    }
+    return memory + addr;
+}
+
+static const char *hostString(uint32_t addr)
+{
+    const char *str = (const char *)memAt(addr, 1);
+    size_t len = 0;
+    while (addr + len < MEM_SIZE && str[len] != '\0')
+    {
+        len++;
+    }
+    memAt(addr, len + 1);
+    return str;
+}
+
+static void hostPutchar(void)
+{
+    putchar(regs[10]);
+}
+
+static void hostPuts(void)
+{
+    puts(hostString(regs[10]));
+}
+
+static void hostStrcmp(void)
+{
+    regs[10] = strcmp(hostString(regs[10]), hostString(regs[11]));
+}
+
+static void hostStrlen(void)
+{
+    regs[10] = strlen(hostString(regs[10]));
+}
+
+static void hostExit(void)
+{
+    halted = true;
+    exitCode = (int32_t)regs[10];
+}
+
+static void hostAbort(void)
+{
+    fatal("abort() called");
+}
+
+// Supports %d %i %u %x %c %s and %%, with integer arguments taken from a1-a7
+static void hostPrintf(void)
+{
+    const char *format = hostString(regs[10]);
+    size_t arg = 11;
+    for (const char *c = format; *c != '\0'; c++)
+    {
+        if (*c != '%')
+        {
+            putchar(*c);
+            continue;
+        }
+        c++;
+        uint32_t value = arg <= 17 ? regs[arg] : 0;
+        switch (*c)
+        {
+        case 'd':
+        case 'i':
+            printf("%d", (int32_t)value);
+            arg++;
+            break;
+        case 'u':
+            printf("%u", value);
+            arg++;
+            break;
+        case 'x':
+            printf("%x", value);
+            arg++;
+            break;
+        case 'c':
+            putchar(value);
+            arg++;
+            break;
+        case 's':
+            fputs(hostString(value), stdout);
+            arg++;
+            break;
+        case '%':
+            putchar('%');
+            break;
+        default:
+            fatal("printf: unsupported conversion `%%%c'", *c);
+        }
+    }
+}
+
+static const HostFunc hostTable[] = {
+    {"putchar", hostPutchar},
+    {"puts", hostPuts},
+    {"printf", hostPrintf},
+    {"strcmp", hostStrcmp},
+    {"strlen", hostStrlen},
+    {"exit", hostExit},
+    {"abort", hostAbort},
+};
+
+static bool resolveHost(const char *name, uint32_t *addr)
+{
+    for (uint32_t i = 0; i < hostCount; i++)
+    {
+        if (strcmp(hostFuncs[i]->name, name) == 0)
+        {
+            *addr = HOST_BASE + i * 4;
+            return true;
+        }
+    }
+    for (size_t i = 0; i < sizeof(hostTable) / sizeof(hostTable[0]); i++)
+    {
+        if (strcmp(hostTable[i].name, name) == 0)
+        {
+            hostFuncs[hostCount] = &hostTable[i];
+            *addr = HOST_BASE + hostCount * 4;
+            hostCount++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Linking
+
+static uint32_t symbolAddress(const char *name, size_t fileIndex, size_t line)
+{
+    if (strcmp(name, "__global_pointer$") == 0)
+    {
+        return sections[SECTION_SDATA].base + 0x800;
+    }
+    for (size_t i = 0; i < sizeof(namedSections) / sizeof(namedSections[0]); i++)
+    {
+        const Section *section = &sections[namedSections[i].id];
+        if (strncmp(name, "__start_", 8) == 0 && strcmp(name + 8, namedSections[i].name) == 0)
+        {
+            return section->base;
+        }
+        if (strncmp(name, "__stop_", 7) == 0 && strcmp(name + 7, namedSections[i].name) == 0)
+        {
+            return section->base + (uint32_t)section->size;
+        }
+    }
+    Symbol *symbol = findSymbol(name, fileIndex);
+    if (symbol == NULL || !symbol->defined)
+    {
+        uint32_t addr;
+        if (resolveHost(name, &addr))
+        {
+            return addr;
+        }
+        fatal("%s:%zu: undefined reference to `%s'", fileNames[fileIndex], line, name);
+    }
+    if (symbol->section == SECTION_TEXT)
+    {
+        return TEXT_BASE + symbol->offset;
+    }
+    return sections[symbol->section].base + symbol->offset;
+}
+
+static int32_t signExtend(uint32_t value, unsigned bits)
+{
+    uint32_t mask = 1u << (bits - 1);
+    value &= (bits == 32) ? 0xffffffffu : ((1u << bits) - 1);
+    return (int32_t)((value ^ mask) - mask);
+}
+
+static void link(void)
+{
+    uint32_t addr = DATA_BASE;
+    SectionId order[] = {SECTION_RODATA, SECTION_DATA, SECTION_PROFILE, SECTION_FUNCTION_PROFILES, SECTION_SDATA, SECTION_SBSS, SECTION_BSS};
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    {
+        addr = (addr + 15) & ~15u;
+        sections[order[i]].base = addr;
+        addr += sections[order[i]].size;
+    }
+    if (addr >= STACK_TOP - 0x100000)
+    {
+        fatal("program too large");
+    }
+    if (TEXT_BASE + textSize * 4 >= DATA_BASE)
+    {
+        fatal("text too large");
+    }
+
+    for (size_t i = 0; i < fixupCount; i++)
+    {
+        uint32_t value = symbolAddress(fixups[i].symbol, fixups[i].fileIndex, 0);
+        memcpy(sections[fixups[i].section].bytes + fixups[i].offset, &value, 4);
+    }
+
+    for (size_t i = 0; i < textSize; i++)
+    {
+        Instr *instr = &text[i];
+        if (instr->reloc == RELOC_NONE)
+        {
+            continue;
+        }
+        uint32_t instrPc = TEXT_BASE + i * 4;
+        uint32_t target = symbolAddress(instr->symbol, instr->fileIndex, instr->line) + instr->imm;
+        switch (instr->reloc)
+        {
+        case RELOC_HI:
+            instr->imm = (int32_t)((target + 0x800) >> 12);
+            break;
+        case RELOC_LO:
+            instr->imm = signExtend(target, 12);
+            break;
+        case RELOC_PCREL_HI:
+            instr->imm = (int32_t)((target - instrPc + 0x800) >> 12);
+            break;
+        case RELOC_PCREL_LO:
+            instr->imm = signExtend(target - (instrPc - 4), 12);
+            break;
+        case RELOC_PCREL:
+            instr->imm = (int32_t)(target - instrPc);
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < SECTION_COUNT; i++)
+    {
+        if (i != SECTION_TEXT && sections[i].size != 0)
+        {
+            memcpy(memory + sections[i].base, sections[i].bytes, sections[i].size);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Execution
+
+static float getF32(uint8_t reg)
+{
+    uint64_t bits = fregs[reg];
+    float value;
+    if ((bits >> 32) != 0xffffffffu)
+    {
+        uint32_t nan = 0x7fc00000u; // improperly NaN-boxed values read as the canonical NaN
+        memcpy(&value, &nan, 4);
+        return value;
+    }
+    uint32_t low = (uint32_t)bits;
+    memcpy(&value, &low, 4);
+    return value;
+}
+
+static void setF32(uint8_t reg, float value)
+{
+    uint32_t low;
+    memcpy(&low, &value, 4);
+    fregs[reg] = 0xffffffff00000000ull | low;
+}
+
+static double getF64(uint8_t reg)
+{
+    double value;
+    memcpy(&value, &fregs[reg], 8);
+    return value;
+}
+
+static void setF64(uint8_t reg, double value)
+{
+    memcpy(&fregs[reg], &value, 8);
+}
+
+static uint32_t load(uint32_t addr, uint32_t size)
+{
+    uint8_t *ptr = memAt(addr, size);
+    uint32_t value = 0;
+    memcpy(&value, ptr, size);
+    return value;
+}
+
+static void store(uint32_t addr, uint32_t value, uint32_t size)
+{
+    memcpy(memAt(addr, size), &value, size);
+}
+
+// openat, close and write as pk forwards them to the host, enough for a program to dump a profile
+static uint32_t fileSyscall(uint32_t number, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    static FILE *files[16];
+    switch (number)
+    {
+    case 56:
+    {
+        // only fresh files written from the start are supported
+        const char *path = hostString(a1);
+        (void)a0;
+        (void)a3;
+        if ((a2 & 3) != 1)
+        {
+            return (uint32_t)-1;
+        }
+        for (uint32_t fd = 3; fd < 16; fd++)
+        {
+            if (files[fd] == NULL)
+            {
+                files[fd] = fopen(path, "wb");
+                return files[fd] == NULL ? (uint32_t)-1 : fd;
+            }
+        }
+        return (uint32_t)-1;
+    }
+    case 57:
+        if (a0 < 16 && files[a0] != NULL)
+        {
+            fclose(files[a0]);
+            files[a0] = NULL;
+            return 0;
+        }
+        return (uint32_t)-1;
+    default:
+        if (a0 == 1 || a0 == 2)
+        {
+            fwrite(memAt(a1, a2), 1, a2, a0 == 1 ? stdout : stderr);
+            return a2;
+        }
+        if (a0 < 16 && files[a0] != NULL)
+        {
+            return (uint32_t)fwrite(memAt(a1, a2), 1, a2, files[a0]);
+        }
+        return (uint32_t)-1;
+    }
+}
+
+// Scoreboard for the pipeline model: cycle at which each register becomes available
+static uint64_t intReady[32];
+static uint64_t fltReady[32];
+static uint64_t divBusyUntil;
+
+static uint64_t maxU64(uint64_t a, uint64_t b)
+{
+    return a > b ? a : b;
+}
+
+static bool readsFltRs1(const Instr *instr)
+{
+    switch (instr->op)
+    {
+    case OP_FCVT_S_W:
+    case OP_FCVT_S_WU:
+    case OP_FMV_W_X:
+    case OP_FCVT_D_W:
+    case OP_FCVT_D_WU:
+    case OP_FLW:
+    case OP_FLD:
+    case OP_FSW:
+    case OP_FSD:
+        return false;
+    default:
+        return instr->op >= OP_FADD_S && instr->op <= OP_FMSUB_D;
+    }
+}
+
+static bool writesFltRd(const Instr *instr)
+{
+    switch (instr->op)
+    {
+    case OP_FSW:
+    case OP_FSD:
+    case OP_FEQ_S:
+    case OP_FLT_S:
+    case OP_FLE_S:
+    case OP_FEQ_D:
+    case OP_FLT_D:
+    case OP_FLE_D:
+    case OP_FCVT_W_S:
+    case OP_FCVT_WU_S:
+    case OP_FCVT_W_D:
+    case OP_FCVT_WU_D:
+    case OP_FMV_X_W:
+        return false;
+    default:
+        return instr->op >= OP_FLW && instr->op <= OP_FMSUB_D;
+    }
+}
+
+static bool readsRs2(const Instr *instr)
+{
+    switch (instr->instrClass)
+    {
+    case CLASS_BRANCH:
+    case CLASS_STORE:
+    case CLASS_FP_STORE:
+        return true;
+    case CLASS_ALU:
+    case CLASS_MUL:
+    case CLASS_DIV:
+        return instr->op >= OP_ADD && instr->op <= OP_REMU;
+    case CLASS_FP_ADD:
+    case CLASS_FP_MUL:
+    case CLASS_FP_DIV:
+    case CLASS_FP_MISC:
+        return instr->op != OP_FSQRT_S && instr->op != OP_FSQRT_D && readsFltRs1(instr) &&
+               instr->op != OP_FCVT_W_S && instr->op != OP_FCVT_WU_S && instr->op != OP_FCVT_W_D &&
+               instr->op != OP_FCVT_WU_D && instr->op != OP_FCVT_S_D && instr->op != OP_FCVT_D_S &&
+               instr->op != OP_FMV_X_W;
+    default:
+        return false;
+    }
+}
+
+static bool readsRs1(const Instr *instr)
+{
+    switch (instr->op)
+    {
+    case OP_LUI:
+    case OP_AUIPC:
+    case OP_JAL:
+    case OP_RDCYCLE:
+    case OP_RDINSTRET:
+    case OP_ECALL:
+    case OP_EBREAK:
+        return false;
+    default:
+        return true;
+    }
+}
+
+static void modelTiming(const Instr *instr, bool taken, bool backward)
+{
+    uint64_t issue = stats.cycles;
+    if (readsRs1(instr))
+    {
+        issue = maxU64(issue, readsFltRs1(instr) ? fltReady[instr->rs1] : intReady[instr->rs1]);
+    }
+    if (readsRs2(instr))
+    {
+        bool fltRs2 = instr->instrClass == CLASS_FP_STORE || (readsFltRs1(instr) && instr->instrClass != CLASS_FP_LOAD);
+        issue = maxU64(issue, fltRs2 ? fltReady[instr->rs2] : intReady[instr->rs2]);
+    }
+    if (instr->op == OP_FMADD_S || instr->op == OP_FMSUB_S || instr->op == OP_FMADD_D || instr->op == OP_FMSUB_D)
+    {
+        issue = maxU64(issue, fltReady[instr->rs3]);
+    }
+    if ((instr->instrClass == CLASS_DIV || instr->instrClass == CLASS_FP_DIV) && model.unpipelinedDiv)
+    {
+        issue = maxU64(issue, divBusyUntil);
+    }
+    stats.stallCycles += issue - stats.cycles;
+
+    uint64_t ready = issue + model.latency[instr->instrClass];
+    if ((instr->instrClass == CLASS_DIV || instr->instrClass == CLASS_FP_DIV) && model.unpipelinedDiv)
+    {
+        divBusyUntil = ready;
+    }
+    if (writesFltRd(instr))
+    {
+        fltReady[instr->rd] = ready;
+    }
+    else if (instr->instrClass != CLASS_STORE && instr->instrClass != CLASS_FP_STORE && instr->instrClass != CLASS_BRANCH && instr->rd != 0)
+    {
+        intReady[instr->rd] = ready;
+    }
+
+    uint64_t next = issue + 1;
+    if (instr->instrClass == CLASS_BRANCH)
+    {
+        // static backward-taken/forward-not-taken prediction
+        if (taken != backward)
+        {
+            next += model.mispredictPenalty;
+            stats.mispredicts++;
+        }
+    }
+    else if (instr->instrClass == CLASS_JUMP)
+    {
+        next += instr->op == OP_JALR ? model.mispredictPenalty : model.takenJumpPenalty;
+    }
+    stats.cycles = next;
+}
+
+static void step(void)
+{
+    if (pc >= HOST_BASE)
+    {
+        if (pc == EXIT_ADDR)
+        {
+            halted = true;
+            exitCode = (int32_t)regs[10];
+            return;
+        }
+        uint32_t index = (pc - HOST_BASE) / 4;
+        if (index >= hostCount)
+        {
+            fatal("jump to invalid address 0x%08x", pc);
+        }
+        hostFuncs[index]->func();
+        pc = regs[1];
+        return;
+    }
+    if (pc < TEXT_BASE || pc >= TEXT_BASE + textSize * 4 || (pc & 3) != 0)
+    {
+        fatal("jump to invalid address 0x%08x", pc);
+    }
+    const Instr *instr = &text[(pc - TEXT_BASE) / 4];
+    uint32_t rs1 = regs[instr->rs1];
+    uint32_t rs2 = regs[instr->rs2];
+    uint32_t nextPc = pc + 4;
+    uint32_t result = 0;
+    bool writeInt = true;
+    bool taken = false;
+
+    switch (instr->op)
+    {
+    case OP_LUI:
+        result = (uint32_t)instr->imm << 12;
+        break;
+    case OP_AUIPC:
+        result = pc + ((uint32_t)instr->imm << 12);
+        break;
+    case OP_JAL:
+        result = pc + 4;
+        nextPc = pc + instr->imm;
+        break;
+    case OP_JALR:
+        result = pc + 4;
+        nextPc = (rs1 + instr->imm) & ~1u;
+        break;
+    case OP_BEQ:
+        taken = rs1 == rs2;
+        writeInt = false;
+        break;
+    case OP_BNE:
+        taken = rs1 != rs2;
+        writeInt = false;
+        break;
+    case OP_BLT:
+        taken = (int32_t)rs1 < (int32_t)rs2;
+        writeInt = false;
+        break;
+    case OP_BGE:
+        taken = (int32_t)rs1 >= (int32_t)rs2;
+        writeInt = false;
+        break;
+    case OP_BLTU:
+        taken = rs1 < rs2;
+        writeInt = false;
+        break;
+    case OP_BGEU:
+        taken = rs1 >= rs2;
+        writeInt = false;
+        break;
+    case OP_LB:
+        result = (int32_t)(int8_t)load(rs1 + instr->imm, 1);
+        break;
+    case OP_LH:
+        result = (int32_t)(int16_t)load(rs1 + instr->imm, 2);
+        break;
+    case OP_LW:
+        result = load(rs1 + instr->imm, 4);
+        break;
+    case OP_LBU:
+        result = load(rs1 + instr->imm, 1);
+        break;
+    case OP_LHU:
+        result = load(rs1 + instr->imm, 2);
+        break;
+    case OP_SB:
+        store(rs1 + instr->imm, rs2, 1);
+        writeInt = false;
+        break;
+    case OP_SH:
+        store(rs1 + instr->imm, rs2, 2);
+        writeInt = false;
+        break;
+    case OP_SW:
+        store(rs1 + instr->imm, rs2, 4);
+        writeInt = false;
+        break;
+    case OP_ADDI:
+        result = rs1 + instr->imm;
+        break;
+    case OP_SLTI:
+        result = (int32_t)rs1 < instr->imm;
+        break;
+    case OP_SLTIU:
+        result = rs1 < (uint32_t)instr->imm;
+        break;
+    case OP_XORI:
+        result = rs1 ^ instr->imm;
+        break;
+    case OP_ORI:
+        result = rs1 | instr->imm;
+        break;
+    case OP_ANDI:
+        result = rs1 & instr->imm;
+        break;
+    case OP_SLLI:
+        result = rs1 << (instr->imm & 31);
+        break;
+    case OP_SRLI:
+        result = rs1 >> (instr->imm & 31);
+        break;
+    case OP_SRAI:
+        result = (uint32_t)((int32_t)rs1 >> (instr->imm & 31));
+        break;
+    case OP_ADD:
+        result = rs1 + rs2;
+        break;
+    case OP_SUB:
+        result = rs1 - rs2;
+        break;
+    case OP_SLL:
+        result = rs1 << (rs2 & 31);
+        break;
+    case OP_SLT:
+        result = (int32_t)rs1 < (int32_t)rs2;
+        break;
+    case OP_SLTU:
+        result = rs1 < rs2;
+        break;
+    case OP_XOR:
+        result = rs1 ^ rs2;
+        break;
+    case OP_SRL:
+        result = rs1 >> (rs2 & 31);
+        break;
+    case OP_SRA:
+        result = (uint32_t)((int32_t)rs1 >> (rs2 & 31));
+        break;
+    case OP_OR:
+        result = rs1 | rs2;
+        break;
+    case OP_AND:
+        result = rs1 & rs2;
+        break;
+    case OP_MUL:
+        result = rs1 * rs2;
+        break;
+    case OP_MULH:
+        result = (uint32_t)(((int64_t)(int32_t)rs1 * (int64_t)(int32_t)rs2) >> 32);
+        break;
+    case OP_MULHSU:
+        result = (uint32_t)(((int64_t)(int32_t)rs1 * (int64_t)(uint64_t)rs2) >> 32);
+        break;
+    case OP_MULHU:
+        result = (uint32_t)(((uint64_t)rs1 * (uint64_t)rs2) >> 32);
+        break;
+    case OP_DIV:
+        if (rs2 == 0)
+        {
+            result = 0xffffffffu;
+        }
+        else if (rs1 == 0x80000000u && rs2 == 0xffffffffu)
+        {
+            result = rs1;
+        }
+        else
+        {
+            result = (uint32_t)((int32_t)rs1 / (int32_t)rs2);
+        }
+        break;
+    case OP_DIVU:
+        result = rs2 == 0 ? 0xffffffffu : rs1 / rs2;
+        break;
+    case OP_REM:
+        if (rs2 == 0)
+        {
+            result = rs1;
+        }
+        else if (rs1 == 0x80000000u && rs2 == 0xffffffffu)
+        {
+            result = 0;
+        }
+        else
+        {
+            result = (uint32_t)((int32_t)rs1 % (int32_t)rs2);
+        }
+        break;
+    case OP_REMU:
+        result = rs2 == 0 ? rs1 : rs1 % rs2;
+        break;
+    case OP_FLW:
+        fregs[instr->rd] = 0xffffffff00000000ull | load(rs1 + instr->imm, 4);
+        writeInt = false;
+        break;
+    case OP_FLD:
+    {
+        uint64_t value = load(rs1 + instr->imm, 4) | ((uint64_t)load(rs1 + instr->imm + 4, 4) << 32);
+        fregs[instr->rd] = value;
+        writeInt = false;
+        break;
+    }
+    case OP_FSW:
+        store(rs1 + instr->imm, (uint32_t)fregs[instr->rs2], 4);
+        writeInt = false;
+        break;
+    case OP_FSD:
+        store(rs1 + instr->imm, (uint32_t)fregs[instr->rs2], 4);
+        store(rs1 + instr->imm + 4, (uint32_t)(fregs[instr->rs2] >> 32), 4);
+        writeInt = false;
+        break;
+    case OP_FADD_S:
+        setF32(instr->rd, getF32(instr->rs1) + getF32(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FSUB_S:
+        setF32(instr->rd, getF32(instr->rs1) - getF32(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FMUL_S:
+        setF32(instr->rd, getF32(instr->rs1) * getF32(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FDIV_S:
+        setF32(instr->rd, getF32(instr->rs1) / getF32(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FSQRT_S:
+        setF32(instr->rd, sqrtf(getF32(instr->rs1)));
+        writeInt = false;
+        break;
+    case OP_FSGNJ_S:
+    case OP_FSGNJN_S:
+    case OP_FSGNJX_S:
+    {
+        uint32_t a = (uint32_t)fregs[instr->rs1];
+        uint32_t b = (uint32_t)fregs[instr->rs2];
+        uint32_t sign = instr->op == OP_FSGNJ_S ? (b & 0x80000000u) : instr->op == OP_FSGNJN_S ? (~b & 0x80000000u)
+                                                                                                : ((a ^ b) & 0x80000000u);
+        fregs[instr->rd] = 0xffffffff00000000ull | (a & 0x7fffffffu) | sign;
+        writeInt = false;
+        break;
+    }
+    case OP_FMIN_S:
+        setF32(instr->rd, fminf(getF32(instr->rs1), getF32(instr->rs2)));
+        writeInt = false;
+        break;
+    case OP_FMAX_S:
+        setF32(instr->rd, fmaxf(getF32(instr->rs1), getF32(instr->rs2)));
+        writeInt = false;
+        break;
+    case OP_FEQ_S:
+        result = getF32(instr->rs1) == getF32(instr->rs2);
+        break;
+    case OP_FLT_S:
+        result = getF32(instr->rs1) < getF32(instr->rs2);
+        break;
+    case OP_FLE_S:
+        result = getF32(instr->rs1) <= getF32(instr->rs2);
+        break;
+    case OP_FCVT_W_S:
+        result = (uint32_t)(int32_t)truncf(getF32(instr->rs1));
+        break;
+    case OP_FCVT_WU_S:
+        result = (uint32_t)truncf(getF32(instr->rs1));
+        break;
+    case OP_FCVT_S_W:
+        setF32(instr->rd, (float)(int32_t)rs1);
+        writeInt = false;
+        break;
+    case OP_FCVT_S_WU:
+        setF32(instr->rd, (float)rs1);
+        writeInt = false;
+        break;
+    case OP_FMV_X_W:
+        result = (uint32_t)fregs[instr->rs1];
+        break;
+    case OP_FMV_W_X:
+        fregs[instr->rd] = 0xffffffff00000000ull | rs1;
+        writeInt = false;
+        break;
+    case OP_FMADD_S:
+        setF32(instr->rd, fmaf(getF32(instr->rs1), getF32(instr->rs2), getF32(instr->rs3)));
+        writeInt = false;
+        break;
+    case OP_FMSUB_S:
+        setF32(instr->rd, fmaf(getF32(instr->rs1), getF32(instr->rs2), -getF32(instr->rs3)));
+        writeInt = false;
+        break;
+    case OP_FADD_D:
+        setF64(instr->rd, getF64(instr->rs1) + getF64(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FSUB_D:
+        setF64(instr->rd, getF64(instr->rs1) - getF64(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FMUL_D:
+        setF64(instr->rd, getF64(instr->rs1) * getF64(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FDIV_D:
+        setF64(instr->rd, getF64(instr->rs1) / getF64(instr->rs2));
+        writeInt = false;
+        break;
+    case OP_FSQRT_D:
+        setF64(instr->rd, sqrt(getF64(instr->rs1)));
+        writeInt = false;
+        break;
+    case OP_FSGNJ_D:
+    case OP_FSGNJN_D:
+    case OP_FSGNJX_D:
+    {
+        uint64_t a = fregs[instr->rs1];
+        uint64_t b = fregs[instr->rs2];
+        uint64_t bit = 0x8000000000000000ull;
+        uint64_t sign = instr->op == OP_FSGNJ_D ? (b & bit) : instr->op == OP_FSGNJN_D ? (~b & bit)
+                                                                                        : ((a ^ b) & bit);
+        fregs[instr->rd] = (a & ~bit) | sign;
+        writeInt = false;
+        break;
+    }
+    case OP_FMIN_D:
+        setF64(instr->rd, fmin(getF64(instr->rs1), getF64(instr->rs2)));
+        writeInt = false;
+        break;
+    case OP_FMAX_D:
+        setF64(instr->rd, fmax(getF64(instr->rs1), getF64(instr->rs2)));
+        writeInt = false;
+        break;
+    case OP_FEQ_D:
+        result = getF64(instr->rs1) == getF64(instr->rs2);
+        break;
+    case OP_FLT_D:
+        result = getF64(instr->rs1) < getF64(instr->rs2);
+        break;
+    case OP_FLE_D:
+        result = getF64(instr->rs1) <= getF64(instr->rs2);
+        break;
+    case OP_FCVT_W_D:
+        result = (uint32_t)(int32_t)trunc(getF64(instr->rs1));
+        break;
+    case OP_FCVT_WU_D:
+        result = (uint32_t)trunc(getF64(instr->rs1));
+        break;
+    case OP_FCVT_D_W:
+        setF64(instr->rd, (double)(int32_t)rs1);
+        writeInt = false;
+        break;
+    case OP_FCVT_D_WU:
+        setF64(instr->rd, (double)rs1);
+        writeInt = false;
+        break;
+    case OP_FCVT_S_D:
+        setF32(instr->rd, (float)getF64(instr->rs1));
+        writeInt = false;
+        break;
+    case OP_FCVT_D_S:
+        setF64(instr->rd, (double)getF32(instr->rs1));
+        writeInt = false;
+        break;
+    case OP_FMADD_D:
+        setF64(instr->rd, fma(getF64(instr->rs1), getF64(instr->rs2), getF64(instr->rs3)));
+        writeInt = false;
+        break;
+    case OP_FMSUB_D:
+        setF64(instr->rd, fma(getF64(instr->rs1), getF64(instr->rs2), -getF64(instr->rs3)));
+        writeInt = false;
+        break;
+    case OP_RDCYCLE:
+        result = (uint32_t)stats.cycles;
+        break;
+    case OP_RDINSTRET:
+        result = (uint32_t)stats.instrs;
+        break;
+    case OP_ECALL:
+        // a7 = 93 is the exit system call used by newlib/pk
+        if (regs[17] == 93)
+        {
+            halted = true;
+            exitCode = (int32_t)regs[10];
+        }
+        else if (regs[17] == 56 || regs[17] == 57 || regs[17] == 64)
+        {
+            regs[10] = fileSyscall(regs[17], regs[10], regs[11], regs[12], regs[13]);
+        }
+        else
+        {
+            fatal("unsupported system call %u", regs[17]);
+        }
+        writeInt = false;
+        break;
+    case OP_EBREAK:
+        fatal("ebreak at 0x%08x", pc);
+        break;
+    }
+
+    if (instr->instrClass == CLASS_BRANCH && taken)
+    {
+        nextPc = pc + instr->imm;
+    }
+    if (writeInt && instr->rd != 0)
+    {
+        regs[instr->rd] = result;
+    }
+
+    stats.instrs++;
+    stats.classCounts[instr->instrClass]++;
+    if (instr->instrClass == CLASS_LOAD || instr->instrClass == CLASS_FP_LOAD)
+    {
+        stats.loads++;
+    }
+    if (instr->instrClass == CLASS_STORE || instr->instrClass == CLASS_FP_STORE)
+    {
+        stats.stores++;
+    }
+    if (instr->instrClass == CLASS_BRANCH)
+    {
+        stats.branches++;
+        stats.branchesTaken += taken;
+    }
+    if (instr->instrClass == CLASS_JUMP)
+    {
+        stats.jumps++;
+        stats.calls += instr->rd == 1;
+    }
+    modelTiming(instr, taken, instr->imm < 0);
+    pc = nextPc;
+}
+
+static void printStats(FILE *file)
+{
+    fprintf(file, "model            %s\n", model.name);
+    fprintf(file, "instructions     %llu\n", (unsigned long long)stats.instrs);
+    fprintf(file, "cycles           %llu\n", (unsigned long long)stats.cycles);
+    fprintf(file, "stall-cycles     %llu\n", (unsigned long long)stats.stallCycles);
+    fprintf(file, "loads            %llu\n", (unsigned long long)stats.loads);
+    fprintf(file, "stores           %llu\n", (unsigned long long)stats.stores);
+    fprintf(file, "branches         %llu\n", (unsigned long long)stats.branches);
+    fprintf(file, "branches-taken   %llu\n", (unsigned long long)stats.branchesTaken);
+    fprintf(file, "mispredicts      %llu\n", (unsigned long long)stats.mispredicts);
+    fprintf(file, "jumps            %llu\n", (unsigned long long)stats.jumps);
+    fprintf(file, "calls            %llu\n", (unsigned long long)stats.calls);
+    fprintf(file, "static-size      %zu\n", textSize * 4);
+    for (size_t i = 0; i < CLASS_COUNT; i++)
+    {
+        fprintf(file, "class.%-10s %llu\n", classNames[i], (unsigned long long)stats.classCounts[i]);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rvsim [--stats] [--model NAME] [--lat CLASS=N] [--max-instrs N] [--entry SYM] file.s...\n");
+    fprintf(stderr, "Models:");
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+    {
+        fprintf(stderr, " %s", models[i].name);
+    }
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    bool showStats = false;
+    uint64_t maxInstrs = 1000000000ull;
+    const char *entry = "main";
+    model = models[1];
+    fileNames = malloc(sizeof(char *) * argc);
+    size_t fileCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            showStats = true;
+        }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            bool found = false;
+            for (size_t j = 0; j < sizeof(models) / sizeof(models[0]); j++)
+            {
+                if (strcmp(models[j].name, name) == 0)
+                {
+                    model = models[j];
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                usage();
+            }
+        }
+        else if (strcmp(argv[i], "--lat") == 0 && i + 1 < argc)
+        {
+            char *setting = argv[++i];
+            char *equals = strchr(setting, '=');
+            bool found = false;
+            if (equals != NULL)
+            {
+                *equals = '\0';
+                for (size_t j = 0; j < CLASS_COUNT; j++)
+                {
+                    if (strcmp(classNames[j], setting) == 0)
+                    {
+                        model.latency[j] = strtoul(equals + 1, NULL, 0);
+                        found = true;
+                    }
+                }
+            }
+            if (!found)
+            {
+                usage();
+            }
+        }
+        else if (strcmp(argv[i], "--max-instrs") == 0 && i + 1 < argc)
+        {
+            maxInstrs = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc)
+        {
+            entry = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+        }
+        else
+        {
+            fileNames[fileCount++] = argv[i];
+        }
+    }
+    if (fileCount == 0)
+    {
+        usage();
+    }
+
+    for (size_t i = 0; i < fileCount; i++)
+    {
+        assembleFile(fileNames[i], i);
+    }
+    memory = calloc(MEM_SIZE, 1);
+    if (memory == NULL)
+    {
+        abort();
+    }
+    link();
+
+    Symbol *mainSymbol = NULL;
+    for (size_t i = 0; i < symbolCount; i++)
+    {
+        if (symbols[i].isGlobal && symbols[i].defined && strcmp(symbols[i].name, entry) == 0)
+        {
+            mainSymbol = &symbols[i];
+        }
+    }
+    if (mainSymbol == NULL || mainSymbol->section != SECTION_TEXT)
+    {
+        fatal("no global function `%s'", entry);
+    }
+
+    pc = TEXT_BASE + mainSymbol->offset;
+    regs[1] = EXIT_ADDR;
+    regs[2] = STACK_TOP;
+    regs[3] = sections[SECTION_SDATA].base + 0x800;
+    while (!halted)
+    {
+        if (stats.instrs >= maxInstrs)
+        {
+            fatal("instruction limit reached");
+        }
+        step();
+    }
+    fflush(stdout);
+    if (showStats)
+    {
+        printStats(stderr);
+    }
+    return exitCode & 0xff;
+}
@@ -17,6 +17,10 @@ int evaluateIntConstExpr(Expr *expr)
     {
     case CONSTANT_EXPR:
     {
+        if (expr->constant->type == CHAR_TYPE)
+        {
+            return (signed char)expr->constant->char_const;
+        }
         return expr->constant->int_const;
     }
     case OPERATION_EXPR:
@@ -36,9 +40,9 @@ int evaluateIntConstExpr(Expr *expr)
         switch(expr->operation->operator)
         {
             case ADD:
-                return op1 + op2;
+                return expr->operation->op2 == NULL ? op1 : op1 + op2;
             case SUB:
-                return op1 - op2;
+                return expr->operation->op2 == NULL ? -op1 : op1 - op2;
             case MUL:
                 return op1 * op2;
             case DIV:
@@ -688,13 +692,20 @@ char *IntToStr(int integer)
     return string;
 }
 
+// entry for a switch, numbered so its labels are unique in the file
+SymbolEntry *switchEntryCreate(void)
+{
+    SymbolEntry *switchEntry = symbolEntryCreate(IntToStr(switchCount), 0, 0, SWITCH_ENTRY);
+    switchCount += 1;
+    return switchEntry;
+}
+
 // switch statement second pass
 void scanSwitchStmt(SwitchStmt *switchStmt, SymbolTable *parentTable)
 {
-    SymbolEntry *switchEntry = symbolEntryCreate(IntToStr(switchCount), 0, 0, SWITCH_ENTRY);
+    SymbolEntry *switchEntry = switchEntryCreate();
     entryPush(parentTable, switchEntry);
     switchStmt->symbolEntry = switchEntry;
-    switchCount += 1;
     scanExpr(switchStmt->selector, parentTable);
     scanStmt(switchStmt->body, parentTable);
 }
@@ -710,13 +721,20 @@ void scanIfStmt(IfStmt *ifStmt, SymbolTable *parentTable)
     }
 }
 
+// entry for a for loop, numbered so its labels are unique in the file
+SymbolEntry *forEntryCreate(void)
+{
+    SymbolEntry *forEntry = symbolEntryCreate(IntToStr(forCount), 0, 0, FOR_ENTRY); // make identifier work
+    forCount += 1;
+    return forEntry;
+}
+
 // for statement second pass
 void scanForStmt(ForStmt *forStmt, SymbolTable *parentTable)
 {
-    SymbolEntry *forEntry = symbolEntryCreate(IntToStr(forCount), 0, 0, FOR_ENTRY); // make identifier work
+    SymbolEntry *forEntry = forEntryCreate();
     entryPush(parentTable, forEntry);
     forStmt->symbolEntry = forEntry;
-    forCount += 1;
 
     scanStmt(forStmt->init, parentTable);
     scanStmt(forStmt->condition, parentTable);
@@ -724,13 +742,20 @@ void scanForStmt(ForStmt *forStmt, SymbolTable *parentTable)
     scanExpr(forStmt->modifier, parentTable);
 }
 
+// entry for a while loop, numbered so its labels are unique in the file
+SymbolEntry *whileEntryCreate(void)
+{
+    SymbolEntry *whileEntry = symbolEntryCreate(IntToStr(whileCount), 0, 0, WHILE_ENTRY); // make identifier work
+    whileCount += 1;
+    return whileEntry;
+}
+
 // while statement second pass
 void scanWhileStmt(WhileStmt *whileStmt, SymbolTable *parentTable)
 {
-    SymbolEntry *whileEntry = symbolEntryCreate(IntToStr(whileCount), 0, 0, WHILE_ENTRY); // make identifier work
+    SymbolEntry *whileEntry = whileEntryCreate();
     entryPush(parentTable, whileEntry);
     whileStmt->symbolEntry = whileEntry;
-    whileCount += 1;
     scanExpr(whileStmt->condition, parentTable);
     scanStmt(whileStmt->body, parentTable);
 }
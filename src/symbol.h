@@ -44,6 +44,9 @@ typedef struct SymbolTable
 
 SymbolEntry *symbolEntryCreate(char *ident, size_t storageSize, size_t typeSize, EntryType entryType);
 void symbolEntryDestroy(SymbolEntry *symbolEntry);
+SymbolEntry *forEntryCreate(void);
+SymbolEntry *whileEntryCreate(void);
+SymbolEntry *switchEntryCreate(void);
 
 SymbolTable *symbolTableCreate(size_t entryLength, size_t childrenLength, SymbolTable *parentTable, SymbolEntry *masterFunc);
 void entryListResize(SymbolTable *symbolTable, size_t symbolTableSize);